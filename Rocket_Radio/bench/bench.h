@@ -0,0 +1,78 @@
+#ifndef bench_h
+#define bench_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <chrono>
+#include <vector>
+
+#include "sensor_data.h"
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// A data_pkg_t frame: type byte plus 48 bytes of sensor data.
+#define BENCH_FRAME_LEN 49
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+typedef std::chrono::steady_clock bench_clock_t;
+
+// Hdlc sink that just counts what it's given.
+struct bench_sink_t
+{
+    uint64_t bytes = 0;
+    uint32_t sum = 0;
+
+    void write( uint8_t data ) { bytes++; sum += data; }
+    void write( uint8_t const * data, size_t length ) { bytes += length; sum += data[0]; }
+};
+
+// Hdlc handler that counts frames.
+struct bench_handler_t
+{
+    uint64_t frames = 0;
+    uint32_t sum = 0;
+
+    void frame_received( uint8_t * data, uint16_t size ) { frames++; sum += data[0] + size; }
+};
+
+
+/******************************************************************************
+ *                          Function Declarations
+ *****************************************************************************/
+
+// Helpers
+double bench_seconds_since( bench_clock_t::time_point start );
+void bench_report( char const * name, double seconds, uint64_t bytes, uint64_t frames );
+void bench_fail( char const * name, char const * reason );
+void bench_keep( uint32_t value );
+bool bench_load( char const * path, std::vector<uint8_t> &data );
+data_pkg_t bench_flight_sample( uint32_t time_ms );
+void bench_random_frame( uint8_t * frame );
+
+// Benchmarks. Each one returns false if its self check failed.
+bool bench_crc();
+bool bench_hdlc_rx( char const * capture );
+bool bench_hdlc_tx();
+bool bench_escape();
+bool bench_xbee();
+bool bench_txq();
+bool bench_batch();
+bool bench_spsc();
+bool bench_codec();
+bool bench_sched();
+bool bench_bus();
+bool bench_prof();
+bool bench_nmea( char const * nmea_log );
+bool bench_fec();
+bool bench_trigger();
+bool bench_schema();
+bool bench_sdlog();
+bool bench_downlink();
+
+#endif
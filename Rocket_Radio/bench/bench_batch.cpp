@@ -0,0 +1,293 @@
+#include "bench.h"
+#include "telemetry/sensor_batch.h"
+#include "telemetry/tlm_codec.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define BATCH_BENCH_BAUD 9600
+
+// Simulated run time and loop() period.
+#define BATCH_BENCH_RUN_MS 10000
+#define BATCH_BENCH_TICK_US 1000
+
+// data_send_task period.
+#define BATCH_BENCH_SEND_MS 200
+
+// gps_send_task period and gps_data_t size.
+#define BATCH_BENCH_GPS_MS 1000
+#define BATCH_BENCH_GPS_LEN 17
+
+
+/******************************************************************************
+ *                               Local Types
+ *****************************************************************************/
+
+// How samples are sent.
+typedef uint8_t batch_mode_t;
+enum
+{
+    BATCH_SINGLE    = 0,    // Latest sample in a SENSOR_DATA frame, like data_send_task used to
+    BATCH_RAW       = 1,    // SensorBatch, SENSOR_BATCH frames
+    BATCH_CODED     = 2,    // SensorBatch, SENSOR_CODED frames
+
+    BATCH_MODE_CNT
+};
+
+// What one simulated run saw at the far end.
+struct batch_result_t
+{
+    uint32_t taken;
+    uint32_t delivered;
+    uint32_t frames;
+    uint32_t bad;
+    uint64_t wire_bytes;
+};
+
+
+/******************************************************************************
+ *                               Local Vars
+ *****************************************************************************/
+
+static char const * const batch_mode_names[BATCH_MODE_CNT] =
+{
+    "single",
+    "batched",
+    "coded",
+};
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   batch_sample
+*       Sample number n of a simulated flight.
+*       adc_chnl_0 carries n so the far side can check it.
+**********************************************************/
+static data_pkg_t batch_sample( uint32_t n, uint32_t sample_ms )
+{
+    data_pkg_t sample = bench_flight_sample( n * sample_ms );
+
+    sample.adc_chnl_0 = (uint16_t)( n & 0x3FF );
+
+    return sample;
+}
+
+
+/**********************************************************
+*   batch_check
+*       Count a sample the far side got.
+**********************************************************/
+static void batch_check( batch_result_t & result, int32_t & last_index, sensor_sample_t const & sample )
+{
+    if( ( (int32_t)sample.index <= last_index )
+     || ( sample.data.adc_chnl_0 != ( sample.index & 0x3FF ) ) )
+    {
+        result.bad++;
+    }
+
+    last_index = sample.index;
+    result.delivered++;
+}
+
+
+/**********************************************************
+*   batch_run
+*       Take a sample every sample_ms and send through an
+*       Xbee whose UART drains at BATCH_BENCH_BAUD.
+**********************************************************/
+static batch_result_t batch_run( uint32_t sample_ms, batch_mode_t mode )
+{
+    UARTClass tx_serial;
+    UARTClass rx_serial;
+    Xbee tx( &tx_serial );
+    Xbee rx( &rx_serial );
+    SensorBatch batch( &tx );
+    TlmDecoder decoder;
+    data_pkg_t latest;
+    uint8_t gps[ BATCH_BENCH_GPS_LEN ] = { 0 };
+    uint8_t wire[ 256 ];
+    int32_t last_index = -1;
+    batch_result_t result;
+
+    memset( &result, 0, sizeof(result) );
+
+    tx.setup( BATCH_BENCH_BAUD );
+    tx_serial.set_tx_limited( true );
+    batch.set_coded( mode == BATCH_CODED );
+
+    rx.set_frame_hndlr( SENSOR_DATA, [&]( uint8_t const *, uint16_t size )
+    {
+        result.frames++;
+        result.delivered += ( size == SENSOR_DATA_WIRE_SIZE ) ? 1 : 0;
+    });
+
+    rx.set_frame_hndlr( SENSOR_BATCH, [&]( uint8_t const * buffer, uint16_t size )
+    {
+        uint8_t count = buffer[0];
+        sensor_sample_t sample;
+
+        result.frames++;
+
+        if( ( count == 0 )
+         || ( size != 1 + count * SENSOR_SAMPLE_WIRE_SIZE ) )
+        {
+            result.bad++;
+            return;
+        }
+
+        for( uint8_t i = 0; i < count; i++ )
+        {
+            sensor_sample_unpack( &buffer[ 1 + i * SENSOR_SAMPLE_WIRE_SIZE ], sample );
+            batch_check( result, last_index, sample );
+        }
+    });
+
+    rx.set_frame_hndlr( SENSOR_CODED, [&]( uint8_t const * buffer, uint16_t size )
+    {
+        sensor_sample_t samples[ SENSOR_BATCH_RING_SIZE ];
+        uint8_t count = decoder.decode_frame( buffer, size, samples, SENSOR_BATCH_RING_SIZE );
+
+        result.frames++;
+
+        for( uint8_t i = 0; i < count; i++ )
+        {
+            batch_check( result, last_index, samples[i] );
+        }
+    });
+
+    for( uint32_t now_ms = 0; now_ms < BATCH_BENCH_RUN_MS; now_ms += BATCH_BENCH_TICK_US / 1000 )
+    {
+        if( now_ms % sample_ms == 0 )
+        {
+            latest = batch_sample( result.taken++, sample_ms );
+            if( mode != BATCH_SINGLE )
+            {
+                batch.add( latest );
+            }
+        }
+
+        if( now_ms % BATCH_BENCH_SEND_MS == 0 )
+        {
+            if( mode != BATCH_SINGLE )
+            {
+                batch.send();
+            }
+            else
+            {
+                tx.send_data( SENSOR_DATA, (uint8_t*)&latest, sizeof(latest), true );
+            }
+        }
+
+        if( now_ms % BATCH_BENCH_GPS_MS == 0 )
+        {
+            tx.send_data( GPS_DATA, gps, sizeof(gps), true );
+        }
+
+        tx.read();
+        tx_serial.run( BATCH_BENCH_TICK_US );
+
+        size_t count;
+        while( ( count = tx_serial.take_tx( wire, sizeof(wire) ) ) > 0 )
+        {
+            rx_serial.inject( wire, count );
+            result.wire_bytes += count;
+        }
+
+        rx.read();
+    }
+
+    return result;
+}
+
+
+/**********************************************************
+*   batch_report
+*       Print one simulated run.
+**********************************************************/
+static void batch_report( char const * name, batch_result_t const & r )
+{
+    printf( "%-32s %5u taken %5u delivered %5.1f%% %5u frames %6.1f samples/frame %6.1f wire bytes/sample\n",
+            name,
+            r.taken,
+            r.delivered,
+            100.0 * r.delivered / r.taken,
+            r.frames,
+            r.frames ? (double)r.delivered / r.frames : 0.0,
+            r.delivered ? (double)r.wire_bytes / r.delivered : 0.0 );
+}
+
+
+/**********************************************************
+*   bench_batch
+*       Single sample frames against SENSOR_BATCH and
+*       SENSOR_CODED frames at 9600 baud, at the current
+*       10Hz sample rate and faster. Checks samples arrive
+*       whole and in order, batches cost no more bytes per
+*       sample than single frames, and coding at least
+*       doubles the samples the link can carry.
+**********************************************************/
+bool bench_batch()
+{
+    bool ok = true;
+    static const uint32_t rates_ms[] = { 100, 50, 25, 20 };
+
+    printf( "%-32s %u samples per %u byte MTU\n", "batch", (unsigned)SENSOR_BATCH_MAX_SAMPLES, (unsigned)XBEE_MTU );
+
+    for( uint32_t sample_ms : rates_ms )
+    {
+        batch_result_t results[ BATCH_MODE_CNT ];
+        char name[ 64 ];
+
+        for( batch_mode_t mode = 0; mode < BATCH_MODE_CNT; mode++ )
+        {
+            results[mode] = batch_run( sample_ms, mode );
+
+            snprintf( name, sizeof(name), "batch %uHz %s", (unsigned)( 1000 / sample_ms ), batch_mode_names[mode] );
+            batch_report( name, results[mode] );
+
+            if( results[mode].bad != 0 )
+            {
+                bench_fail( name, "corrupt or out of order samples" );
+                ok = false;
+            }
+        }
+
+        batch_result_t const & single = results[ BATCH_SINGLE ];
+        batch_result_t const & batched = results[ BATCH_RAW ];
+        batch_result_t const & coded = results[ BATCH_CODED ];
+
+        // 10Hz fits in 9600 baud as is, up to 50Hz once coded. Allow
+        //  for the last frame still being on the wire.
+        if( ( ( sample_ms >= 100 )
+           && ( batched.delivered + SENSOR_BATCH_MAX_SAMPLES < batched.taken ) )
+         || ( coded.delivered + SENSOR_BATCH_RING_SIZE < coded.taken )
+         || ( batched.delivered < single.delivered ) )
+        {
+            bench_fail( name, "lost samples" );
+            ok = false;
+        }
+
+        if( batched.wire_bytes * single.delivered > single.wire_bytes * batched.delivered )
+        {
+            bench_fail( name, "more framing overhead than single frames" );
+            ok = false;
+        }
+
+        if( ( sample_ms <= 25 )
+         && ( coded.delivered < 2 * batched.delivered ) )
+        {
+            bench_fail( name, "coding didn't double the samples sent" );
+            ok = false;
+        }
+    }
+
+    return ok;
+}
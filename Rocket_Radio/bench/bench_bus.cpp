@@ -0,0 +1,462 @@
+#include "bench.h"
+#include "acq/acq_sched.h"
+#include "sensors/bno055_async.h"
+#include "sensors/dlv_async.h"
+#include "sensors/mcp3008_burst.h"
+#include "sim_bus.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// Simulated run time, and what the rest of a loop() pass costs.
+#define BUS_BENCH_RUN_MS 2000
+#define BUS_BENCH_LOOP_US 100
+
+// How often a blocking read checks whether it's done.
+#define BUS_BENCH_SPIN_US 10
+
+// 100kHz I2C. Start, address, repeated start and stop cost about two
+//  bytes on top of the data.
+#define BUS_BENCH_I2C_BYTE_US 90
+#define BUS_BENCH_I2C_XFER_US 200
+
+// 1MHz SPI, chip select setup and hold.
+#define BUS_BENCH_SPI_BYTE_US 8
+#define BUS_BENCH_SPI_XFER_US 2
+
+// What Adafruit_MCP3008::readADC adds to each conversion, the SPI
+//  transaction and chip select calls.
+#define BUS_BENCH_READADC_US 10
+
+// CPU time the SPI interrupt takes per byte.
+#define BUS_BENCH_SPI_ISR_US 1
+
+#define BUS_BENCH_ADC_PERIOD_US 1000
+#define BUS_BENCH_ADC_CS_PIN 10
+#define BUS_BENCH_IMU_ADDR 0x29
+
+// State machine timing passes.
+#define BUS_BENCH_STEP_READS 1000000
+
+
+/******************************************************************************
+ *                               Local Types
+ *****************************************************************************/
+
+// What one simulated run saw.
+struct bus_result_t
+{
+    uint32_t worst_gap_us;
+    uint64_t wait_us;
+    uint64_t isr_us;
+    uint32_t reads[SRC_CNT];
+    uint32_t late;
+    uint32_t failed;
+    uint32_t adc_samples;
+    uint32_t adc_missed;
+    uint32_t bad;
+};
+
+
+/******************************************************************************
+ *                               Local Vars
+ *****************************************************************************/
+
+// Raw register values the simulated sensors give, and what they read
+//  as. 14.7 PSI and 20C from the DLV.
+static const int16_t bus_euler_raw[3] = { 1600, -320, 48 };
+static const float bus_euler[3] = { 100.0f, -20.0f, 3.0f };
+static const int16_t bus_accel_raw[3] = { 981, -5, 12 };
+static const float bus_accel[3] = { 9.81f, -0.05f, 0.12f };
+static const uint16_t bus_prsur_raw = 14484;
+static const uint16_t bus_temp_raw = 716;
+static const float bus_prsur = 14.7f;
+static const float bus_temp = 68.0f;
+
+// Simulated time and the two buses, for the read functions.
+static uint32_t bus_now_us;
+static uint64_t * bus_wait_us;
+static SimBus * bus_twi;
+static SimBus * bus_spi;
+static bool bus_blocking;
+
+static Bno055Async * bus_imu;
+static DlvAsync * bus_dlv;
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+static void bus_advance( uint32_t us )
+{
+    bus_twi->advance( us );
+    bus_spi->advance( us );
+    bus_now_us += us;
+}
+
+
+static bool bus_imu_device( bus_xfer_t & xfer )
+{
+    int16_t const * raw = ( xfer.reg == BNO055_EULER_REG ) ? bus_euler_raw : bus_accel_raw;
+
+    if( xfer.len != 6 )
+    {
+        return false;
+    }
+
+    memcpy( xfer.rx, raw, 6 );
+    return true;
+}
+
+
+static bool bus_dlv_device( bus_xfer_t & xfer )
+{
+    if( xfer.len != 4 )
+    {
+        return false;
+    }
+
+    xfer.rx[0] = bus_prsur_raw >> 8;
+    xfer.rx[1] = bus_prsur_raw & 0xFF;
+    xfer.rx[2] = bus_temp_raw >> 3;
+    xfer.rx[3] = ( bus_temp_raw & 0x07 ) << 5;
+    return true;
+}
+
+
+// Channel n reads 100 * n + 7
+static bool bus_adc_device( bus_xfer_t & xfer )
+{
+    for( uint8_t i = 0; i + MCP3008_XFER_LEN <= xfer.len; i += MCP3008_XFER_LEN )
+    {
+        uint16_t value = 100 * ( ( xfer.tx[ i + 1 ] >> 4 ) & 0x07 ) + 7;
+
+        xfer.rx[ i + 0 ] = 0;
+        xfer.rx[ i + 1 ] = ( value >> 8 ) & 0x03;
+        xfer.rx[ i + 2 ] = value & 0xFF;
+    }
+
+    return true;
+}
+
+
+/**********************************************************
+*   bus_wait
+*       Spin on a read the way a blocking driver does,
+*       adding the time to the run's wait.
+**********************************************************/
+template< typename Read >
+static bus_sts_t bus_wait( Read read )
+{
+    bus_sts_t sts;
+
+    while( ( sts = read() ) == BUS_BUSY )
+    {
+        bus_advance( BUS_BENCH_SPIN_US );
+        *bus_wait_us += BUS_BENCH_SPIN_US;
+    }
+
+    return sts;
+}
+
+
+static bus_sts_t bus_euler_read( uint32_t time_us, void * sample )
+{
+    auto read = [&]() { return bus_imu->read( BNO055_EULER_REG, BNO055_EULER_LSB, time_us, (vec3_sample_t *)sample ); };
+
+    return bus_blocking ? bus_wait( read ) : read();
+}
+
+
+static bus_sts_t bus_accel_read( uint32_t time_us, void * sample )
+{
+    auto read = [&]() { return bus_imu->read( BNO055_ACCEL_REG, BNO055_ACCEL_LSB, time_us, (vec3_sample_t *)sample ); };
+
+    return bus_blocking ? bus_wait( read ) : read();
+}
+
+
+static bus_sts_t bus_prsur_read( uint32_t time_us, void * sample )
+{
+    auto read = [&]() { return bus_dlv->read( time_us, (prsur_sample_t *)sample ); };
+
+    return bus_blocking ? bus_wait( read ) : read();
+}
+
+
+static bool bus_vec_ok( vec3_sample_t const * sample, float const * expect )
+{
+    return ( fabsf( sample->x - expect[0] ) < 0.001f )
+        && ( fabsf( sample->y - expect[1] ) < 0.001f )
+        && ( fabsf( sample->z - expect[2] ) < 0.001f );
+}
+
+
+static bool bus_adc_ok( adc_sample_t const & sample )
+{
+    for( uint8_t i = 0; i < ADC_CHNL_CNT; i++ )
+    {
+        if( sample.adc[i] != 100 * i + 7 )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**********************************************************
+*   bus_adc_blocking
+*       The ADC the way Adafruit_MCP3008 reads it, one
+*       transaction per channel, each waited on.
+**********************************************************/
+static bool bus_adc_blocking( adc_sample_t & sample )
+{
+    uint8_t tx[ MCP3008_XFER_LEN ];
+    uint8_t rx[ MCP3008_XFER_LEN ];
+    bus_xfer_t xfer;
+
+    memset( &xfer, 0, sizeof(xfer) );
+    xfer.addr = BUS_BENCH_ADC_CS_PIN;
+    xfer.tx = tx;
+    xfer.rx = rx;
+    xfer.len = MCP3008_XFER_LEN;
+
+    sample.time_us = bus_now_us;
+    for( uint8_t i = 0; i < ADC_CHNL_CNT; i++ )
+    {
+        tx[0] = 0x01;
+        tx[1] = 0x80 | ( i << 4 );
+        tx[2] = 0x00;
+
+        bus_advance( BUS_BENCH_READADC_US );
+        *bus_wait_us += BUS_BENCH_READADC_US;
+
+        if( bus_wait( [&]() { return bus_step( bus_spi, xfer ); } ) != BUS_DONE )
+        {
+            return false;
+        }
+
+        sample.adc[i] = ( ( rx[1] & 0x03 ) << 8 ) | rx[2];
+    }
+
+    return true;
+}
+
+
+/**********************************************************
+*   bus_run
+*       A simulated loop() reading the sensors on
+*       main.cpp's schedule, with the ADC timer interrupt
+*       at 1kHz, either waiting on every transfer or
+*       through the state machines.
+**********************************************************/
+static bus_result_t bus_run( bool blocking )
+{
+    static const acq_source_t sources[] =
+    {
+        { SRC_IMU_EULER,    10,     0,      bus_euler_read  },
+        { SRC_IMU_ACCEL,    10,     5,      bus_accel_read  },
+        { SRC_PRESSURE,     50,     2,      bus_prsur_read  },
+    };
+    uint8_t const count = sizeof(sources) / sizeof(sources[0]);
+
+    SimBus twi( BUS_BENCH_I2C_BYTE_US, BUS_BENCH_I2C_XFER_US );
+    SimBus spi( BUS_BENCH_SPI_BYTE_US, BUS_BENCH_SPI_XFER_US );
+    Bno055Async imu( &twi, BUS_BENCH_IMU_ADDR );
+    DlvAsync dlv( &twi, DLV_015A_RANGE_PSI );
+    Mcp3008Burst adc( &spi, BUS_BENCH_ADC_CS_PIN );
+    AcqScheduler acq( sources, count );
+    uint32_t next_adc_us = BUS_BENCH_ADC_PERIOD_US;
+    bus_result_t result;
+
+    memset( &result, 0, sizeof(result) );
+
+    twi.set_device( BUS_BENCH_IMU_ADDR, bus_imu_device );
+    twi.set_device( DLV_I2C_ADDR, bus_dlv_device );
+    spi.set_device( BUS_BENCH_ADC_CS_PIN, bus_adc_device );
+
+    bus_now_us = 1;
+    bus_wait_us = &result.wait_us;
+    bus_twi = &twi;
+    bus_spi = &spi;
+    bus_blocking = blocking;
+    bus_imu = &imu;
+    bus_dlv = &dlv;
+
+    adc.set_done( []( void * ctx, adc_sample_t const & sample )
+    {
+        bus_result_t * r = (bus_result_t *)ctx;
+
+        r->adc_samples++;
+        r->bad += bus_adc_ok( sample ) ? 0 : 1;
+    }, &result );
+
+    acq.set_sink( [&]( src_id_t source, void const * sample, uint8_t )
+    {
+        vec3_sample_t const * vec = (vec3_sample_t const *)sample;
+        prsur_sample_t const * prsur = (prsur_sample_t const *)sample;
+        bool ok;
+
+        switch( source )
+        {
+            case SRC_IMU_EULER:
+                ok = bus_vec_ok( vec, bus_euler );
+                break;
+
+            case SRC_IMU_ACCEL:
+                ok = bus_vec_ok( vec, bus_accel );
+                break;
+
+            default:
+                ok = ( fabsf( prsur->prsur - bus_prsur ) < 0.01f )
+                  && ( fabsf( prsur->temp - bus_temp ) < 0.2f );
+                break;
+        }
+
+        result.bad += ok ? 0 : 1;
+    });
+
+    acq.begin( bus_now_us );
+
+    while( bus_now_us < BUS_BENCH_RUN_MS * 1000UL )
+    {
+        uint32_t start_us = bus_now_us;
+
+        // The timer interrupt, taken between passes
+        if( (int32_t)( bus_now_us - next_adc_us ) >= 0 )
+        {
+            next_adc_us += BUS_BENCH_ADC_PERIOD_US;
+
+            if( blocking )
+            {
+                adc_sample_t sample;
+
+                result.adc_samples++;
+                result.bad += ( bus_adc_blocking( sample ) && bus_adc_ok( sample ) ) ? 0 : 1;
+            }
+            else if( !adc.start( bus_now_us ) )
+            {
+                result.adc_missed++;
+            }
+        }
+
+        acq.run( bus_now_us );
+        bus_advance( BUS_BENCH_LOOP_US );
+
+        if( bus_now_us - start_us > result.worst_gap_us )
+        {
+            result.worst_gap_us = bus_now_us - start_us;
+        }
+    }
+
+    for( uint8_t i = 0; i < count; i++ )
+    {
+        result.reads[ sources[i].source ] = acq.reads( sources[i].source );
+        result.late += acq.late( sources[i].source );
+        result.failed += acq.failed( sources[i].source );
+    }
+
+    result.isr_us = blocking ? 0 : spi.bytes() * BUS_BENCH_SPI_ISR_US;
+
+    return result;
+}
+
+
+static void bus_report( char const * name, bus_result_t const & r )
+{
+    printf( "%-32s worst loop() pass %5u us, %5.1f%% CPU waiting on a bus, %4.1f%% in bus interrupts\n",
+            name,
+            r.worst_gap_us,
+            100.0 * r.wait_us / ( BUS_BENCH_RUN_MS * 1000.0 ),
+            100.0 * r.isr_us / ( BUS_BENCH_RUN_MS * 1000.0 ) );
+    printf( "  %-30s %u adc %u missed, %u euler %u accel %u prsur, %u late %u failed\n",
+            "",
+            r.adc_samples,
+            r.adc_missed,
+            r.reads[ SRC_IMU_EULER ],
+            r.reads[ SRC_IMU_ACCEL ],
+            r.reads[ SRC_PRESSURE ],
+            r.late,
+            r.failed );
+}
+
+
+/**********************************************************
+*   bench_bus
+*       The sensor state machines on simulated buses.
+*       Checks they read back what the simulated sensors
+*       hold, against the same reads waited on, and that
+*       not waiting keeps loop() passes short without
+*       losing a read. Also times the state machines with
+*       a bus that takes no time.
+**********************************************************/
+bool bench_bus()
+{
+    bool ok = true;
+
+    bus_result_t blocking = bus_run( true );
+    bus_report( "bus blocking reads", blocking );
+
+    bus_result_t async = bus_run( false );
+    bus_report( "bus state machines", async );
+
+    uint32_t const adc_expected = BUS_BENCH_RUN_MS * 1000UL / BUS_BENCH_ADC_PERIOD_US - 1;
+
+    if( ( blocking.bad != 0 )
+     || ( async.bad != 0 ) )
+    {
+        bench_fail( "bus", "read back the wrong values" );
+        ok = false;
+    }
+
+    if( ( async.failed != 0 )
+     || ( async.late != 0 )
+     || ( async.adc_missed != 0 )
+     || ( async.adc_samples + 1 < adc_expected )
+     || ( async.reads[ SRC_IMU_EULER ] + 1 < BUS_BENCH_RUN_MS / 10 )
+     || ( async.reads[ SRC_PRESSURE ] + 1 < BUS_BENCH_RUN_MS / 50 ) )
+    {
+        bench_fail( "bus state machines", "reads lost or late" );
+        ok = false;
+    }
+
+    if( ( async.worst_gap_us > BUS_BENCH_LOOP_US )
+     || ( async.wait_us != 0 ) )
+    {
+        bench_fail( "bus state machines", "loop() waited on a bus" );
+        ok = false;
+    }
+
+    // The state machines themselves, on a bus that finishes at once
+    SimBus twi( 0, 0 );
+    Bno055Async imu( &twi, BUS_BENCH_IMU_ADDR );
+    vec3_sample_t sample;
+    uint32_t done = 0;
+
+    twi.set_device( BUS_BENCH_IMU_ADDR, bus_imu_device );
+
+    bench_clock_t::time_point start = bench_clock_t::now();
+    for( uint32_t i = 0; i < BUS_BENCH_STEP_READS; i++ )
+    {
+        while( imu.read( BNO055_EULER_REG, BNO055_EULER_LSB, i, &sample ) == BUS_BUSY )
+        {
+            twi.advance( 0 );
+        }
+        done++;
+    }
+    double seconds = bench_seconds_since( start );
+    bench_keep( done + (uint32_t)sample.x );
+
+    printf( "%-32s %8.1f ns/read\n", "bus bno055 state machine", seconds * 1e9 / BUS_BENCH_STEP_READS );
+
+    return ok;
+}
@@ -0,0 +1,195 @@
+#include "bench.h"
+#include "telemetry/tlm_codec.h"
+#include "telemetry/tlm_schema.h"
+#include "xbee/xbee.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// Two minutes of flight at 100Hz.
+#define CODEC_BENCH_RATE_HZ 100
+#define CODEC_BENCH_SAMPLES ( 120 * CODEC_BENCH_RATE_HZ )
+
+// Every Nth frame is lost in the loss check.
+#define CODEC_BENCH_LOSS_EVERY 5
+
+// Flag, type byte, crc and flag around every frame.
+#define CODEC_BENCH_FRAME_OVERHEAD 5
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   codec_matches
+*       True if decoded is within rounding of sample. ADC
+*       channels have to be exact.
+**********************************************************/
+static bool codec_matches( data_pkg_t const & sample, data_pkg_t const & decoded )
+{
+    tlm_codec_cfg_t const & cfg = tlm_codec_default_cfg;
+    float const a[] = { sample.angle_x, sample.angle_y, sample.angle_z, sample.accel_x, sample.accel_y, sample.accel_z, sample.prsur, sample.prsur_temp };
+    float const b[] = { decoded.angle_x, decoded.angle_y, decoded.angle_z, decoded.accel_x, decoded.accel_y, decoded.accel_z, decoded.prsur, decoded.prsur_temp };
+    float const res[] = { cfg.angle_res, cfg.angle_res, cfg.angle_res, cfg.accel_res, cfg.accel_res, cfg.accel_res, cfg.prsur_res, cfg.temp_res };
+
+    if( memcmp( &sample, &decoded, offsetof( data_pkg_t, angle_x ) ) != 0 )
+    {
+        return false;
+    }
+
+    for( int i = 0; i < 8; i++ )
+    {
+        if( fabsf( a[i] - b[i] ) > res[i] * 0.501f + fabsf( a[i] ) * 1e-6f )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**********************************************************
+*   codec_pack
+*       Pack samples into full frames. Returns the encoded
+*       frames, and adds their size on the wire to bytes.
+**********************************************************/
+static std::vector< std::vector<uint8_t> > codec_pack( std::vector<data_pkg_t> const & samples, uint64_t & bytes )
+{
+    std::vector< std::vector<uint8_t> > frames;
+    TlmEncoder encoder;
+    uint8_t frame[ MAX_DATA_LENGTH - sizeof(data_type_t) ];
+    size_t next = 0;
+
+    while( next < samples.size() )
+    {
+        encoder.begin_frame( frame, sizeof(frame), (uint16_t)next );
+        while( ( next < samples.size() )
+            && ( encoder.add( samples[next] ) ) )
+        {
+            next++;
+        }
+
+        uint8_t size = encoder.end_frame();
+        frames.push_back( std::vector<uint8_t>( frame, frame + size ) );
+        bytes += size + CODEC_BENCH_FRAME_OVERHEAD;
+    }
+
+    return frames;
+}
+
+
+/**********************************************************
+*   bench_codec
+*       Round trips a simulated flight through the
+*       telemetry codec, with and without lost frames, and
+*       reports how much smaller it is than SENSOR_DATA
+*       frames.
+**********************************************************/
+bool bench_codec()
+{
+    std::vector<data_pkg_t> samples;
+    sensor_sample_t decoded[ UINT8_MAX ];
+    uint64_t coded_bytes = 0;
+    uint64_t single_bytes = 0;
+    uint32_t out = 0;
+    bool ok = true;
+
+    for( uint32_t n = 0; n < CODEC_BENCH_SAMPLES; n++ )
+    {
+        samples.push_back( bench_flight_sample( n * 1000 / CODEC_BENCH_RATE_HZ ) );
+        single_bytes += SENSOR_DATA_WIRE_SIZE + CODEC_BENCH_FRAME_OVERHEAD;
+    }
+
+    bench_clock_t::time_point start = bench_clock_t::now();
+    std::vector< std::vector<uint8_t> > frames = codec_pack( samples, coded_bytes );
+    double encode_s = bench_seconds_since( start );
+
+    // Everything should come back
+    TlmDecoder decoder;
+    start = bench_clock_t::now();
+    for( std::vector<uint8_t> const & frame : frames )
+    {
+        uint8_t count = decoder.decode_frame( frame.data(), frame.size(), decoded, UINT8_MAX );
+
+        for( uint8_t s = 0; s < count; s++, out++ )
+        {
+            if( ( decoded[s].index != (uint16_t)out )
+             || ( !codec_matches( samples[out], decoded[s].data ) ) )
+            {
+                ok = false;
+            }
+        }
+    }
+    double decode_s = bench_seconds_since( start );
+
+    bench_report( "codec encode", encode_s, CODEC_BENCH_SAMPLES * sizeof(data_pkg_t), CODEC_BENCH_SAMPLES );
+    bench_report( "codec decode", decode_s, CODEC_BENCH_SAMPLES * sizeof(data_pkg_t), CODEC_BENCH_SAMPLES );
+    printf( "%-32s %6.1f bytes/sample %6.1f bytes/sample single %6.2fx smaller %6.1f samples/frame\n",
+            "codec flight 100Hz",
+            (double)coded_bytes / CODEC_BENCH_SAMPLES,
+            (double)single_bytes / CODEC_BENCH_SAMPLES,
+            (double)single_bytes / coded_bytes,
+            (double)CODEC_BENCH_SAMPLES / frames.size() );
+
+    if( ( !ok )
+     || ( out != CODEC_BENCH_SAMPLES ) )
+    {
+        bench_fail( "codec round trip", "samples changed or lost" );
+        return false;
+    }
+
+    // Lose frames. Whatever does come out has to be right, and the
+    //  decoder has to pick up again at the next keyframe.
+    TlmDecoder lossy;
+    uint32_t lossy_out = 0;
+    for( size_t f = 0; f < frames.size(); f++ )
+    {
+        if( f % CODEC_BENCH_LOSS_EVERY == CODEC_BENCH_LOSS_EVERY - 1 )
+        {
+            continue;
+        }
+
+        uint8_t count = lossy.decode_frame( frames[f].data(), frames[f].size(), decoded, UINT8_MAX );
+
+        for( uint8_t s = 0; s < count; s++ )
+        {
+            if( !codec_matches( samples[ decoded[s].index ], decoded[s].data ) )
+            {
+                ok = false;
+            }
+        }
+
+        lossy_out += count;
+    }
+
+    printf( "%-32s %u of %u samples, %u skipped waiting for a keyframe\n",
+            "codec 1 in 5 frames lost",
+            lossy_out,
+            CODEC_BENCH_SAMPLES,
+            lossy.skipped() );
+
+    if( ( !ok )
+     || ( lossy_out == 0 ) )
+    {
+        bench_fail( "codec lost frames", "bad samples after a lost frame" );
+        return false;
+    }
+
+    // The point of it
+    if( single_bytes < 2 * coded_bytes )
+    {
+        bench_fail( "codec flight 100Hz", "less than 2x smaller" );
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,139 @@
+#include "bench.h"
+#include "crc16.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// CRC-16/MCRF4XX check value, crc of "123456789" starting from 0xFFFF.
+#define CRC16_CHECK_VAL 0x6F91
+
+#define CRC_BENCH_BYTES ( 64UL * 1024UL * 1024UL )
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+typedef uint16_t (*crc_block_fn_t)( uint16_t, uint8_t const *, size_t );
+
+typedef struct
+{
+    char const * name;
+    crc_block_fn_t fn;
+} crc_engine_t;
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+static crc_engine_t const engines[] =
+{
+    { "crc16 bitwise", crc16_ccitt_block_bitwise },
+    { "crc16 table",   crc16_ccitt_block_table   },
+    { "crc16 slice4",  crc16_ccitt_block_slice4  },
+};
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   crc_check
+*       Make sure every engine matches the bitwise
+*       reference, for every length and alignment.
+**********************************************************/
+static bool crc_check( crc_engine_t const & engine )
+{
+    uint8_t buf[ 300 ];
+
+    if( engine.fn( CRC16_CCITT_INIT_VAL, (uint8_t const *)"123456789", 9 ) != CRC16_CHECK_VAL )
+    {
+        bench_fail( engine.name, "check value" );
+        return false;
+    }
+
+    srand( 1 );
+    for( size_t i = 0; i < sizeof(buf); i++ )
+    {
+        buf[i] = (uint8_t)rand();
+    }
+
+    for( size_t off = 0; off < 4; off++ )
+    {
+        for( size_t len = 0; len < sizeof(buf) - off; len++ )
+        {
+            uint16_t ref = CRC16_CCITT_INIT_VAL;
+            for( size_t i = 0; i < len; i++ )
+            {
+                ref = crc16_ccitt_update_bitwise( ref, buf[off + i] );
+            }
+
+            if( engine.fn( CRC16_CCITT_INIT_VAL, &buf[off], len ) != ref )
+            {
+                bench_fail( engine.name, "mismatch with bitwise reference" );
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+/**********************************************************
+*   bench_crc
+*       Throughput of each crc engine on one large block
+*       and on frame sized blocks.
+**********************************************************/
+bool bench_crc()
+{
+    bool ok = true;
+    uint8_t * buf = new uint8_t[ CRC_BENCH_BYTES ];
+    char name[ 64 ];
+
+    for( size_t i = 0; i < CRC_BENCH_BYTES; i++ )
+    {
+        buf[i] = (uint8_t)( i * 131 + ( i >> 7 ) );
+    }
+
+    for( size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++ )
+    {
+        crc_engine_t const & engine = engines[e];
+
+        if( !crc_check( engine ) )
+        {
+            ok = false;
+            continue;
+        }
+
+        // One big block
+        bench_clock_t::time_point start = bench_clock_t::now();
+        bench_keep( engine.fn( CRC16_CCITT_INIT_VAL, buf, CRC_BENCH_BYTES ) );
+        bench_report( engine.name, bench_seconds_since( start ), CRC_BENCH_BYTES, 0 );
+
+        // Frame sized blocks
+        uint64_t frames = CRC_BENCH_BYTES / BENCH_FRAME_LEN;
+        uint32_t acc = 0;
+
+        start = bench_clock_t::now();
+        for( uint64_t f = 0; f < frames; f++ )
+        {
+            acc += engine.fn( CRC16_CCITT_INIT_VAL, &buf[ f * BENCH_FRAME_LEN ], BENCH_FRAME_LEN );
+        }
+        bench_keep( acc );
+
+        snprintf( name, sizeof(name), "%s (%d byte frames)", engine.name, BENCH_FRAME_LEN );
+        bench_report( name, bench_seconds_since( start ), frames * BENCH_FRAME_LEN, frames );
+    }
+
+    delete[] buf;
+    return ok;
+}
@@ -0,0 +1,435 @@
+#include "bench.h"
+#include "../tools/common/log_dl_client.h"
+#include "log/log_downlink.h"
+#include "log/log_files.h"
+#include "xbee/xbee.h"
+
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <SdFat.h>
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+#include <random>
+#include <utility>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// Both radios' UARTs, as main.cpp sets them up.
+#define DL_BENCH_BAUD 9600
+
+// Log files on the card. Two days, one with a log that rotated into a
+//  second file, and LogFiles' ready spares that mustn't be listed.
+#define DL_BENCH_FILE_BLOCKS 256
+#define DL_BENCH_SPARES 2
+#define DL_BENCH_FILE_CNT 3
+
+// A transparent mode XBee sends what it has once XBEE_MTU bytes are in
+//  or the UART has been quiet this long, ATRO. Each RF packet is either
+//  lost whole or arrives DL_BENCH_AIR_MS later.
+#define DL_BENCH_RO_MS 3
+#define DL_BENCH_AIR_MS 10
+
+// A transfer that hasn't finished in this many times as long as the
+//  file takes at the line rate has failed.
+#define DL_BENCH_TIMEOUT_X 20
+
+// The windowed transfer has to beat stop-and-wait over the same lossy
+//  link by this much, and use at least this much of a clean one.
+#define DL_BENCH_MIN_GAIN 2.0
+#define DL_BENCH_MIN_CLEAN_PCT 75
+
+#define DL_BENCH_SEED 4321
+
+
+/******************************************************************************
+ *                               Local Types
+ *****************************************************************************/
+
+/**********************************************************
+*   dl_link_t
+*       One way of the radio link. Takes what one UART
+*       puts on the wire, cuts it into RF packets as the
+*       XBee does and hands the ones that aren't lost to
+*       the other UART.
+**********************************************************/
+struct dl_link_t
+{
+    UARTClass * from;
+    UARTClass * to;
+    uint32_t loss_pct;
+    std::minstd_rand rng;
+
+    std::vector<uint8_t> packet;
+    uint32_t last_ms = 0;
+    std::deque< std::pair< uint32_t, std::vector<uint8_t> > > air;  // Arrival time, packet
+    uint32_t packets = 0;
+    uint32_t lost = 0;
+
+    dl_link_t( UARTClass * from, UARTClass * to, uint32_t loss_pct, uint32_t seed ) :
+        from( from ), to( to ), loss_pct( loss_pct ), rng( seed ) {}
+
+    void run( uint32_t now_ms )
+    {
+        uint8_t buffer[ XBEE_MTU ];
+        size_t count = from->take_tx( buffer, sizeof(buffer) );
+
+        for( size_t i = 0; i < count; i++ )
+        {
+            packet.push_back( buffer[i] );
+            if( packet.size() == XBEE_MTU )
+            {
+                this->send( now_ms );
+            }
+        }
+
+        if( count > 0 )
+        {
+            last_ms = now_ms;
+        }
+        else if( ( !packet.empty() )
+              && ( now_ms - last_ms >= DL_BENCH_RO_MS ) )
+        {
+            this->send( now_ms );
+        }
+
+        while( ( !air.empty() )
+            && ( (int32_t)( now_ms - air.front().first ) >= 0 ) )
+        {
+            to->inject( air.front().second.data(), air.front().second.size() );
+            air.pop_front();
+        }
+    }
+
+    void send( uint32_t now_ms )
+    {
+        packets++;
+        if( rng() % 100 < loss_pct )
+        {
+            lost++;
+        }
+        else
+        {
+            air.push_back( std::make_pair( now_ms + DL_BENCH_AIR_MS, packet ) );
+        }
+        packet.clear();
+    }
+};
+
+/**********************************************************
+*   dl_sim_t
+*       The rocket's radio and LogDownlink, the ground's
+*       radio and a LogDlClient, and the link between, run
+*       a millisecond of simulated time a step. Frames and
+*       ticks go to whichever client ground_end points at.
+**********************************************************/
+struct dl_sim_t
+{
+    UARTClass rocket_serial;
+    UARTClass ground_serial;
+    Xbee rocket;
+    Xbee ground;
+    LogDownlink downlink;
+    LogDlClient client;
+    LogDlClient * ground_end;
+    dl_link_t down;
+    dl_link_t up;
+    uint32_t last_us;
+
+    dl_sim_t( uint32_t loss_pct ) :
+        rocket( &rocket_serial ),
+        ground( &ground_serial ),
+        downlink( &rocket ),
+        client( [this]( uint8_t const * data, uint16_t size ) { ground.send_data( LOG_DOWNLINK, data, size ); } ),
+        ground_end( &client ),
+        down( &rocket_serial, &ground_serial, loss_pct, DL_BENCH_SEED ),
+        up( &ground_serial, &rocket_serial, loss_pct, DL_BENCH_SEED + 1 ),
+        last_us( micros() )
+    {
+        rocket.setup( DL_BENCH_BAUD );
+        ground.setup( DL_BENCH_BAUD );
+        rocket_serial.set_tx_limited( true );
+        ground_serial.set_tx_limited( true );
+
+        rocket.set_frame_hndlr( LOG_DOWNLINK, [this]( uint8_t const * data, uint16_t size ) { downlink.frame_received( data, size ); } );
+        ground.set_frame_hndlr( LOG_DOWNLINK, [this]( uint8_t const * data, uint16_t size ) { ground_end->frame_received( data, size ); } );
+    }
+
+    void step()
+    {
+        uint32_t start = micros();
+
+        rocket_serial.run( start - last_us );
+        ground_serial.run( start - last_us );
+        last_us = start;
+
+        down.run( millis() );
+        up.run( millis() );
+
+        rocket.read();
+        if( downlink.busy() )
+        {
+            downlink.service( millis() );
+        }
+
+        ground.read();
+        ground_end->tick( millis() );
+
+        uint32_t elapsed = micros() - start;
+        if( elapsed < 1000 )
+        {
+            sim_clock_advance( 1000 - elapsed );
+        }
+    }
+};
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   dl_byte
+*       What's at offset in log file num, so what comes
+*       down can be checked.
+**********************************************************/
+static uint8_t dl_byte( uint16_t num, uint32_t offset )
+{
+    return (uint8_t)( offset * 31 + num * 7 + ( offset >> 9 ) );
+}
+
+
+/**********************************************************
+*   dl_write
+*       Open the next of files' ready files and write
+*       length bytes of its pattern.
+**********************************************************/
+static bool dl_write( LogFiles & files, uint32_t length )
+{
+    uint8_t block[512];
+
+    if( !files.open() )
+    {
+        return false;
+    }
+
+    for( uint32_t offset = 0; offset < length; offset += sizeof(block) )
+    {
+        uint32_t count = min( (uint32_t)sizeof(block), length - offset );
+
+        for( uint32_t i = 0; i < count; i++ )
+        {
+            block[i] = dl_byte( files.number(), offset + i );
+        }
+
+        if( files.write( block, count ) != count )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**********************************************************
+*   dl_card
+*       Fill the card: /10_17/log_1.bin, then a log in
+*       /10_18 that rotated from log_1.bin into log_2.bin,
+*       with a ready spare left over. expect gets what
+*       LIST should find.
+**********************************************************/
+static bool dl_card( SdFat & sd, log_dl_entry_t * expect )
+{
+    LogFiles files( sd, DL_BENCH_FILE_BLOCKS, DL_BENCH_SPARES );
+    log_dl_entry_t const files_made[DL_BENCH_FILE_CNT] =
+    {
+        { 10, 17, 1, 20000 },
+        { 10, 18, 1, DL_BENCH_FILE_BLOCKS * 512 - LOG_FILES_MARGIN },
+        { 10, 18, 2, 40000 },
+    };
+
+    sd.begin( 0 );
+
+    bool ok = ( files.prepare( "/10_17" ) )
+           && ( dl_write( files, files_made[0].length ) );
+    files.close( true );
+
+    ok = ( ok )
+      && ( files.prepare( "/10_18" ) )
+      && ( dl_write( files, files_made[1].length ) );
+    files.close( false );
+
+    ok = ( ok )
+      && ( dl_write( files, files_made[2].length ) );
+    files.close( true );
+
+    memcpy( expect, files_made, sizeof(files_made) );
+
+    return ok;
+}
+
+
+/**********************************************************
+*   dl_list
+*       LIST over a lossy link. Has to find the logs and
+*       nothing else.
+**********************************************************/
+static bool dl_list( log_dl_entry_t const * expect )
+{
+    dl_sim_t sim( 10 );
+    std::vector<log_dl_entry_t> found;
+    uint32_t start = millis();
+
+    sim.client.set_list_hndlr( [&]( log_dl_entry_t const & entry ) { found.push_back( entry ); } );
+    sim.client.list( millis() );
+
+    while( ( sim.client.state() == LOG_DL_LISTING )
+        && ( millis() - start < 60000 ) )
+    {
+        sim.step();
+    }
+
+    bool ok = ( sim.client.state() == LOG_DL_IDLE )
+           && ( found.size() == DL_BENCH_FILE_CNT );
+
+    for( size_t i = 0; ( ok ) && ( i < found.size() ); i++ )
+    {
+        ok = ( memcmp( &found[i], &expect[i], sizeof(log_dl_entry_t) ) == 0 );
+    }
+
+    printf( "%-32s %u files in %.1f s\n", "log downlink list", (unsigned)found.size(), ( millis() - start ) / 1000.0 );
+
+    if( !ok )
+    {
+        bench_fail( "log downlink list", "didn't list the logs" );
+    }
+
+    return ok;
+}
+
+
+/**********************************************************
+*   dl_get
+*       Bring file down over a link losing loss_pct of its
+*       RF packets, window chunks in flight. If resume_at
+*       isn't 0 the ground end restarts once that much has
+*       come, and a new client picks up from what was
+*       saved. Checks every byte and returns the
+*       throughput in bytes a second, 0 if it failed.
+**********************************************************/
+static double dl_get( char const * name, log_dl_entry_t const & file, uint8_t window, uint32_t loss_pct, uint32_t resume_at )
+{
+    dl_sim_t sim( loss_pct );
+    std::vector<uint8_t> data;
+    uint32_t line_rate = DL_BENCH_BAUD / 10;
+    uint32_t timeout_ms = (uint64_t)file.length * 1000 * DL_BENCH_TIMEOUT_X / line_rate;
+    uint32_t start = millis();
+    LogDlClient resumed( [&]( uint8_t const * buffer, uint16_t size ) { sim.ground.send_data( LOG_DOWNLINK, buffer, size ); } );
+
+    auto keep = [&]( uint8_t const * buffer, uint16_t size ) { data.insert( data.end(), buffer, buffer + size ); };
+    sim.client.set_data_hndlr( keep );
+    resumed.set_data_hndlr( keep );
+    sim.client.get( file, 0, window, millis() );
+
+    while( ( sim.ground_end->state() == LOG_DL_GETTING )
+        && ( millis() - start < timeout_ms ) )
+    {
+        sim.step();
+
+        if( ( resume_at )
+         && ( sim.ground_end == &sim.client )
+         && ( data.size() >= resume_at ) )
+        {
+            // The ground tool's gone, what's saved is all it had
+            sim.ground_end = &resumed;
+            data.resize( resumed.get( file, data.size(), window, millis() ) );
+        }
+    }
+
+    double seconds = ( millis() - start ) / 1000.0;
+    double rate = file.length / seconds;
+    bool ok = ( sim.ground_end->state() == LOG_DL_DONE_OK )
+           && ( data.size() == file.length );
+
+    for( uint32_t i = 0; ( ok ) && ( i < data.size() ); i++ )
+    {
+        ok = ( data[i] == dl_byte( file.num, i ) );
+    }
+
+    printf( "%-32s %6.0f B/s %3.0f%% of the line, %5.1f s, %4u resent, %3u dup, %u/%u packets lost\n",
+            name,
+            rate,
+            rate * 100 / line_rate,
+            seconds,
+            sim.downlink.chunks_resent(),
+            sim.ground_end->duplicates(),
+            sim.down.lost + sim.up.lost,
+            sim.down.packets + sim.up.packets );
+
+    if( !ok )
+    {
+        bench_fail( name, "file didn't come down whole" );
+        return 0;
+    }
+
+    return rate;
+}
+
+
+/**********************************************************
+*   bench_downlink
+*       The SD logs brought down over the radio, both ends
+*       over the fake UARTs at the board's baud rate and a
+*       link that loses RF packets. Stop-and-wait against
+*       the window over the same losses, and a transfer the
+*       ground restarts part way through. Time is
+*       simulated, so the rates are what the link would
+*       give. Checks every log is listed and comes down
+*       whole, and the window fills a clean link and beats
+*       stop-and-wait.
+**********************************************************/
+bool bench_downlink()
+{
+    SdFat sd;
+    log_dl_entry_t expect[DL_BENCH_FILE_CNT];
+    bool ok = true;
+
+    sim_clock_enable( true );
+
+    if( !dl_card( sd, expect ) )
+    {
+        bench_fail( "log downlink", "couldn't write the logs" );
+        sim_clock_enable( false );
+        return false;
+    }
+
+    ok &= dl_list( expect );
+
+    double clean = dl_get( "log downlink window 16, 0% loss", expect[1], LOG_DL_WINDOW, 0, 0 );
+    double stop_wait = dl_get( "log downlink window 1, 10% loss", expect[1], 1, 10, 0 );
+    double windowed = dl_get( "log downlink window 16, 10% loss", expect[1], LOG_DL_WINDOW, 10, 0 );
+    double lossy = dl_get( "log downlink window 16, 25% loss", expect[1], LOG_DL_WINDOW, 25, 0 );
+    double resumed = dl_get( "log downlink resumed, 10% loss", expect[2], LOG_DL_WINDOW, 10, expect[2].length / 2 );
+
+    ok &= ( clean > 0 ) && ( stop_wait > 0 ) && ( windowed > 0 ) && ( lossy > 0 ) && ( resumed > 0 );
+
+    if( clean * 100 < DL_BENCH_BAUD / 10 * DL_BENCH_MIN_CLEAN_PCT )
+    {
+        bench_fail( "log downlink", "window doesn't fill a clean link" );
+        ok = false;
+    }
+
+    if( windowed < stop_wait * DL_BENCH_MIN_GAIN )
+    {
+        bench_fail( "log downlink", "window no better than stop-and-wait" );
+        ok = false;
+    }
+
+    sim_clock_enable( false );
+
+    return ok;
+}
@@ -0,0 +1,91 @@
+#include "bench.h"
+#include "hdlc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define ESC_BENCH_MAX_DATA_LENGTH 64
+
+#define ESC_BENCH_FRAMES 1000000
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+typedef Hdlc< ESC_BENCH_MAX_DATA_LENGTH, bench_sink_t, bench_handler_t > bench_hdlc_t;
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   bench_escape
+*       Worst case framing: every payload byte is a flag
+*       or an escape so every byte doubles on the wire.
+*       Encodes the frames then decodes them again.
+**********************************************************/
+bool bench_escape()
+{
+    uint8_t frame[ BENCH_FRAME_LEN ];
+    uint8_t encoded[ bench_hdlc_t::max_encoded_length ];
+    std::vector<uint8_t> stream;
+    uint16_t encoded_length = 0;
+    bool ok = true;
+
+    for( int i = 0; i < BENCH_FRAME_LEN; i++ )
+    {
+        frame[i] = ( i & 1 ) ? CONTROL_ESCAPE_OCTET : FRAME_BOUNDARY_OCTET;
+    }
+
+    // Encode
+    bench_clock_t::time_point start = bench_clock_t::now();
+    for( int f = 0; f < ESC_BENCH_FRAMES; f++ )
+    {
+        encoded_length = bench_hdlc_t::encode_frame( frame, BENCH_FRAME_LEN, encoded, sizeof(encoded) );
+        bench_keep( encoded[ f % encoded_length ] );
+    }
+    bench_report( "hdlc escape-heavy encode", bench_seconds_since( start ), (uint64_t)BENCH_FRAME_LEN * ESC_BENCH_FRAMES, ESC_BENCH_FRAMES );
+
+    if( encoded_length < 2 * BENCH_FRAME_LEN + 2 )
+    {
+        bench_fail( "hdlc escape-heavy encode", "payload wasn't escaped" );
+        return false;
+    }
+
+    // Decode
+    for( int f = 0; f < ESC_BENCH_FRAMES / 10; f++ )
+    {
+        stream.insert( stream.end(), encoded, encoded + encoded_length );
+    }
+
+    {
+        bench_sink_t sink;
+        bench_handler_t handler;
+        uint8_t rcv_buffer[ bench_hdlc_t::max_frame_length ];
+        bench_hdlc_t hdlc( sink, handler, rcv_buffer );
+
+        start = bench_clock_t::now();
+        for( int pass = 0; pass < 10; pass++ )
+        {
+            hdlc.receive( stream.data(), stream.size() );
+        }
+        bench_report( "hdlc escape-heavy decode", bench_seconds_since( start ), (uint64_t)stream.size() * 10, handler.frames );
+        bench_keep( handler.sum );
+
+        if( handler.frames != ESC_BENCH_FRAMES )
+        {
+            bench_fail( "hdlc escape-heavy decode", "lost frames" );
+            ok = false;
+        }
+    }
+
+    return ok;
+}
@@ -0,0 +1,361 @@
+#include "bench.h"
+#include "hdlc.h"
+#include "rs_code.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define FEC_BENCH_MAX_DATA_LENGTH 252
+
+// Frames sent at each bit error rate.
+#define FEC_BENCH_FRAMES 20000
+
+// Frames encoded and decoded for the speed numbers.
+#define FEC_BENCH_SPEED_FRAMES 200000
+
+
+/******************************************************************************
+ *                               Local Types
+ *****************************************************************************/
+
+// Hdlc handler that checks frames against the one that was sent.
+struct fec_bench_handler_t
+{
+    uint8_t const * expect;
+    uint16_t length;
+    uint64_t good = 0;
+    uint64_t bad = 0;
+
+    void frame_received( uint8_t * data, uint16_t size )
+    {
+        if( ( size == length )
+         && ( memcmp( data, expect, size ) == 0 ) )
+        {
+            good++;
+        }
+        else
+        {
+            bad++;
+        }
+    }
+};
+
+typedef Hdlc< FEC_BENCH_MAX_DATA_LENGTH, bench_sink_t, fec_bench_handler_t > fec_hdlc_t;
+
+// What came out of one run over the noisy link.
+struct fec_result_t
+{
+    uint64_t wire_bytes;        // Before noise
+    uint64_t delivered;
+    uint32_t corrected;
+};
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   flip_bits
+*       Flip each bit of wire with probability ber. Steps
+*       from one error to the next with a geometric draw
+*       rather than a draw per bit.
+**********************************************************/
+static void flip_bits( std::vector<uint8_t> &wire, double ber )
+{
+    uint64_t const bits = (uint64_t)wire.size() * 8;
+    uint64_t bit = 0;
+
+    if( ber <= 0 )
+    {
+        return;
+    }
+
+    double const scale = 1.0 / log( 1.0 - ber );
+
+    for( ;; )
+    {
+        double u = ( rand() + 1.0 ) / ( RAND_MAX + 2.0 );
+
+        bit += (uint64_t)( log( u ) * scale );
+        if( bit >= bits )
+        {
+            break;
+        }
+
+        wire[ bit / 8 ] ^= 1 << ( bit % 8 );
+        bit++;
+    }
+}
+
+
+/**********************************************************
+*   fec_run
+*       Send FEC_BENCH_FRAMES copies of frame over a link
+*       with the given bit error rate and count what
+*       comes out the other end.
+**********************************************************/
+static fec_result_t fec_run( uint8_t const * frame, uint16_t length, bool fec, double ber )
+{
+    uint8_t encoded[ fec_hdlc_t::max_encoded_length ];
+    uint16_t encoded_length = fec_hdlc_t::encode_frame( frame, length, encoded, sizeof(encoded), fec );
+    std::vector<uint8_t> wire;
+    fec_result_t result;
+
+    wire.reserve( (size_t)encoded_length * FEC_BENCH_FRAMES );
+    for( int f = 0; f < FEC_BENCH_FRAMES; f++ )
+    {
+        wire.insert( wire.end(), encoded, encoded + encoded_length );
+    }
+
+    result.wire_bytes = wire.size();
+    flip_bits( wire, ber );
+
+    bench_sink_t sink;
+    fec_bench_handler_t handler;
+    uint8_t rcv_buffer[ fec_hdlc_t::max_frame_length ];
+    fec_hdlc_t hdlc( sink, handler, rcv_buffer );
+
+    handler.expect = frame;
+    handler.length = length;
+    hdlc.receive( wire.data(), wire.size() );
+
+    result.delivered = handler.good;
+    result.corrected = hdlc.fec_corrected();
+
+    return result;
+}
+
+
+/**********************************************************
+*   fec_speed
+*       Encode and decode clean FEC frames for the cost of
+*       the parity and the syndrome check, then noisy ones
+*       for the cost of fixing them.
+**********************************************************/
+static bool fec_speed( uint8_t const * frame, uint16_t length )
+{
+    uint8_t encoded[ fec_hdlc_t::max_encoded_length ];
+    uint16_t encoded_length = 0;
+    std::vector<uint8_t> wire;
+    bool ok = true;
+
+    bench_clock_t::time_point start = bench_clock_t::now();
+    for( int f = 0; f < FEC_BENCH_SPEED_FRAMES; f++ )
+    {
+        encoded_length = fec_hdlc_t::encode_frame( frame, length, encoded, sizeof(encoded), true );
+        bench_keep( encoded[ f % encoded_length ] );
+    }
+    bench_report( "hdlc fec encode", bench_seconds_since( start ), (uint64_t)length * FEC_BENCH_SPEED_FRAMES, FEC_BENCH_SPEED_FRAMES );
+
+    for( int f = 0; f < FEC_BENCH_SPEED_FRAMES / 10; f++ )
+    {
+        wire.insert( wire.end(), encoded, encoded + encoded_length );
+    }
+
+    for( int noisy = 0; noisy < 2; noisy++ )
+    {
+        char const * name = noisy ? "hdlc fec decode ber 1e-3" : "hdlc fec decode clean";
+        std::vector<uint8_t> copy( wire );
+        bench_sink_t sink;
+        fec_bench_handler_t handler;
+        uint8_t rcv_buffer[ fec_hdlc_t::max_frame_length ];
+        fec_hdlc_t hdlc( sink, handler, rcv_buffer );
+
+        handler.expect = frame;
+        handler.length = length;
+        if( noisy )
+        {
+            flip_bits( copy, 1e-3 );
+        }
+
+        start = bench_clock_t::now();
+        hdlc.receive( copy.data(), copy.size() );
+        bench_report( name, bench_seconds_since( start ), copy.size(), handler.good );
+
+        if( ( !noisy )
+         && ( handler.good != FEC_BENCH_SPEED_FRAMES / 10 ) )
+        {
+            bench_fail( name, "lost clean frames" );
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+
+/**********************************************************
+*   fec_limits
+*       Blocks with up to nroots / 2 bad bytes come back
+*       exactly as they were sent.
+**********************************************************/
+static bool fec_limits()
+{
+    uint8_t block[ RS_BLOCK_SIZE ];
+    uint8_t sent[ RS_BLOCK_SIZE ];
+    uint8_t const data = RS_BLOCK_SIZE - RS_FEC_NROOTS;
+    uint8_t const t = RS_FEC_NROOTS / 2;
+
+    for( int trial = 0; trial < 1000; trial++ )
+    {
+        uint8_t errors = trial % ( t + 1 );
+
+        for( uint8_t i = 0; i < data; i++ )
+        {
+            sent[i] = (uint8_t)rand();
+        }
+        memset( &sent[ data ], 0, RS_FEC_NROOTS );
+        rs_fec.update( &sent[ data ], sent, data );
+        memcpy( block, sent, sizeof(block) );
+
+        // errors different positions
+        for( uint8_t e = 0; e < errors; )
+        {
+            uint8_t pos = rand() % RS_BLOCK_SIZE;
+
+            if( block[pos] == sent[pos] )
+            {
+                block[pos] ^= 1 + rand() % 255;
+                e++;
+            }
+        }
+
+        if( ( rs_fec.decode( block, sizeof(block) ) != errors )
+         || ( memcmp( block, sent, sizeof(block) ) != 0 ) )
+        {
+            bench_fail( "rs fec limits", "didn't fix nroots / 2 errors" );
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**********************************************************
+*   fec_flag_flip
+*       Plain and FEC frames with the FEC flag in their
+*       first byte flipped on the wire still get through,
+*       down the other path, with the right data type.
+**********************************************************/
+static bool fec_flag_flip( uint8_t const * frame, uint16_t length )
+{
+    bool ok = true;
+
+    for( int fec = 0; fec < 2; fec++ )
+    {
+        uint8_t encoded[ fec_hdlc_t::max_encoded_length ];
+        uint16_t encoded_length = fec_hdlc_t::encode_frame( frame, length, encoded, sizeof(encoded), fec );
+        bench_sink_t sink;
+        fec_bench_handler_t handler;
+        uint8_t rcv_buffer[ fec_hdlc_t::max_frame_length ];
+        fec_hdlc_t hdlc( sink, handler, rcv_buffer );
+
+        // The data type comes right after the boundary byte and
+        //  neither 0x00 nor 0x80 is escaped.
+        encoded[1] ^= HDLC_FEC_FLAG;
+
+        handler.expect = frame;
+        handler.length = length;
+        hdlc.receive( encoded, encoded_length );
+
+        printf( "%-32s %s frame %s\n", "fec flag flipped", fec ? "fec" : "plain", handler.good == 1 ? "delivered" : "lost" );
+        if( ( handler.good != 1 )
+         || ( hdlc.crc_errors() != 0 ) )
+        {
+            bench_fail( "fec flag flipped", fec ? "fec frame lost" : "plain frame lost" );
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+
+/**********************************************************
+*   bench_fec
+*       data_pkg_t sized and full telemetry frames sent
+*       with and without FEC over links with random bit
+*       errors. Reports the share of frames delivered and
+*       the goodput, payload bytes delivered per byte
+*       sent, and how much goodput FEC gains for each unit
+*       of overhead it adds. Checks every frame gets
+*       through a clean link, FEC gets more through at
+*       1e-3, a block is fixed right up to nroots / 2
+*       bad bytes and a flipped FEC flag doesn't lose the
+*       frame.
+**********************************************************/
+bool bench_fec()
+{
+    static const uint16_t lengths[] = { BENCH_FRAME_LEN, FEC_BENCH_MAX_DATA_LENGTH };
+    static const double bers[] = { 0, 1e-5, 1e-4, 1e-3, 3e-3, 1e-2 };
+    uint8_t frame[ FEC_BENCH_MAX_DATA_LENGTH ];
+    bool ok = true;
+
+    srand( 21 );
+    for( int i = 0; i < FEC_BENCH_MAX_DATA_LENGTH; i++ )
+    {
+        frame[i] = (uint8_t)rand();
+    }
+    frame[0] = 0;   // SENSOR_DATA
+
+    ok &= fec_speed( frame, lengths[0] );
+    ok &= fec_limits();
+    ok &= fec_flag_flip( frame, lengths[0] );
+
+    for( uint16_t length : lengths )
+    {
+        for( double ber : bers )
+        {
+            fec_result_t plain = fec_run( frame, length, false, ber );
+            fec_result_t fec = fec_run( frame, length, true, ber );
+            double plain_goodput = (double)plain.delivered * length / plain.wire_bytes;
+            double fec_goodput = (double)fec.delivered * length / fec.wire_bytes;
+            double overhead = (double)fec.wire_bytes / plain.wire_bytes - 1;
+            char name[ 64 ];
+            char gain[ 16 ] = "     -";
+
+            // Goodput gained per unit of overhead, none if nothing
+            //  got through without FEC.
+            if( plain_goodput > 0 )
+            {
+                snprintf( gain, sizeof(gain), "%+6.2f", ( fec_goodput / plain_goodput - 1 ) / overhead );
+            }
+
+            snprintf( name, sizeof(name), "fec %u bytes ber %.0e", length, ber );
+            printf( "%-32s %5.1f%% / %5.1f%% delivered %5.3f / %5.3f goodput %s gain/overhead %5u fixed\n",
+                    name,
+                    100.0 * plain.delivered / FEC_BENCH_FRAMES,
+                    100.0 * fec.delivered / FEC_BENCH_FRAMES,
+                    plain_goodput,
+                    fec_goodput,
+                    gain,
+                    fec.corrected );
+
+            if( ( ber == 0 )
+             && ( ( plain.delivered != FEC_BENCH_FRAMES ) || ( fec.delivered != FEC_BENCH_FRAMES ) ) )
+            {
+                bench_fail( name, "lost frames on a clean link" );
+                ok = false;
+            }
+
+            if( ( ber == 1e-3 )
+             && ( fec.delivered <= plain.delivered ) )
+            {
+                bench_fail( name, "fec didn't deliver more frames" );
+                ok = false;
+            }
+        }
+    }
+
+    return ok;
+}
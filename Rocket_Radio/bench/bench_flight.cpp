@@ -0,0 +1,136 @@
+#include "bench.h"
+#include "hdlc.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// Flight profile, in seconds from power on.
+#define FLIGHT_LAUNCH_S 10.0
+#define FLIGHT_BURNOUT_S 13.0
+#define FLIGHT_BOOST_ACCEL 80.0     // m/s^2
+#define FLIGHT_COAST_DECEL 12.0     // Gravity plus drag
+#define FLIGHT_DESCENT_RATE 8.0     // m/s under the chute
+
+#define SEA_LEVEL_PSI 14.696
+
+static_assert( BENCH_FRAME_LEN == 1 + sizeof(data_pkg_t), "BENCH_FRAME_LEN isn't a data_pkg_t frame" );
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   flight_noise
+*       Repeatable noise in [-1, 1] for time_ms and a
+*       channel.
+**********************************************************/
+static double flight_noise( uint32_t time_ms, uint32_t channel )
+{
+    uint32_t x = time_ms * 2654435761u ^ ( channel + 1 ) * 40503u;
+
+    x ^= x >> 15;
+    x *= 0x2C1B3C6Du;
+    x ^= x >> 12;
+
+    return ( x & 0xFFFF ) / 32767.5 - 1.0;
+}
+
+
+/**********************************************************
+*   bench_flight_sample
+*       What the sensors would read time_ms into a flight:
+*       sitting on the pad, a 3 s burn, coast to apogee and
+*       a slow descent, with sensor noise on top.
+**********************************************************/
+data_pkg_t bench_flight_sample( uint32_t time_ms )
+{
+    double t = time_ms / 1000.0;
+    double burn = FLIGHT_BURNOUT_S - FLIGHT_LAUNCH_S;
+    double v_burnout = FLIGHT_BOOST_ACCEL * burn;
+    double t_apogee = FLIGHT_BURNOUT_S + v_burnout / FLIGHT_COAST_DECEL;
+    double alt_burnout = 0.5 * FLIGHT_BOOST_ACCEL * burn * burn;
+    double alt_apogee = alt_burnout + 0.5 * v_burnout * ( t_apogee - FLIGHT_BURNOUT_S );
+    double alt;
+    double accel;
+    double accel_noise;
+    double spin = 0.0;
+    data_pkg_t sample;
+
+    if( t < FLIGHT_LAUNCH_S )
+    {
+        alt = 0.0;
+        accel = 0.0;
+        accel_noise = 0.05;
+    }
+    else if( t < FLIGHT_BURNOUT_S )
+    {
+        double dt = t - FLIGHT_LAUNCH_S;
+        alt = 0.5 * FLIGHT_BOOST_ACCEL * dt * dt;
+        accel = FLIGHT_BOOST_ACCEL;
+        accel_noise = 2.0;
+        spin = 90.0 * dt * dt;
+    }
+    else if( t < t_apogee )
+    {
+        double dt = t - FLIGHT_BURNOUT_S;
+        alt = alt_burnout + v_burnout * dt - 0.5 * FLIGHT_COAST_DECEL * dt * dt;
+        accel = -FLIGHT_COAST_DECEL;
+        accel_noise = 1.0;
+        spin = 90.0 * burn * burn + 540.0 * dt;
+    }
+    else
+    {
+        alt = alt_apogee - FLIGHT_DESCENT_RATE * ( t - t_apogee );
+        alt = ( alt < 0.0 ) ? 0.0 : alt;
+        accel = 0.0;
+        accel_noise = ( alt > 0.0 ) ? 0.5 : 0.05;
+    }
+
+    memset( &sample, 0, sizeof(sample) );
+
+    sample.angle_x = (float)fmod( 12.5 + spin + 0.06 * flight_noise( time_ms, 0 ) + 360.0, 360.0 );
+    sample.angle_y = (float)( 88.0 + 0.06 * flight_noise( time_ms, 1 ) );
+    sample.angle_z = (float)( -1.5 + 0.06 * flight_noise( time_ms, 2 ) );
+
+    sample.accel_x = (float)( accel_noise * flight_noise( time_ms, 3 ) );
+    sample.accel_y = (float)( accel_noise * flight_noise( time_ms, 4 ) );
+    sample.accel_z = (float)( accel + accel_noise * flight_noise( time_ms, 5 ) );
+
+    sample.prsur = (float)( SEA_LEVEL_PSI * pow( 1.0 - 2.25577e-5 * alt, 5.25588 ) + 0.002 * flight_noise( time_ms, 6 ) );
+    sample.prsur_temp = (float)( 72.0 - 0.0036 * alt + 0.1 * flight_noise( time_ms, 7 ) );
+
+    sample.adc_chnl_0 = (uint16_t)( 512 + 100 * sin( t / 7.0 ) + 2 * flight_noise( time_ms, 8 ) );
+    sample.adc_chnl_1 = (uint16_t)( 300 + 2 * flight_noise( time_ms, 9 ) );
+    sample.adc_chnl_2 = (uint16_t)( 700 + 50 * cos( t / 3.0 ) + 2 * flight_noise( time_ms, 10 ) );
+    sample.adc_chnl_3 = (uint16_t)( 1023 * ( accel + 100.0 ) / 200.0 );
+    sample.adc_chnl_4 = (uint16_t)( 100 + 2 * flight_noise( time_ms, 12 ) );
+    sample.adc_chnl_5 = (uint16_t)( 900 + 3 * flight_noise( time_ms, 13 ) );
+    sample.adc_chnl_6 = (uint16_t)( 512 );
+    sample.adc_chnl_7 = (uint16_t)( 20 + 20 * flight_noise( time_ms, 15 ) );
+
+    return sample;
+}
+
+
+/**********************************************************
+*   bench_random_frame
+*       Fill a BENCH_FRAME_LEN frame with rand() bytes, so
+*       it has the usual amount of escapes. The first byte
+*       is the data type, which never has the FEC flag.
+**********************************************************/
+void bench_random_frame( uint8_t * frame )
+{
+    for( int i = 0; i < BENCH_FRAME_LEN; i++ )
+    {
+        frame[i] = (uint8_t)rand();
+    }
+
+    frame[0] &= ~HDLC_FEC_FLAG;
+}
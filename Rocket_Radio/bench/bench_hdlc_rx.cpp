@@ -0,0 +1,165 @@
+#include "bench.h"
+#include "hdlc.h"
+#include "hdlc_legacy.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define RX_BENCH_MAX_DATA_LENGTH 64
+
+// Size of the synthetic stream when no capture is given.
+#define RX_BENCH_FRAMES 500000
+
+// Matches XBEE_READ_CHUNK, what Xbee::read hands the decoder at once.
+#define RX_BENCH_CHUNK 32
+
+#define RX_BENCH_PASSES 10
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+typedef Hdlc< RX_BENCH_MAX_DATA_LENGTH, bench_sink_t, bench_handler_t > bench_hdlc_t;
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   make_stream
+*       Build a stream of encoded data_pkg_t sized frames
+*       with random contents, so it has the usual amount
+*       of escapes.
+**********************************************************/
+static void make_stream( std::vector<uint8_t> &stream )
+{
+    uint8_t frame[ BENCH_FRAME_LEN ];
+    uint8_t encoded[ HDLC_ENCODED_LENGTH( BENCH_FRAME_LEN ) ];
+
+    srand( 2 );
+    for( int f = 0; f < RX_BENCH_FRAMES; f++ )
+    {
+        bench_random_frame( frame );
+        uint16_t encoded_length = bench_hdlc_t::encode_frame( frame, BENCH_FRAME_LEN, encoded, sizeof(encoded) );
+
+        stream.insert( stream.end(), encoded, encoded + encoded_length );
+    }
+}
+
+
+/**********************************************************
+*   bench_hdlc_rx
+*       Decode a capture, or a synthetic stream if
+*       capture is NULL, byte at a time and a chunk at a
+*       time, with the Hdlc template and the old
+*       std::function based class.
+**********************************************************/
+bool bench_hdlc_rx( char const * capture )
+{
+    std::vector<uint8_t> stream;
+    uint64_t legacy_frames = 0;
+    bool ok = true;
+
+    if( capture )
+    {
+        if( !bench_load( capture, stream ) )
+        {
+            bench_fail( "hdlc rx", "can't read capture" );
+            return false;
+        }
+    }
+    else
+    {
+        make_stream( stream );
+    }
+
+    uint64_t const total = (uint64_t)stream.size() * RX_BENCH_PASSES;
+
+    // Old class, byte at a time
+    {
+        HdlcLegacy hdlc( RX_BENCH_MAX_DATA_LENGTH );
+        hdlc.set_rcv_hndlr( [&legacy_frames]( uint8_t * data, uint8_t size )
+        {
+            bench_keep( data[0] + size );
+            legacy_frames++;
+        });
+
+        bench_clock_t::time_point start = bench_clock_t::now();
+        for( int pass = 0; pass < RX_BENCH_PASSES; pass++ )
+        {
+            for( size_t i = 0; i < stream.size(); i++ )
+            {
+                hdlc.byte_receive( stream[i] );
+            }
+        }
+        bench_report( "hdlc rx legacy byte_receive", bench_seconds_since( start ), total, legacy_frames );
+    }
+
+    if( ( !capture )
+     && ( legacy_frames != (uint64_t)RX_BENCH_FRAMES * RX_BENCH_PASSES ) )
+    {
+        bench_fail( "hdlc rx legacy byte_receive", "lost frames" );
+        ok = false;
+    }
+
+    // Template, byte at a time
+    {
+        bench_sink_t sink;
+        bench_handler_t handler;
+        uint8_t rcv_buffer[ bench_hdlc_t::max_frame_length ];
+        bench_hdlc_t hdlc( sink, handler, rcv_buffer );
+
+        bench_clock_t::time_point start = bench_clock_t::now();
+        for( int pass = 0; pass < RX_BENCH_PASSES; pass++ )
+        {
+            for( size_t i = 0; i < stream.size(); i++ )
+            {
+                hdlc.byte_receive( stream[i] );
+            }
+        }
+        bench_report( "hdlc rx byte_receive", bench_seconds_since( start ), total, handler.frames );
+        bench_keep( handler.sum );
+
+        if( handler.frames != legacy_frames )
+        {
+            bench_fail( "hdlc rx byte_receive", "frame count differs from legacy" );
+            ok = false;
+        }
+    }
+
+    // Template, a chunk at a time
+    {
+        bench_sink_t sink;
+        bench_handler_t handler;
+        uint8_t rcv_buffer[ bench_hdlc_t::max_frame_length ];
+        bench_hdlc_t hdlc( sink, handler, rcv_buffer );
+
+        bench_clock_t::time_point start = bench_clock_t::now();
+        for( int pass = 0; pass < RX_BENCH_PASSES; pass++ )
+        {
+            for( size_t i = 0; i < stream.size(); i += RX_BENCH_CHUNK )
+            {
+                hdlc.receive( &stream[i], ( stream.size() - i < RX_BENCH_CHUNK ) ? stream.size() - i : RX_BENCH_CHUNK );
+            }
+        }
+        bench_report( "hdlc rx receive", bench_seconds_since( start ), total, handler.frames );
+        bench_keep( handler.sum );
+
+        if( handler.frames != legacy_frames )
+        {
+            bench_fail( "hdlc rx receive", "frame count differs from legacy" );
+            ok = false;
+        }
+    }
+
+    return ok;
+}
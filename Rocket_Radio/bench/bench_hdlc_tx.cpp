@@ -0,0 +1,174 @@
+#include "bench.h"
+#include "hdlc.h"
+#include "hdlc_legacy.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define TX_BENCH_MAX_DATA_LENGTH 64
+
+#define TX_BENCH_FRAMES 2000000
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+typedef Hdlc< TX_BENCH_MAX_DATA_LENGTH, bench_sink_t, bench_handler_t > bench_hdlc_t;
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   bench_hdlc_tx
+*       Send frames through the old std::function based
+*       class and through the Hdlc template, and print how
+*       much memory each one needs.
+**********************************************************/
+bool bench_hdlc_tx()
+{
+    uint8_t frame[ BENCH_FRAME_LEN ];
+    uint64_t legacy_bytes = 0;
+    bool ok = true;
+
+    srand( 3 );
+    bench_random_frame( frame );
+
+    // Old class, one handler call per byte
+    {
+        HdlcLegacy hdlc( TX_BENCH_MAX_DATA_LENGTH );
+        hdlc.set_send_hndlr( [&legacy_bytes]( uint8_t data )
+        {
+            bench_keep( data );
+            legacy_bytes++;
+        });
+
+        bench_clock_t::time_point start = bench_clock_t::now();
+        for( int f = 0; f < TX_BENCH_FRAMES; f++ )
+        {
+            frame[0] = (uint8_t)f;
+            hdlc.send_frame( frame, BENCH_FRAME_LEN );
+        }
+        bench_report( "hdlc tx legacy send_frame", bench_seconds_since( start ), legacy_bytes, TX_BENCH_FRAMES );
+    }
+
+    // Template, send_frame
+    {
+        bench_sink_t sink;
+        bench_handler_t handler;
+        uint8_t rcv_buffer[ bench_hdlc_t::max_frame_length ];
+        bench_hdlc_t hdlc( sink, handler, rcv_buffer );
+
+        bench_clock_t::time_point start = bench_clock_t::now();
+        for( int f = 0; f < TX_BENCH_FRAMES; f++ )
+        {
+            frame[0] = (uint8_t)f;
+            hdlc.send_frame( frame, BENCH_FRAME_LEN );
+        }
+        bench_report( "hdlc tx send_frame", bench_seconds_since( start ), sink.bytes, TX_BENCH_FRAMES );
+        bench_keep( sink.sum );
+
+        if( sink.bytes != legacy_bytes )
+        {
+            bench_fail( "hdlc tx send_frame", "byte count differs from legacy" );
+            ok = false;
+        }
+    }
+
+    // Template, the old byte at a time path
+    {
+        bench_sink_t sink;
+        bench_handler_t handler;
+        uint8_t rcv_buffer[ bench_hdlc_t::max_frame_length ];
+        bench_hdlc_t hdlc( sink, handler, rcv_buffer );
+
+        bench_clock_t::time_point start = bench_clock_t::now();
+        for( int f = 0; f < TX_BENCH_FRAMES; f++ )
+        {
+            frame[0] = (uint8_t)f;
+            hdlc.send_frame_bytes( frame, BENCH_FRAME_LEN );
+        }
+        bench_report( "hdlc tx send_frame_bytes", bench_seconds_since( start ), sink.bytes, TX_BENCH_FRAMES );
+        bench_keep( sink.sum );
+
+        if( sink.bytes != legacy_bytes )
+        {
+            bench_fail( "hdlc tx send_frame_bytes", "byte count differs from legacy" );
+            ok = false;
+        }
+    }
+
+    // Template, encode then one sink call per frame
+    {
+        bench_sink_t sink;
+
+        bench_clock_t::time_point start = bench_clock_t::now();
+        for( int f = 0; f < TX_BENCH_FRAMES; f++ )
+        {
+            uint8_t encoded[ bench_hdlc_t::max_encoded_length ];
+
+            frame[0] = (uint8_t)f;
+            uint16_t encoded_length = bench_hdlc_t::encode_frame( frame, BENCH_FRAME_LEN, encoded, sizeof(encoded) );
+            if( encoded_length > 0 )
+            {
+                sink.write( encoded, encoded_length );
+            }
+        }
+        bench_report( "hdlc tx encode_frame", bench_seconds_since( start ), sink.bytes, TX_BENCH_FRAMES );
+        bench_keep( sink.sum );
+
+        if( sink.bytes != legacy_bytes )
+        {
+            bench_fail( "hdlc tx encode_frame", "byte count differs from legacy" );
+            ok = false;
+        }
+    }
+
+    // Template, the same frame streamed as type byte then data
+    {
+        bench_sink_t sink;
+        bench_handler_t handler;
+        uint8_t rcv_buffer[ bench_hdlc_t::max_frame_length ];
+        bench_hdlc_t hdlc( sink, handler, rcv_buffer );
+
+        bench_clock_t::time_point start = bench_clock_t::now();
+        for( int f = 0; f < TX_BENCH_FRAMES; f++ )
+        {
+            frame[0] = (uint8_t)f;
+            hdlc.begin_frame();
+            hdlc.append_frame( frame, 1 );
+            hdlc.append_frame( &frame[1], BENCH_FRAME_LEN - 1 );
+            hdlc.end_frame();
+        }
+        bench_report( "hdlc tx streamed", bench_seconds_since( start ), sink.bytes, TX_BENCH_FRAMES );
+        bench_keep( sink.sum );
+
+        if( sink.bytes != legacy_bytes )
+        {
+            bench_fail( "hdlc tx streamed", "byte count differs from legacy" );
+            ok = false;
+        }
+    }
+
+    // Memory needed for a MAX_DATA_LENGTH Hdlc. The old class keeps
+    //  two std::function handlers in the object and its buffers on the
+    //  heap, the template decodes into a buffer the caller gives and
+    //  has no transmit buffer.
+    printf( "%-32s %6u bytes object + %u bytes heap\n",
+            "hdlc legacy memory",
+            (unsigned)sizeof(HdlcLegacy),
+            (unsigned)( ( TX_BENCH_MAX_DATA_LENGTH + 2 ) + HDLC_LEGACY_ENCODED_LENGTH( TX_BENCH_MAX_DATA_LENGTH ) ) );
+    printf( "%-32s %6u bytes object + %u bytes receive buffer\n",
+            "hdlc template memory",
+            (unsigned)sizeof(bench_hdlc_t),
+            (unsigned)bench_hdlc_t::max_frame_length );
+
+    return ok;
+}
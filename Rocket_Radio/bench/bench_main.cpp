@@ -0,0 +1,138 @@
+// Host side benchmarks for the radio code. Built by the native env
+//  against the Arduino stand-ins in native/.
+//
+// Build and run from Rocket_Radio/:
+//      platformio run -e native
+//      .pioenvs/native/program [serial1_capture.bin [gps_log.nmea]]
+//
+// Without a capture the receive benchmark runs on a synthetic stream,
+//  without a GPS log the NMEA benchmark does. Pass "-" to skip one.
+// Exits non zero if any benchmark's self check fails, so it can gate
+//  changes to the framing code.
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+// Written by bench_keep so results can't be optimized away.
+static volatile uint32_t bench_keep_val;
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   bench_seconds_since
+*       Seconds elapsed since start.
+**********************************************************/
+double bench_seconds_since( bench_clock_t::time_point start )
+{
+    return std::chrono::duration<double>( bench_clock_t::now() - start ).count();
+}
+
+
+/**********************************************************
+*   bench_report
+*       Print one result line. frames may be 0 if the
+*       benchmark doesn't work on frames.
+**********************************************************/
+void bench_report( char const * name, double seconds, uint64_t bytes, uint64_t frames )
+{
+    printf( "%-32s %10.2f MB/s %8.3f ns/byte",
+            name,
+            bytes / seconds / 1e6,
+            seconds * 1e9 / bytes );
+
+    if( frames )
+    {
+        printf( " %12.0f frames/s %8.1f ns/frame",
+                frames / seconds,
+                seconds * 1e9 / frames );
+    }
+
+    printf( "\n" );
+}
+
+
+/**********************************************************
+*   bench_fail
+*       Print a self check failure.
+**********************************************************/
+void bench_fail( char const * name, char const * reason )
+{
+    printf( "%-32s FAILED: %s\n", name, reason );
+}
+
+
+/**********************************************************
+*   bench_keep
+*       Consume a result.
+**********************************************************/
+void bench_keep( uint32_t value )
+{
+    bench_keep_val = value;
+}
+
+
+/**********************************************************
+*   bench_load
+*       Read a whole file, like a raw capture of a UART.
+**********************************************************/
+bool bench_load( char const * path, std::vector<uint8_t> &data )
+{
+    FILE * f = fopen( path, "rb" );
+    uint8_t buf[ 4096 ];
+    size_t n;
+
+    if( !f )
+    {
+        return false;
+    }
+
+    while( ( n = fread( buf, 1, sizeof(buf), f ) ) > 0 )
+    {
+        data.insert( data.end(), buf, buf + n );
+    }
+
+    fclose( f );
+    return true;
+}
+
+
+/**********************************************************
+*   main
+**********************************************************/
+int main( int argc, char ** argv )
+{
+    bool ok = true;
+    char const * capture = ( ( argc > 1 ) && strcmp( argv[1], "-" ) ) ? argv[1] : NULL;
+    char const * nmea_log = ( ( argc > 2 ) && strcmp( argv[2], "-" ) ) ? argv[2] : NULL;
+
+    ok &= bench_crc();
+    ok &= bench_hdlc_rx( capture );
+    ok &= bench_hdlc_tx();
+    ok &= bench_escape();
+    ok &= bench_xbee();
+    ok &= bench_txq();
+    ok &= bench_codec();
+    ok &= bench_batch();
+    ok &= bench_spsc();
+    ok &= bench_sched();
+    ok &= bench_bus();
+    ok &= bench_prof();
+    ok &= bench_nmea( nmea_log );
+    ok &= bench_fec();
+    ok &= bench_trigger();
+    ok &= bench_schema();
+    ok &= bench_sdlog();
+    ok &= bench_downlink();
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
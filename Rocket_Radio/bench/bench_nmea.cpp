@@ -0,0 +1,396 @@
+#include "bench.h"
+#include "gps/nmea_parser.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// Synthetic log, an hour of fixes at 10Hz.
+#define NMEA_BENCH_FIXES 36000
+#define NMEA_BENCH_RATE_HZ 10
+
+// Every Nth sentence gets a character flipped, every Mth fix a GSV
+//  sentence the parser has to skip over.
+#define NMEA_BENCH_CORRUPT_EVERY 97
+#define NMEA_BENCH_GSV_EVERY 10
+
+// Matches GPS_READ_CHUNK in main.cpp.
+#define NMEA_BENCH_CHUNK 32
+
+#define NMEA_BENCH_PASSES 5
+
+// Longest line the old parser buffers, same as Adafruit_GPS.
+#define NMEA_LEGACY_MAX_LINE 120
+
+
+/******************************************************************************
+ *                               Local Types
+ *****************************************************************************/
+
+// Roughly what Adafruit_GPS does. read() a byte per loop() into a line
+//  buffer, then parse() the line with strchr and atof.
+struct nmea_legacy_t
+{
+    char line[ NMEA_LEGACY_MAX_LINE ];
+    uint8_t length;
+    gps_data_t data;
+    uint32_t fixes;
+};
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   nmea_sentence
+*       Append body as a whole sentence, with its '$',
+*       checksum and line end.
+**********************************************************/
+static void nmea_sentence( std::vector<uint8_t> &stream, char const * body )
+{
+    uint8_t sum = 0;
+    char tail[ 8 ];
+
+    for( char const * c = body; *c; c++ )
+    {
+        sum ^= (uint8_t)*c;
+    }
+
+    snprintf( tail, sizeof(tail), "*%02X\r\n", sum );
+    stream.push_back( '$' );
+    stream.insert( stream.end(), body, body + strlen( body ) );
+    stream.insert( stream.end(), tail, tail + strlen( tail ) );
+}
+
+
+/**********************************************************
+*   nmea_coord
+*       deg as NMEA's dddmm.mmmm and a hemisphere.
+**********************************************************/
+static void nmea_coord( char * out, size_t size, double deg, int deg_digits, char pos, char neg )
+{
+    double a = fabs( deg );
+    int whole = (int)a;
+    double minutes = ( a - whole ) * 60.0;
+
+    snprintf( out, size, "%0*d%07.4f,%c", deg_digits, whole, minutes, ( deg < 0 ) ? neg : pos );
+}
+
+
+/**********************************************************
+*   make_nmea
+*       An RMC and GGA pair per fix, a drifting position,
+*       the odd GSV and the odd corrupted sentence. What
+*       the parser should make of each fix goes in fixes.
+**********************************************************/
+static uint32_t make_nmea( std::vector<uint8_t> &stream, std::vector<gps_data_t> &fixes )
+{
+    uint32_t corrupted = 0;
+    uint32_t sentences = 0;
+
+    for( uint32_t f = 0; f < NMEA_BENCH_FIXES; f++ )
+    {
+        uint32_t ms = f * ( 1000 / NMEA_BENCH_RATE_HZ );
+        uint32_t sec_of_day = 12 * 3600 + ms / 1000;
+        double lat = 32.9401 + f * 1e-6;
+        double lon = -106.9194 - f * 2e-6;
+        char time[ 16 ];
+        char lat_s[ 24 ];
+        char lon_s[ 24 ];
+        char body[ 128 ];
+        gps_data_t fix;
+        bool good = true;
+
+        snprintf( time, sizeof(time), "%02u%02u%02u.%03u", sec_of_day / 3600, sec_of_day / 60 % 60, sec_of_day % 60, ms % 1000 );
+        nmea_coord( lat_s, sizeof(lat_s), lat, 2, 'N', 'S' );
+        nmea_coord( lon_s, sizeof(lon_s), lon, 3, 'E', 'W' );
+
+        memset( &fix, 0, sizeof(fix) );
+        fix.year = 19;
+        fix.month = 5;
+        fix.day = 12;
+        fix.hour = sec_of_day / 3600;
+        fix.min = sec_of_day / 60 % 60;
+        fix.sec = sec_of_day % 60;
+        fix.lat = (float)lat;
+        fix.lon = (float)lon;
+        fix.fix = true;
+        fix.fix_qual = 1;
+        fix.sat_num = 7 + f % 5;
+
+        snprintf( body, sizeof(body), "GPRMC,%s,A,%s,%s,0.13,309.62,120519,,,A", time, lat_s, lon_s );
+        nmea_sentence( stream, body );
+        if( ++sentences % NMEA_BENCH_CORRUPT_EVERY == 0 )
+        {
+            stream[ stream.size() - 20 ] ^= 0x01;
+            corrupted++;
+            good = false;
+        }
+
+        snprintf( body, sizeof(body), "GPGGA,%s,%s,%s,1,%02u,1.01,1412.3,M,-22.5,M,,", time, lat_s, lon_s, fix.sat_num );
+        nmea_sentence( stream, body );
+        if( ++sentences % NMEA_BENCH_CORRUPT_EVERY == 0 )
+        {
+            stream[ stream.size() - 20 ] ^= 0x01;
+            corrupted++;
+            good = false;
+        }
+
+        if( f % NMEA_BENCH_GSV_EVERY == 0 )
+        {
+            nmea_sentence( stream, "GPGSV,3,1,11,10,63,137,17,07,61,098,15,05,59,290,20,08,54,157,30" );
+        }
+
+        if( good )
+        {
+            fixes.push_back( fix );
+        }
+    }
+
+    return corrupted;
+}
+
+
+/**********************************************************
+*   legacy_degrees
+*       dddmm.mmmm to degrees the way Adafruit_GPS does,
+*       through atof.
+**********************************************************/
+static float legacy_degrees( char const * p )
+{
+    double v = atof( p );
+    int deg = (int)( v / 100 );
+
+    return (float)( deg + ( v - deg * 100 ) / 60.0 );
+}
+
+
+/**********************************************************
+*   legacy_parse
+*       Check a buffered line's checksum and pull the
+*       fields out of it with strchr.
+**********************************************************/
+static void legacy_parse( nmea_legacy_t &gps )
+{
+    char * nmea = gps.line;
+    char * star = strchr( nmea, '*' );
+    uint8_t sum = 0;
+    char * p;
+
+    if( ( nmea[0] != '$' )
+     || ( !star ) )
+    {
+        return;
+    }
+
+    for( p = nmea + 1; p < star; p++ )
+    {
+        sum ^= (uint8_t)*p;
+    }
+
+    if( strtol( star + 1, NULL, 16 ) != sum )
+    {
+        return;
+    }
+
+    bool rmc = ( strstr( nmea, "RMC," ) == nmea + 3 );
+    bool gga = ( strstr( nmea, "GGA," ) == nmea + 3 );
+    if( !rmc && !gga )
+    {
+        return;
+    }
+
+    p = strchr( nmea, ',' ) + 1;
+    uint32_t time = atol( p );
+    gps.data.hour = time / 10000;
+    gps.data.min = time / 100 % 100;
+    gps.data.sec = time % 100;
+
+    if( rmc )
+    {
+        p = strchr( p, ',' ) + 1;
+        gps.data.fix = ( *p == 'A' );
+    }
+
+    p = strchr( p, ',' ) + 1;
+    gps.data.lat = legacy_degrees( p );
+    p = strchr( p, ',' ) + 1;
+    gps.data.lat = ( *p == 'S' ) ? -gps.data.lat : gps.data.lat;
+    p = strchr( p, ',' ) + 1;
+    gps.data.lon = legacy_degrees( p );
+    p = strchr( p, ',' ) + 1;
+    gps.data.lon = ( *p == 'W' ) ? -gps.data.lon : gps.data.lon;
+
+    if( gga )
+    {
+        p = strchr( p, ',' ) + 1;
+        gps.data.fix_qual = atoi( p );
+        p = strchr( p, ',' ) + 1;
+        gps.data.sat_num = atoi( p );
+        gps.fixes++;
+    }
+    else
+    {
+        p = strchr( p, ',' ) + 1;
+        p = strchr( p, ',' ) + 1;
+        p = strchr( p, ',' ) + 1;
+        uint32_t date = atol( p );
+        gps.data.day = date / 10000;
+        gps.data.month = date / 100 % 100;
+        gps.data.year = date % 100;
+    }
+}
+
+
+/**********************************************************
+*   legacy_read
+*       One byte, as gps.read() and gps.parse() took it.
+**********************************************************/
+static void legacy_read( nmea_legacy_t &gps, uint8_t c )
+{
+    if( c == '\n' )
+    {
+        gps.line[gps.length] = 0;
+        legacy_parse( gps );
+        gps.length = 0;
+    }
+    else if( gps.length < NMEA_LEGACY_MAX_LINE - 1 )
+    {
+        gps.line[gps.length++] = (char)c;
+    }
+}
+
+
+/**********************************************************
+*   same_fix
+*       Whether two fixes agree, positions to about a
+*       metre.
+**********************************************************/
+static bool same_fix( gps_data_t const & a, gps_data_t const & b )
+{
+    return ( a.year == b.year )
+        && ( a.month == b.month )
+        && ( a.day == b.day )
+        && ( a.hour == b.hour )
+        && ( a.min == b.min )
+        && ( a.sec == b.sec )
+        && ( fabs( a.lat - b.lat ) < 1e-5 )
+        && ( fabs( a.lon - b.lon ) < 1e-5 )
+        && ( a.fix == b.fix )
+        && ( a.fix_qual == b.fix_qual )
+        && ( a.sat_num == b.sat_num );
+}
+
+
+/**********************************************************
+*   bench_nmea
+*       Parse a recorded GPS log, or a synthetic one if
+*       nmea_log is NULL, the old way a byte per call and
+*       with NmeaParser a chunk at a time. On the synthetic
+*       log every fix is checked against what was written.
+**********************************************************/
+bool bench_nmea( char const * nmea_log )
+{
+    std::vector<uint8_t> stream;
+    std::vector<gps_data_t> expected;
+    uint32_t corrupted = 0;
+    bool ok = true;
+
+    if( nmea_log )
+    {
+        if( !bench_load( nmea_log, stream ) )
+        {
+            bench_fail( "nmea", "can't read GPS log" );
+            return false;
+        }
+    }
+    else
+    {
+        corrupted = make_nmea( stream, expected );
+    }
+
+    uint64_t const total = (uint64_t)stream.size() * NMEA_BENCH_PASSES;
+    nmea_legacy_t legacy;
+
+    // Line buffer and atof, a byte at a time
+    {
+        bench_clock_t::time_point start = bench_clock_t::now();
+        for( int pass = 0; pass < NMEA_BENCH_PASSES; pass++ )
+        {
+            memset( &legacy, 0, sizeof(legacy) );
+            for( size_t i = 0; i < stream.size(); i++ )
+            {
+                legacy_read( legacy, stream[i] );
+            }
+        }
+        bench_report( "nmea legacy read/parse", bench_seconds_since( start ), total, (uint64_t)legacy.fixes * NMEA_BENCH_PASSES );
+        bench_keep( legacy.data.sat_num );
+    }
+
+    // Streaming, a chunk at a time
+    NmeaParser nmea;
+    uint64_t fixes = 0;
+    {
+        bench_clock_t::time_point start = bench_clock_t::now();
+        for( int pass = 0; pass < NMEA_BENCH_PASSES; pass++ )
+        {
+            nmea = NmeaParser();
+            for( size_t i = 0; i < stream.size(); i += NMEA_BENCH_CHUNK )
+            {
+                nmea.receive( &stream[i], ( stream.size() - i < NMEA_BENCH_CHUNK ) ? stream.size() - i : NMEA_BENCH_CHUNK );
+                fixes += nmea.fix_ready() ? 1 : 0;
+            }
+        }
+        bench_report( "nmea NmeaParser receive", bench_seconds_since( start ), total, fixes );
+        bench_keep( nmea.data().sat_num );
+    }
+
+    printf( "%-32s %u sentences, %u bad\n", "nmea NmeaParser", nmea.sentences(), nmea.bad() );
+
+    if( !same_fix( nmea.data(), legacy.data ) )
+    {
+        bench_fail( "nmea NmeaParser", "last fix differs from legacy" );
+        ok = false;
+    }
+
+    if( nmea_log )
+    {
+        return ok;
+    }
+
+    if( nmea.bad() != corrupted )
+    {
+        bench_fail( "nmea NmeaParser", "corrupted sentences not all caught" );
+        ok = false;
+    }
+
+    // Byte at a time, so every fix can be checked
+    NmeaParser check;
+    size_t next = 0;
+    bool match = true;
+    for( size_t i = 0; i < stream.size(); i++ )
+    {
+        check.receive( stream[i] );
+        if( check.fix_ready() )
+        {
+            match &= ( next < expected.size() ) && same_fix( check.data(), expected[next] );
+            next++;
+        }
+    }
+
+    if( ( !match )
+     || ( next != expected.size() ) )
+    {
+        bench_fail( "nmea NmeaParser", "fixes lost or parsed wrong" );
+        ok = false;
+    }
+
+    return ok;
+}
@@ -0,0 +1,137 @@
+#include "bench.h"
+#include "util/prof.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define PROF_BENCH_PAIRS 10000000
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   prof_stat
+*       Section i's stats out of a DIAGNOSTICS frame.
+**********************************************************/
+static diag_stat_t prof_stat( uint8_t const * frame, uint8_t i )
+{
+    diag_stat_t stat;
+
+    memcpy( &stat, &frame[ sizeof(diag_hdr_t) + i * sizeof(stat) ], sizeof(stat) );
+    return stat;
+}
+
+
+/**********************************************************
+*   bench_prof
+*       Checks the stats and histogram in a DIAGNOSTICS
+*       frame against known times, then measures what a
+*       start() / stop() pair costs.
+**********************************************************/
+bool bench_prof()
+{
+    uint8_t frame[ DIAG_FRAME_SIZE ];
+    diag_hdr_t hdr;
+    Profiler prof;
+    bool ok = true;
+
+    prof.begin( 0 );
+
+    // 3 x 1000us and 1 x 3000us, in buckets 9 and 11
+    prof.add( PROF_LOOP, 1000 * PROF_TICKS_PER_US );
+    prof.add( PROF_LOOP, 1000 * PROF_TICKS_PER_US );
+    prof.add( PROF_LOOP, 1000 * PROF_TICKS_PER_US );
+    prof.add( PROF_LOOP, 3000 * PROF_TICKS_PER_US );
+
+    // Under 2us and off the top end
+    prof.add( PROF_SD_WRITE, 1 );
+    prof.add( PROF_SD_WRITE, 1000000 * PROF_TICKS_PER_US );
+
+    // 500 passes a second, then 250
+    for( uint32_t ms = 0; ms < 1000; ms += 2 )
+    {
+        prof.loop( ms );
+    }
+    for( uint32_t ms = 1000; ms <= 2000; ms += 4 )
+    {
+        prof.loop( ms );
+    }
+
+    prof.overrun();
+    prof.overrun();
+
+    // Counts saturate rather than wrap
+    prof.set_count( PROF_CNT_ADC_LOG_MISSED, 12 );
+    prof.set_count( PROF_CNT_ACQ_FAILED, 100000 );
+
+    if( ( prof.fill( frame, sizeof(frame) - 1, 2000 ) != 0 )
+     || ( prof.fill( frame, sizeof(frame), 2000 ) != DIAG_FRAME_SIZE ) )
+    {
+        bench_fail( "prof fill", "wrong size" );
+        return false;
+    }
+
+    memcpy( &hdr, frame, sizeof(hdr) );
+    diag_stat_t loop = prof_stat( frame, PROF_LOOP );
+    diag_stat_t sd = prof_stat( frame, PROF_SD_WRITE );
+    diag_stat_t idle = prof_stat( frame, PROF_GPS_SEND );
+    uint16_t missed, failed;
+    memcpy( &missed, &frame[ sizeof(hdr) + PROF_SECTION_CNT * sizeof(loop) + PROF_CNT_ADC_LOG_MISSED * sizeof(missed) ], sizeof(missed) );
+    memcpy( &failed, &frame[ sizeof(hdr) + PROF_SECTION_CNT * sizeof(loop) + PROF_CNT_ACQ_FAILED * sizeof(failed) ], sizeof(failed) );
+
+    printf( "%-32s %u loops/s, %u overruns, loop %u / %u / %u us, buckets 9 %u 11 %u\n",
+            "prof stats", hdr.loops_per_s, hdr.overruns, loop.min_us, loop.mean_us, loop.max_us,
+            loop.hist[9], loop.hist[11] );
+
+    if( ( hdr.uptime_ms != 2000 )
+     || ( hdr.overruns != 2 )
+     || ( hdr.section_cnt != PROF_SECTION_CNT )
+     || ( hdr.count_cnt != PROF_COUNT_CNT )
+     || ( missed != 12 )
+     || ( failed != UINT16_MAX )
+     || ( hdr.loops_per_s < 240 )
+     || ( hdr.loops_per_s > 260 ) )
+    {
+        bench_fail( "prof stats", "header wrong" );
+        ok = false;
+    }
+
+    if( ( loop.count != 4 )
+     || ( loop.min_us != 1000 )
+     || ( loop.max_us != 3000 )
+     || ( loop.mean_us != 1500 )
+     || ( loop.hist[9] != 192 )
+     || ( loop.hist[11] != 64 )
+     || ( sd.hist[0] == 0 )
+     || ( sd.hist[ PROF_HIST_BINS - 1 ] == 0 )
+     || ( idle.count != 0 )
+     || ( idle.min_us != 0 ) )
+    {
+        bench_fail( "prof stats", "section stats wrong" );
+        ok = false;
+    }
+
+    // What timing a section costs
+    prof.begin( 0 );
+    bench_clock_t::time_point start = bench_clock_t::now();
+    for( uint32_t i = 0; i < PROF_BENCH_PAIRS; i++ )
+    {
+        uint32_t section_start = prof.start();
+        prof.stop( PROF_XBEE_READ, section_start );
+    }
+    double seconds = bench_seconds_since( start );
+
+    prof.fill( frame, sizeof(frame), 0 );
+    bench_keep( frame[ sizeof(hdr) ] );
+
+    printf( "%-32s %8.1f ns/section\n", "prof start() / stop()", seconds * 1e9 / PROF_BENCH_PAIRS );
+
+    return ok;
+}
@@ -0,0 +1,328 @@
+#include "bench.h"
+#include "acq/acq_sched.h"
+#include "telemetry/tagged_batch.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define SCHED_BENCH_BAUD 9600
+
+// Simulated run time, and what the rest of a loop() pass costs.
+#define SCHED_BENCH_RUN_MS 10000
+#define SCHED_BENCH_LOOP_US 100
+
+// data_send_task period.
+#define SCHED_BENCH_SEND_MS 200
+
+// Time each read holds the 100kHz I2C bus. A BNO055 vector is a
+//  register write and a 6 byte read, a DLV read is 4 bytes.
+#define SCHED_BENCH_IMU_US 900
+#define SCHED_BENCH_PRSUR_US 600
+
+
+/******************************************************************************
+ *                               Local Types
+ *****************************************************************************/
+
+// What one simulated run saw.
+struct sched_result_t
+{
+    uint32_t worst_pass_us;
+    uint32_t reads[SRC_CNT];
+    uint32_t late[SRC_CNT];
+    uint32_t lag_us[SRC_CNT];
+    uint32_t delivered[SRC_CNT];
+    uint32_t bad;
+};
+
+
+/******************************************************************************
+ *                               Local Vars
+ *****************************************************************************/
+
+// Simulated clock, starting at 1 us. Reads move it on by what they
+//  cost.
+static uint32_t sched_now_us;
+
+static char const * const sched_src_names[SRC_CNT] =
+{
+    "adc",
+    "euler",
+    "accel",
+    "prsur",
+};
+
+// Same as main.cpp
+static const acq_source_t sched_phased[] =
+{
+    { SRC_IMU_EULER,    10,         0,          NULL },
+    { SRC_IMU_ACCEL,    10,         5,          NULL },
+    { SRC_PRESSURE,     50,         2,          NULL },
+};
+
+// Same rates, every source starting on the same tick
+static const acq_source_t sched_unphased[] =
+{
+    { SRC_IMU_EULER,    10,         0,          NULL },
+    { SRC_IMU_ACCEL,    10,         0,          NULL },
+    { SRC_PRESSURE,     50,         0,          NULL },
+};
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+static bus_sts_t sched_imu_read( uint32_t time_us, void * sample )
+{
+    vec3_sample_t * out = (vec3_sample_t *)sample;
+
+    out->time_us = time_us;
+    out->x = out->y = out->z = (float)time_us;
+    sched_now_us += SCHED_BENCH_IMU_US;
+
+    return BUS_DONE;
+}
+
+
+static bus_sts_t sched_prsur_read( uint32_t time_us, void * sample )
+{
+    prsur_sample_t * out = (prsur_sample_t *)sample;
+
+    out->time_us = time_us;
+    out->prsur = out->temp = (float)time_us;
+    sched_now_us += SCHED_BENCH_PRSUR_US;
+
+    return BUS_DONE;
+}
+
+
+/**********************************************************
+*   sched_run
+*       Run an AcqScheduler over table from a simulated
+*       loop(), sending its samples through an Xbee whose
+*       UART drains at SCHED_BENCH_BAUD.
+**********************************************************/
+static sched_result_t sched_run( acq_source_t const * table, uint8_t count )
+{
+    acq_source_t sources[ ACQ_MAX_SOURCES ];
+    UARTClass tx_serial;
+    UARTClass rx_serial;
+    Xbee tx( &tx_serial );
+    Xbee rx( &rx_serial );
+    TaggedBatch tagged( &tx );
+    uint32_t rx_last_us[SRC_CNT] = { 0 };
+    uint32_t next_send_ms = 0;
+    uint8_t wire[ 256 ];
+    sched_result_t result;
+
+    memset( &result, 0, sizeof(result) );
+
+    for( uint8_t i = 0; i < count; i++ )
+    {
+        sources[i] = table[i];
+        sources[i].read = ( table[i].source == SRC_PRESSURE ) ? sched_prsur_read : sched_imu_read;
+    }
+
+    tx.setup( SCHED_BENCH_BAUD );
+    tx_serial.set_tx_limited( true );
+    tagged.set_decimation( SRC_IMU_EULER, 5 );
+    tagged.set_decimation( SRC_PRESSURE, 2 );
+
+    rx.set_frame_hndlr( SENSOR_TAGGED, [&]( uint8_t const * buffer, uint16_t size )
+    {
+        uint8_t offset = 0;
+        src_id_t source;
+        uint8_t const * sample;
+        uint32_t time_us;
+
+        while( tagged_next( buffer, size, offset, source, sample ) )
+        {
+            memcpy( &time_us, sample, sizeof(time_us) );
+            if( ( rx_last_us[source] != 0 )
+             && ( time_us <= rx_last_us[source] ) )
+            {
+                result.bad++;
+            }
+
+            rx_last_us[source] = time_us;
+            result.delivered[source]++;
+        }
+
+        if( offset != size )
+        {
+            result.bad++;
+        }
+    });
+
+    sched_now_us = 1;
+    AcqScheduler acq( sources, count );
+    acq.begin( sched_now_us );
+    acq.set_sink( [&]( src_id_t source, void const * sample, uint8_t size )
+    {
+        uint32_t time_us;
+
+        memcpy( &time_us, sample, sizeof(time_us) );
+        for( uint8_t i = 0; i < count; i++ )
+        {
+            if( sources[i].source == source )
+            {
+                // How long after its slot the read was made
+                uint32_t lag = ( time_us - 1 - sources[i].phase_ms * 1000UL ) % ( sources[i].period_ms * 1000UL );
+
+                if( lag > result.lag_us[source] )
+                {
+                    result.lag_us[source] = lag;
+                }
+            }
+        }
+
+        tagged.add( source, sample, size );
+    });
+
+    while( sched_now_us < SCHED_BENCH_RUN_MS * 1000UL )
+    {
+        uint32_t start_us = sched_now_us;
+
+        acq.run( sched_now_us );
+        sched_now_us += SCHED_BENCH_LOOP_US;
+
+        if( sched_now_us / 1000 >= next_send_ms )
+        {
+            tagged.send();
+            next_send_ms += SCHED_BENCH_SEND_MS;
+        }
+
+        tx.read();
+        tx_serial.run( sched_now_us - start_us );
+
+        size_t n;
+        while( ( n = tx_serial.take_tx( wire, sizeof(wire) ) ) > 0 )
+        {
+            rx_serial.inject( wire, n );
+        }
+        rx.read();
+
+        if( sched_now_us - start_us > result.worst_pass_us )
+        {
+            result.worst_pass_us = sched_now_us - start_us;
+        }
+    }
+
+    for( uint8_t i = 0; i < count; i++ )
+    {
+        result.reads[ sources[i].source ] = acq.reads( sources[i].source );
+        result.late[ sources[i].source ] = acq.late( sources[i].source );
+    }
+
+    return result;
+}
+
+
+/**********************************************************
+*   sched_report
+*       Print one simulated run.
+**********************************************************/
+static void sched_report( char const * name, acq_source_t const * table, uint8_t count, sched_result_t const & r )
+{
+    printf( "%-32s worst loop() pass %u us\n", name, r.worst_pass_us );
+
+    for( uint8_t i = 0; i < count; i++ )
+    {
+        src_id_t s = table[i].source;
+
+        printf( "  %-30s %6.1f Hz %4u late %5u us worst lag %5u sent\n",
+                sched_src_names[s],
+                r.reads[s] * 1000.0 / SCHED_BENCH_RUN_MS,
+                r.late[s],
+                r.lag_us[s],
+                r.delivered[s] );
+    }
+}
+
+
+/**********************************************************
+*   bench_sched
+*       The acquisition scheduler with main.cpp's rates,
+*       with and without phase offsets, against reading
+*       every sensor in one 100ms task. Checks each source
+*       keeps its rate and is read on time, a pass never
+*       makes more than one read and the SENSOR_TAGGED frames arrive whole and
+*       in order. Also times run() itself.
+**********************************************************/
+bool bench_sched()
+{
+    uint8_t const count = sizeof(sched_phased) / sizeof(sched_phased[0]);
+    bool ok = true;
+
+    printf( "%-32s worst loop() pass %u us, each sensor at 10 Hz\n",
+            "sched one 100ms task",
+            2 * SCHED_BENCH_IMU_US + SCHED_BENCH_PRSUR_US + SCHED_BENCH_LOOP_US );
+
+    sched_result_t unphased = sched_run( sched_unphased, count );
+    sched_report( "sched no phase offsets", sched_unphased, count, unphased );
+
+    sched_result_t phased = sched_run( sched_phased, count );
+    sched_report( "sched phased", sched_phased, count, phased );
+
+    if( phased.worst_pass_us > SCHED_BENCH_IMU_US + SCHED_BENCH_LOOP_US )
+    {
+        bench_fail( "sched phased", "more than one read in a pass" );
+        ok = false;
+    }
+
+    for( uint8_t i = 0; i < count; i++ )
+    {
+        acq_source_t const & src = sched_phased[i];
+        uint32_t expected = SCHED_BENCH_RUN_MS / src.period_ms;
+
+        if( ( phased.reads[ src.source ] + 1 < expected )
+         || ( phased.late[ src.source ] != 0 )
+         || ( phased.lag_us[ src.source ] > SCHED_BENCH_LOOP_US ) )
+        {
+            bench_fail( "sched phased", "source off its rate" );
+            ok = false;
+        }
+    }
+
+    // Everything decimated in has to come out, less the last frame
+    //  or two
+    if( ( phased.bad != 0 )
+     || ( phased.delivered[ SRC_IMU_EULER ] + 20 < phased.reads[ SRC_IMU_EULER ] / 5 )
+     || ( phased.delivered[ SRC_PRESSURE ] + 10 < phased.reads[ SRC_PRESSURE ] / 2 )
+     || ( phased.delivered[ SRC_IMU_ACCEL ] != 0 ) )
+    {
+        bench_fail( "sched tagged frames", "samples lost, out of order or not decimated" );
+        ok = false;
+    }
+
+    // What run() itself costs with reads that cost nothing
+    acq_source_t free_sources[ count ];
+    for( uint8_t i = 0; i < count; i++ )
+    {
+        free_sources[i] = sched_phased[i];
+        free_sources[i].read = []( uint32_t time_us, void * sample ) { memcpy( sample, &time_us, sizeof(time_us) ); return (bus_sts_t)BUS_DONE; };
+    }
+
+    AcqScheduler acq( free_sources, count );
+    uint32_t const passes = 10000000;
+    uint32_t made = 0;
+
+    acq.begin( 0 );
+    bench_clock_t::time_point start = bench_clock_t::now();
+    for( uint32_t now_us = 0; now_us < passes; now_us++ )
+    {
+        made += acq.run( now_us ) ? 1 : 0;
+    }
+    double seconds = bench_seconds_since( start );
+    bench_keep( made );
+
+    printf( "%-32s %8.1f ns/pass %u reads\n", "sched run()", seconds * 1e9 / passes, made );
+
+    return ok;
+}
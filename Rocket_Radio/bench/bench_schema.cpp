@@ -0,0 +1,174 @@
+#include "bench.h"
+#include "telemetry/tlm_schema.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define SCHEMA_BENCH_SAMPLES 2000000
+
+
+/******************************************************************************
+ *                               Local Types
+ *****************************************************************************/
+
+// data_pkg_t and gps_data_t as they were when they went out with a
+//  memcpy, which is what the LabVIEW clusters are built for.
+typedef struct __attribute__((packed))
+{
+    uint16_t adc[8];
+    float angle_x;
+    float angle_y;
+    float angle_z;
+    float accel_x;
+    float accel_y;
+    float accel_z;
+    float prsur;
+    float prsur_temp;
+} packed_pkg_t;
+
+typedef struct __attribute__((packed))
+{
+    uint8_t date_time[6];
+    float lat;
+    float lon;
+    bool fix;
+    uint8_t fix_qual;
+    uint8_t sat_num;
+} packed_gps_t;
+
+static_assert( sizeof(packed_pkg_t) == SENSOR_DATA_WIRE_SIZE, "packed_pkg_t is the old data_pkg_t" );
+static_assert( sizeof(packed_gps_t) == GPS_DATA_WIRE_SIZE, "packed_gps_t is the old gps_data_t" );
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   schema_legacy
+*       Frames packed by the schema have the same bytes as
+*       the old packed structs did, and unpack to what
+*       went in.
+**********************************************************/
+static bool schema_legacy()
+{
+    for( uint32_t t = 0; t < 60000; t += 97 )
+    {
+        data_pkg_t in = bench_flight_sample( t );
+        data_pkg_t out;
+        packed_pkg_t old;
+        uint8_t wire[ SENSOR_DATA_WIRE_SIZE ];
+
+        memcpy( old.adc, &in.adc_chnl_0, sizeof(old.adc) );
+        old.angle_x = in.angle_x;
+        old.angle_y = in.angle_y;
+        old.angle_z = in.angle_z;
+        old.accel_x = in.accel_x;
+        old.accel_y = in.accel_y;
+        old.accel_z = in.accel_z;
+        old.prsur = in.prsur;
+        old.prsur_temp = in.prsur_temp;
+
+        sensor_wire_t::pack( in, wire );
+        sensor_wire_t::unpack( wire, out );
+
+        if( ( memcmp( wire, &old, sizeof(wire) ) != 0 )
+         || ( memcmp( &in, &out, sizeof(in) ) != 0 ) )
+        {
+            bench_fail( "schema sensor", "frame doesn't match the old layout" );
+            return false;
+        }
+    }
+
+    gps_data_t gps;
+    gps_data_t gps_out;
+    packed_gps_t old_gps;
+    uint8_t gps_wire[ GPS_DATA_WIRE_SIZE ];
+
+    memset( &gps, 0, sizeof(gps) );
+    memset( &gps_out, 0, sizeof(gps_out) );
+    gps.year = 19;
+    gps.month = 5;
+    gps.day = 12;
+    gps.hour = 14;
+    gps.min = 3;
+    gps.sec = 59;
+    gps.lat = 39.1031f;
+    gps.lon = -84.5120f;
+    gps.fix = true;
+    gps.fix_qual = 2;
+    gps.sat_num = 9;
+
+    memcpy( old_gps.date_time, &gps.year, sizeof(old_gps.date_time) );
+    old_gps.lat = gps.lat;
+    old_gps.lon = gps.lon;
+    old_gps.fix = gps.fix;
+    old_gps.fix_qual = gps.fix_qual;
+    old_gps.sat_num = gps.sat_num;
+
+    gps_wire_t::pack( gps, gps_wire );
+    gps_wire_t::unpack( gps_wire, gps_out );
+
+    if( ( memcmp( gps_wire, &old_gps, sizeof(gps_wire) ) != 0 )
+     || ( memcmp( &gps, &gps_out, sizeof(gps) ) != 0 ) )
+    {
+        bench_fail( "schema gps", "frame doesn't match the old layout" );
+        return false;
+    }
+
+    return true;
+}
+
+
+/**********************************************************
+*   bench_schema
+*       Packing and unpacking sensor frames with the
+*       schema, against a plain memcpy of the struct for
+*       scale, and checks the frames haven't changed.
+**********************************************************/
+bool bench_schema()
+{
+    static data_pkg_t samples[ 64 ];
+    uint8_t wire[ SENSOR_DATA_WIRE_SIZE ];
+    data_pkg_t out;
+    bool ok = true;
+
+    for( uint32_t i = 0; i < 64; i++ )
+    {
+        samples[i] = bench_flight_sample( 10000 + i * 100 );
+    }
+
+    bench_clock_t::time_point start = bench_clock_t::now();
+    for( uint32_t i = 0; i < SCHEMA_BENCH_SAMPLES; i++ )
+    {
+        memcpy( wire, &samples[ i % 64 ], sizeof(wire) );
+        bench_keep( wire[ i % sizeof(wire) ] );
+    }
+    bench_report( "schema memcpy", bench_seconds_since( start ), (uint64_t)SCHEMA_BENCH_SAMPLES * sizeof(wire), SCHEMA_BENCH_SAMPLES );
+
+    start = bench_clock_t::now();
+    for( uint32_t i = 0; i < SCHEMA_BENCH_SAMPLES; i++ )
+    {
+        sensor_wire_t::pack( samples[ i % 64 ], wire );
+        bench_keep( wire[ i % sizeof(wire) ] );
+    }
+    bench_report( "schema pack", bench_seconds_since( start ), (uint64_t)SCHEMA_BENCH_SAMPLES * sizeof(wire), SCHEMA_BENCH_SAMPLES );
+
+    start = bench_clock_t::now();
+    for( uint32_t i = 0; i < SCHEMA_BENCH_SAMPLES; i++ )
+    {
+        wire[ i % sizeof(wire) ] ^= 1;
+        sensor_wire_t::unpack( wire, out );
+        bench_keep( out.adc_chnl_0 );
+    }
+    bench_report( "schema unpack", bench_seconds_since( start ), (uint64_t)SCHEMA_BENCH_SAMPLES * sizeof(wire), SCHEMA_BENCH_SAMPLES );
+
+    ok &= schema_legacy();
+
+    return ok;
+}
@@ -0,0 +1,532 @@
+#include "bench.h"
+#include "log/bin_log.h"
+#include "log/block_writer.h"
+#include "log/log_files.h"
+#include "../tools/common/log_read.h"
+
+#include <Arduino.h>
+#include <SdFat.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <functional>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// Five minutes of logging, started from the ground on the pad and
+//  running through the flight, about 10MB at the board's rates.
+#define SDLOG_BENCH_FLIGHT_MS 300000
+
+// Smaller files than the board's so the run rotates through a few.
+#define SDLOG_BENCH_FILE_BLOCKS 8192
+#define SDLOG_BENCH_SPARES 3
+
+#define SDLOG_BENCH_DIR "/10_18"
+
+// Longest a loop pass may spend on the card with the files made ahead.
+//  A rotation is the worst, flushing one file and writing the next's
+//  header.
+#define SDLOG_BENCH_MAX_US 5000
+
+
+/******************************************************************************
+ *                               Local Types
+ *****************************************************************************/
+
+// What one way of writing the log did over the flight.
+typedef struct
+{
+    std::vector<uint32_t> pass_us;  // Card time of each loop pass
+    uint32_t dropped;               // Bytes the block writer threw away
+    uint32_t rotations;
+} sdlog_run_t;
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   sdlog_header
+*       Start a log file, as main.cpp's log_header does.
+**********************************************************/
+template< typename Sink >
+static void sdlog_header( BlockWriter<Sink> & writer, BinLog< BlockWriter<Sink> > & log )
+{
+    writer.begin();
+    writer.set_blocking( true );
+    log.begin();
+    writer.set_blocking( false );
+    writer.flush();
+}
+
+
+/**********************************************************
+*   sdlog_records
+*       The records the board logs in millisecond t: every
+*       ADC sample, the IMU at 100Hz each, pressure at 50Hz
+*       and sensor and GPS records at 10Hz.
+**********************************************************/
+template< typename Sink >
+static void sdlog_records( BinLog< BlockWriter<Sink> > & log, uint32_t t )
+{
+    adc_sample_t adc;
+    vec3_sample_t vec;
+    prsur_sample_t prsur;
+
+    adc.time_us = t * 1000;
+    for( uint8_t i = 0; i < ADC_CHNL_CNT; i++ )
+    {
+        adc.adc[i] = ( t * 7 + i ) & 0x3FF;
+    }
+    log.write( LOG_REC_ADC, &adc, sizeof(adc), t );
+
+    if( t % 10 == 0 )
+    {
+        vec.time_us = t * 1000;
+        vec.x = vec.y = vec.z = t * 0.001f;
+        log.write( LOG_REC_EULER, &vec, sizeof(vec), t );
+    }
+    else if( t % 10 == 5 )
+    {
+        vec.time_us = t * 1000;
+        vec.x = vec.y = vec.z = 9.8f;
+        log.write( LOG_REC_ACCEL, &vec, sizeof(vec), t );
+    }
+
+    if( t % 20 == 2 )
+    {
+        prsur.time_us = t * 1000;
+        prsur.prsur = 14.7f;
+        prsur.temp = 20.0f;
+        log.write( LOG_REC_PRSUR, &prsur, sizeof(prsur), t );
+    }
+
+    if( t % 100 == 0 )
+    {
+        data_pkg_t sample = bench_flight_sample( t );
+        log.write( LOG_REC_SENSOR, &sample, sizeof(sample), t );
+    }
+    else if( t % 100 == 50 )
+    {
+        gps_data_t gps;
+
+        memset( &gps, 0, sizeof(gps) );
+        log.write( LOG_REC_GPS, &gps, sizeof(gps), t );
+    }
+}
+
+
+/**********************************************************
+*   sdlog_fly
+*       Run the flight through a log as loop() does, a
+*       pass a millisecond: the records due by now, then
+*       between(), then one service(). A pass that stalls
+*       on the card puts the next ones behind, and their
+*       records all come at once, as they would out of the
+*       sampler's ring.
+**********************************************************/
+template< typename Sink >
+static void sdlog_fly( BlockWriter<Sink> & writer, BinLog< BlockWriter<Sink> > & log, std::function<void()> between, sdlog_run_t & run )
+{
+    uint32_t base_us = micros();
+    uint32_t next_ms = 0;
+
+    while( next_ms < SDLOG_BENCH_FLIGHT_MS )
+    {
+        uint32_t now_ms = ( micros() - base_us ) / 1000;
+
+        while( ( next_ms <= now_ms )
+            && ( next_ms < SDLOG_BENCH_FLIGHT_MS ) )
+        {
+            sdlog_records( log, next_ms++ );
+        }
+
+        uint32_t start = micros();
+        between();
+        writer.service();
+        run.pass_us.push_back( micros() - start );
+
+        uint32_t elapsed_us = micros() - base_us;
+        if( elapsed_us < next_ms * 1000 )
+        {
+            sim_clock_advance( next_ms * 1000 - elapsed_us );
+        }
+    }
+
+    writer.flush();
+    run.dropped += writer.dropped();
+}
+
+
+/**********************************************************
+*   sdlog_print
+*       Card time per loop pass: worst, 99th percentile and
+*       how many passes went over 1 and 10 ms.
+**********************************************************/
+static void sdlog_print( char const * name, sdlog_run_t const & run )
+{
+    std::vector<uint32_t> sorted = run.pass_us;
+    uint32_t over_1ms = 0;
+    uint32_t over_10ms = 0;
+
+    std::sort( sorted.begin(), sorted.end() );
+    for( uint32_t us : sorted )
+    {
+        over_1ms += ( us > 1000 ) ? 1 : 0;
+        over_10ms += ( us > 10000 ) ? 1 : 0;
+    }
+
+    printf( "%-32s max %6u us p99 %5u us, >1 ms %5u >10 ms %5u, dropped %u bytes\n",
+            name,
+            sorted.back(),
+            sorted[ sorted.size() * 99 / 100 ],
+            over_1ms,
+            over_10ms,
+            run.dropped );
+}
+
+
+/**********************************************************
+*   sdlog_check
+*       Read back log_1.bin to log_<files>.bin in the bench
+*       directory. Each must start with a log header, and
+*       hold records in sequence with none missing. Counts
+*       the ADC records.
+**********************************************************/
+static bool sdlog_check( uint16_t files, uint32_t & adc_recs )
+{
+    char path[ LOG_FILES_PATH_LEN ];
+
+    adc_recs = 0;
+
+    for( uint16_t num = 1; num <= files; num++ )
+    {
+        File file;
+        log_hdr_t hdr;
+        uint16_t seq = 0;
+
+        snprintf( path, sizeof(path), SDLOG_BENCH_DIR "/log_%u.bin", (unsigned)num );
+        if( !file.open( path, O_READ ) )
+        {
+            return false;
+        }
+
+        std::vector<uint8_t> data( file.fileSize() );
+        file.read( data.data(), data.size() );
+        file.close();
+
+        memcpy( &hdr, data.data(), sizeof(hdr) );
+        if( ( data.size() < bin_log_hdr_size() )
+         || ( hdr.magic != BIN_LOG_MAGIC )
+         || ( hdr.hdr_size != bin_log_hdr_size() ) )
+        {
+            return false;
+        }
+
+        for( size_t i = hdr.hdr_size; i + sizeof(log_rec_hdr_t) <= data.size(); )
+        {
+            log_rec_hdr_t rec;
+
+            if( data[i] != BIN_LOG_SYNC )
+            {
+                i++;
+                continue;
+            }
+
+            memcpy( &rec, &data[i], sizeof(rec) );
+            if( ( rec.rec_type >= LOG_REC_CNT )
+             || ( rec.seq != seq++ ) )
+            {
+                return false;
+            }
+
+            adc_recs += ( rec.rec_type == LOG_REC_ADC ) ? 1 : 0;
+            i += sizeof(rec) + bin_log_layouts[rec.rec_type].desc.size;
+        }
+    }
+
+    return true;
+}
+
+
+/**********************************************************
+*   sdlog_read_back
+*       Read log_1.bin to log_<files>.bin back the way
+*       tools/log2csv does, through tools/common/log_read.h.
+*       Each header has to parse whole, and the records
+*       come in sequence. Counts the ADC records. The
+*       header is bigger than the block writer's two
+*       blocks, so a writer that dropped its tail makes
+*       the files unreadable here.
+**********************************************************/
+static bool sdlog_read_back( uint16_t files, uint32_t & adc_recs, uint16_t & hdr_size )
+{
+    char path[ LOG_FILES_PATH_LEN ];
+
+    adc_recs = 0;
+
+    for( uint16_t num = 1; num <= files; num++ )
+    {
+        File file;
+        log_hdr_t hdr;
+        std::vector<log_rec_info_t> recs;
+        log_rec_hdr_t rec_hdr;
+        uint8_t rec_data[ 256 ];
+        uint32_t skipped = 0;
+        uint16_t seq = 0;
+        bool ok = true;
+
+        snprintf( path, sizeof(path), SDLOG_BENCH_DIR "/log_%u.bin", (unsigned)num );
+        if( !file.open( path, O_READ ) )
+        {
+            return false;
+        }
+
+        std::vector<uint8_t> data( file.fileSize() );
+        file.read( data.data(), data.size() );
+        file.close();
+
+        FILE * in = fmemopen( data.data(), data.size(), "rb" );
+        if( in == NULL )
+        {
+            return false;
+        }
+
+        if( ( !log_read_header( in, hdr, recs ) )
+         || ( recs.size() != LOG_REC_CNT ) )
+        {
+            ok = false;
+        }
+
+        while( ( ok )
+            && ( log_read_record( in, recs, rec_hdr, rec_data, skipped ) ) )
+        {
+            ok = ( rec_hdr.seq == seq++ );
+            adc_recs += ( rec_hdr.rec_type == LOG_REC_ADC ) ? 1 : 0;
+        }
+        fclose( in );
+
+        if( !ok )
+        {
+            return false;
+        }
+        hdr_size = hdr.hdr_size;
+    }
+
+    return true;
+}
+
+
+/**********************************************************
+*   sdlog_grow
+*       The old way: one file opened with O_TRUNC that
+*       grows a cluster at a time, the FAT and directory
+*       entry written as it goes.
+**********************************************************/
+static bool sdlog_grow( sdlog_run_t & run )
+{
+    SdFat sd;
+    File file;
+    BlockWriter<File> writer( file );
+    BinLog< BlockWriter<File> > log( writer );
+
+    sd.begin( 0 );
+    sd.mkdir( SDLOG_BENCH_DIR );
+    if( !file.open( SDLOG_BENCH_DIR "/log_1.bin", O_WRITE | O_CREAT | O_TRUNC ) )
+    {
+        bench_fail( "sd log grow", "couldn't open the log" );
+        return false;
+    }
+
+    sdlog_header( writer, log );
+    sdlog_fly( writer, log, []{}, run );
+    file.close();
+
+    sdlog_print( "sd log growing file", run );
+    printf( "%-32s %u FAT and directory copies\n", "", sd.card()->au_copies() );
+
+    return true;
+}
+
+
+/**********************************************************
+*   sdlog_files
+*       The log through LogFiles: files made and erased on
+*       the pad, raw block writes in flight, rotating when
+*       one fills. No pass may stall and nothing may be
+*       lost.
+**********************************************************/
+static bool sdlog_files( sdlog_run_t & run )
+{
+    SdFat sd;
+    LogFiles files( sd, SDLOG_BENCH_FILE_BLOCKS, SDLOG_BENCH_SPARES );
+    BlockWriter<LogFiles> writer( files );
+    BinLog< BlockWriter<LogFiles> > log( writer );
+    uint32_t adc_recs;
+    bool ok = true;
+
+    sd.begin( 0 );
+
+    uint32_t start = micros();
+    if( ( !files.prepare( SDLOG_BENCH_DIR ) )
+     || ( !files.open() ) )
+    {
+        bench_fail( "sd log files", "couldn't get files ready" );
+        return false;
+    }
+    uint32_t prepare_us = micros() - start;
+    uint32_t copies = sd.card()->au_copies();
+
+    sdlog_header( writer, log );
+    sdlog_fly( writer, log, [&]
+    {
+        if( files.full() )
+        {
+            run.dropped += writer.dropped();
+            writer.flush();
+            files.close( false );
+            if( files.open() )
+            {
+                sdlog_header( writer, log );
+            }
+            run.rotations++;
+        }
+    }, run );
+    copies = sd.card()->au_copies() - copies;
+
+    // The stats go in the last file's header, through a read and write
+    uint8_t stats[16];
+    memset( stats, 0x5A, sizeof(stats) );
+    writer.patch( bin_log_stats_offset(), stats, sizeof(stats) );
+    files.close( true );
+
+    sdlog_print( "sd log contiguous files", run );
+    printf( "%-32s %u rotations, %u copies in flight, %.1f ms getting ready on the pad\n",
+            "",
+            run.rotations,
+            copies,
+            prepare_us / 1000.0 );
+
+    if( *std::max_element( run.pass_us.begin(), run.pass_us.end() ) > SDLOG_BENCH_MAX_US )
+    {
+        bench_fail( "sd log files", "a loop pass stalled on the card" );
+        ok = false;
+    }
+
+    if( run.dropped != 0 )
+    {
+        bench_fail( "sd log files", "block writer dropped data" );
+        ok = false;
+    }
+
+    if( ( !sdlog_check( run.rotations + 1, adc_recs ) )
+     || ( adc_recs != SDLOG_BENCH_FLIGHT_MS ) )
+    {
+        bench_fail( "sd log files", "files don't read back as the whole log" );
+        ok = false;
+    }
+
+    uint16_t hdr_size = 0;
+    if( ( !sdlog_read_back( run.rotations + 1, adc_recs, hdr_size ) )
+     || ( adc_recs != SDLOG_BENCH_FLIGHT_MS ) )
+    {
+        bench_fail( "sd log files", "files don't read back through log_read.h" );
+        ok = false;
+    }
+    else
+    {
+        printf( "%-32s %u byte headers, %u ADC records through log_read.h\n", "", hdr_size, adc_recs );
+    }
+
+    return ok;
+}
+
+
+/**********************************************************
+*   sdlog_exact
+*       Fill the active block exactly while the other is
+*       still waiting for the card. The write has to be
+*       turned away, not flip onto the waiting block and
+*       clear it, and the file has to read back as
+*       written.
+**********************************************************/
+static bool sdlog_exact()
+{
+    SdFat sd;
+    File file;
+    BlockWriter<File> writer( file );
+    uint8_t first[ BLOCK_WRITER_BLOCK_SIZE ];
+    uint8_t exact[ BLOCK_WRITER_BLOCK_SIZE ];
+
+    sd.begin( 0 );
+    sd.mkdir( SDLOG_BENCH_DIR );
+    if( !file.open( SDLOG_BENCH_DIR "/exact.bin", O_WRITE | O_CREAT | O_TRUNC ) )
+    {
+        bench_fail( "sd log exact block", "couldn't open the file" );
+        return false;
+    }
+
+    memset( first, 0x11, sizeof(first) );
+    memset( exact, 0x22, sizeof(exact) );
+    writer.begin();
+
+    // The first block waits for service(), then the active one is
+    //  offered exactly enough to fill it, then one byte less.
+    writer.write( first, sizeof(first) );
+    writer.write( exact, sizeof(exact) );
+    uint32_t dropped = writer.dropped();
+    writer.write( exact, sizeof(exact) - 1 );
+    writer.flush();
+    file.close();
+
+    if( !file.open( SDLOG_BENCH_DIR "/exact.bin", O_READ ) )
+    {
+        bench_fail( "sd log exact block", "couldn't read the file back" );
+        return false;
+    }
+
+    std::vector<uint8_t> data( file.fileSize() );
+    file.read( data.data(), data.size() );
+    file.close();
+
+    if( ( dropped != sizeof(exact) )
+     || ( data.size() < sizeof(first) + sizeof(exact) - 1 )
+     || ( memcmp( data.data(), first, sizeof(first) ) != 0 )
+     || ( memcmp( &data[ sizeof(first) ], exact, sizeof(exact) - 1 ) != 0 ) )
+    {
+        bench_fail( "sd log exact block", "the waiting block was lost or moved" );
+        return false;
+    }
+
+    printf( "%-32s %u bytes turned away, file reads back whole\n", "sd log exact block", dropped );
+
+    return true;
+}
+
+
+/**********************************************************
+*   bench_sdlog
+*       The SD log over a simulated flight, on an aged
+*       FAT volume with card timing, the old growing file
+*       against contiguous files made ahead. Card time is
+*       simulated, so millis() and micros() are too while
+*       it runs.
+**********************************************************/
+bool bench_sdlog()
+{
+    sdlog_run_t grow = sdlog_run_t();
+    sdlog_run_t files = sdlog_run_t();
+    bool ok = true;
+
+    sim_clock_enable( true );
+    ok &= sdlog_grow( grow );
+    ok &= sdlog_files( files );
+    ok &= sdlog_exact();
+    sim_clock_enable( false );
+
+    return ok;
+}
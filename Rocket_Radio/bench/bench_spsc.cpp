@@ -0,0 +1,196 @@
+#include "bench.h"
+#include "util/spsc_ring.h"
+
+#include <stdio.h>
+#include <thread>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define SPSC_BENCH_ITEMS 10000000UL
+
+// Items pushed across threads. Spinning threads yield, so this runs
+//  on a single core machine too.
+#define SPSC_BENCH_THREAD_ITEMS 2000000UL
+
+// Same size as the sampler's log ring.
+#define SPSC_BENCH_RING_SIZE 256
+
+
+/******************************************************************************
+ *                               Local Types
+ *****************************************************************************/
+
+// adc_sample_t sized item. Every channel is derived from seq so a torn
+//  copy shows up.
+struct spsc_item_t
+{
+    uint32_t seq;
+    uint16_t adc[ADC_CHNL_CNT];
+};
+
+typedef SpscRing< spsc_item_t, SPSC_BENCH_RING_SIZE > spsc_ring_t;
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+static spsc_item_t spsc_item( uint32_t seq )
+{
+    spsc_item_t item;
+
+    item.seq = seq;
+    for( uint16_t i = 0; i < ADC_CHNL_CNT; i++ )
+    {
+        item.adc[i] = (uint16_t)( seq * 7 + i );
+    }
+
+    return item;
+}
+
+
+static bool spsc_item_ok( spsc_item_t const & item )
+{
+    for( uint16_t i = 0; i < ADC_CHNL_CNT; i++ )
+    {
+        if( item.adc[i] != (uint16_t)( item.seq * 7 + i ) )
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/**********************************************************
+*   spsc_run
+*       Push SPSC_BENCH_THREAD_ITEMS from one thread while
+*       another pops them. With retry the producer spins on
+*       a full ring so every item has to arrive, without it
+*       full pushes are dropped like the sampler's are.
+*       Returns false if an item arrives torn, twice, out
+*       of order or goes missing without being counted.
+**********************************************************/
+static bool spsc_run( char const * name, bool retry )
+{
+    spsc_ring_t * ring = new spsc_ring_t;
+    uint64_t received = 0;
+    int64_t last = -1;
+    bool ok = true;
+
+    bench_clock_t::time_point start = bench_clock_t::now();
+
+    std::thread producer( [ring, retry]()
+    {
+        for( uint32_t seq = 0; seq < SPSC_BENCH_THREAD_ITEMS; seq++ )
+        {
+            while( ( !ring->push( spsc_item( seq ) ) )
+                && ( retry ) )
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    while( true )
+    {
+        spsc_item_t item;
+
+        if( !ring->pop( item ) )
+        {
+            if( ( last == SPSC_BENCH_THREAD_ITEMS - 1 )
+             || ( ( !retry )
+               && ( received + ring->dropped() == SPSC_BENCH_THREAD_ITEMS ) ) )
+            {
+                break;
+            }
+
+            std::this_thread::yield();
+            continue;
+        }
+
+        if( ( (int64_t)item.seq <= last )
+         || ( ( retry )
+           && ( (int64_t)item.seq != last + 1 ) )
+         || ( !spsc_item_ok( item ) ) )
+        {
+            ok = false;
+        }
+
+        last = item.seq;
+        received++;
+    }
+
+    producer.join();
+    bench_report( name, bench_seconds_since( start ), received * sizeof(spsc_item_t), received );
+
+    if( retry )
+    {
+        ok &= ( received == SPSC_BENCH_THREAD_ITEMS );
+    }
+    else
+    {
+        ok &= ( received + ring->dropped() == SPSC_BENCH_THREAD_ITEMS );
+        printf( "%-32s %llu received %u dropped\n", name, (unsigned long long)received, ring->dropped() );
+    }
+
+    if( !ok )
+    {
+        bench_fail( name, "items torn, lost or out of order" );
+    }
+
+    delete ring;
+    return ok;
+}
+
+
+/**********************************************************
+*   bench_spsc
+*       SpscRing between two threads, standing in for the
+*       sampler interrupt and loop(). Also times a push and
+*       pop on one thread, the cost the interrupt pays.
+*       Checks no item is torn, lost or reordered, and a
+*       full ring keeps what it has and counts the drops.
+**********************************************************/
+bool bench_spsc()
+{
+    spsc_ring_t * ring = new spsc_ring_t;
+    spsc_item_t item;
+    uint32_t sum = 0;
+    bool ok = true;
+
+    bench_clock_t::time_point start = bench_clock_t::now();
+    for( uint32_t seq = 0; seq < SPSC_BENCH_ITEMS; seq++ )
+    {
+        ring->push( spsc_item( seq ) );
+        ring->pop( item );
+        sum += item.adc[0];
+    }
+    bench_keep( sum );
+    bench_report( "spsc push + pop", bench_seconds_since( start ), SPSC_BENCH_ITEMS * sizeof(spsc_item_t), SPSC_BENCH_ITEMS );
+
+    // A full ring keeps what it has and counts the rest
+    for( uint32_t seq = 0; seq < SPSC_BENCH_RING_SIZE + 10; seq++ )
+    {
+        ring->push( spsc_item( seq ) );
+    }
+
+    if( ( ring->count() != SPSC_BENCH_RING_SIZE )
+     || ( ring->dropped() != 10 )
+     || ( !ring->pop( item ) )
+     || ( item.seq != 0 ) )
+    {
+        bench_fail( "spsc full ring", "wrong items kept or drops not counted" );
+        ok = false;
+    }
+    delete ring;
+
+    ok &= spsc_run( "spsc 2 threads lossless", true );
+    ok &= spsc_run( "spsc 2 threads dropping", false );
+
+    return ok;
+}
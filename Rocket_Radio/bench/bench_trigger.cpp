@@ -0,0 +1,269 @@
+#include "bench.h"
+#include "flight/flight_detect.h"
+#include "log/pre_trigger.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// Same sizes as main.cpp
+#define TRIGGER_BENCH_RING_SIZE 16384
+
+// Records pushed through the ring for the speed numbers.
+#define TRIGGER_BENCH_RECORDS 2000000
+
+// How long the simulated flight runs, past the end of the burst.
+#define TRIGGER_BENCH_FLIGHT_MS 60000
+
+
+/******************************************************************************
+ *                                Variables
+ *****************************************************************************/
+
+static const flight_cfg_t trigger_cfg =
+{
+    30.0,       // launch_accel m/s^2
+    100,        // launch_hold_ms
+    0.1,        // launch_dp psi
+    0.02,       // apogee_dp psi
+    200,        // apogee_hold_ms
+    4000,       // apogee_lockout_ms
+    2000,       // pre_ms
+    10000,      // post_ms
+    120000,     // burst_max_ms
+};
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   trigger_fly
+*       Feed bench_flight_sample through the detector at
+*       the board's rates, accel at 100Hz and pressure at
+*       20Hz, with a bump pad_bump_ms long on the pad at
+*       5 s. Times are FLIGHT_NO_TIME for events that
+*       never came.
+**********************************************************/
+static void trigger_fly( FlightDetect & flight, uint32_t pad_bump_ms, uint32_t & launch_ms, uint32_t & apogee_ms, uint32_t & end_ms )
+{
+    launch_ms = FLIGHT_NO_TIME;
+    apogee_ms = FLIGHT_NO_TIME;
+    end_ms = FLIGHT_NO_TIME;
+    flight.reset();
+
+    for( uint32_t t = 0; t < TRIGGER_BENCH_FLIGHT_MS; t += 10 )
+    {
+        data_pkg_t s = bench_flight_sample( t );
+        flight_event_t events[3];
+
+        if( ( t >= 5000 )
+         && ( t < 5000 + pad_bump_ms ) )
+        {
+            s.accel_x += 40.0;
+        }
+
+        events[0] = flight.accel( t, s.accel_x, s.accel_y, s.accel_z );
+        events[1] = ( t % 50 == 0 ) ? flight.pressure( t, s.prsur ) : (flight_event_t)FLIGHT_EVT_NONE;
+        events[2] = flight.tick( t );
+
+        for( flight_event_t event : events )
+        {
+            if( event == FLIGHT_EVT_LAUNCH )
+            {
+                launch_ms = flight.launch_ms();
+            }
+            else if( event == FLIGHT_EVT_APOGEE )
+            {
+                apogee_ms = flight.apogee_ms();
+            }
+            else if( event == FLIGHT_EVT_BURST_END )
+            {
+                end_ms = t;
+            }
+        }
+    }
+}
+
+
+/**********************************************************
+*   trigger_detect
+*       Launch is found within 300 ms of 10 s, apogee
+*       between 33 s and 37 s, the burst ends post_ms
+*       after apogee, and a 50 ms knock on the pad doesn't
+*       count.
+**********************************************************/
+static bool trigger_detect()
+{
+    FlightDetect flight( trigger_cfg );
+    uint32_t launch_ms;
+    uint32_t apogee_ms;
+    uint32_t end_ms;
+    bool ok = true;
+
+    bench_clock_t::time_point start = bench_clock_t::now();
+    trigger_fly( flight, 50, launch_ms, apogee_ms, end_ms );
+    // Bytes are the accel and pressure floats fed in, frames the 10 ms steps
+    bench_report( "flight detect 60 s",
+                  bench_seconds_since( start ),
+                  ( TRIGGER_BENCH_FLIGHT_MS / 10 * 3 + TRIGGER_BENCH_FLIGHT_MS / 50 ) * sizeof(float),
+                  TRIGGER_BENCH_FLIGHT_MS / 10 );
+
+    printf( "%-32s launch %.3f s apogee %.3f s burst end %.3f s\n", "flight detect events", launch_ms / 1000.0, apogee_ms / 1000.0, end_ms / 1000.0 );
+
+    if( ( launch_ms < 10000 )
+     || ( launch_ms > 10300 ) )
+    {
+        bench_fail( "flight detect", "launch missed or early, pad bump?" );
+        ok = false;
+    }
+
+    if( ( apogee_ms < 33000 )
+     || ( apogee_ms > 37000 ) )
+    {
+        bench_fail( "flight detect", "apogee missed" );
+        ok = false;
+    }
+
+    if( ( end_ms == FLIGHT_NO_TIME )
+     || ( end_ms < apogee_ms + trigger_cfg.post_ms ) )
+    {
+        bench_fail( "flight detect", "burst ended early or not at all" );
+        ok = false;
+    }
+
+    // With the IMU out launch still comes from the pressure
+    flight_cfg_t no_imu = trigger_cfg;
+
+    no_imu.launch_accel = 1e6;
+    FlightDetect baro( no_imu );
+
+    trigger_fly( baro, 0, launch_ms, apogee_ms, end_ms );
+    printf( "%-32s launch %.3f s apogee %.3f s\n", "flight detect pressure only", launch_ms / 1000.0, apogee_ms / 1000.0 );
+
+    if( ( launch_ms < 10000 )
+     || ( launch_ms > 12000 ) )
+    {
+        bench_fail( "flight detect pressure only", "launch missed" );
+        ok = false;
+    }
+
+    return ok;
+}
+
+
+/**********************************************************
+*   trigger_ring
+*       Push records the size the board logs through the
+*       ring and check they come out in order, that the
+*       window holds pre_ms of them and that full rings
+*       drop the oldest.
+**********************************************************/
+static bool trigger_ring()
+{
+    static PreTrigger< TRIGGER_BENCH_RING_SIZE > ring;
+    uint8_t data[ BIN_LOG_MAX_DATA ];
+    pre_rec_t rec;
+    bool ok = true;
+
+    memset( data, 0x5A, sizeof(data) );
+
+    // Speed, pushing 18 byte ADC records with the window on and
+    //  draining as the log would
+    ring.clear();
+    ring.set_window( trigger_cfg.pre_ms );
+
+    bench_clock_t::time_point start = bench_clock_t::now();
+    for( uint32_t i = 0; i < TRIGGER_BENCH_RECORDS; i++ )
+    {
+        memcpy( data, &i, sizeof(i) );
+        ring.push( LOG_REC_ADC, data, 18, i );
+    }
+    bench_report( "pre-trigger push", bench_seconds_since( start ), (uint64_t)TRIGGER_BENCH_RECORDS * 18, TRIGGER_BENCH_RECORDS );
+
+    uint32_t oldest = ring.oldest_ms();
+    if( TRIGGER_BENCH_RECORDS - 1 - oldest > trigger_cfg.pre_ms )
+    {
+        bench_fail( "pre-trigger window", "kept records older than the window" );
+        ok = false;
+    }
+
+    uint32_t expect = oldest;
+    uint32_t popped = 0;
+
+    start = bench_clock_t::now();
+    while( ring.pop( rec ) )
+    {
+        uint32_t i;
+
+        memcpy( &i, rec.data, sizeof(i) );
+        if( ( i != expect )
+         || ( rec.hdr.time_ms != expect )
+         || ( rec.hdr.size != 18 ) )
+        {
+            bench_fail( "pre-trigger pop", "records out of order" );
+            ok = false;
+            break;
+        }
+        expect++;
+        popped++;
+    }
+    bench_report( "pre-trigger pop", bench_seconds_since( start ), (uint64_t)popped * 18, popped );
+
+    if( expect != TRIGGER_BENCH_RECORDS )
+    {
+        bench_fail( "pre-trigger pop", "lost the newest records" );
+        ok = false;
+    }
+
+    // Window off, a full ring drops the oldest and keeps the newest
+    ring.clear();
+    ring.set_window( 0 );
+
+    uint32_t dropped = ring.dropped();
+    uint32_t count = 2 * TRIGGER_BENCH_RING_SIZE / ( sizeof(pre_rec_hdr_t) + 40 );
+
+    for( uint32_t i = 0; i < count; i++ )
+    {
+        memcpy( data, &i, sizeof(i) );
+        ring.push( LOG_REC_SENSOR, data, 40, i );
+    }
+
+    if( ( ring.dropped() == dropped )
+     || ( !ring.pop( rec ) )
+     || ( rec.hdr.time_ms != ring.dropped() - dropped ) )
+    {
+        bench_fail( "pre-trigger full", "didn't drop the oldest" );
+        ok = false;
+    }
+
+    printf( "%-32s %u of %u records kept, %u ms of ADC at 100Hz\n",
+            "pre-trigger full",
+            count - ( ring.dropped() - dropped ),
+            count,
+            (unsigned)( TRIGGER_BENCH_RING_SIZE / ( sizeof(pre_rec_hdr_t) + 18 ) * 10 ) );
+
+    return ok;
+}
+
+
+/**********************************************************
+*   bench_trigger
+*       Launch and apogee detection over the simulated
+*       flight, and the pre-trigger ring's speed and
+*       ordering.
+**********************************************************/
+bool bench_trigger()
+{
+    bool ok = true;
+
+    ok &= trigger_detect();
+    ok &= trigger_ring();
+
+    return ok;
+}
@@ -0,0 +1,278 @@
+#include "bench.h"
+#include "xbee/xbee.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define TXQ_BENCH_BAUD 9600
+
+// Simulated run time and loop() period.
+#define TXQ_BENCH_RUN_MS 10000
+#define TXQ_BENCH_TICK_US 1000
+
+// Telemetry periods from main.cpp, and an overload period the link can't
+//  keep up with.
+#define TXQ_BENCH_SENSOR_MS 200
+#define TXQ_BENCH_GPS_MS 1000
+#define TXQ_BENCH_FAST_SENSOR_MS 20
+
+// How often a command reply is sent, and what it carries.
+#define TXQ_BENCH_REPLY_MS 1500
+#define DATA_LOG_REPLY_BYTE 0x5A
+
+// Sizes of data_pkg_t and gps_data_t.
+#define TXQ_BENCH_SENSOR_LEN 48
+#define TXQ_BENCH_GPS_LEN 17
+
+
+/******************************************************************************
+ *                               Local Types
+ *****************************************************************************/
+
+// What one simulated run saw at the far end.
+struct txq_result_t
+{
+    uint32_t sent;
+    uint32_t delivered;
+    uint32_t replies_sent;
+    uint32_t replies;
+    uint32_t refused;
+    uint32_t out_of_order;
+    uint32_t blocked;
+    uint64_t age_sum_ms;
+    uint32_t age_max_ms;
+};
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   txq_stamp
+*       Put a sequence number and send time at the front
+*       of a telemetry payload.
+**********************************************************/
+static void txq_stamp( uint8_t * data, uint32_t seq, uint32_t now_ms )
+{
+    memcpy( &data[0], &seq, sizeof(seq) );
+    memcpy( &data[4], &now_ms, sizeof(now_ms) );
+}
+
+
+/**********************************************************
+*   txq_run
+*       Run the telemetry schedule through an Xbee whose
+*       UART drains at TXQ_BENCH_BAUD. Frames are decoded
+*       by a second Xbee on the far side. With blocking
+*       set, frames skip the queue and are written to the
+*       UART directly, like send_data used to.
+**********************************************************/
+static txq_result_t txq_run( uint32_t sensor_ms, tx_policy_t policy, bool blocking )
+{
+    UARTClass tx_serial;
+    UARTClass rx_serial;
+    Xbee tx( &tx_serial );
+    Xbee rx( &rx_serial );
+    uint8_t sensor[ TXQ_BENCH_SENSOR_LEN ] = { 0 };
+    uint8_t gps[ TXQ_BENCH_GPS_LEN ] = { 0 };
+    uint8_t reply = DATA_LOG_REPLY_BYTE;
+    uint8_t wire[ 256 ];
+    uint8_t frame[ MAX_DATA_LENGTH ];
+    uint8_t encoded[ HDLC_ENCODED_LENGTH( MAX_DATA_LENGTH ) ];
+    uint32_t now_ms = 0;
+    uint32_t last_seq = 0;
+    txq_result_t result;
+
+    memset( &result, 0, sizeof(result) );
+
+    tx.setup( TXQ_BENCH_BAUD );
+    tx.set_tx_policy( policy );
+    tx_serial.set_tx_limited( true );
+
+    rx.set_frame_hndlr( SENSOR_DATA, [&]( uint8_t const * buffer, uint16_t size )
+    {
+        uint32_t seq;
+        uint32_t sent_ms;
+
+        memcpy( &seq, &buffer[0], sizeof(seq) );
+        memcpy( &sent_ms, &buffer[4], sizeof(sent_ms) );
+
+        if( ( size != TXQ_BENCH_SENSOR_LEN )
+         || ( ( result.delivered > 0 )
+           && ( seq <= last_seq ) ) )
+        {
+            result.out_of_order++;
+        }
+
+        last_seq = seq;
+        result.delivered++;
+        result.age_sum_ms += now_ms - sent_ms;
+        if( now_ms - sent_ms > result.age_max_ms )
+        {
+            result.age_max_ms = now_ms - sent_ms;
+        }
+    });
+
+    rx.set_frame_hndlr( DATA_LOG, [&]( uint8_t const * buffer, uint16_t size )
+    {
+        if( ( size == 1 )
+         && ( buffer[0] == DATA_LOG_REPLY_BYTE ) )
+        {
+            result.replies++;
+        }
+    });
+
+    for( now_ms = 0; now_ms < TXQ_BENCH_RUN_MS; now_ms += TXQ_BENCH_TICK_US / 1000 )
+    {
+        bool send_sensor = ( now_ms % sensor_ms == 0 );
+        bool send_gps = ( now_ms % TXQ_BENCH_GPS_MS == 0 );
+        bool send_reply = ( now_ms % TXQ_BENCH_REPLY_MS == TXQ_BENCH_REPLY_MS / 2 );
+
+        if( send_sensor )
+        {
+            result.sent++;
+            txq_stamp( sensor, result.sent, now_ms );
+        }
+
+        if( blocking )
+        {
+            // Old path. Every byte that doesn't fit in the UART
+            //  buffer is a byte loop() spent spinning.
+            if( send_sensor )
+            {
+                frame[0] = SENSOR_DATA;
+                memcpy( &frame[1], sensor, sizeof(sensor) );
+                uint16_t len = Hdlc< MAX_DATA_LENGTH, UARTClass, Xbee >::encode_frame( frame, sizeof(sensor) + 1, encoded, sizeof(encoded) );
+                tx_serial.write( encoded, len );
+            }
+        }
+        else
+        {
+            if( ( send_sensor )
+             && ( !tx.send_data( SENSOR_DATA, sensor, sizeof(sensor), true ) ) )
+            {
+                result.refused++;
+            }
+
+            if( send_gps )
+            {
+                tx.send_data( GPS_DATA, gps, sizeof(gps), true );
+            }
+
+            if( send_reply )
+            {
+                result.replies_sent++;
+                if( !tx.send_data( DATA_LOG, &reply, sizeof(reply) ) )
+                {
+                    result.refused++;
+                }
+            }
+
+            tx.read();
+        }
+
+        tx_serial.run( TXQ_BENCH_TICK_US );
+
+        size_t count;
+        while( ( count = tx_serial.take_tx( wire, sizeof(wire) ) ) > 0 )
+        {
+            rx_serial.inject( wire, count );
+        }
+
+        rx.read();
+    }
+
+    result.blocked = tx_serial.tx_blocked();
+
+    return result;
+}
+
+
+/**********************************************************
+*   txq_report
+*       Print one simulated run.
+**********************************************************/
+static void txq_report( char const * name, txq_result_t const & r )
+{
+    printf( "%-32s %5u sent %5u delivered %5u dropped %6.1f ms mean age %5u ms max age %6.1f ms blocked\n",
+            name,
+            r.sent,
+            r.delivered,
+            r.sent - r.delivered,
+            r.delivered ? (double)r.age_sum_ms / r.delivered : 0.0,
+            r.age_max_ms,
+            r.blocked * 10.0 * 1000.0 / TXQ_BENCH_BAUD );
+}
+
+
+/**********************************************************
+*   bench_txq
+*       Non-blocking transmit queue against a UART that
+*       drains at 9600 baud. Checks loop() never blocks,
+*       frames arrive whole and in order, command replies
+*       are never dropped and an overloaded link keeps the
+*       newest telemetry under TXQ_DROP_OLDEST.
+**********************************************************/
+bool bench_txq()
+{
+    bool ok = true;
+
+    // The old blocking send, for comparison. Only the overload
+    //  case can fill the UART buffer.
+    txq_report( "txq blocking 50Hz sensor", txq_run( TXQ_BENCH_FAST_SENSOR_MS, TXQ_DROP_OLDEST, true ) );
+
+    txq_result_t normal = txq_run( TXQ_BENCH_SENSOR_MS, TXQ_DROP_OLDEST, false );
+    txq_result_t oldest = txq_run( TXQ_BENCH_FAST_SENSOR_MS, TXQ_DROP_OLDEST, false );
+    txq_result_t newest = txq_run( TXQ_BENCH_FAST_SENSOR_MS, TXQ_DROP_NEWEST, false );
+
+    txq_report( "txq 5Hz sensor", normal );
+    txq_report( "txq 50Hz sensor drop oldest", oldest );
+    txq_report( "txq 50Hz sensor drop newest", newest );
+
+    // Everything fits at the normal rate, allowing for the last
+    //  frame still being on the wire
+    if( ( normal.blocked != 0 )
+     || ( normal.out_of_order != 0 )
+     || ( normal.refused != 0 )
+     || ( normal.delivered + 1 < normal.sent )
+     || ( normal.replies != normal.replies_sent ) )
+    {
+        bench_fail( "txq 5Hz sensor", "frames lost or blocked" );
+        ok = false;
+    }
+
+    if( ( oldest.blocked != 0 )
+     || ( newest.blocked != 0 ) )
+    {
+        bench_fail( "txq 50Hz sensor", "loop() blocked on the UART" );
+        ok = false;
+    }
+
+    if( ( oldest.out_of_order != 0 )
+     || ( newest.out_of_order != 0 ) )
+    {
+        bench_fail( "txq 50Hz sensor", "frames corrupt or out of order" );
+        ok = false;
+    }
+
+    if( ( oldest.replies + 1 < oldest.replies_sent )
+     || ( newest.replies + 1 < newest.replies_sent ) )
+    {
+        bench_fail( "txq 50Hz sensor", "command replies dropped" );
+        ok = false;
+    }
+
+    if( oldest.age_sum_ms * newest.delivered > newest.age_sum_ms * oldest.delivered )
+    {
+        bench_fail( "txq 50Hz sensor", "drop oldest didn't keep the newest data" );
+        ok = false;
+    }
+
+    return ok;
+}
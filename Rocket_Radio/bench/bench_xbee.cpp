@@ -0,0 +1,218 @@
+#include "bench.h"
+#include "xbee/xbee.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define XBEE_BENCH_FRAMES 1000000
+
+// Frames sent between each read() on the far side.
+#define XBEE_BENCH_BURST 2
+
+// Size of data_pkg_t.
+#define XBEE_BENCH_DATA_LEN 48
+
+// Large frames are streamed in as this many data_pkg_t.
+#define XBEE_BENCH_BIG_PKGS ( ( XBEE_MAX_FRAME_LENGTH - 1 ) / XBEE_BENCH_DATA_LEN )
+#define XBEE_BENCH_BIG_FRAMES ( XBEE_BENCH_FRAMES / XBEE_BENCH_BIG_PKGS )
+
+
+/******************************************************************************
+ *                          Function Declarations
+ *****************************************************************************/
+
+static bool bench_xbee_stream();
+static bool bench_xbee_max_frame();
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   bench_xbee
+*       Xbee to Xbee over the fake UARTs. Measures
+*       send_data, the copy between UARTs, read() and
+*       dispatch to a registered handler.
+**********************************************************/
+bool bench_xbee()
+{
+    UARTClass tx_serial;
+    UARTClass rx_serial;
+    Xbee tx( &tx_serial );
+    Xbee rx( &rx_serial );
+    uint8_t data[ XBEE_BENCH_DATA_LEN ];
+    uint8_t wire[ 2 * HDLC_ENCODED_LENGTH( MAX_DATA_LENGTH ) ];
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+
+    for( int i = 0; i < XBEE_BENCH_DATA_LEN; i++ )
+    {
+        data[i] = (uint8_t)rand();
+    }
+
+    rx.set_frame_hndlr( SENSOR_DATA, [&frames]( uint8_t const * buffer, uint16_t size )
+    {
+        bench_keep( buffer[0] + size );
+        frames++;
+    });
+
+    bench_clock_t::time_point start = bench_clock_t::now();
+    for( int f = 0; f < XBEE_BENCH_FRAMES; f += XBEE_BENCH_BURST )
+    {
+        for( int b = 0; b < XBEE_BENCH_BURST; b++ )
+        {
+            data[0] = (uint8_t)( f + b );
+            tx.send_data( SENSOR_DATA, data, sizeof(data) );
+        }
+
+        size_t count = tx_serial.take_tx( wire, sizeof(wire) );
+        rx_serial.inject( wire, count );
+        bytes += count;
+
+        rx.read();
+    }
+    bench_report( "xbee send_data -> read", bench_seconds_since( start ), bytes, frames );
+
+    if( ( frames != XBEE_BENCH_FRAMES )
+     || ( rx.dropped_frames() != 0 ) )
+    {
+        bench_fail( "xbee send_data -> read", "lost frames" );
+        return false;
+    }
+
+    return ( bench_xbee_stream() )
+        && ( bench_xbee_max_frame() );
+}
+
+
+/**********************************************************
+*   bench_xbee_stream
+*       The same data_pkg_t's streamed into frames as big
+*       as Xbee takes with begin_send / append_send /
+*       end_send. Checks every byte comes out in order.
+**********************************************************/
+static bool bench_xbee_stream()
+{
+    UARTClass tx_serial;
+    UARTClass rx_serial;
+    Xbee tx( &tx_serial );
+    Xbee rx( &rx_serial );
+    uint8_t data[ XBEE_BENCH_DATA_LEN ];
+    uint8_t wire[ SERIAL_BUFFER_SIZE ];
+    uint64_t frames = 0;
+    uint64_t bytes = 0;
+    bool in_order = true;
+
+    rx.set_frame_hndlr( SENSOR_BATCH, [&]( uint8_t const * buffer, uint16_t size )
+    {
+        if( size != XBEE_BENCH_BIG_PKGS * XBEE_BENCH_DATA_LEN )
+        {
+            in_order = false;
+        }
+
+        for( uint16_t p = 0; p < size; p += XBEE_BENCH_DATA_LEN )
+        {
+            in_order &= ( buffer[p] == (uint8_t)( frames * XBEE_BENCH_BIG_PKGS + p / XBEE_BENCH_DATA_LEN ) );
+        }
+        frames++;
+    });
+
+    for( int i = 0; i < XBEE_BENCH_DATA_LEN; i++ )
+    {
+        data[i] = (uint8_t)rand();
+    }
+
+    bench_clock_t::time_point start = bench_clock_t::now();
+    for( int f = 0; f < XBEE_BENCH_BIG_FRAMES; f++ )
+    {
+        tx.begin_send( SENSOR_BATCH );
+        for( int p = 0; p < XBEE_BENCH_BIG_PKGS; p++ )
+        {
+            data[0] = (uint8_t)( f * XBEE_BENCH_BIG_PKGS + p );
+            tx.append_send( data, sizeof(data) );
+        }
+        tx.end_send();
+
+        // A frame is more than the UART buffer holds, keep moving it
+        //  across until the queue is empty
+        size_t count;
+        while( ( count = tx_serial.take_tx( wire, sizeof(wire) ) ) > 0 )
+        {
+            rx_serial.inject( wire, count );
+            bytes += count;
+
+            rx.read();
+            tx.write_pending();
+        }
+    }
+    bench_report( "xbee streamed big frames -> read", bench_seconds_since( start ), bytes, frames * XBEE_BENCH_BIG_PKGS );
+
+    if( ( frames != XBEE_BENCH_BIG_FRAMES )
+     || ( !in_order ) )
+    {
+        bench_fail( "xbee streamed big frames -> read", "lost or mangled frames" );
+        return false;
+    }
+
+    return true;
+}
+
+
+/**********************************************************
+*   bench_xbee_max_frame
+*       send_data with the most data it takes, which has
+*       to come out whole, and with one byte more, which
+*       has to be refused and counted.
+**********************************************************/
+static bool bench_xbee_max_frame()
+{
+    UARTClass tx_serial;
+    UARTClass rx_serial;
+    Xbee tx( &tx_serial );
+    Xbee rx( &rx_serial );
+    static uint8_t data[ XBEE_MAX_FRAME_LENGTH ];
+    uint8_t wire[ SERIAL_BUFFER_SIZE ];
+    uint16_t received = 0;
+    bool same = false;
+
+    for( int i = 0; i < XBEE_MAX_FRAME_LENGTH; i++ )
+    {
+        data[i] = (uint8_t)rand();
+    }
+
+    rx.set_frame_hndlr( SENSOR_BATCH, [&]( uint8_t const * buffer, uint16_t size )
+    {
+        received = size;
+        same = ( memcmp( buffer, data, size ) == 0 );
+    });
+
+    bool sent = tx.send_data( SENSOR_BATCH, data, XBEE_MAX_FRAME_LENGTH - 1 );
+    bool refused = !tx.send_data( SENSOR_BATCH, data, XBEE_MAX_FRAME_LENGTH );
+
+    size_t count;
+    while( ( count = tx_serial.take_tx( wire, sizeof(wire) ) ) > 0 )
+    {
+        rx_serial.inject( wire, count );
+        rx.read();
+        tx.write_pending();
+    }
+
+    if( ( !sent )
+     || ( !refused )
+     || ( tx.dropped_tx_frames() != 1 )
+     || ( received != XBEE_MAX_FRAME_LENGTH - 1 )
+     || ( !same ) )
+    {
+        bench_fail( "xbee max frame", "biggest frame lost or oversized one not refused" );
+        return false;
+    }
+
+    return true;
+}
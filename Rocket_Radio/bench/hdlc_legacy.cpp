@@ -0,0 +1,305 @@
+#include "hdlc_legacy.h"
+#include "crc16.h"
+
+#include <stdint.h>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define FRAME_BOUNDARY_OCTET 0x7E
+#define CONTROL_ESCAPE_OCTET 0x7D
+#define INVERT_OCTET 0x20
+
+#define OUT_BUF_SIZE 126
+
+/* 16bit low and high bytes copier */
+#define low(x) ((x)&0xFF)
+#define high(x) (((x) >> 8) & 0xFF)
+
+
+/******************************************************************************
+ *                        Local Function Declarations
+ *****************************************************************************/
+
+static inline uint8_t * escape_byte( uint8_t data, uint8_t * out );
+
+
+/******************************************************************************
+ *                          Method Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   Hdlc
+*       Constructor
+**********************************************************/
+HdlcLegacy::HdlcLegacy( uint16_t max_data_length ) :
+    escape_character( false ),
+    receive_frame_buffer( new uint8_t[max_data_length + 2] ),
+    frame_position( 0 ),
+    max_frame_length( max_data_length + 2 ),
+    transmit_frame_buffer( new uint8_t[HDLC_LEGACY_ENCODED_LENGTH( max_data_length )] ),
+    transmit_frame_size( HDLC_LEGACY_ENCODED_LENGTH( max_data_length ) )
+    // out_buf(OUT_BUF_SIZE)
+{
+}
+
+
+/**********************************************************
+*   set_send_hndlr
+*       set the handler that is called to transmit bytes.
+**********************************************************/
+void HdlcLegacy::set_send_hndlr( send_hdnlr_t const & send_byte_hndlr )
+{
+    m_send_byte_hndlr = send_byte_hndlr;
+}
+
+
+/**********************************************************
+*   set_rcv_hndlr
+*       set the handler that is called to receive data.
+**********************************************************/
+void HdlcLegacy::set_rcv_hndlr( recv_hndlr_t const & recv_hndlr )
+{
+    m_recv_frame_hndlr = recv_hndlr;
+}
+
+
+/**********************************************************
+*   set_rcv_buffer
+*       Decode received frames into buffer instead of the
+*       Hdlc's own one. buffer must hold max_data_length
+*       plus 2 bytes. Safe to call from the receive
+*       handler, the next frame goes into the new buffer.
+**********************************************************/
+void HdlcLegacy::set_rcv_buffer( uint8_t * buffer )
+{
+    this->receive_frame_buffer = buffer;
+}
+
+
+/**********************************************************
+*   decode_byte
+*       Run one received byte through the frame parser.
+*       Shared by byte_receive and receive so the block
+*       path gets it inlined.
+**********************************************************/
+inline void HdlcLegacy::decode_byte( uint8_t data )
+{
+    // We're either at the beging or end of a frame
+    if( data == FRAME_BOUNDARY_OCTET )
+    {
+        // We expected to get an escaped char instead 
+        //  we got the frame boundry. Discard partial
+        //  frame.
+        if( this->escape_character == true )
+        {
+            this->escape_character = false;
+        }
+        // Check if we're at the end of the frame and
+        //  if its crc is valid.
+        else if( this->frame_position >= 2 )
+        {
+            uint16_t length = this->frame_position - 2;
+            uint16_t fcs = ( this->receive_frame_buffer[length + 1] << 8 ) | this->receive_frame_buffer[length]; // (msb << 8 ) | lsb
+
+            if( crc16_ccitt_block( CRC16_CCITT_INIT_VAL, this->receive_frame_buffer, length ) == fcs )
+            {
+                m_recv_frame_hndlr( receive_frame_buffer, length );
+            }
+        }
+
+        // Reset the frame
+        this->frame_position = 0;
+        return;
+    }
+
+    // The previous char was an escape.
+    //  Convert data back to unescaped version.
+    if( this->escape_character )
+    {
+        this->escape_character = false;
+        data ^= INVERT_OCTET;
+    }
+    // This char is an escape char
+    else if( data == CONTROL_ESCAPE_OCTET )
+    {
+        this->escape_character = true;
+        return;
+    }
+
+    // Add data to frame buffer
+    receive_frame_buffer[ this->frame_position ] = data;
+
+    this->frame_position++;
+
+    // Throw away frame if we reach the max frame length
+    if( this->frame_position == this->max_frame_length )
+    {
+        this->frame_position = 0;
+    }
+}
+
+
+/**********************************************************
+*   byte_receive
+*       Function to find valid HDLC frame from incoming 
+*       data
+**********************************************************/
+void HdlcLegacy::byte_receive( uint8_t data )
+{
+    this->decode_byte( data );
+}
+
+
+/**********************************************************
+*   receive
+*       Find valid HDLC frames in a block of incoming
+*       data. The receive handler is called once for
+*       every complete frame in the block.
+**********************************************************/
+void HdlcLegacy::receive( uint8_t const * data, size_t length )
+{
+    uint8_t const * const end = data + length;
+
+    while( data < end )
+    {
+        this->decode_byte( *data++ );
+    }
+}
+
+
+/**********************************************************
+*   send_byte
+*       Method to send a byte.
+**********************************************************/
+void HdlcLegacy::send_byte( uint8_t data )
+{
+    if( ( data == CONTROL_ESCAPE_OCTET ) 
+     || ( data == FRAME_BOUNDARY_OCTET ) )
+    {
+        // (*this->send_byte_handler)( CONTROL_ESCAPE_OCTET );
+        m_send_byte_hndlr( CONTROL_ESCAPE_OCTET );
+        data ^= INVERT_OCTET;
+    }
+
+    // (*this->send_byte_handler)( data );
+    m_send_byte_hndlr( data );
+}
+
+
+/**********************************************************
+*   send_boundry_byte
+*       Method to send a boundry byte.
+**********************************************************/
+void HdlcLegacy::send_boundry_byte()
+{
+    // (*this->send_byte_handler)( FRAME_BOUNDARY_OCTET );
+    m_send_byte_hndlr( FRAME_BOUNDARY_OCTET );
+}
+
+
+/**********************************************************
+*   send_frame
+*       Wrap given data in HDLC frame and send it out byte 
+*       at a time
+**********************************************************/
+void HdlcLegacy::send_frame( uint8_t const * const buffer, uint8_t length )
+{
+    uint8_t data;
+    uint16_t fcs = crc16_ccitt_block( CRC16_CCITT_INIT_VAL, buffer, length );
+
+    // Send first boundry byte
+    this->send_boundry_byte();
+
+    // Send data
+    for( int i = 0; i < length; i++ )
+    {
+        this->send_byte( buffer[i] );
+    }
+
+    // Send low crc
+    data = low(fcs);
+    this->send_byte( data );
+
+    // Send high crc
+    data = high(fcs);
+    this->send_byte( data );
+
+    // Send last boundry byte
+    this->send_boundry_byte();
+}
+
+
+/**********************************************************
+*   encode_frame
+*       Wrap given data in HDLC frame and write the
+*       escaped frame into out so it can be sent with one
+*       call. Returns the encoded length, or 0 if out
+*       might be too small to hold the frame.
+**********************************************************/
+uint16_t HdlcLegacy::encode_frame( uint8_t const * const buffer, uint8_t length, uint8_t * out, uint16_t out_size )
+{
+    uint8_t * const start = out;
+    uint16_t fcs;
+
+    if( out_size < HDLC_LEGACY_ENCODED_LENGTH( length ) )
+    {
+        return 0;
+    }
+
+    fcs = crc16_ccitt_block( CRC16_CCITT_INIT_VAL, buffer, length );
+
+    // First boundry byte
+    *out++ = FRAME_BOUNDARY_OCTET;
+
+    // Data
+    for( int i = 0; i < length; i++ )
+    {
+        out = escape_byte( buffer[i], out );
+    }
+
+    // Low then high crc
+    out = escape_byte( low(fcs), out );
+    out = escape_byte( high(fcs), out );
+
+    // Last boundry byte
+    *out++ = FRAME_BOUNDARY_OCTET;
+
+    return out - start;
+}
+
+
+/**********************************************************
+*   encode_frame
+*       Same as above but encodes into the Hdlc's own
+*       transmit buffer. The returned pointer is valid
+*       until the next call.
+**********************************************************/
+uint8_t const * HdlcLegacy::encode_frame( uint8_t const * const buffer, uint8_t length, uint16_t &encoded_length )
+{
+    encoded_length = encode_frame( buffer, length, transmit_frame_buffer, transmit_frame_size );
+
+    return transmit_frame_buffer;
+}
+
+
+/**********************************************************
+*   escape_byte
+*       Write data to out, escaping it if needed. Returns
+*       the new end of out.
+**********************************************************/
+static inline uint8_t * escape_byte( uint8_t data, uint8_t * out )
+{
+    if( ( data == CONTROL_ESCAPE_OCTET ) 
+     || ( data == FRAME_BOUNDARY_OCTET ) )
+    {
+        *out++ = CONTROL_ESCAPE_OCTET;
+        data ^= INVERT_OCTET;
+    }
+
+    *out++ = data;
+
+    return out;
+}
\ No newline at end of file
@@ -0,0 +1,75 @@
+#ifndef hdlc_legacy_h
+#define hdlc_legacy_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <functional>
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// Worst case size of an encoded frame carrying length data bytes. Every
+//  data and crc byte escaped plus the two boundary bytes.
+#define HDLC_LEGACY_ENCODED_LENGTH(length) ( 2 * ( (length) + 2 ) + 2 )
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+typedef std::function<void(uint8_t)> send_hdnlr_t;
+typedef std::function<void(uint8_t*, uint8_t)> recv_hndlr_t;
+
+/******************************************************************************
+ *                          Function Declarations
+ *****************************************************************************/
+
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   HdlcLegacy
+*       Copy of the std::function based Hdlc class the
+*       template replaced, kept so the benchmarks can
+*       compare the two. Only change is the receive buffer
+*       is sized from max_data_length, the original read
+*       max_frame_length before it was set.
+**********************************************************/
+class HdlcLegacy
+{
+public:
+    HdlcLegacy( uint16_t max_data_length );
+
+    void set_send_hndlr( send_hdnlr_t const & send_byte_hndlr );
+    void set_rcv_hndlr( recv_hndlr_t const & recv_hndlr );
+    void set_rcv_buffer( uint8_t * buffer );
+
+    void byte_receive( uint8_t data );
+    void receive( uint8_t const * data, size_t length );
+    void send_frame( uint8_t const * const buffer, uint8_t length );
+
+    uint16_t encode_frame( uint8_t const * const buffer, uint8_t length, uint8_t * out, uint16_t out_size );
+    uint8_t const * encode_frame( uint8_t const * const buffer, uint8_t length, uint16_t &encoded_length );
+
+private:    
+    void decode_byte( uint8_t data );
+    void send_byte( uint8_t data );
+    void send_boundry_byte();
+
+    send_hdnlr_t m_send_byte_hndlr;
+    recv_hndlr_t m_recv_frame_hndlr;
+        
+    bool escape_character;
+    uint8_t *receive_frame_buffer;
+    uint8_t frame_position;
+    uint16_t max_frame_length;
+
+    uint8_t *transmit_frame_buffer;
+    uint16_t transmit_frame_size;
+};
+
+#endif
\ No newline at end of file
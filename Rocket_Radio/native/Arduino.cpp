@@ -0,0 +1,90 @@
+#include "Arduino.h"
+
+#include <chrono>
+#include <thread>
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+static std::chrono::steady_clock::time_point const start_time = std::chrono::steady_clock::now();
+
+// See sim_clock_enable
+static bool sim_clock_on = false;
+static uint64_t sim_clock_us = 0;
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+static uint64_t real_micros()
+{
+    return (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - start_time ).count();
+}
+
+
+uint32_t millis()
+{
+    if( sim_clock_on )
+    {
+        return (uint32_t)( sim_clock_us / 1000 );
+    }
+
+    return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - start_time ).count();
+}
+
+
+uint32_t micros()
+{
+    return (uint32_t)( sim_clock_on ? sim_clock_us : real_micros() );
+}
+
+
+void delay( uint32_t ms )
+{
+    if( sim_clock_on )
+    {
+        sim_clock_us += (uint64_t)ms * 1000;
+        return;
+    }
+
+    std::this_thread::sleep_for( std::chrono::milliseconds( ms ) );
+}
+
+
+void delayMicroseconds( uint32_t us )
+{
+    if( sim_clock_on )
+    {
+        sim_clock_us += us;
+        return;
+    }
+
+    std::this_thread::sleep_for( std::chrono::microseconds( us ) );
+}
+
+
+/**********************************************************
+*   sim_clock_enable
+*       Switch between real and simulated time. Simulated
+*       time starts from the real time, so neither clock
+*       jumps back.
+**********************************************************/
+void sim_clock_enable( bool enabled )
+{
+    if( ( enabled )
+     && ( !sim_clock_on ) )
+    {
+        sim_clock_us = real_micros();
+    }
+
+    sim_clock_on = enabled;
+}
+
+
+void sim_clock_advance( uint32_t us )
+{
+    sim_clock_us += us;
+}
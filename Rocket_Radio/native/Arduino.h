@@ -0,0 +1,40 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+/******************************************************************************
+ *  Host stand-in for the parts of the Arduino core the radio code uses.
+ *  Only on the include path of the native env.
+ *****************************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#include "HardwareSerial.h"
+
+// The SAM core pulls min and max in from std for C++
+using std::min;
+using std::max;
+
+
+/******************************************************************************
+ *                          Function Declarations
+ *****************************************************************************/
+
+uint32_t millis();
+uint32_t micros();
+void delay( uint32_t ms );
+void delayMicroseconds( uint32_t us );
+
+// Host side. While on, millis() and micros() only move with
+//  sim_clock_advance(), and delay() moves them rather than sleeping, so a
+//  simulation can run faster than real time and still see the time its
+//  parts would have taken.
+void sim_clock_enable( bool enabled );
+void sim_clock_advance( uint32_t us );
+
+#endif
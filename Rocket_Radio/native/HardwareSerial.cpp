@@ -0,0 +1,212 @@
+#include "HardwareSerial.h"
+
+#include <algorithm>
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+UARTClass Serial;
+USARTClass Serial1;
+USARTClass Serial2;
+USARTClass Serial3;
+
+
+/******************************************************************************
+ *                          Method Definitions
+ *****************************************************************************/
+
+UARTClass::UARTClass() :
+    m_baud_rate( 9600 ),
+    m_tx_limited( false ),
+    m_tx_blocked( 0 ),
+    m_bit_time( 0 )
+{
+}
+
+
+void UARTClass::begin( uint32_t baud_rate )
+{
+    m_baud_rate = baud_rate;
+}
+
+
+void UARTClass::end()
+{
+    m_rx.clear();
+    m_tx.clear();
+    m_wire.clear();
+}
+
+
+int UARTClass::available()
+{
+    return (int)m_rx.size();
+}
+
+
+int UARTClass::peek()
+{
+    return m_rx.empty() ? -1 : m_rx.front();
+}
+
+
+int UARTClass::read()
+{
+    if( m_rx.empty() )
+    {
+        return -1;
+    }
+
+    uint8_t data = m_rx.front();
+    m_rx.pop_front();
+
+    return data;
+}
+
+
+int UARTClass::availableForWrite()
+{
+    return m_tx_limited ? SERIAL_BUFFER_SIZE - (int)m_tx.size() : SERIAL_BUFFER_SIZE;
+}
+
+
+void UARTClass::flush()
+{
+}
+
+
+size_t UARTClass::write( uint8_t data )
+{
+    queue_tx( data );
+    return 1;
+}
+
+
+size_t UARTClass::write( uint8_t const * buffer, size_t size )
+{
+    for( size_t i = 0; i < size; i++ )
+    {
+        queue_tx( buffer[i] );
+    }
+
+    return size;
+}
+
+
+/**********************************************************
+*   inject
+*       Make bytes available to read().
+**********************************************************/
+void UARTClass::inject( uint8_t const * buffer, size_t size )
+{
+    m_rx.insert( m_rx.end(), buffer, buffer + size );
+}
+
+
+/**********************************************************
+*   take_tx
+*       Collect up to size bytes that have been written.
+**********************************************************/
+size_t UARTClass::take_tx( uint8_t * buffer, size_t size )
+{
+    size_t count = ( m_wire.size() < size ) ? m_wire.size() : size;
+
+    std::copy( m_wire.begin(), m_wire.begin() + count, buffer );
+    m_wire.erase( m_wire.begin(), m_wire.begin() + count );
+
+    return count;
+}
+
+
+/**********************************************************
+*   tx_pending
+*       Bytes written that take_tx() hasn't collected,
+*       including ones still in the transmit buffer.
+**********************************************************/
+size_t UARTClass::tx_pending()
+{
+    return m_tx.size() + m_wire.size();
+}
+
+
+uint32_t UARTClass::baud_rate()
+{
+    return m_baud_rate;
+}
+
+
+
+/**********************************************************
+*   set_tx_limited
+*       Turn the baud rate limited transmit buffer on or
+*       off.
+**********************************************************/
+void UARTClass::set_tx_limited( bool limited )
+{
+    m_tx_limited = limited;
+    m_bit_time = 0;
+}
+
+
+/**********************************************************
+*   run
+*       Let us microseconds of wire time pass. Sends 10
+*       bits (start, 8 data, stop) per byte.
+**********************************************************/
+void UARTClass::run( uint32_t us )
+{
+    m_bit_time += (uint64_t)us * m_baud_rate;
+
+    while( ( !m_tx.empty() )
+        && ( m_bit_time >= 10ULL * 1000000ULL ) )
+    {
+        m_wire.push_back( m_tx.front() );
+        m_tx.pop_front();
+        m_bit_time -= 10ULL * 1000000ULL;
+    }
+
+    // An idle line doesn't bank time
+    if( m_tx.empty() )
+    {
+        m_bit_time = 0;
+    }
+}
+
+
+/**********************************************************
+*   tx_blocked
+*       Bytes written while the transmit buffer was full.
+*       The real core would have busy waited for each one.
+**********************************************************/
+uint32_t UARTClass::tx_blocked()
+{
+    return m_tx_blocked;
+}
+
+
+/**********************************************************
+*   queue_tx
+*       Put a written byte in the transmit buffer, or
+*       straight on the wire if it isn't limited.
+**********************************************************/
+void UARTClass::queue_tx( uint8_t data )
+{
+    if( !m_tx_limited )
+    {
+        m_wire.push_back( data );
+        return;
+    }
+
+    // The board would spin until the ISR frees a byte, let the
+    //  byte in front go out on the wire instead.
+    if( m_tx.size() >= SERIAL_BUFFER_SIZE )
+    {
+        m_tx_blocked++;
+        m_wire.push_back( m_tx.front() );
+        m_tx.pop_front();
+    }
+
+    m_tx.push_back( data );
+}
\ No newline at end of file
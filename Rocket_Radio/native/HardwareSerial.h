@@ -0,0 +1,123 @@
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// Same ring buffer size as the SAM core's UARTClass.
+#define SERIAL_BUFFER_SIZE 128
+
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   HardwareSerial
+*       The SAM core's serial base class, only what
+*       UARTClass needs. Like the core's it has no
+*       availableForWrite(), only UARTClass does, so code
+*       that needs it has to hold a UARTClass for the due
+*       env to build.
+**********************************************************/
+class HardwareSerial
+{
+public:
+    virtual ~HardwareSerial() {}
+
+    virtual void begin( uint32_t baud_rate ) = 0;
+    virtual void end() = 0;
+
+    virtual int available() = 0;
+    virtual int peek() = 0;
+    virtual int read() = 0;
+    virtual void flush() = 0;
+
+    virtual size_t write( uint8_t data ) = 0;
+    virtual size_t write( uint8_t const * buffer, size_t size ) = 0;
+
+    virtual operator bool() = 0;
+};
+
+
+/**********************************************************
+*   UARTClass
+*       Host stand-in for the SAM core UART. Bytes given
+*       to inject() show up on the receive side, bytes
+*       written are kept until take_tx() collects them.
+*       Both sides are unbounded so benchmarks never see
+*       a full buffer, unless set_tx_limited() is on. Then
+*       written bytes sit in a SERIAL_BUFFER_SIZE transmit
+*       buffer that run() drains at the baud rate, and any
+*       write that wouldn't fit is counted in
+*       tx_blocked(), since on the board it would have
+*       busy waited.
+**********************************************************/
+class UARTClass : public HardwareSerial
+{
+public:
+    UARTClass();
+
+    void begin( uint32_t baud_rate );
+    void end();
+
+    int available();
+    int peek();
+    int read();
+    int availableForWrite();
+    void flush();
+
+    size_t write( uint8_t data );
+    size_t write( uint8_t const * buffer, size_t size );
+
+    operator bool() { return true; }
+
+    // Test side
+    void inject( uint8_t const * buffer, size_t size );
+    size_t take_tx( uint8_t * buffer, size_t size );
+    size_t tx_pending();
+    uint32_t baud_rate();
+
+    void set_tx_limited( bool limited );
+    void run( uint32_t us );
+    uint32_t tx_blocked();
+
+private:
+    void queue_tx( uint8_t data );
+
+    uint32_t m_baud_rate;
+    bool m_tx_limited;
+    uint32_t m_tx_blocked;
+    uint64_t m_bit_time;        // Wire time owed to the TX buffer, in us * baud
+
+    std::deque<uint8_t> m_rx;
+    std::deque<uint8_t> m_tx;   // UART transmit buffer
+    std::deque<uint8_t> m_wire; // Sent, waiting for take_tx
+};
+
+
+/**********************************************************
+*   USARTClass
+*       Serial1 to Serial3 on the Due. A UARTClass as far
+*       as anything here uses it.
+**********************************************************/
+class USARTClass : public UARTClass
+{
+};
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+extern UARTClass Serial;
+extern USARTClass Serial1;
+extern USARTClass Serial2;
+extern USARTClass Serial3;
+
+#endif
@@ -0,0 +1,898 @@
+#include "SdFat.h"
+#include "Arduino.h"
+
+#include <string.h>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define SD_SIM_CLUSTER_BYTES ( SD_SIM_CLUSTER_BLOCKS * 512 )
+
+// Seed for the volume's aging, the same card every run.
+#define SD_SIM_AGE_SEED 12345
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+// Volume File works on, like SdFat's current working volume.
+static SdFat * sd_sim_vol = NULL;
+
+static const uint8_t sd_sim_zeros[512] = { 0 };
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+static std::string parent_of( std::string const & path )
+{
+    size_t slash = path.find_last_of( '/' );
+
+    return ( ( slash == std::string::npos ) || ( slash == 0 ) ) ? "/" : path.substr( 0, slash );
+}
+
+
+/******************************************************************************
+ *                          SdSpiCard Methods
+ *****************************************************************************/
+
+SdSpiCard::SdSpiCard() :
+    m_written( SD_SIM_BLOCKS, false )
+{
+}
+
+
+bool SdSpiCard::readBlock( uint32_t block, uint8_t * dst )
+{
+    auto found = m_blocks.find( block );
+
+    if( found == m_blocks.end() )
+    {
+        memset( dst, 0, 512 );
+    }
+    else
+    {
+        memcpy( dst, found->second.data(), 512 );
+    }
+
+    m_reads++;
+    this->charge( SD_SIM_CMD_US + SD_SIM_XFER_US + SD_SIM_READ_US );
+
+    return block < SD_SIM_BLOCKS;
+}
+
+
+/**********************************************************
+*   writeBlock
+*       Store the block. Outside the open allocation units
+*       it costs opening one, and the copy if the block
+*       held data.
+**********************************************************/
+bool SdSpiCard::writeBlock( uint32_t block, uint8_t const * src )
+{
+    uint32_t au = block / SD_SIM_AU_BLOCKS;
+    uint32_t us = SD_SIM_CMD_US + SD_SIM_XFER_US + SD_SIM_PROGRAM_US;
+
+    if( block >= SD_SIM_BLOCKS )
+    {
+        return false;
+    }
+
+    auto open = std::find( m_open_aus.begin(), m_open_aus.end(), au );
+    if( open != m_open_aus.end() )
+    {
+        m_open_aus.erase( open );
+    }
+    else
+    {
+        if( m_written[block] )
+        {
+            m_au_copies++;
+            us += SD_SIM_AU_COPY_US;
+        }
+        else
+        {
+            us += SD_SIM_AU_OPEN_US;
+        }
+
+        if( m_open_aus.size() >= SD_SIM_OPEN_AUS )
+        {
+            m_open_aus.pop_back();
+        }
+    }
+    m_open_aus.push_front( au );
+
+    memcpy( m_blocks[block].data(), src, 512 );
+    m_written[block] = true;
+    m_writes++;
+
+    this->charge( us );
+
+    return true;
+}
+
+
+/**********************************************************
+*   erase
+*       Blocks first_block to last_block read as zeros
+*       after. Whole allocation units erase in the
+*       background on a real card, the cost is per unit.
+**********************************************************/
+bool SdSpiCard::erase( uint32_t first_block, uint32_t last_block )
+{
+    if( ( first_block > last_block )
+     || ( last_block >= SD_SIM_BLOCKS ) )
+    {
+        return false;
+    }
+
+    for( auto it = m_blocks.begin(); it != m_blocks.end(); )
+    {
+        if( ( it->first >= first_block )
+         && ( it->first <= last_block ) )
+        {
+            it = m_blocks.erase( it );
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    for( uint32_t block = first_block; block <= last_block; block++ )
+    {
+        m_written[block] = false;
+    }
+
+    uint32_t aus = last_block / SD_SIM_AU_BLOCKS - first_block / SD_SIM_AU_BLOCKS + 1;
+    this->charge( SD_SIM_CMD_US + aus * SD_SIM_ERASE_AU_US );
+
+    return true;
+}
+
+
+uint64_t SdSpiCard::busy_us() const
+{
+    return m_busy_us;
+}
+
+
+uint32_t SdSpiCard::reads() const
+{
+    return m_reads;
+}
+
+
+uint32_t SdSpiCard::writes() const
+{
+    return m_writes;
+}
+
+
+uint32_t SdSpiCard::au_copies() const
+{
+    return m_au_copies;
+}
+
+
+/**********************************************************
+*   set_written
+*       Mark blocks as holding data, to age a card.
+**********************************************************/
+void SdSpiCard::set_written( uint32_t first_block, uint32_t last_block )
+{
+    for( uint32_t block = first_block; block <= last_block; block++ )
+    {
+        m_written[block] = true;
+    }
+}
+
+
+void SdSpiCard::charge( uint32_t us )
+{
+    m_busy_us += us;
+    sim_clock_advance( us );
+}
+
+
+/******************************************************************************
+ *                            SdFat Methods
+ *****************************************************************************/
+
+/**********************************************************
+*   SdFat
+*       Constructor. Ages the volume, with the blocks of
+*       the clusters in use holding data, and makes the
+*       root directory.
+**********************************************************/
+SdFat::SdFat() :
+    m_used( SD_SIM_CLUSTERS, false ),
+    m_cached( UINT32_MAX )
+{
+    uint32_t seed = SD_SIM_AGE_SEED;
+
+    for( uint32_t c = 0; c < SD_SIM_CLUSTERS / 2; )
+    {
+        seed = seed * 1103515245 + 12345;
+        uint32_t run = 1 + ( seed >> 16 ) % 16;
+        bool used = ( ( seed >> 8 ) & 1 ) != 0;
+
+        for( uint32_t i = 0; ( i < run ) && ( c < SD_SIM_CLUSTERS / 2 ); i++ )
+        {
+            if( used )
+            {
+                m_card.set_written( cluster_block( c ), cluster_block( c ) + SD_SIM_CLUSTER_BLOCKS - 1 );
+            }
+            m_used[c++] = used;
+        }
+    }
+
+    // Both FATs, and the root directory
+    m_card.set_written( SD_SIM_FAT_START, SD_SIM_FAT_START + 2 * SD_SIM_FAT_BLOCKS - 1 );
+    m_card.set_written( cluster_block( 0 ), cluster_block( 0 ) + SD_SIM_CLUSTER_BLOCKS - 1 );
+
+    sd_sim_node_t & root = m_nodes["/"];
+
+    root.is_dir = true;
+    root.size = 0;
+    root.dir_block = 0;
+    root.entries = 0;
+    root.clusters.push_back( 0 );
+    m_used[0] = true;
+}
+
+
+bool SdFat::begin( uint8_t cs_pin )
+{
+    (void)cs_pin;
+    sd_sim_vol = this;
+
+    return true;
+}
+
+
+SdSpiCard * SdFat::card()
+{
+    return &m_card;
+}
+
+
+bool SdFat::exists( char const * path )
+{
+    return this->find( path ) != NULL;
+}
+
+
+/**********************************************************
+*   mkdir
+*       Make a directory. Its parent has to be there and
+*       it mustn't be.
+**********************************************************/
+bool SdFat::mkdir( char const * path )
+{
+    if( ( this->find( path ) )
+     || ( !this->parent_ok( path ) ) )
+    {
+        return false;
+    }
+
+    return this->create( path, true ) != NULL;
+}
+
+
+/**********************************************************
+*   remove
+*       Delete a file, freeing its clusters.
+**********************************************************/
+bool SdFat::remove( char const * path )
+{
+    sd_sim_node_t * node = this->find( path );
+
+    if( ( !node )
+     || ( node->is_dir ) )
+    {
+        return false;
+    }
+
+    this->free_from( node, 0 );
+    this->write_entry( node );
+    m_nodes.erase( path );
+
+    return true;
+}
+
+
+sd_sim_node_t * SdFat::find( std::string const & path )
+{
+    auto found = m_nodes.find( path );
+
+    return ( found == m_nodes.end() ) ? NULL : &found->second;
+}
+
+
+bool SdFat::parent_ok( std::string const & path )
+{
+    sd_sim_node_t * parent = this->find( parent_of( path ) );
+
+    return ( parent ) && ( parent->is_dir );
+}
+
+
+/**********************************************************
+*   create
+*       Add an entry for path to its directory, and a
+*       cluster if it's a directory itself.
+**********************************************************/
+sd_sim_node_t * SdFat::create( std::string const & path, bool is_dir )
+{
+    sd_sim_node_t * parent = this->find( parent_of( path ) );
+    sd_sim_node_t & node = m_nodes[path];
+    uint16_t entry = parent->entries++;
+
+    node.is_dir = is_dir;
+    node.size = 0;
+    node.entries = 0;
+    node.dir_block = cluster_block( parent->clusters[0] ) + ( entry / SD_SIM_DIR_PER_BLOCK ) % SD_SIM_CLUSTER_BLOCKS;
+
+    if( ( is_dir )
+     && ( this->alloc( 1, false, 0, node.clusters ) ) )
+    {
+        this->write_fat( node.clusters, 0 );
+    }
+    this->write_entry( &node );
+
+    return &node;
+}
+
+
+/**********************************************************
+*   alloc
+*       Find count free clusters, searching from hint and
+*       reading the FAT as it goes, and add them to
+*       clusters. If contiguous they have to be one run.
+**********************************************************/
+bool SdFat::alloc( uint32_t count, bool contiguous, uint32_t hint, std::vector<uint32_t> & clusters )
+{
+    uint32_t run_start = 0;
+    uint32_t run = 0;
+    std::vector<uint32_t> found;
+
+    for( uint32_t i = 0; i < SD_SIM_CLUSTERS; i++ )
+    {
+        uint32_t c = ( hint + i ) % SD_SIM_CLUSTERS;
+
+        if( ( i == 0 )
+         || ( c % SD_SIM_FAT_PER_BLOCK == 0 ) )
+        {
+            this->meta_read( SD_SIM_FAT_START + c / SD_SIM_FAT_PER_BLOCK );
+        }
+
+        if( m_used[c] )
+        {
+            run = 0;
+            continue;
+        }
+
+        if( !contiguous )
+        {
+            found.push_back( c );
+            if( found.size() == count )
+            {
+                break;
+            }
+            continue;
+        }
+
+        // A run can't wrap round the end of the volume
+        if( ( run == 0 )
+         || ( c == 0 ) )
+        {
+            run_start = c;
+            run = 0;
+        }
+
+        if( ++run == count )
+        {
+            for( uint32_t r = 0; r < count; r++ )
+            {
+                found.push_back( run_start + r );
+            }
+            break;
+        }
+    }
+
+    if( found.size() != count )
+    {
+        return false;
+    }
+
+    for( uint32_t c : found )
+    {
+        m_used[c] = true;
+        clusters.push_back( c );
+    }
+
+    return true;
+}
+
+
+/**********************************************************
+*   free_from
+*       Give back every cluster of node's after the first
+*       keep.
+**********************************************************/
+void SdFat::free_from( sd_sim_node_t * node, size_t keep )
+{
+    if( node->clusters.size() <= keep )
+    {
+        return;
+    }
+
+    for( size_t i = keep; i < node->clusters.size(); i++ )
+    {
+        m_used[ node->clusters[i] ] = false;
+    }
+
+    // The entries freed and the new end of the chain
+    this->write_fat( node->clusters, ( keep > 0 ) ? keep - 1 : 0 );
+    node->clusters.resize( keep );
+}
+
+
+/**********************************************************
+*   write_fat
+*       Write the FAT blocks, both copies, holding the
+*       entries of clusters from first on.
+**********************************************************/
+void SdFat::write_fat( std::vector<uint32_t> const & clusters, size_t first )
+{
+    uint32_t last_block = UINT32_MAX;
+
+    for( size_t i = first; i < clusters.size(); i++ )
+    {
+        uint32_t block = SD_SIM_FAT_START + clusters[i] / SD_SIM_FAT_PER_BLOCK;
+
+        if( block == last_block )
+        {
+            continue;
+        }
+
+        this->meta_read( block );
+        m_card.writeBlock( block, sd_sim_zeros );
+        m_card.writeBlock( block + SD_SIM_FAT_BLOCKS, sd_sim_zeros );
+        last_block = block;
+    }
+}
+
+
+/**********************************************************
+*   write_entry
+*       Read and write back node's directory entry block.
+**********************************************************/
+void SdFat::write_entry( sd_sim_node_t const * node )
+{
+    this->meta_read( node->dir_block );
+    m_card.writeBlock( node->dir_block, sd_sim_zeros );
+}
+
+
+/**********************************************************
+*   meta_read
+*       Bring a FAT or directory block into SdFat's one
+*       block cache, reading it unless it's there already.
+**********************************************************/
+void SdFat::meta_read( uint32_t block )
+{
+    uint8_t data[512];
+
+    if( block != m_cached )
+    {
+        m_card.readBlock( block, data );
+        m_cached = block;
+    }
+}
+
+
+uint32_t SdFat::cluster_block( uint32_t cluster )
+{
+    return SD_SIM_DATA_START + cluster * SD_SIM_CLUSTER_BLOCKS;
+}
+
+
+/******************************************************************************
+ *                             File Methods
+ *****************************************************************************/
+
+File::File() :
+    m_vol( NULL ),
+    m_node( NULL ),
+    m_pos( 0 ),
+    m_writable( false ),
+    m_dirty( false )
+{
+}
+
+
+/**********************************************************
+*   open
+*       Open path on the mounted volume. O_CREAT makes it
+*       if need be, O_TRUNC empties it. Directories only
+*       open to read.
+**********************************************************/
+bool File::open( char const * path, int oflag )
+{
+    this->close();
+
+    if( !sd_sim_vol )
+    {
+        return false;
+    }
+
+    sd_sim_node_t * node = sd_sim_vol->find( path );
+    bool writable = ( oflag & O_ACCMODE ) != O_RDONLY;
+
+    if( !node )
+    {
+        if( ( !( oflag & O_CREAT ) )
+         || ( !writable )
+         || ( !sd_sim_vol->parent_ok( path ) ) )
+        {
+            return false;
+        }
+        node = sd_sim_vol->create( path, false );
+    }
+    else if( ( node->is_dir )
+          && ( writable ) )
+    {
+        return false;
+    }
+    else if( ( writable )
+          && ( oflag & O_TRUNC ) )
+    {
+        sd_sim_vol->free_from( node, 0 );
+        node->size = 0;
+        sd_sim_vol->write_entry( node );
+    }
+
+    m_vol = sd_sim_vol;
+    m_node = node;
+    m_path = path;
+    m_pos = 0;
+    m_writable = writable;
+    m_dirty = false;
+
+    return true;
+}
+
+
+/**********************************************************
+*   openNext
+*       Open the entry after the last one this was opened
+*       on in dir, reading its directory block. False once
+*       there are no more.
+**********************************************************/
+bool File::openNext( File * dir, int oflag )
+{
+    uint32_t index = 0;
+
+    this->close();
+
+    if( ( !dir->m_node )
+     || ( !dir->m_node->is_dir ) )
+    {
+        return false;
+    }
+
+    for( auto & entry : dir->m_vol->m_nodes )
+    {
+        if( ( entry.first == dir->m_path )
+         || ( parent_of( entry.first ) != dir->m_path ) )
+        {
+            continue;
+        }
+
+        if( index++ == dir->m_pos )
+        {
+            dir->m_pos++;
+            dir->m_vol->meta_read( entry.second.dir_block );
+            return this->open( entry.first.c_str(), oflag );
+        }
+    }
+
+    return false;
+}
+
+
+/**********************************************************
+*   createContiguous
+*       Make a new file of size bytes on one run of
+*       clusters, and open it for writing.
+**********************************************************/
+bool File::createContiguous( char const * path, uint32_t size )
+{
+    this->close();
+
+    if( ( !sd_sim_vol )
+     || ( size == 0 )
+     || ( sd_sim_vol->find( path ) )
+     || ( !sd_sim_vol->parent_ok( path ) ) )
+    {
+        return false;
+    }
+
+    std::vector<uint32_t> clusters;
+    uint32_t count = ( size + SD_SIM_CLUSTER_BYTES - 1 ) / SD_SIM_CLUSTER_BYTES;
+
+    if( !sd_sim_vol->alloc( count, true, 0, clusters ) )
+    {
+        return false;
+    }
+
+    sd_sim_node_t * node = sd_sim_vol->create( path, false );
+
+    node->clusters = clusters;
+    node->size = size;
+    sd_sim_vol->write_fat( node->clusters, 0 );
+    sd_sim_vol->write_entry( node );
+
+    m_vol = sd_sim_vol;
+    m_node = node;
+    m_path = path;
+    m_pos = 0;
+    m_writable = true;
+    m_dirty = false;
+
+    return true;
+}
+
+
+/**********************************************************
+*   contiguousRange
+*       First and last card block of the file, false if
+*       it isn't in one piece.
+**********************************************************/
+bool File::contiguousRange( uint32_t * first_block, uint32_t * last_block )
+{
+    if( ( !m_node )
+     || ( m_node->clusters.empty() ) )
+    {
+        return false;
+    }
+
+    for( size_t i = 1; i < m_node->clusters.size(); i++ )
+    {
+        if( m_node->clusters[i] != m_node->clusters[i - 1] + 1 )
+        {
+            return false;
+        }
+    }
+
+    *first_block = SdFat::cluster_block( m_node->clusters.front() );
+    *last_block = SdFat::cluster_block( m_node->clusters.back() ) + SD_SIM_CLUSTER_BLOCKS - 1;
+
+    return true;
+}
+
+
+/**********************************************************
+*   truncate
+*       Cut the file to length bytes, freeing clusters past
+*       it.
+**********************************************************/
+bool File::truncate( uint32_t length )
+{
+    if( ( !m_node )
+     || ( !m_writable )
+     || ( length > m_node->size ) )
+    {
+        return false;
+    }
+
+    m_vol->free_from( m_node, ( length + SD_SIM_CLUSTER_BYTES - 1 ) / SD_SIM_CLUSTER_BYTES );
+    m_node->size = length;
+    m_pos = min( m_pos, length );
+    m_vol->write_entry( m_node );
+    m_dirty = false;
+
+    return true;
+}
+
+
+bool File::isOpen() const
+{
+    return m_node != NULL;
+}
+
+
+bool File::isDir() const
+{
+    return ( m_node )
+        && ( m_node->is_dir );
+}
+
+
+/**********************************************************
+*   getName
+*       The file's name, without its directory. False if
+*       it doesn't fit in size.
+**********************************************************/
+bool File::getName( char * name, size_t size )
+{
+    std::string base = m_path.substr( m_path.find_last_of( '/' ) + 1 );
+
+    if( ( !m_node )
+     || ( base.size() >= size ) )
+    {
+        return false;
+    }
+
+    strcpy( name, base.c_str() );
+
+    return true;
+}
+
+
+void File::rewind()
+{
+    m_pos = 0;
+}
+
+
+void File::close()
+{
+    if( m_node )
+    {
+        this->flush();
+    }
+
+    m_node = NULL;
+}
+
+
+/**********************************************************
+*   read
+*       Up to length bytes from the current position.
+*       Returns how many.
+**********************************************************/
+int File::read( void * data, size_t length )
+{
+    uint8_t block[512];
+    size_t done = 0;
+
+    if( ( !m_node )
+     || ( m_node->is_dir ) )
+    {
+        return -1;
+    }
+
+    length = min( length, (size_t)( m_node->size - m_pos ) );
+
+    while( done < length )
+    {
+        uint32_t offset = m_pos % 512;
+        size_t count = min( length - done, (size_t)( 512 - offset ) );
+        uint32_t lba = SdFat::cluster_block( m_node->clusters[ m_pos / SD_SIM_CLUSTER_BYTES ] ) + ( m_pos % SD_SIM_CLUSTER_BYTES ) / 512;
+
+        m_vol->m_card.readBlock( lba, block );
+        memcpy( (uint8_t *)data + done, &block[offset], count );
+        done += count;
+        m_pos += count;
+    }
+
+    return (int)done;
+}
+
+
+/**********************************************************
+*   write
+*       Write at the current position. Whole aligned blocks
+*       go straight to the card, partial ones are read
+*       first if they hold data. A cluster is allocated
+*       and linked into the FAT whenever the file runs
+*       into a new one.
+**********************************************************/
+size_t File::write( void const * data, size_t length )
+{
+    uint8_t block[512];
+    size_t done = 0;
+
+    if( ( !m_node )
+     || ( !m_writable ) )
+    {
+        return 0;
+    }
+
+    while( done < length )
+    {
+        uint32_t offset = m_pos % 512;
+        size_t count = min( length - done, (size_t)( 512 - offset ) );
+        uint32_t index = m_pos / SD_SIM_CLUSTER_BYTES;
+
+        while( m_node->clusters.size() <= index )
+        {
+            uint32_t hint = m_node->clusters.empty() ? 0 : m_node->clusters.back() + 1;
+            size_t first = m_node->clusters.empty() ? 0 : m_node->clusters.size() - 1;
+
+            if( !m_vol->alloc( 1, false, hint, m_node->clusters ) )
+            {
+                return done;
+            }
+            m_vol->write_fat( m_node->clusters, first );
+        }
+
+        uint32_t lba = SdFat::cluster_block( m_node->clusters[index] ) + ( m_pos % SD_SIM_CLUSTER_BYTES ) / 512;
+
+        if( count == 512 )
+        {
+            m_vol->m_card.writeBlock( lba, (uint8_t const *)data + done );
+        }
+        else
+        {
+            if( m_pos - offset < m_node->size )
+            {
+                m_vol->m_card.readBlock( lba, block );
+            }
+            else
+            {
+                memset( block, 0, sizeof(block) );
+            }
+            memcpy( &block[offset], (uint8_t const *)data + done, count );
+            m_vol->m_card.writeBlock( lba, block );
+        }
+
+        done += count;
+        m_pos += count;
+        if( m_pos > m_node->size )
+        {
+            m_node->size = m_pos;
+            m_dirty = true;
+        }
+    }
+
+    return done;
+}
+
+
+bool File::seek( uint32_t position )
+{
+    if( ( !m_node )
+     || ( position > m_node->size ) )
+    {
+        return false;
+    }
+
+    m_pos = position;
+
+    return true;
+}
+
+
+/**********************************************************
+*   flush
+*       Write the directory entry if the size changed.
+**********************************************************/
+void File::flush()
+{
+    if( ( m_node )
+     && ( m_dirty ) )
+    {
+        m_vol->write_entry( m_node );
+        m_dirty = false;
+    }
+}
+
+
+uint32_t File::fileSize() const
+{
+    return m_node ? m_node->size : 0;
+}
+
+
+uint32_t File::curPosition() const
+{
+    return m_pos;
+}
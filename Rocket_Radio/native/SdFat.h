@@ -0,0 +1,211 @@
+#ifndef SdFat_h
+#define SdFat_h
+
+/******************************************************************************
+ *  Host stand-in for the parts of SdFat the log code uses, over a FAT32
+ *  volume kept in RAM. Only on the include path of the native env.
+ *****************************************************************************/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <array>
+#include <list>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// SdFat's open flags, from fcntl.h as it does on ARM.
+#ifndef O_READ
+#define O_READ O_RDONLY
+#endif
+#ifndef O_WRITE
+#define O_WRITE O_WRONLY
+#endif
+
+// Card timing. Every command costs SD_SIM_CMD_US plus the block over
+//  SPI, at the 21MHz the Due runs the card at. A read then waits for the
+//  card to fetch the block.
+#define SD_SIM_CMD_US 20
+#define SD_SIM_XFER_US 200
+#define SD_SIM_READ_US 100
+
+// Writes are programmed quickly into one of the card's few open
+//  allocation units. Writing anywhere else closes the least recently
+//  used one and opens another. That's cheap if the block is erased, but
+//  writing over a block that holds data makes the card copy the unit
+//  to a fresh one, the long stall cards are known for.
+#define SD_SIM_AU_BLOCKS 8192
+#define SD_SIM_OPEN_AUS 2
+#define SD_SIM_PROGRAM_US 60
+#define SD_SIM_AU_OPEN_US 300
+#define SD_SIM_AU_COPY_US 8000
+#define SD_SIM_ERASE_AU_US 300
+
+// Volume, a 4GB card as the SD formatter lays it out: 32KB clusters,
+//  two FATs, and the data starting on an allocation unit.
+#define SD_SIM_BLOCKS 8388608
+#define SD_SIM_CLUSTER_BLOCKS 64
+#define SD_SIM_FAT_START 32
+#define SD_SIM_FAT_BLOCKS 1024
+#define SD_SIM_DATA_START SD_SIM_AU_BLOCKS
+#define SD_SIM_CLUSTERS ( ( SD_SIM_BLOCKS - SD_SIM_DATA_START ) / SD_SIM_CLUSTER_BLOCKS )
+
+// FAT32 entries in one FAT block, and directory entries in one block.
+#define SD_SIM_FAT_PER_BLOCK 128
+#define SD_SIM_DIR_PER_BLOCK 16
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// A file or directory on the simulated volume.
+typedef struct
+{
+    bool is_dir;
+    std::vector<uint32_t> clusters;
+    uint32_t size;
+    uint32_t dir_block;     // Block holding its directory entry
+    uint16_t entries;       // Directories, entries made in it
+} sd_sim_node_t;
+
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   SdSpiCard
+*       The card. Keeps every block written, anything else
+*       reads as zeros, and charges each command its time
+*       from the defines above, moving the Arduino
+*       stand-in's simulated clock on by it. Tracks which
+*       blocks hold data, so an erase or a fresh card is
+*       cheap to write and old data isn't.
+**********************************************************/
+class SdSpiCard
+{
+public:
+    SdSpiCard();
+
+    bool readBlock( uint32_t block, uint8_t * dst );
+    bool writeBlock( uint32_t block, uint8_t const * src );
+    bool erase( uint32_t first_block, uint32_t last_block );
+
+    // Test side
+    void set_written( uint32_t first_block, uint32_t last_block );
+    uint64_t busy_us() const;
+    uint32_t reads() const;
+    uint32_t writes() const;
+    uint32_t au_copies() const;
+
+private:
+    void charge( uint32_t us );
+
+    std::unordered_map< uint32_t, std::array<uint8_t, 512> > m_blocks;
+    std::vector<bool> m_written;        // By block, holds data
+    std::list<uint32_t> m_open_aus;     // Most recently written first
+
+    uint64_t m_busy_us = 0;
+    uint32_t m_reads = 0;
+    uint32_t m_writes = 0;
+    uint32_t m_au_copies = 0;
+};
+
+
+class SdFat;
+
+/**********************************************************
+*   File
+*       An open file on the volume SdFat::begin() last
+*       mounted. Writes and seeks go through the FAT like
+*       SdFat's do: a new cluster is found in the FAT and
+*       linked in both copies as the file grows, and
+*       flush() writes the directory entry if the size
+*       changed. A directory opened O_READ lists what's
+*       in it through openNext().
+**********************************************************/
+class File
+{
+public:
+    File();
+
+    bool open( char const * path, int oflag = O_READ );
+    bool openNext( File * dir, int oflag = O_READ );
+    bool createContiguous( char const * path, uint32_t size );
+    bool contiguousRange( uint32_t * first_block, uint32_t * last_block );
+    bool truncate( uint32_t length );
+    bool isOpen() const;
+    bool isDir() const;
+    bool getName( char * name, size_t size );
+    void rewind();
+    void close();
+
+    int read( void * data, size_t length );
+    size_t write( void const * data, size_t length );
+    bool seek( uint32_t position );
+    void flush();
+
+    uint32_t fileSize() const;
+    uint32_t curPosition() const;
+
+    operator bool() const { return isOpen(); }
+
+private:
+    SdFat * m_vol;
+    sd_sim_node_t * m_node;
+    std::string m_path;
+    uint32_t m_pos;         // Directories, entries openNext() has passed
+    bool m_writable;
+    bool m_dirty;           // Size changed since the entry was written
+};
+
+
+/**********************************************************
+*   SdFat
+*       The volume. Starts aged, about half of the first
+*       half of the card taken by files that are long gone
+*       from the test's point of view, in runs of a few
+*       clusters, so allocation has to hunt for space like
+*       it does on a card that's been used a season.
+**********************************************************/
+class SdFat
+{
+public:
+    SdFat();
+
+    bool begin( uint8_t cs_pin );
+    SdSpiCard * card();
+
+    bool exists( char const * path );
+    bool mkdir( char const * path );
+    bool remove( char const * path );
+
+private:
+    friend class File;
+
+    sd_sim_node_t * find( std::string const & path );
+    sd_sim_node_t * create( std::string const & path, bool is_dir );
+    bool parent_ok( std::string const & path );
+
+    bool alloc( uint32_t count, bool contiguous, uint32_t hint, std::vector<uint32_t> & clusters );
+    void free_from( sd_sim_node_t * node, size_t keep );
+    void write_fat( std::vector<uint32_t> const & clusters, size_t first );
+    void write_entry( sd_sim_node_t const * node );
+    void meta_read( uint32_t block );
+
+    static uint32_t cluster_block( uint32_t cluster );
+
+    SdSpiCard m_card;
+    std::vector<bool> m_used;               // By cluster
+    std::map< std::string, sd_sim_node_t > m_nodes;
+    uint32_t m_cached;                      // Metadata block in the cache
+};
+
+#endif
@@ -0,0 +1,96 @@
+#include "sim_bus.h"
+
+SimBus::SimBus( uint32_t byte_us, uint32_t xfer_us ) :
+    m_byte_us( byte_us ),
+    m_xfer_us( xfer_us )
+{
+}
+
+
+bool SimBus::start( bus_xfer_t * xfer )
+{
+    if( ( m_xfer         )
+     || ( xfer->len == 0 ) )
+    {
+        return false;
+    }
+
+    m_xfer = xfer;
+    m_left_us = m_xfer_us + ( xfer->len + xfer->reg_len ) * m_byte_us;
+    xfer->sts = BUS_BUSY;
+
+    return true;
+}
+
+
+bool SimBus::busy()
+{
+    return m_xfer != NULL;
+}
+
+
+void SimBus::set_device( uint8_t addr, sim_device_t const & device )
+{
+    m_devices[addr] = device;
+}
+
+
+/**********************************************************
+*   advance
+*       Move time on by us, finishing the transfer if its
+*       time is up.
+**********************************************************/
+void SimBus::advance( uint32_t us )
+{
+    if( !m_xfer )
+    {
+        return;
+    }
+
+    if( us < m_left_us )
+    {
+        m_left_us -= us;
+        m_busy_us += us;
+        return;
+    }
+
+    m_busy_us += m_left_us;
+    m_left_us = 0;
+    this->finish();
+}
+
+
+uint32_t SimBus::transfers()
+{
+    return m_transfers;
+}
+
+
+uint64_t SimBus::bytes()
+{
+    return m_bytes;
+}
+
+
+uint64_t SimBus::busy_us()
+{
+    return m_busy_us;
+}
+
+
+void SimBus::finish()
+{
+    bus_xfer_t * xfer = m_xfer;
+    std::map<uint8_t, sim_device_t>::iterator device = m_devices.find( xfer->addr );
+    bool ack = ( device != m_devices.end() ) && device->second( *xfer );
+
+    m_xfer = NULL;
+    m_transfers++;
+    m_bytes += xfer->len + xfer->reg_len;
+    xfer->sts = ack ? BUS_DONE : BUS_ERROR;
+
+    if( xfer->done )
+    {
+        xfer->done( xfer );
+    }
+}
@@ -0,0 +1,66 @@
+#ifndef sim_bus_h
+#define sim_bus_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <map>
+
+#include "bus/bus.h"
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// A device on a SimBus. Fills in xfer.rx from xfer.reg or xfer.tx,
+//  returns false to NACK.
+typedef std::function<bool( bus_xfer_t & xfer )> sim_device_t;
+
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   SimBus
+*       Host stand-in for SamTwiBus and SamSpiBus. A
+*       transfer takes xfer_us plus byte_us for every byte
+*       on the wire, of simulated time moved on by
+*       advance(). It finishes inside advance(), where the
+*       board would finish it in an interrupt, with the
+*       reply from the device registered at its address
+*       or chip select pin. Nothing registered there NACKs.
+**********************************************************/
+class SimBus : public Bus
+{
+public:
+    SimBus( uint32_t byte_us, uint32_t xfer_us );
+
+    bool start( bus_xfer_t * xfer );
+    bool busy();
+
+    // Test side
+    void set_device( uint8_t addr, sim_device_t const & device );
+    void advance( uint32_t us );
+
+    uint32_t transfers();
+    uint64_t bytes();
+    uint64_t busy_us();
+
+private:
+    void finish();
+
+    uint32_t m_byte_us;
+    uint32_t m_xfer_us;
+    std::map<uint8_t, sim_device_t> m_devices;
+
+    bus_xfer_t * m_xfer = NULL;
+    uint32_t m_left_us = 0;
+
+    uint32_t m_transfers = 0;
+    uint64_t m_bytes = 0;
+    uint64_t m_busy_us = 0;
+};
+
+#endif
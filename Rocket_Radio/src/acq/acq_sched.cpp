@@ -0,0 +1,189 @@
+#include "acq_sched.h"
+
+#include <string.h>
+
+AcqScheduler::AcqScheduler( acq_source_t const * sources, uint8_t count ) :
+    m_sources( sources ),
+    m_count( ( count < ACQ_MAX_SOURCES ) ? count : ACQ_MAX_SOURCES )
+{
+    for( uint8_t i = 0; i < m_count; i++ )
+    {
+        m_period_ms[i] = m_sources[i].period_ms;
+    }
+
+    memset( m_next_us, 0, sizeof(m_next_us) );
+    memset( m_reads, 0, sizeof(m_reads) );
+    memset( m_late, 0, sizeof(m_late) );
+    memset( m_failed, 0, sizeof(m_failed) );
+}
+
+
+/**********************************************************
+*   begin
+*       Start every source's schedule from now_us, offset
+*       by its phase.
+**********************************************************/
+void AcqScheduler::begin( uint32_t now_us )
+{
+    for( uint8_t i = 0; i < m_count; i++ )
+    {
+        m_next_us[i] = now_us + m_sources[i].phase_ms * 1000UL;
+    }
+}
+
+
+/**********************************************************
+*   run
+*       Move along the read that's on the bus, or else
+*       start the read of the source that's been due the
+*       longest, if any is. Returns true if a read was
+*       started, moved along or finished.
+**********************************************************/
+bool AcqScheduler::run( uint32_t now_us )
+{
+    int32_t most_late = -1;
+    int8_t due = -1;
+
+    if( m_pending >= 0 )
+    {
+        return this->finish( m_pending, m_sources[m_pending].read( m_pending_us, m_sample ) );
+    }
+
+    for( uint8_t i = 0; i < m_count; i++ )
+    {
+        int32_t waited = (int32_t)( now_us - m_next_us[i] );
+
+        if( waited > most_late )
+        {
+            most_late = waited;
+            due = i;
+        }
+    }
+
+    if( due < 0 )
+    {
+        return false;
+    }
+
+    uint32_t period_us = m_period_ms[due] * 1000UL;
+
+    // Next slot, skipping any this one has already missed
+    m_next_us[due] += period_us;
+    if( (int32_t)( now_us - m_next_us[due] ) >= 0 )
+    {
+        uint32_t missed = ( now_us - m_next_us[due] ) / period_us + 1;
+
+        m_next_us[due] += missed * period_us;
+        m_late[due] += missed;
+    }
+
+    m_pending_us = now_us;
+    return this->finish( due, m_sources[due].read( now_us, m_sample ) );
+}
+
+
+/**********************************************************
+*   set_sink
+*       Where samples go.
+**********************************************************/
+void AcqScheduler::set_sink( acq_sink_t const & sink )
+{
+    m_sink = sink;
+}
+
+
+/**********************************************************
+*   set_period
+*       Read source every period_ms from its next read on.
+**********************************************************/
+void AcqScheduler::set_period( src_id_t source, uint16_t period_ms )
+{
+    int8_t i = this->find( source );
+
+    if( ( i >= 0 )
+     && ( period_ms > 0 ) )
+    {
+        m_period_ms[i] = period_ms;
+    }
+}
+
+
+/**********************************************************
+*   reads
+*       Samples read from source.
+**********************************************************/
+uint32_t AcqScheduler::reads( src_id_t source )
+{
+    int8_t i = this->find( source );
+
+    return ( i < 0 ) ? 0 : m_reads[i];
+}
+
+
+/**********************************************************
+*   late
+*       Reads of source skipped because it was a whole
+*       period late.
+**********************************************************/
+uint32_t AcqScheduler::late( src_id_t source )
+{
+    int8_t i = this->find( source );
+
+    return ( i < 0 ) ? 0 : m_late[i];
+}
+
+
+/**********************************************************
+*   failed
+*       Reads of source that returned no sample.
+**********************************************************/
+uint32_t AcqScheduler::failed( src_id_t source )
+{
+    int8_t i = this->find( source );
+
+    return ( i < 0 ) ? 0 : m_failed[i];
+}
+
+
+/**********************************************************
+*   finish
+*       Deal with what a read of source i returned.
+**********************************************************/
+bool AcqScheduler::finish( uint8_t i, bus_sts_t sts )
+{
+    switch( sts )
+    {
+        case BUS_BUSY:
+            m_pending = i;
+            return true;
+
+        case BUS_DONE:
+            m_reads[i]++;
+            if( m_sink )
+            {
+                m_sink( m_sources[i].source, m_sample, src_sample_size( m_sources[i].source ) );
+            }
+            break;
+
+        default:
+            m_failed[i]++;
+            break;
+    }
+
+    m_pending = -1;
+    return true;
+}
+
+
+int8_t AcqScheduler::find( src_id_t source )
+{
+    for( uint8_t i = 0; i < m_count; i++ )
+    {
+        if( m_sources[i].source == source )
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
@@ -0,0 +1,104 @@
+#ifndef ACQ_SCHED_H
+#define ACQ_SCHED_H
+
+#include <stdint.h>
+#include <functional>
+
+#include "../bus/bus.h"
+#include "../sensor_data.h"
+
+
+/******************************************************************************
+ *                                   Defines
+ *****************************************************************************/
+
+// Most sources one AcqScheduler runs.
+#define ACQ_MAX_SOURCES 8
+
+// Largest sample a read function fills in.
+#define ACQ_MAX_SAMPLE_SIZE sizeof(adc_sample_t)
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// Fills in sample, which is src_sample_size( source ) bytes, stamped
+//  with time_us. Returns BUS_DONE once it has, BUS_ERROR if the read
+//  failed. A read still on the bus returns BUS_BUSY and is called again
+//  with the same arguments on later passes until it's finished.
+typedef bus_sts_t (*acq_read_t)( uint32_t time_us, void * sample );
+
+// One sensor the scheduler reads. A source is read every period_ms,
+//  phase_ms after the scheduler starts. Sources with the same period
+//  and different phases take turns instead of landing on the same
+//  tick.
+typedef struct
+{
+    src_id_t source;
+    uint16_t period_ms;
+    uint16_t phase_ms;
+    acq_read_t read;
+} acq_source_t;
+
+// Called with every sample read.
+typedef std::function<void( src_id_t, void const *, uint8_t )> acq_sink_t;
+
+
+/******************************************************************************
+ *                                 AcqScheduler
+ *****************************************************************************/
+
+/**********************************************************
+*   AcqScheduler
+*       Reads each sensor in a table at its own rate and
+*       hands the tagged samples to a sink.
+*
+*       run() makes at most one read per call, the one
+*       that has waited longest, so one pass of loop()
+*       never pays for more than one sensor. A read that
+*       doesn't wait on the bus is moved along by the
+*       calls after, and nothing else is read until it's
+*       finished. A source that falls a whole period
+*       behind skips the reads it missed rather than
+*       bunching them up, and counts them as late.
+*
+*       Periods start out as the table's and can be changed
+*       while running with set_period.
+**********************************************************/
+class AcqScheduler
+{
+public:
+    AcqScheduler( acq_source_t const * sources, uint8_t count );
+
+    void begin( uint32_t now_us );
+    bool run( uint32_t now_us );
+
+    void set_sink( acq_sink_t const & sink );
+    void set_period( src_id_t source, uint16_t period_ms );
+
+    uint32_t reads( src_id_t source );
+    uint32_t late( src_id_t source );
+    uint32_t failed( src_id_t source );
+
+private:
+    bool finish( uint8_t i, bus_sts_t sts );
+    int8_t find( src_id_t source );
+
+    acq_source_t const * m_sources;
+    uint8_t m_count;
+    acq_sink_t m_sink;
+
+    // Source whose read is still on the bus, or -1
+    int8_t m_pending = -1;
+    uint32_t m_pending_us = 0;
+    uint8_t m_sample[ACQ_MAX_SAMPLE_SIZE];
+
+    uint16_t m_period_ms[ACQ_MAX_SOURCES];
+    uint32_t m_next_us[ACQ_MAX_SOURCES];
+    uint32_t m_reads[ACQ_MAX_SOURCES];
+    uint32_t m_late[ACQ_MAX_SOURCES];
+    uint32_t m_failed[ACQ_MAX_SOURCES];
+};
+
+#endif
@@ -0,0 +1,263 @@
+#include "sampler.h"
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+// Sampler the timer interrupt runs.
+static Sampler *active_sampler = NULL;
+
+// Set while something other than the sampler is using the SPI bus.
+static volatile bool spi_bus_busy = false;
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   spi_bus_acquire
+*       Called before any other SPI transfer. Once the
+*       flag is set the sampler won't start another burst,
+*       so once the one on the bus is done it's free.
+**********************************************************/
+void spi_bus_acquire()
+{
+    spi_bus_busy = true;
+    std::atomic_signal_fence( std::memory_order_seq_cst );
+
+    while( ( active_sampler                 )
+        && ( active_sampler->burst_busy()   ) )
+    {
+    }
+}
+
+
+void spi_bus_release()
+{
+    std::atomic_signal_fence( std::memory_order_seq_cst );
+    spi_bus_busy = false;
+}
+
+
+/**********************************************************
+*   TC3_Handler
+*       TC1 channel 0 compare interrupt.
+**********************************************************/
+void TC3_Handler()
+{
+    // Reading the status clears the interrupt
+    TC_GetStatus( TC1, 0 );
+
+    if( active_sampler )
+    {
+        active_sampler->isr();
+    }
+}
+
+
+/******************************************************************************
+ *                                   Sampler
+ *****************************************************************************/
+
+Sampler::Sampler( Mcp3008Burst *adc ) :
+    m_adc( adc )
+{
+    m_adc->set_done( burst_done, this );
+
+    for( uint8_t i = 0; i < SAMPLE_CONSUMER_CNT; i++ )
+    {
+        m_decimation[i] = 1;
+        m_skip[i] = 0;
+    }
+}
+
+
+/**********************************************************
+*   begin
+*       Start sampling at rate_hz. The ADC's bus has to be
+*       set up already.
+**********************************************************/
+void Sampler::begin( uint32_t rate_hz )
+{
+    m_period_us = 1000000UL / rate_hz;
+    m_last_us = 0;
+    active_sampler = this;
+
+    // TC1 channel 0 counting MCK/128 up to RC
+    pmc_set_writeprotect( false );
+    pmc_enable_periph_clk( ID_TC3 );
+    TC_Configure( TC1, 0, TC_CMR_WAVE | TC_CMR_WAVSEL_UP_RC | TC_CMR_TCCLKS_TIMER_CLOCK4 );
+    TC_SetRC( TC1, 0, VARIANT_MCK / 128 / rate_hz );
+
+    TC1->TC_CHANNEL[0].TC_IER = TC_IER_CPCS;
+    TC1->TC_CHANNEL[0].TC_IDR = ~TC_IER_CPCS;
+
+    NVIC_SetPriority( TC3_IRQn, SAMPLER_IRQ_PRIORITY );
+    NVIC_EnableIRQ( TC3_IRQn );
+    TC_Start( TC1, 0 );
+}
+
+
+void Sampler::end()
+{
+    NVIC_DisableIRQ( TC3_IRQn );
+    TC_Stop( TC1, 0 );
+    active_sampler = NULL;
+}
+
+
+/**********************************************************
+*   set_decimation
+*       Only pass every decimation'th sample to consumer.
+*       Safe while sampling, it's one halfword store the
+*       SPI interrupt picks up at its next sample. A skip
+*       count already past a smaller decimation just lets
+*       the next sample through.
+**********************************************************/
+void Sampler::set_decimation( sample_consumer_t consumer, uint16_t decimation )
+{
+    if( consumer < SAMPLE_CONSUMER_CNT )
+    {
+        m_decimation[consumer] = ( decimation > 0 ) ? decimation : 1;
+    }
+}
+
+
+/**********************************************************
+*   pop
+*       Oldest sample waiting for consumer. Returns false
+*       if there isn't one. Only call from loop() context.
+**********************************************************/
+bool Sampler::pop( sample_consumer_t consumer, adc_sample_t & sample )
+{
+    switch( consumer )
+    {
+        case SAMPLE_TO_LOG:
+            return m_log_ring.pop( sample );
+
+        case SAMPLE_TO_TLM:
+            return m_tlm_ring.pop( sample );
+
+        default:
+            return false;
+    }
+}
+
+
+/**********************************************************
+*   dropped
+*       Samples consumer lost because its ring was full.
+**********************************************************/
+uint32_t Sampler::dropped( sample_consumer_t consumer )
+{
+    switch( consumer )
+    {
+        case SAMPLE_TO_LOG:
+            return m_log_ring.dropped();
+
+        case SAMPLE_TO_TLM:
+            return m_tlm_ring.dropped();
+
+        default:
+            return 0;
+    }
+}
+
+
+/**********************************************************
+*   tries
+*       Timer interrupts so far, samples taken or missed.
+**********************************************************/
+uint32_t Sampler::tries()
+{
+    return m_tries;
+}
+
+
+/**********************************************************
+*   missed
+*       Samples not taken because the SPI bus was busy.
+**********************************************************/
+uint32_t Sampler::missed()
+{
+    return m_missed;
+}
+
+
+/**********************************************************
+*   max_jitter_us
+*       Furthest any interrupt has been from its period.
+**********************************************************/
+uint32_t Sampler::max_jitter_us()
+{
+    return m_max_jitter_us;
+}
+
+
+/**********************************************************
+*   burst_busy
+*       True while a burst is on the bus.
+**********************************************************/
+bool Sampler::burst_busy()
+{
+    return m_adc->busy();
+}
+
+
+/**********************************************************
+*   isr
+*       Start one sample. Runs in the timer interrupt.
+**********************************************************/
+void Sampler::isr()
+{
+    uint32_t now = micros();
+
+    if( m_last_us != 0 )
+    {
+        int32_t error = (int32_t)( now - m_last_us - m_period_us );
+        uint32_t jitter = ( error < 0 ) ? -error : error;
+
+        if( jitter > m_max_jitter_us )
+        {
+            m_max_jitter_us = jitter;
+        }
+    }
+    m_last_us = now;
+    m_tries++;
+
+    if( ( spi_bus_busy          )
+     || ( !m_adc->start( now )  ) )
+    {
+        m_missed++;
+    }
+}
+
+
+/**********************************************************
+*   burst_done
+*       Hand a finished burst to the consumers. Runs in
+*       the SPI interrupt.
+**********************************************************/
+void Sampler::burst_done( void * ctx, adc_sample_t const & sample )
+{
+    Sampler * self = (Sampler *)ctx;
+
+    self->push( sample );
+}
+
+
+void Sampler::push( adc_sample_t const & sample )
+{
+    if( ++m_skip[SAMPLE_TO_LOG] >= m_decimation[SAMPLE_TO_LOG] )
+    {
+        m_skip[SAMPLE_TO_LOG] = 0;
+        m_log_ring.push( sample );
+    }
+
+    if( ++m_skip[SAMPLE_TO_TLM] >= m_decimation[SAMPLE_TO_TLM] )
+    {
+        m_skip[SAMPLE_TO_TLM] = 0;
+        m_tlm_ring.push( sample );
+    }
+}
@@ -0,0 +1,117 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#include "../sensor_data.h"
+#include "../sensors/mcp3008_burst.h"
+#include "../util/spsc_ring.h"
+
+
+/******************************************************************************
+ *                                   Defines
+ *****************************************************************************/
+
+#define SAMPLER_RATE_HZ 1000
+
+// Slots in each consumer's ring. The log ring holds a quarter second
+//  at 1kHz for loop() to get to. That doesn't cover SD card writes,
+//  the card holds the SPI bus the ADC is on for them, so samples due
+//  during one are missed, not buffered. See missed().
+#define SAMPLER_LOG_RING_SIZE 256
+#define SAMPLER_TLM_RING_SIZE 4
+
+// Timer interrupt priority. Above the UARTs so their traffic doesn't add
+//  jitter, 0 is highest.
+#define SAMPLER_IRQ_PRIORITY 2
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// Who a sample is for. Each one gets its own ring and drains it at its
+//  own pace.
+typedef uint8_t sample_consumer_t;
+enum
+{
+    SAMPLE_TO_LOG   = 0,    // Every sample, to the SD card
+    SAMPLE_TO_TLM   = 1,    // Decimated, to the telemetry task
+
+    SAMPLE_CONSUMER_CNT
+};
+
+
+/******************************************************************************
+ *                          Function Declarations
+ *****************************************************************************/
+
+// Anything else on the SPI bus (the SD card) has to hold it while
+//  talking, the sampler skips a sample rather than collide with it.
+//  Acquiring waits out a burst already on the bus.
+void spi_bus_acquire();
+void spi_bus_release();
+
+
+/******************************************************************************
+ *                                   Sampler
+ *****************************************************************************/
+
+/**********************************************************
+*   Sampler
+*       Starts a burst read of every ADC channel from a TC1
+*       channel 0 timer interrupt, so the sample rate
+*       doesn't depend on how busy loop() is. The burst
+*       finishes in the SPI interrupt, which pushes the
+*       sample, stamped with the micros() it was started
+*       at, into a lock free ring per consumer.
+*
+*       Nothing is resampled. A sample that finds its ring
+*       full is dropped and counted, one that finds the SPI
+*       bus taken, or the last burst not finished, is
+*       missed and counted. While logging the SD card
+*       takes the bus for each block it writes, so some
+*       are missed then, tries() gives the rate.
+**********************************************************/
+class Sampler
+{
+public:
+    Sampler( Mcp3008Burst *adc );
+
+    void begin( uint32_t rate_hz );
+    void end();
+
+    void set_decimation( sample_consumer_t consumer, uint16_t decimation );
+    bool pop( sample_consumer_t consumer, adc_sample_t & sample );
+
+    uint32_t dropped( sample_consumer_t consumer );
+    uint32_t tries();
+    uint32_t missed();
+    uint32_t max_jitter_us();
+    bool burst_busy();
+
+    void isr();
+
+private:
+    static void burst_done( void * ctx, adc_sample_t const & sample );
+    void push( adc_sample_t const & sample );
+
+    Mcp3008Burst *m_adc;
+
+    SpscRing< adc_sample_t, SAMPLER_LOG_RING_SIZE > m_log_ring;
+    SpscRing< adc_sample_t, SAMPLER_TLM_RING_SIZE > m_tlm_ring;
+
+    // Set from loop(), read in the SPI interrupt
+    volatile uint16_t m_decimation[SAMPLE_CONSUMER_CNT];
+    uint16_t m_skip[SAMPLE_CONSUMER_CNT];
+
+    // Only touched by the interrupts once running
+    uint32_t m_period_us = 0;
+    uint32_t m_last_us = 0;
+    volatile uint32_t m_tries = 0;
+    volatile uint32_t m_missed = 0;
+    volatile uint32_t m_max_jitter_us = 0;
+};
+
+#endif
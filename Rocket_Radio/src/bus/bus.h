@@ -0,0 +1,116 @@
+#ifndef BUS_H
+#define BUS_H
+
+#include <stdint.h>
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// Where a transfer is at.
+typedef uint8_t bus_sts_t;
+enum
+{
+    BUS_IDLE    = 0,    // Not started, or finished and seen
+    BUS_BUSY    = 1,    // On the bus
+    BUS_DONE    = 2,    // rx holds the reply
+    BUS_ERROR   = 3,    // NACK or the bus gave up
+};
+
+struct bus_xfer_t;
+
+// Called from the bus interrupt when a transfer finishes, sts already
+//  set. Keep it short.
+typedef void (*bus_done_t)( bus_xfer_t * xfer );
+
+/**********************************************************
+*   bus_xfer_t
+*       One transfer. On I2C a read of len bytes from the
+*       device at addr, after writing reg to it if
+*       reg_len is 1. On SPI len bytes are clocked out of
+*       tx and into rx with chip select pin addr held low,
+*       and raised between every frame_len bytes if that
+*       isn't 0.
+*
+*       Has to stay put until it's finished.
+**********************************************************/
+struct bus_xfer_t
+{
+    uint8_t addr;
+    uint8_t reg;
+    uint8_t reg_len;
+    uint8_t frame_len;
+
+    uint8_t const * tx;
+    uint8_t * rx;
+    uint8_t len;
+
+    bus_done_t done;
+    void * ctx;
+
+    volatile bus_sts_t sts;
+};
+
+
+/******************************************************************************
+ *                                     Bus
+ *****************************************************************************/
+
+/**********************************************************
+*   Bus
+*       A bus that runs one transfer at a time without the
+*       caller waiting on it. start() puts the first byte
+*       on the wire and returns, the backend finishes the
+*       transfer from its interrupt, or from poll() if it
+*       doesn't have one.
+**********************************************************/
+class Bus
+{
+public:
+    virtual ~Bus() {}
+
+    // False if a transfer is already running.
+    virtual bool start( bus_xfer_t * xfer ) = 0;
+    virtual bool busy() = 0;
+    virtual void poll() {}
+};
+
+
+/**********************************************************
+*   bus_step
+*       Move a transfer along from loop() context. Starts
+*       it if it hasn't been, returns BUS_BUSY until it's
+*       finished then BUS_DONE or BUS_ERROR once, leaving
+*       it ready to start again.
+**********************************************************/
+inline bus_sts_t bus_step( Bus *bus, bus_xfer_t & xfer )
+{
+    bus_sts_t sts = xfer.sts;
+
+    switch( sts )
+    {
+        case BUS_IDLE:
+            // Left idle if the bus is taken, so the next call
+            //  tries again
+            bus->start( &xfer );
+            return BUS_BUSY;
+
+        case BUS_BUSY:
+            bus->poll();
+            sts = xfer.sts;
+            if( sts == BUS_BUSY )
+            {
+                return BUS_BUSY;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    xfer.sts = BUS_IDLE;
+    return sts;
+}
+
+#endif
@@ -0,0 +1,140 @@
+#include "sam_spi_bus.h"
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+// Bus the SPI0 interrupt runs.
+static SamSpiBus *active_spi_bus = NULL;
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   SPI0_Handler
+*       A byte has been clocked in.
+**********************************************************/
+void SPI0_Handler()
+{
+    if( active_spi_bus )
+    {
+        active_spi_bus->isr();
+    }
+}
+
+
+/******************************************************************************
+ *                                  SamSpiBus
+ *****************************************************************************/
+
+/**********************************************************
+*   begin
+*       Take the SPI0 interrupt. Call after SPI.begin().
+**********************************************************/
+void SamSpiBus::begin()
+{
+    active_spi_bus = this;
+
+    SPI0->SPI_IDR = 0xFFFFFFFF;
+    NVIC_ClearPendingIRQ( SPI0_IRQn );
+    NVIC_SetPriority( SPI0_IRQn, SAM_SPI_IRQ_PRIORITY );
+    NVIC_EnableIRQ( SPI0_IRQn );
+}
+
+
+/**********************************************************
+*   start
+*       Select the device and send the first byte. Returns
+*       false if a transfer is already running.
+**********************************************************/
+bool SamSpiBus::start( bus_xfer_t * xfer )
+{
+    if( ( m_xfer         )
+     || ( xfer->len == 0 ) )
+    {
+        return false;
+    }
+
+    m_xfer = xfer;
+    m_pos = 0;
+    xfer->sts = BUS_BUSY;
+
+    // Mode 0, 8 bits. Set every time, the SPI library rewrites it.
+    SPI0->SPI_CSR[ SAM_SPI_CHNL ] = SPI_CSR_SCBR( SAM_SPI_SCBR ) | SPI_CSR_NCPHA | SPI_CSR_BITS_8_BIT;
+
+    // Drop anything left in RDR so the first interrupt is our byte
+    (void)SPI0->SPI_RDR;
+
+    this->select( true );
+    SPI0->SPI_TDR = SPI_TDR_TD( xfer->tx[0] ) | SPI_PCS( SAM_SPI_CHNL );
+    SPI0->SPI_IER = SPI_IER_RDRF;
+
+    return true;
+}
+
+
+bool SamSpiBus::busy()
+{
+    return m_xfer != NULL;
+}
+
+
+/**********************************************************
+*   isr
+*       Store the byte clocked in and send the next one,
+*       toggling chip select between frames.
+**********************************************************/
+void SamSpiBus::isr()
+{
+    bus_xfer_t * xfer = m_xfer;
+
+    if( !xfer )
+    {
+        SPI0->SPI_IDR = SPI_IDR_RDRF;
+        return;
+    }
+
+    xfer->rx[ m_pos++ ] = (uint8_t)SPI0->SPI_RDR;
+
+    if( m_pos == xfer->len )
+    {
+        this->select( false );
+        this->finish( BUS_DONE );
+        return;
+    }
+
+    if( ( xfer->frame_len               )
+     && ( m_pos % xfer->frame_len == 0  ) )
+    {
+        // The MCP3008 wants chip select high at least 270ns
+        //  between conversions
+        this->select( false );
+        delayMicroseconds( 1 );
+        this->select( true );
+    }
+
+    SPI0->SPI_TDR = SPI_TDR_TD( xfer->tx[ m_pos ] ) | SPI_PCS( SAM_SPI_CHNL );
+}
+
+
+void SamSpiBus::select( bool selected )
+{
+    digitalWrite( m_xfer->addr, selected ? LOW : HIGH );
+}
+
+
+void SamSpiBus::finish( bus_sts_t sts )
+{
+    bus_xfer_t * xfer = m_xfer;
+
+    SPI0->SPI_IDR = SPI_IDR_RDRF;
+    m_xfer = NULL;
+    xfer->sts = sts;
+
+    if( xfer->done )
+    {
+        xfer->done( xfer );
+    }
+}
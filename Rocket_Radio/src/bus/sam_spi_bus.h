@@ -0,0 +1,57 @@
+#ifndef SAM_SPI_BUS_H
+#define SAM_SPI_BUS_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#include "bus.h"
+
+
+/******************************************************************************
+ *                                   Defines
+ *****************************************************************************/
+
+// SPI clock. MCK / SCBR, 1MHz is what the MCP3008 takes at 2.7V.
+#define SAM_SPI_SCBR 84
+
+// Chip select channel whose CSR this bus sets up. Channel 3 is the one
+//  the SPI library gives pins that aren't NPCS pins, and chip select is
+//  driven by hand here anyway.
+#define SAM_SPI_CHNL 3
+
+// Same as the timer interrupt that starts ADC bursts, so a burst's
+//  bytes don't wait behind the next tick.
+#define SAM_SPI_IRQ_PRIORITY 2
+
+
+/******************************************************************************
+ *                                  SamSpiBus
+ *****************************************************************************/
+
+/**********************************************************
+*   SamSpiBus
+*       SPI transfers on SPI0, a byte per SPI0 interrupt.
+*       The CPU is free while each byte is on the wire,
+*       about 8us at 1MHz. SPI.begin() has to have set up
+*       the pins first. Anything else using SPI0 has to
+*       wait until busy() is false.
+**********************************************************/
+class SamSpiBus : public Bus
+{
+public:
+    void begin();
+
+    bool start( bus_xfer_t * xfer );
+    bool busy();
+
+    void isr();
+
+private:
+    void select( bool selected );
+    void finish( bus_sts_t sts );
+
+    bus_xfer_t * volatile m_xfer = NULL;
+    uint8_t m_pos = 0;
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include "sam_twi_bus.h"
+
+/**********************************************************
+*   start
+*       Address the device and start reading. Returns
+*       false if a transfer is already running.
+**********************************************************/
+bool SamTwiBus::start( bus_xfer_t * xfer )
+{
+    if( ( m_xfer         )
+     || ( xfer->len == 0 ) )
+    {
+        return false;
+    }
+
+    m_xfer = xfer;
+    m_pos = 0;
+    m_start_us = micros();
+    xfer->sts = BUS_BUSY;
+
+    // Reading the status clears any NACK left from before
+    (void)TWI1->TWI_SR;
+
+    TWI1->TWI_MMR = 0;
+    TWI1->TWI_MMR = TWI_MMR_DADR( xfer->addr )
+                  | TWI_MMR_MREAD
+                  | ( xfer->reg_len ? TWI_MMR_IADRSZ_1_BYTE : TWI_MMR_IADRSZ_NONE );
+    TWI1->TWI_IADR = xfer->reg;
+
+    // A one byte read has to ask for the stop along with the start
+    TWI1->TWI_CR = ( xfer->len == 1 ) ? ( TWI_CR_START | TWI_CR_STOP ) : TWI_CR_START;
+
+    return true;
+}
+
+
+bool SamTwiBus::busy()
+{
+    return m_xfer != NULL;
+}
+
+
+/**********************************************************
+*   poll
+*       Take the next byte if one has come in, and finish
+*       the transfer once the stop has gone out.
+**********************************************************/
+void SamTwiBus::poll()
+{
+    if( !m_xfer )
+    {
+        return;
+    }
+
+    uint32_t sr = TWI1->TWI_SR;
+
+    if( sr & TWI_SR_NACK )
+    {
+        this->finish( BUS_ERROR );
+        return;
+    }
+
+    if( ( sr & TWI_SR_RXRDY       )
+     && ( m_pos < m_xfer->len     ) )
+    {
+        m_xfer->rx[ m_pos++ ] = TWI1->TWI_RHR;
+
+        // The stop goes out after the byte being received now
+        if( m_xfer->len - m_pos == 1 )
+        {
+            TWI1->TWI_CR = TWI_CR_STOP;
+        }
+    }
+
+    if( ( m_pos == m_xfer->len    )
+     && ( sr & TWI_SR_TXCOMP      ) )
+    {
+        this->finish( BUS_DONE );
+    }
+    else if( micros() - m_start_us > SAM_TWI_TIMEOUT_US )
+    {
+        TWI1->TWI_CR = TWI_CR_STOP;
+        this->finish( BUS_ERROR );
+    }
+}
+
+
+void SamTwiBus::finish( bus_sts_t sts )
+{
+    bus_xfer_t * xfer = m_xfer;
+
+    m_xfer = NULL;
+    xfer->sts = sts;
+
+    if( xfer->done )
+    {
+        xfer->done( xfer );
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef SAM_TWI_BUS_H
+#define SAM_TWI_BUS_H
+
+#include <Arduino.h>
+#include <stdint.h>
+
+#include "bus.h"
+
+
+/******************************************************************************
+ *                                   Defines
+ *****************************************************************************/
+
+// A read that hasn't finished in this long has hung the bus. The longest
+//  sensor read is about 1ms at 100kHz.
+#define SAM_TWI_TIMEOUT_US 5000
+
+
+/******************************************************************************
+ *                                  SamTwiBus
+ *****************************************************************************/
+
+/**********************************************************
+*   SamTwiBus
+*       I2C reads on TWI1, the Due's SDA and SCL pins,
+*       moved along a byte at a time by poll(). The Wire
+*       library owns the TWI1 interrupt, so this doesn't
+*       use it. While a received byte waits in RHR the TWI
+*       holds SCL low, so a slow poll() only stretches the
+*       transfer.
+*
+*       Wire has to have set up the pins and clock first,
+*       and mustn't be used again once this is running.
+**********************************************************/
+class SamTwiBus : public Bus
+{
+public:
+    bool start( bus_xfer_t * xfer );
+    bool busy();
+    void poll();
+
+private:
+    void finish( bus_sts_t sts );
+
+    bus_xfer_t * m_xfer = NULL;
+    uint8_t m_pos = 0;
+    uint32_t m_start_us = 0;
+};
+
+#endif
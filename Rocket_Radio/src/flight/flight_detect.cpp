@@ -0,0 +1,248 @@
+#include "flight_detect.h"
+
+
+/******************************************************************************
+ *                          Method Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   FlightDetect
+*       Constructor. cfg is kept by reference.
+**********************************************************/
+FlightDetect::FlightDetect( flight_cfg_t const & cfg ) :
+    m_cfg( cfg )
+{
+    this->reset();
+}
+
+
+/**********************************************************
+*   reset
+*       Back on the pad with no pressure reference.
+**********************************************************/
+void FlightDetect::reset()
+{
+    m_state = FLIGHT_PAD;
+    m_bursting = false;
+    m_launch_ms = FLIGHT_NO_TIME;
+    m_apogee_ms = FLIGHT_NO_TIME;
+
+    m_accel_since_ms = FLIGHT_NO_TIME;
+    m_dp_since_ms = FLIGHT_NO_TIME;
+    m_rise_since_ms = FLIGHT_NO_TIME;
+
+    m_have_prsur = false;
+    m_prsur = 0;
+    m_ground_prsur = 0;
+    m_min_prsur = 0;
+    m_min_ms = FLIGHT_NO_TIME;
+}
+
+
+/**********************************************************
+*   accel
+*       Take a linear acceleration sample, gravity taken
+*       out. On the pad a magnitude over launch_accel held
+*       for launch_hold_ms is a launch, timed from when it
+*       first went over.
+**********************************************************/
+flight_event_t FlightDetect::accel( uint32_t time_ms, float x, float y, float z )
+{
+    float const limit = m_cfg.launch_accel;
+
+    if( m_state != FLIGHT_PAD )
+    {
+        return FLIGHT_EVT_NONE;
+    }
+
+    if( x * x + y * y + z * z < limit * limit )
+    {
+        m_accel_since_ms = FLIGHT_NO_TIME;
+        return FLIGHT_EVT_NONE;
+    }
+
+    if( m_accel_since_ms == FLIGHT_NO_TIME )
+    {
+        m_accel_since_ms = time_ms;
+    }
+
+    if( time_ms - m_accel_since_ms >= m_cfg.launch_hold_ms )
+    {
+        return this->launch( m_accel_since_ms );
+    }
+
+    return FLIGHT_EVT_NONE;
+}
+
+
+/**********************************************************
+*   pressure
+*       Take a pressure sample. On the pad it moves the
+*       ground reference, and the smoothed pressure
+*       staying launch_dp under it is a launch. After
+*       apogee_lockout_ms of flight the smoothed pressure
+*       staying apogee_dp over its lowest point is apogee,
+*       timed at that lowest point.
+**********************************************************/
+flight_event_t FlightDetect::pressure( uint32_t time_ms, float prsur )
+{
+    if( !m_have_prsur )
+    {
+        m_have_prsur = true;
+        m_prsur = prsur;
+        m_ground_prsur = prsur;
+        return FLIGHT_EVT_NONE;
+    }
+
+    m_prsur += ( prsur - m_prsur ) / ( 1 << FLIGHT_PRSUR_SHIFT );
+
+    switch( m_state )
+    {
+        case FLIGHT_PAD:
+            m_ground_prsur += ( prsur - m_ground_prsur ) / ( 1 << FLIGHT_GROUND_SHIFT );
+
+            if( m_prsur > m_ground_prsur - m_cfg.launch_dp )
+            {
+                m_dp_since_ms = FLIGHT_NO_TIME;
+                break;
+            }
+
+            if( m_dp_since_ms == FLIGHT_NO_TIME )
+            {
+                m_dp_since_ms = time_ms;
+            }
+
+            if( time_ms - m_dp_since_ms >= m_cfg.launch_hold_ms )
+            {
+                return this->launch( m_dp_since_ms );
+            }
+            break;
+
+        case FLIGHT_ASCENT:
+            if( m_prsur < m_min_prsur )
+            {
+                m_min_prsur = m_prsur;
+                m_min_ms = time_ms;
+                m_rise_since_ms = FLIGHT_NO_TIME;
+                break;
+            }
+
+            if( ( time_ms - m_launch_ms < m_cfg.apogee_lockout_ms )
+             || ( m_prsur < m_min_prsur + m_cfg.apogee_dp ) )
+            {
+                m_rise_since_ms = FLIGHT_NO_TIME;
+                break;
+            }
+
+            if( m_rise_since_ms == FLIGHT_NO_TIME )
+            {
+                m_rise_since_ms = time_ms;
+            }
+
+            if( time_ms - m_rise_since_ms >= m_cfg.apogee_hold_ms )
+            {
+                m_state = FLIGHT_DESCENT;
+                m_apogee_ms = m_min_ms;
+                return FLIGHT_EVT_APOGEE;
+            }
+            break;
+
+        default:
+            break;
+    }
+
+    return FLIGHT_EVT_NONE;
+}
+
+
+/**********************************************************
+*   tick
+*       Ends the burst post_ms after apogee, or
+*       burst_max_ms after launch if apogee never came.
+*       Call often, the samples don't.
+**********************************************************/
+flight_event_t FlightDetect::tick( uint32_t time_ms )
+{
+    if( !m_bursting )
+    {
+        return FLIGHT_EVT_NONE;
+    }
+
+    if( ( ( m_state == FLIGHT_DESCENT ) && ( time_ms - m_apogee_ms >= m_cfg.post_ms ) )
+     || ( time_ms - m_launch_ms >= m_cfg.burst_max_ms ) )
+    {
+        m_bursting = false;
+        return FLIGHT_EVT_BURST_END;
+    }
+
+    return FLIGHT_EVT_NONE;
+}
+
+
+flight_cfg_t const & FlightDetect::cfg() const
+{
+    return m_cfg;
+}
+
+
+flight_state_t FlightDetect::state() const
+{
+    return m_state;
+}
+
+
+/**********************************************************
+*   bursting
+*       True from launch until the burst ends.
+**********************************************************/
+bool FlightDetect::bursting() const
+{
+    return m_bursting;
+}
+
+
+uint32_t FlightDetect::launch_ms() const
+{
+    return m_launch_ms;
+}
+
+
+uint32_t FlightDetect::apogee_ms() const
+{
+    return m_apogee_ms;
+}
+
+
+/**********************************************************
+*   prsur
+*       Smoothed pressure.
+**********************************************************/
+float FlightDetect::prsur() const
+{
+    return m_prsur;
+}
+
+
+float FlightDetect::ground_prsur() const
+{
+    return m_ground_prsur;
+}
+
+
+/**********************************************************
+*   launch
+*       Leave the pad and start the burst, launch timed at
+*       since_ms.
+**********************************************************/
+flight_event_t FlightDetect::launch( uint32_t since_ms )
+{
+    m_state = FLIGHT_ASCENT;
+    m_bursting = true;
+    m_launch_ms = since_ms;
+
+    m_min_prsur = m_prsur;
+    m_min_ms = since_ms;
+    m_rise_since_ms = FLIGHT_NO_TIME;
+
+    return FLIGHT_EVT_LAUNCH;
+}
@@ -0,0 +1,127 @@
+#ifndef FLIGHT_DETECT_H
+#define FLIGHT_DETECT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// Smoothing of the pressure the detectors look at, 1 / 2^n of each new
+//  sample. The ground reference is smoothed much harder so a launch
+//  doesn't drag it along.
+#define FLIGHT_PRSUR_SHIFT 2
+#define FLIGHT_GROUND_SHIFT 6
+
+// A time that hasn't happened.
+#define FLIGHT_NO_TIME UINT32_MAX
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// Where the flight is.
+typedef uint8_t flight_state_t;
+enum
+{
+    FLIGHT_PAD      = 0,    // Waiting for launch
+    FLIGHT_ASCENT   = 1,    // Launched, waiting for apogee
+    FLIGHT_DESCENT  = 2,    // Past apogee
+};
+
+// What a sample or tick set off.
+typedef uint8_t flight_event_t;
+enum
+{
+    FLIGHT_EVT_NONE         = 0,
+    FLIGHT_EVT_LAUNCH       = 1,    // Start the burst, dump the pre-trigger window
+    FLIGHT_EVT_APOGEE       = 2,
+    FLIGHT_EVT_BURST_END    = 3,    // Post window is over, back to normal rates
+};
+
+// Detector thresholds and the windows around them.
+typedef struct
+{
+    float launch_accel;         // m/s^2, linear accel magnitude
+    uint16_t launch_hold_ms;    // Held this long before it counts
+    float launch_dp;            // psi below ground, backup for a bad IMU
+    float apogee_dp;            // psi above the lowest pressure seen
+    uint16_t apogee_hold_ms;
+    uint16_t apogee_lockout_ms; // No apogee this soon after launch, rides out transonic pressure spikes
+    uint16_t pre_ms;            // Kept from before launch
+    uint16_t post_ms;           // Burst keeps going after apogee
+    uint32_t burst_max_ms;      // Burst ends this long after launch at the latest
+} flight_cfg_t;
+
+// One LOG_REC_EVENT record.
+typedef struct __attribute__((packed))
+{
+    flight_event_t event;
+    flight_state_t state;
+    float prsur;                // Smoothed, when it happened
+    float ground_prsur;
+} flight_evt_rec_t;
+
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   FlightDetect
+*       Spots launch from the IMU's linear acceleration,
+*       or the pressure falling away from the ground
+*       reference, and apogee from the pressure climbing
+*       back off its lowest point. Times the burst that
+*       runs from launch until post_ms after apogee.
+*
+*       Fed samples with their own timestamps, so the same
+*       code runs on the board and over a recorded CSV on
+*       the host. Every call returns the event it set off,
+*       if any.
+**********************************************************/
+class FlightDetect
+{
+public:
+    FlightDetect( flight_cfg_t const & cfg );
+
+    void reset();
+
+    flight_event_t accel( uint32_t time_ms, float x, float y, float z );
+    flight_event_t pressure( uint32_t time_ms, float prsur );
+    flight_event_t tick( uint32_t time_ms );
+
+    flight_cfg_t const & cfg() const;
+    flight_state_t state() const;
+    bool bursting() const;
+    uint32_t launch_ms() const;
+    uint32_t apogee_ms() const;
+    float prsur() const;
+    float ground_prsur() const;
+
+private:
+    flight_event_t launch( uint32_t since_ms );
+
+    flight_cfg_t const & m_cfg;
+
+    flight_state_t m_state;
+    bool m_bursting;
+    uint32_t m_launch_ms;
+    uint32_t m_apogee_ms;
+
+    // Start of the current run over a threshold, FLIGHT_NO_TIME if
+    //  not over it
+    uint32_t m_accel_since_ms;
+    uint32_t m_dp_since_ms;
+    uint32_t m_rise_since_ms;
+
+    bool m_have_prsur;
+    float m_prsur;
+    float m_ground_prsur;
+    float m_min_prsur;
+    uint32_t m_min_ms;
+};
+
+#endif
@@ -0,0 +1,475 @@
+#include "nmea_parser.h"
+
+#include <string.h>
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+static const uint32_t nmea_pow10[ NMEA_MAX_DIGITS + 1 ] =
+{
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+};
+
+
+/******************************************************************************
+ *                          Method Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   NmeaParser
+*       Constructor
+**********************************************************/
+NmeaParser::NmeaParser() :
+    m_state( NMEA_WAIT_START ),
+    m_rmc_time( NMEA_NO_TIME ),
+    m_gga_time( NMEA_NO_TIME ),
+    m_fix_time( NMEA_NO_TIME ),
+    m_fix_ready( false ),
+    m_sentences( 0 ),
+    m_bad( 0 )
+{
+    memset( &m_data, 0, sizeof(m_data) );
+}
+
+
+/**********************************************************
+*   receive
+*       Parse a buffer of bytes from the GPS UART.
+**********************************************************/
+void NmeaParser::receive( uint8_t const * data, size_t length )
+{
+    size_t i = 0;
+
+    while( i < length )
+    {
+        // Runs of digits are most of a sentence. Take them in locals,
+        //  since stores through data could alias the members.
+        if( ( m_state == NMEA_FIELD )
+         && ( m_field > 0 ) )
+        {
+            uint8_t sum = m_sum;
+            uint8_t chars = m_length;
+            uint32_t value = m_value;
+            uint8_t digits = m_digits;
+            size_t start = i;
+
+            while( ( i < length )
+                && ( (uint8_t)( data[i] - '0' ) <= 9 )
+                && ( digits < NMEA_MAX_DIGITS )
+                && ( chars < NMEA_MAX_SENTENCE ) )
+            {
+                sum ^= data[i];
+                value = value * 10 + ( data[i] - '0' );
+                digits++;
+                chars++;
+                i++;
+            }
+
+            if( i > start )
+            {
+                m_sum = sum;
+                m_length = chars;
+                m_value = value;
+                m_frac_digits += m_frac ? digits - m_digits : 0;
+                m_chars += digits - m_digits;
+                m_digits = digits;
+                continue;
+            }
+        }
+
+        this->receive( data[i++] );
+    }
+}
+
+
+/**********************************************************
+*   receive
+*       Parse one byte from the GPS UART.
+**********************************************************/
+void NmeaParser::receive( uint8_t data )
+{
+    if( data == '$' )
+    {
+        // A sentence cut short by the next one
+        if( m_state != NMEA_WAIT_START )
+        {
+            m_bad++;
+        }
+
+        this->start();
+        return;
+    }
+
+    if( m_state == NMEA_WAIT_START )
+    {
+        return;
+    }
+
+    if( ( data < ' ' )
+     || ( data > '~' )
+     || ( ++m_length > NMEA_MAX_SENTENCE ) )
+    {
+        m_bad++;
+        m_state = NMEA_WAIT_START;
+        return;
+    }
+
+    switch( m_state )
+    {
+        case NMEA_FIELD:
+            if( data == '*' )
+            {
+                this->field_end();
+                m_state = NMEA_CHECKSUM;
+                m_given_sum = 0;
+                m_hex_cnt = 0;
+                break;
+            }
+
+            m_sum ^= data;
+
+            if( data == ',' )
+            {
+                this->field_end();
+                m_field++;
+                this->field_start();
+            }
+            else
+            {
+                this->field_char( data );
+            }
+            break;
+
+        case NMEA_CHECKSUM:
+        {
+            uint8_t nibble;
+
+            if( ( data >= '0' )
+             && ( data <= '9' ) )
+            {
+                nibble = data - '0';
+            }
+            else if( ( data >= 'A' )
+                  && ( data <= 'F' ) )
+            {
+                nibble = data - 'A' + 10;
+            }
+            else
+            {
+                m_bad++;
+                m_state = NMEA_WAIT_START;
+                break;
+            }
+
+            m_given_sum = ( m_given_sum << 4 ) | nibble;
+            if( ++m_hex_cnt == 2 )
+            {
+                this->sentence_end();
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+
+/**********************************************************
+*   fix_ready
+*       True once per fix, when both of its sentences have
+*       been parsed.
+**********************************************************/
+bool NmeaParser::fix_ready()
+{
+    bool ready = m_fix_ready;
+
+    m_fix_ready = false;
+    return ready;
+}
+
+
+/**********************************************************
+*   data
+*       Everything parsed from good sentences so far.
+**********************************************************/
+gps_data_t const & NmeaParser::data() const
+{
+    return m_data;
+}
+
+
+/**********************************************************
+*   sentences
+*       Sentences with a good checksum, of any type.
+**********************************************************/
+uint32_t NmeaParser::sentences() const
+{
+    return m_sentences;
+}
+
+
+/**********************************************************
+*   bad
+*       Sentences thrown away for a bad checksum, a bad
+*       character or being cut short.
+**********************************************************/
+uint32_t NmeaParser::bad() const
+{
+    return m_bad;
+}
+
+
+/**********************************************************
+*   start
+*       A '$' came in, start a new sentence.
+**********************************************************/
+void NmeaParser::start()
+{
+    m_state = NMEA_FIELD;
+    m_type = NMEA_OTHER;
+    m_length = 0;
+    m_sum = 0;
+    m_field = 0;
+
+    m_next = m_data;
+    m_next_time = NMEA_NO_TIME;
+    m_coord_set = false;
+
+    this->field_start();
+}
+
+
+void NmeaParser::field_start()
+{
+    m_chars = 0;
+    m_value = 0;
+    m_digits = 0;
+    m_frac_digits = 0;
+    m_frac = false;
+    m_letter = 0;
+}
+
+
+/**********************************************************
+*   field_char
+*       Add a character to the field being read. Digits
+*       go into m_value as they come.
+**********************************************************/
+void NmeaParser::field_char( uint8_t data )
+{
+    if( ( m_field == 0 )
+     && ( m_chars < sizeof(m_address) ) )
+    {
+        m_address[m_chars] = (char)data;
+    }
+
+    m_chars++;
+
+    if( ( data >= '0' )
+     && ( data <= '9' ) )
+    {
+        if( m_digits < NMEA_MAX_DIGITS )
+        {
+            m_value = m_value * 10 + ( data - '0' );
+            m_digits++;
+            m_frac_digits += m_frac ? 1 : 0;
+        }
+    }
+    else if( data == '.' )
+    {
+        m_frac = true;
+    }
+    else if( !m_letter )
+    {
+        m_letter = (char)data;
+    }
+}
+
+
+/**********************************************************
+*   field_end
+*       Store the field just read into m_next, if it's
+*       one of the ones wanted. Empty fields leave the last
+*       value alone.
+**********************************************************/
+void NmeaParser::field_end()
+{
+    if( m_field == 0 )
+    {
+        // Any talker, GP, GN...
+        if( m_chars == sizeof(m_address) )
+        {
+            if( memcmp( &m_address[2], "RMC", 3 ) == 0 )
+            {
+                m_type = NMEA_RMC;
+            }
+            else if( memcmp( &m_address[2], "GGA", 3 ) == 0 )
+            {
+                m_type = NMEA_GGA;
+            }
+        }
+        return;
+    }
+
+    if( ( m_type == NMEA_OTHER )
+     || ( m_chars == 0 ) )
+    {
+        return;
+    }
+
+    // Numbered as in RMC. GGA has lat and lon too but no status field
+    //  ahead of them, so everything after its time is one field on.
+    uint8_t field = m_field;
+    if( ( m_type == NMEA_GGA )
+     && ( field >= 2 ) )
+    {
+        field++;
+    }
+
+    switch( field )
+    {
+        case 1:
+        {
+            uint32_t time = this->scaled( 3 );
+
+            m_next_time = time;
+            m_next.hour = time / 10000000;
+            m_next.min = time / 100000 % 100;
+            m_next.sec = time / 1000 % 100;
+            break;
+        }
+
+        case 2:
+            if( m_type == NMEA_RMC )
+            {
+                m_next.fix = ( m_letter == 'A' );
+            }
+            break;
+
+        case 3:
+        case 5:
+            m_coord = this->degrees();
+            m_coord_set = true;
+            break;
+
+        case 4:
+        case 6:
+            if( m_coord_set )
+            {
+                float coord = ( ( m_letter == 'S' ) || ( m_letter == 'W' ) ) ? -m_coord : m_coord;
+
+                if( field == 4 )
+                {
+                    m_next.lat = coord;
+                }
+                else
+                {
+                    m_next.lon = coord;
+                }
+            }
+            m_coord_set = false;
+            break;
+
+        case 7:
+            if( m_type == NMEA_GGA )
+            {
+                m_next.fix_qual = m_value;
+                m_next.fix = ( m_value > 0 );
+            }
+            break;
+
+        case 8:
+            if( m_type == NMEA_GGA )
+            {
+                m_next.sat_num = m_value;
+            }
+            break;
+
+        case 9:
+            if( m_type == NMEA_RMC )
+            {
+                m_next.day = m_value / 10000;
+                m_next.month = m_value / 100 % 100;
+                m_next.year = m_value % 100;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**********************************************************
+*   sentence_end
+*       The checksum is in. Keep what the sentence said if
+*       it matches.
+**********************************************************/
+void NmeaParser::sentence_end()
+{
+    m_state = NMEA_WAIT_START;
+
+    if( m_given_sum != m_sum )
+    {
+        m_bad++;
+        return;
+    }
+
+    m_sentences++;
+
+    switch( m_type )
+    {
+        case NMEA_RMC:
+            m_rmc_time = m_next_time;
+            break;
+
+        case NMEA_GGA:
+            m_gga_time = m_next_time;
+            break;
+
+        default:
+            return;
+    }
+
+    m_data = m_next;
+
+    if( ( m_rmc_time == m_gga_time )
+     && ( m_rmc_time != NMEA_NO_TIME )
+     && ( m_rmc_time != m_fix_time ) )
+    {
+        m_fix_time = m_rmc_time;
+        m_fix_ready = true;
+    }
+}
+
+
+/**********************************************************
+*   scaled
+*       The field's number with frac_digits digits after
+*       the point, as an integer.
+**********************************************************/
+uint32_t NmeaParser::scaled( uint8_t frac_digits ) const
+{
+    if( m_frac_digits > frac_digits )
+    {
+        return m_value / nmea_pow10[ m_frac_digits - frac_digits ];
+    }
+
+    return m_value * nmea_pow10[ frac_digits - m_frac_digits ];
+}
+
+
+/**********************************************************
+*   degrees
+*       The field as degrees, from NMEA's dddmm.mmmm.
+**********************************************************/
+float NmeaParser::degrees() const
+{
+    uint32_t whole = m_value / nmea_pow10[m_frac_digits];
+    float minutes = ( whole % 100 ) + (float)( m_value % nmea_pow10[m_frac_digits] ) / nmea_pow10[m_frac_digits];
+
+    return ( whole / 100 ) + minutes / 60.0f;
+}
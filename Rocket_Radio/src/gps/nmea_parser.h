@@ -0,0 +1,115 @@
+#ifndef NMEA_PARSER_H
+#define NMEA_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "../sensor_data.h"
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// Longest sentence the NMEA spec allows, '$' to checksum. Anything longer
+//  is garbage and dropped.
+#define NMEA_MAX_SENTENCE 82
+
+// Digits kept of a number. More than fits in 32 bits are ignored, which
+//  only ever drops fraction digits past what a float holds.
+#define NMEA_MAX_DIGITS 9
+
+// Sentence time when it had none.
+#define NMEA_NO_TIME UINT32_MAX
+
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   NmeaParser
+*       Parses RMC and GGA sentences straight into a
+*       gps_data_t as the bytes arrive, a buffer at a
+*       time. Nothing is copied or buffered as text, fields
+*       are turned into integers as they go by and the
+*       checksum is kept on the fly. A sentence only
+*       changes data() once its checksum has checked out.
+*
+*       fix_ready() is true once an RMC and a GGA for the
+*       same time have both been parsed, so once per
+*       update at any update rate.
+**********************************************************/
+class NmeaParser
+{
+public:
+    NmeaParser();
+
+    void receive( uint8_t const * data, size_t length );
+    void receive( uint8_t data );
+
+    bool fix_ready();
+    gps_data_t const & data() const;
+
+    uint32_t sentences() const;
+    uint32_t bad() const;
+
+private:
+    // Where in a sentence the parser is
+    enum state_t
+    {
+        NMEA_WAIT_START,
+        NMEA_FIELD,
+        NMEA_CHECKSUM,
+    };
+
+    // Sentences that are parsed, the rest only checksummed
+    enum sentence_t
+    {
+        NMEA_OTHER,
+        NMEA_RMC,
+        NMEA_GGA,
+    };
+
+    void start();
+    void field_start();
+    void field_char( uint8_t data );
+    void field_end();
+    void sentence_end();
+
+    uint32_t scaled( uint8_t frac_digits ) const;
+    float degrees() const;
+
+    state_t m_state;
+    sentence_t m_type;
+    uint8_t m_length;           // Characters since '$'
+    uint8_t m_sum;              // XOR of everything between '$' and '*'
+    uint8_t m_given_sum;        // Checksum in the sentence
+    uint8_t m_hex_cnt;
+
+    // The field being read
+    uint8_t m_field;            // 0 is the address
+    char m_address[5];
+    uint8_t m_chars;
+    uint32_t m_value;           // Its digits as an integer
+    uint8_t m_digits;
+    uint8_t m_frac_digits;      // How many of them came after the '.'
+    bool m_frac;
+    char m_letter;              // First non digit in it, 0 if none
+
+    // Sentence being parsed, becomes m_data if its checksum is good
+    gps_data_t m_next;
+    uint32_t m_next_time;       // hhmmss.sss read as hhmmsssss
+    float m_coord;              // Lat or lon, waiting on its hemisphere
+    bool m_coord_set;
+
+    gps_data_t m_data;
+    uint32_t m_rmc_time;        // Time of the last good RMC
+    uint32_t m_gga_time;        // and GGA
+    uint32_t m_fix_time;        // and whole fix
+    bool m_fix_ready;
+
+    uint32_t m_sentences;
+    uint32_t m_bad;
+};
+
+#endif
@@ -0,0 +1,137 @@
+#include "bin_log.h"
+#include "../sensor_data.h"
+#include "../telemetry/tlm_schema.h"
+#include "../flight/flight_detect.h"
+#include "link_capture.h"
+
+#include <stddef.h>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define ADC_FIELD( name, type, precision, field ) \
+    { name, type, offsetof( adc_sample_t, field ), precision }
+
+#define VEC3_FIELD( name, type, precision, field ) \
+    { name, type, offsetof( vec3_sample_t, field ), precision }
+
+#define PRSUR_FIELD( name, type, precision, field ) \
+    { name, type, offsetof( prsur_sample_t, field ), precision }
+
+#define LINK_FIELD( name, type, precision, field ) \
+    { name, type, offsetof( link_chunk_t, field ), precision }
+
+#define EVENT_FIELD( name, type, precision, field ) \
+    { name, type, offsetof( flight_evt_rec_t, field ), precision }
+
+#define ARRAY_CNT(a) ( sizeof(a) / sizeof(a[0]) )
+
+static_assert( BIN_LOG_STATS_SIZE % 32 == 0, "BinLog::begin zeros it 32 bytes at a time" );
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+// Sensor and GPS records use the telemetry schema's tables, see
+//  tlm_schema.h.
+
+// Timer driven ADC samples.
+static const log_field_t adc_fields[] =
+{
+    ADC_FIELD( "time_us",       LOG_FIELD_U32,   0, time_us     ),
+    ADC_FIELD( "adc_chnl_0",    LOG_FIELD_U16,   0, adc[0]      ),
+    ADC_FIELD( "adc_chnl_1",    LOG_FIELD_U16,   0, adc[1]      ),
+    ADC_FIELD( "adc_chnl_2",    LOG_FIELD_U16,   0, adc[2]      ),
+    ADC_FIELD( "adc_chnl_3",    LOG_FIELD_U16,   0, adc[3]      ),
+    ADC_FIELD( "adc_chnl_4",    LOG_FIELD_U16,   0, adc[4]      ),
+    ADC_FIELD( "adc_chnl_5",    LOG_FIELD_U16,   0, adc[5]      ),
+    ADC_FIELD( "adc_chnl_6",    LOG_FIELD_U16,   0, adc[6]      ),
+    ADC_FIELD( "adc_chnl_7",    LOG_FIELD_U16,   0, adc[7]      ),
+};
+
+// IMU samples, each at the rate the acquisition scheduler reads them.
+static const log_field_t euler_fields[] =
+{
+    VEC3_FIELD( "time_us",      LOG_FIELD_U32,   0, time_us     ),
+    VEC3_FIELD( "angle_X",      LOG_FIELD_FLOAT, 4, x           ),
+    VEC3_FIELD( "angle_Y",      LOG_FIELD_FLOAT, 4, y           ),
+    VEC3_FIELD( "angle_Z",      LOG_FIELD_FLOAT, 4, z           ),
+};
+
+static const log_field_t accel_fields[] =
+{
+    VEC3_FIELD( "time_us",      LOG_FIELD_U32,   0, time_us     ),
+    VEC3_FIELD( "accel_X",      LOG_FIELD_FLOAT, 4, x           ),
+    VEC3_FIELD( "accel_Y",      LOG_FIELD_FLOAT, 4, y           ),
+    VEC3_FIELD( "accel_Z",      LOG_FIELD_FLOAT, 4, z           ),
+};
+
+static const log_field_t prsur_fields[] =
+{
+    PRSUR_FIELD( "time_us",           LOG_FIELD_U32,   0, time_us ),
+    PRSUR_FIELD( "air pressure",      LOG_FIELD_FLOAT, 4, prsur   ),
+    PRSUR_FIELD( "air pressure temp", LOG_FIELD_FLOAT, 4, temp    ),
+};
+
+// Raw radio bytes. The bytes themselves don't go in the CSV, the
+//  replay tool reads them from the log.
+static const log_field_t link_fields[] =
+{
+    LINK_FIELD( "time_us",      LOG_FIELD_U32,   0, time_us     ),
+    LINK_FIELD( "length",       LOG_FIELD_U8,    0, length      ),
+};
+
+// Launch, apogee and the end of the burst, as FlightDetect saw them.
+static const log_field_t event_fields[] =
+{
+    EVENT_FIELD( "event",           LOG_FIELD_U8,    0, event         ),
+    EVENT_FIELD( "state",           LOG_FIELD_U8,    0, state         ),
+    EVENT_FIELD( "air pressure",    LOG_FIELD_FLOAT, 4, prsur         ),
+    EVENT_FIELD( "ground pressure", LOG_FIELD_FLOAT, 4, ground_prsur  ),
+};
+
+const log_layout_t bin_log_layouts[LOG_REC_CNT] =
+{
+    { { LOG_REC_SENSOR, sizeof(data_pkg_t),   tlm_schema_t::sensor_cnt, "snsr" }, tlm_schema_t::sensor },
+    { { LOG_REC_GPS,    sizeof(gps_data_t),   tlm_schema_t::gps_cnt,    "gps"  }, tlm_schema_t::gps    },
+    { { LOG_REC_ADC,    sizeof(adc_sample_t), ARRAY_CNT(adc_fields),    "adc"  }, adc_fields    },
+    { { LOG_REC_EULER,  sizeof(vec3_sample_t),  ARRAY_CNT(euler_fields),  "euler" }, euler_fields  },
+    { { LOG_REC_ACCEL,  sizeof(vec3_sample_t),  ARRAY_CNT(accel_fields),  "accel" }, accel_fields  },
+    { { LOG_REC_PRSUR,  sizeof(prsur_sample_t), ARRAY_CNT(prsur_fields),  "prsur" }, prsur_fields  },
+    { { LOG_REC_LINK,   sizeof(link_chunk_t),   ARRAY_CNT(link_fields),   "link"  }, link_fields   },
+    { { LOG_REC_EVENT,  sizeof(flight_evt_rec_t), ARRAY_CNT(event_fields), "event" }, event_fields  },
+};
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   bin_log_hdr_size
+*       Size of the header BinLog::begin writes.
+**********************************************************/
+uint16_t bin_log_hdr_size()
+{
+    return bin_log_stats_offset() + BIN_LOG_STATS_SIZE;
+}
+
+
+/**********************************************************
+*   bin_log_stats_offset
+*       Where in the file the stats area starts.
+**********************************************************/
+uint32_t bin_log_stats_offset()
+{
+    uint32_t offset = sizeof(log_hdr_t);
+
+    for( uint8_t i = 0; i < LOG_REC_CNT; i++ )
+    {
+        offset += sizeof(log_rec_desc_t) + bin_log_layouts[i].desc.field_cnt * sizeof(log_field_t);
+    }
+
+    return offset;
+}
@@ -0,0 +1,226 @@
+#ifndef BIN_LOG_H
+#define BIN_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// First four bytes of a log file, "RRLG" read as little endian.
+#define BIN_LOG_MAGIC 0x474C5252
+#define BIN_LOG_VERSION 2
+
+// First byte of every record. Anything else between records is padding.
+#define BIN_LOG_SYNC 0xA5
+
+#define BIN_LOG_REC_NAME_LEN 8
+#define BIN_LOG_FIELD_NAME_LEN 20
+
+// Largest record payload.
+#define BIN_LOG_MAX_DATA 64
+
+// Bytes at the end of the header kept for the run's stats, filled in
+//  when the log is closed. All zeros if it never was. Version 2 on.
+#define BIN_LOG_STATS_SIZE 256
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// Labels what's in a record.
+typedef uint8_t log_rec_type_t;
+enum
+{
+    LOG_REC_SENSOR  = 0,    // data_pkg_t
+    LOG_REC_GPS     = 1,    // gps_data_t
+    LOG_REC_ADC     = 2,    // adc_sample_t
+    LOG_REC_EULER   = 3,    // vec3_sample_t
+    LOG_REC_ACCEL   = 4,    // vec3_sample_t
+    LOG_REC_PRSUR   = 5,    // prsur_sample_t
+    LOG_REC_LINK    = 6,    // link_chunk_t
+    LOG_REC_EVENT   = 7,    // flight_evt_rec_t
+
+    LOG_REC_CNT
+};
+
+// How a field is stored. All multi byte values are little endian.
+typedef uint8_t log_field_type_t;
+enum
+{
+    LOG_FIELD_U8    = 0,
+    LOG_FIELD_U16   = 1,
+    LOG_FIELD_U32   = 2,
+    LOG_FIELD_I16   = 3,
+    LOG_FIELD_I32   = 4,
+    LOG_FIELD_FLOAT = 5,
+    LOG_FIELD_BOOL  = 6,
+};
+
+// File header. Followed by hdr.rec_type_cnt record descriptions, then
+//  BIN_LOG_STATS_SIZE bytes of stats.
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint8_t version;
+    uint8_t rec_type_cnt;
+    uint16_t hdr_size;      // Bytes from the start of the file to the first record
+} log_hdr_t;
+
+// Record description. Followed by field_cnt field descriptions, in the
+//  order the columns appear in the CSV.
+typedef struct __attribute__((packed))
+{
+    log_rec_type_t rec_type;
+    uint8_t size;
+    uint8_t field_cnt;
+    char name[BIN_LOG_REC_NAME_LEN];
+} log_rec_desc_t;
+
+typedef struct __attribute__((packed))
+{
+    char name[BIN_LOG_FIELD_NAME_LEN];
+    log_field_type_t type;
+    uint8_t offset;
+    uint8_t precision;      // Decimal places when printed, floats only
+} log_field_t;
+
+// Every record starts with this, then size bytes of data.
+typedef struct __attribute__((packed))
+{
+    uint8_t sync;
+    log_rec_type_t rec_type;
+    uint16_t seq;
+    uint32_t time_ms;
+} log_rec_hdr_t;
+
+typedef struct
+{
+    log_rec_desc_t desc;
+    log_field_t const * fields;
+} log_layout_t;
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+extern const log_layout_t bin_log_layouts[LOG_REC_CNT];
+
+
+/******************************************************************************
+ *                          Function Declarations
+ *****************************************************************************/
+
+uint16_t bin_log_hdr_size();
+uint32_t bin_log_stats_offset();
+
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   BinLog
+*       Writes sensor and GPS data as fixed size binary
+*       records behind a header that describes their
+*       layout. A record costs a copy into the sink, no
+*       formatting. Sink needs
+*       write( uint8_t const *, size_t ).
+**********************************************************/
+template< typename Sink >
+class BinLog
+{
+public:
+    BinLog( Sink & sink );
+
+    void begin();
+    void write( log_rec_type_t rec_type, void const * data, uint8_t size, uint32_t time_ms );
+
+private:
+    Sink & m_sink;
+    uint16_t m_seq;
+};
+
+
+/******************************************************************************
+ *                          Method Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   BinLog
+*       Constructor
+**********************************************************/
+template< typename Sink >
+BinLog< Sink >::BinLog( Sink & sink ) :
+    m_sink( sink ),
+    m_seq( 0 )
+{
+}
+
+
+/**********************************************************
+*   begin
+*       Start a new log by writing the header.
+**********************************************************/
+template< typename Sink >
+void BinLog< Sink >::begin()
+{
+    log_hdr_t hdr;
+
+    hdr.magic = BIN_LOG_MAGIC;
+    hdr.version = BIN_LOG_VERSION;
+    hdr.rec_type_cnt = LOG_REC_CNT;
+    hdr.hdr_size = bin_log_hdr_size();
+
+    m_sink.write( (uint8_t const *)&hdr, sizeof(hdr) );
+
+    for( uint8_t i = 0; i < LOG_REC_CNT; i++ )
+    {
+        log_layout_t const & layout = bin_log_layouts[i];
+
+        m_sink.write( (uint8_t const *)&layout.desc, sizeof(layout.desc) );
+        m_sink.write( (uint8_t const *)layout.fields, layout.desc.field_cnt * sizeof(log_field_t) );
+    }
+
+    // Room for the stats, written over when the log is closed
+    uint8_t zeros[32] = { 0 };
+    for( uint16_t i = 0; i < BIN_LOG_STATS_SIZE; i += sizeof(zeros) )
+    {
+        m_sink.write( zeros, sizeof(zeros) );
+    }
+
+    m_seq = 0;
+}
+
+
+/**********************************************************
+*   write
+*       Add one record to the log.
+**********************************************************/
+template< typename Sink >
+void BinLog< Sink >::write( log_rec_type_t rec_type, void const * data, uint8_t size, uint32_t time_ms )
+{
+    uint8_t rec[ sizeof(log_rec_hdr_t) + BIN_LOG_MAX_DATA ];
+    log_rec_hdr_t hdr;
+
+    if( size > BIN_LOG_MAX_DATA )
+    {
+        return;
+    }
+
+    hdr.sync = BIN_LOG_SYNC;
+    hdr.rec_type = rec_type;
+    hdr.seq = m_seq++;
+    hdr.time_ms = time_ms;
+
+    memcpy( rec, &hdr, sizeof(hdr) );
+    memcpy( &rec[sizeof(hdr)], data, size );
+
+    m_sink.write( rec, sizeof(hdr) + size );
+}
+
+#endif
@@ -0,0 +1,380 @@
+#ifndef BLOCK_WRITER_H
+#define BLOCK_WRITER_H
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// SD card sector size. The card is only ever written a whole sector at a
+//  time, at sector aligned file offsets.
+#define BLOCK_WRITER_BLOCK_SIZE 512
+
+#define BLOCK_WRITER_FLUSH_INTERVAL_MS 1000
+#define BLOCK_WRITER_MAX_AT_RISK BLOCK_WRITER_BLOCK_SIZE
+
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   BlockWriter
+*       Double buffered writer that sits between the log
+*       and the SD card file. write() only copies into RAM.
+*       service(), called from loop(), writes at most one
+*       512 byte block per call so the card never stalls a
+*       task.
+*
+*       A partly filled block is written (zero padded) once
+*       the flush interval has passed or more than
+*       max_at_risk bytes are in RAM. It stays in RAM and
+*       is written again, at the same offset, once it
+*       fills, so the file doesn't gain any padding.
+*
+*       Sink needs write( uint8_t const *, size_t ),
+*       seek( uint32_t ) and flush(), which File and
+*       LogFiles have.
+**********************************************************/
+template< typename Sink >
+class BlockWriter
+{
+public:
+    BlockWriter( Sink & sink );
+
+    void begin();
+    void set_flush_interval( uint32_t interval_ms );
+    void set_max_at_risk( uint16_t max_at_risk );
+    void set_blocking( bool blocking );
+
+    void write( uint8_t const * data, size_t length );
+    void service();
+    void flush();
+    void patch( uint32_t position, uint8_t const * data, size_t length );
+
+    uint16_t space() const;
+    uint16_t at_risk() const;
+    uint32_t max_write_us() const;
+    uint32_t dropped() const;
+
+private:
+    void write_block( uint8_t const * block, uint32_t position );
+
+    Sink & m_sink;
+
+    uint8_t m_blocks[2][BLOCK_WRITER_BLOCK_SIZE];
+    uint8_t m_active;           // Block being filled
+    uint16_t m_fill;            // Bytes in the active block
+    uint16_t m_on_card;         // Bytes of the active block already written
+    bool m_pending;             // The other block is full and not written yet
+    bool m_blocking;            // write() writes blocks itself rather than drop
+
+    uint32_t m_block_pos;       // File offset of the oldest block in RAM
+    uint32_t m_file_pos;        // File offset after the last write
+
+    uint32_t m_flush_interval_ms;
+    uint16_t m_max_at_risk;
+    uint32_t m_last_flush_ms;
+
+    uint32_t m_max_write_us;
+    uint32_t m_dropped;
+};
+
+
+/******************************************************************************
+ *                          Method Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   BlockWriter
+*       Constructor
+**********************************************************/
+template< typename Sink >
+BlockWriter< Sink >::BlockWriter( Sink & sink ) :
+    m_sink( sink ),
+    m_blocking( false ),
+    m_flush_interval_ms( BLOCK_WRITER_FLUSH_INTERVAL_MS ),
+    m_max_at_risk( BLOCK_WRITER_MAX_AT_RISK ),
+    m_max_write_us( 0 )
+{
+    begin();
+}
+
+
+/**********************************************************
+*   begin
+*       Start writing at the beginning of a newly opened
+*       file.
+**********************************************************/
+template< typename Sink >
+void BlockWriter< Sink >::begin()
+{
+    memset( m_blocks, 0, sizeof(m_blocks) );
+    m_active = 0;
+    m_fill = 0;
+    m_on_card = 0;
+    m_pending = false;
+    m_block_pos = 0;
+    m_file_pos = 0;
+    m_last_flush_ms = millis();
+    m_dropped = 0;
+}
+
+
+/**********************************************************
+*   set_flush_interval
+*       Longest time data sits in RAM before it's written.
+**********************************************************/
+template< typename Sink >
+void BlockWriter< Sink >::set_flush_interval( uint32_t interval_ms )
+{
+    m_flush_interval_ms = interval_ms;
+}
+
+
+/**********************************************************
+*   set_max_at_risk
+*       Most bytes allowed in RAM, not yet on the card,
+*       before service() writes a partial block.
+**********************************************************/
+template< typename Sink >
+void BlockWriter< Sink >::set_max_at_risk( uint16_t max_at_risk )
+{
+    m_max_at_risk = max_at_risk;
+}
+
+
+/**********************************************************
+*   set_blocking
+*       While on, write() writes full blocks to the card
+*       itself when it runs out of room instead of
+*       dropping data. For a log's header, which is bigger
+*       than both blocks, never for records.
+**********************************************************/
+template< typename Sink >
+void BlockWriter< Sink >::set_blocking( bool blocking )
+{
+    m_blocking = blocking;
+}
+
+
+/**********************************************************
+*   write
+*       Copy data into the block buffers. If both blocks
+*       are full the data is dropped whole rather than
+*       split.
+**********************************************************/
+template< typename Sink >
+void BlockWriter< Sink >::write( uint8_t const * data, size_t length )
+{
+    if( ( length > this->space() )
+     && ( !m_blocking ) )
+    {
+        m_dropped += length;
+        return;
+    }
+
+    while( length > 0 )
+    {
+        size_t count = BLOCK_WRITER_BLOCK_SIZE - m_fill;
+        if( count > length )
+        {
+            count = length;
+        }
+
+        memcpy( &m_blocks[m_active][m_fill], data, count );
+        m_fill += count;
+        data += count;
+        length -= count;
+
+        // Hand the full block to service() and start the other one.
+        //  Only a blocking write fills it with the other still full.
+        if( m_fill == BLOCK_WRITER_BLOCK_SIZE )
+        {
+            if( m_pending )
+            {
+                write_block( m_blocks[m_active ^ 1], m_block_pos );
+                m_block_pos += BLOCK_WRITER_BLOCK_SIZE;
+            }
+
+            m_pending = true;
+            m_active ^= 1;
+            m_fill = 0;
+            m_on_card = 0;
+            memset( m_blocks[m_active], 0, BLOCK_WRITER_BLOCK_SIZE );
+        }
+    }
+}
+
+
+/**********************************************************
+*   service
+*       Write at most one block to the card. A full block
+*       goes first. Otherwise the partial block is written
+*       if the flush policy says so.
+**********************************************************/
+template< typename Sink >
+void BlockWriter< Sink >::service()
+{
+    uint32_t now = millis();
+    bool interval_up = ( now - m_last_flush_ms ) >= m_flush_interval_ms;
+
+    if( m_pending )
+    {
+        write_block( m_blocks[m_active ^ 1], m_block_pos );
+        m_block_pos += BLOCK_WRITER_BLOCK_SIZE;
+        m_pending = false;
+    }
+    else if( ( m_fill > m_on_card )
+          && ( ( interval_up )
+            || ( m_fill - m_on_card >= m_max_at_risk ) ) )
+    {
+        write_block( m_blocks[m_active], m_block_pos );
+        m_on_card = m_fill;
+    }
+    else if( !interval_up )
+    {
+        return;
+    }
+
+    // Update the directory entry so the data is reachable after a
+    //  power loss.
+    if( interval_up )
+    {
+        uint32_t start = micros();
+        m_sink.flush();
+        uint32_t elapsed = micros() - start;
+
+        m_max_write_us = max( m_max_write_us, elapsed );
+        m_last_flush_ms = now;
+    }
+}
+
+
+/**********************************************************
+*   flush
+*       Write everything in RAM now. Used when closing the
+*       log.
+**********************************************************/
+template< typename Sink >
+void BlockWriter< Sink >::flush()
+{
+    if( m_pending )
+    {
+        write_block( m_blocks[m_active ^ 1], m_block_pos );
+        m_block_pos += BLOCK_WRITER_BLOCK_SIZE;
+        m_pending = false;
+    }
+
+    if( m_fill > m_on_card )
+    {
+        write_block( m_blocks[m_active], m_block_pos );
+        m_on_card = m_fill;
+    }
+
+    m_sink.flush();
+    m_last_flush_ms = millis();
+}
+
+
+/**********************************************************
+*   patch
+*       Write over length bytes already in the file at
+*       position, like the stats in a log's header.
+*       Everything in RAM goes to the card first.
+**********************************************************/
+template< typename Sink >
+void BlockWriter< Sink >::patch( uint32_t position, uint8_t const * data, size_t length )
+{
+    this->flush();
+
+    // The active block is written again when it fills, keep it in step
+    for( size_t i = 0; i < length; i++ )
+    {
+        if( ( position + i >= m_block_pos )
+         && ( position + i < m_block_pos + BLOCK_WRITER_BLOCK_SIZE ) )
+        {
+            m_blocks[m_active][position + i - m_block_pos] = data[i];
+        }
+    }
+
+    m_sink.seek( position );
+    m_sink.write( data, length );
+    m_sink.flush();
+    m_file_pos = position + length;
+}
+
+
+/**********************************************************
+*   space
+*       Most bytes write() takes right now without
+*       dropping them. One short of filling both blocks,
+*       the active one can't fill up while the other is
+*       still waiting for the card.
+**********************************************************/
+template< typename Sink >
+uint16_t BlockWriter< Sink >::space() const
+{
+    return ( m_pending ? 0 : BLOCK_WRITER_BLOCK_SIZE ) + BLOCK_WRITER_BLOCK_SIZE - m_fill - 1;
+}
+
+
+/**********************************************************
+*   at_risk
+*       Bytes in RAM that aren't on the card yet.
+**********************************************************/
+template< typename Sink >
+uint16_t BlockWriter< Sink >::at_risk() const
+{
+    return ( m_pending ? BLOCK_WRITER_BLOCK_SIZE : 0 ) + m_fill - m_on_card;
+}
+
+
+/**********************************************************
+*   max_write_us
+*       Longest a single block write or flush has taken.
+**********************************************************/
+template< typename Sink >
+uint32_t BlockWriter< Sink >::max_write_us() const
+{
+    return m_max_write_us;
+}
+
+
+/**********************************************************
+*   dropped
+*       Bytes thrown away since begin() because both
+*       blocks were full.
+**********************************************************/
+template< typename Sink >
+uint32_t BlockWriter< Sink >::dropped() const
+{
+    return m_dropped;
+}
+
+
+/**********************************************************
+*   write_block
+*       Write one whole block at position, timing it.
+**********************************************************/
+template< typename Sink >
+void BlockWriter< Sink >::write_block( uint8_t const * block, uint32_t position )
+{
+    uint32_t start = micros();
+
+    if( m_file_pos != position )
+    {
+        m_sink.seek( position );
+    }
+
+    m_sink.write( block, BLOCK_WRITER_BLOCK_SIZE );
+    m_file_pos = position + BLOCK_WRITER_BLOCK_SIZE;
+
+    uint32_t elapsed = micros() - start;
+    m_max_write_us = max( m_max_write_us, elapsed );
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef LINK_CAPTURE_H
+#define LINK_CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "bin_log.h"
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// Raw link bytes in one LOG_REC_LINK record. Same as XBEE_READ_CHUNK, so
+//  each chunk Xbee::read takes from the UART is one record.
+#define LINK_CHUNK_SIZE 32
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// Bytes as they came off the radio's UART, before any decoding. time_us
+//  is when they were read. Only the first length bytes of data are used.
+typedef struct __attribute__((packed))
+{
+    uint32_t time_us;
+    uint8_t length;
+    uint8_t data[LINK_CHUNK_SIZE];
+} link_chunk_t;
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   link_capture
+*       Log raw link bytes as LOG_REC_LINK records, split
+*       into LINK_CHUNK_SIZE pieces.
+**********************************************************/
+template< typename Log >
+void link_capture( Log & log, uint32_t time_us, uint8_t const * data, size_t length )
+{
+    link_chunk_t chunk;
+
+    chunk.time_us = time_us;
+    while( length > 0 )
+    {
+        chunk.length = ( length < LINK_CHUNK_SIZE ) ? length : LINK_CHUNK_SIZE;
+        memcpy( chunk.data, data, chunk.length );
+        memset( &chunk.data[chunk.length], 0, LINK_CHUNK_SIZE - chunk.length );
+
+        log.write( LOG_REC_LINK, &chunk, sizeof(chunk), time_us / 1000 );
+        data += chunk.length;
+        length -= chunk.length;
+    }
+}
+
+#endif
@@ -0,0 +1,540 @@
+#include "log_downlink.h"
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+
+static_assert( sizeof(data_type_t) + sizeof(log_dl_data_hdr_t) + LOG_DL_CHUNK <= MAX_DATA_LENGTH, "DATA frame is bigger than MAX_DATA_LENGTH" );
+static_assert( LOG_DL_MAX_WINDOW <= 32, "ACK maps are 32 bits" );
+static_assert( LOG_DL_WINDOW <= LOG_DL_MAX_WINDOW, "window is more than an ACK covers" );
+static_assert( LOG_DL_LIST_MAX >= 1, "a file has to fit in a LIST reply" );
+static_assert( LOG_DL_CHUNK <= UINT8_MAX, "chunk lengths are 8 bits" );
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   log_dl_dir
+*       Month and day from a log directory's name,
+*       "<month>_<day>". False for anything else.
+**********************************************************/
+static bool log_dl_dir( char const * name, uint8_t & month, uint8_t & day )
+{
+    unsigned m;
+    unsigned d;
+    int end = 0;
+
+    if( ( sscanf( name, "%u_%u%n", &m, &d, &end ) != 2 )
+     || ( name[end] != '\0' )
+     || ( m > 12 )
+     || ( d > 31 ) )
+    {
+        return false;
+    }
+
+    month = m;
+    day = d;
+
+    return true;
+}
+
+
+/**********************************************************
+*   log_dl_num
+*       Number from a log file's name, "log_<num>.bin".
+*       False for anything else.
+**********************************************************/
+static bool log_dl_num( char const * name, uint16_t & num )
+{
+    unsigned n;
+    int end = 0;
+
+    if( ( sscanf( name, "log_%u.bin%n", &n, &end ) != 1 )
+     || ( end == 0 )
+     || ( name[end] != '\0' )
+     || ( n > UINT16_MAX ) )
+    {
+        return false;
+    }
+
+    num = n;
+
+    return true;
+}
+
+
+/******************************************************************************
+ *                           LogDownlink Methods
+ *****************************************************************************/
+
+LogDownlink::LogDownlink( Xbee *xbee ) :
+    m_xbee( xbee )
+{
+    memset( &m_get, 0, sizeof(m_get) );
+    memset( &m_done, 0, sizeof(m_done) );
+    memset( &m_index, 0, sizeof(m_index) );
+}
+
+
+/**********************************************************
+*   frame_received
+*       LOG_DOWNLINK frame handler. ACKs and ABORT are
+*       acted on now, LIST and GET in service().
+**********************************************************/
+void LogDownlink::frame_received( uint8_t const * data, uint16_t size )
+{
+    if( size < sizeof(log_dl_op_t) )
+    {
+        return;
+    }
+
+    switch( data[0] )
+    {
+        case LOG_DL_LIST:
+            if( size >= sizeof(log_dl_list_req_t) )
+            {
+                log_dl_list_req_t req;
+
+                memcpy( &req, data, sizeof(req) );
+                m_list_start = req.start;
+                m_list_pending = true;
+            }
+            break;
+
+        case LOG_DL_GET:
+            if( size >= sizeof(log_dl_get_t) )
+            {
+                memcpy( &m_get, data, sizeof(m_get) );
+                m_get_pending = true;
+            }
+            break;
+
+        case LOG_DL_ACK:
+            if( size >= sizeof(log_dl_ack_t) )
+            {
+                log_dl_ack_t ack;
+
+                memcpy( &ack, data, sizeof(ack) );
+                this->ack( ack );
+            }
+            break;
+
+        case LOG_DL_ABORT:
+            this->abort();
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**********************************************************
+*   service
+*       Answer a LIST or start a GET that came in, then
+*       send one chunk if the radio's queue is empty: the
+*       lowest one an ACK showed was skipped or that's
+*       timed out, else the next new one if the window has
+*       room. Sends DONE once every chunk is acked.
+**********************************************************/
+void LogDownlink::service( uint32_t now_ms )
+{
+    if( m_list_pending )
+    {
+        m_list_pending = false;
+        this->list( m_list_start );
+    }
+
+    if( m_get_pending )
+    {
+        m_get_pending = false;
+        this->start( now_ms );
+    }
+
+    if( m_heard )
+    {
+        m_heard = false;
+        m_heard_ms = now_ms;
+    }
+
+    if( ( m_active )
+     && ( m_base >= this->chunk_cnt() ) )
+    {
+        this->finish( LOG_DL_STS_OK );
+    }
+
+    if( m_done_pending )
+    {
+        m_done_pending = !m_xbee->send_data( LOG_DOWNLINK, (uint8_t const *)&m_done, sizeof(m_done) );
+        return;
+    }
+
+    if( !m_active )
+    {
+        return;
+    }
+
+    if( now_ms - m_heard_ms >= LOG_DL_GIVE_UP_MS )
+    {
+        this->abort();
+        return;
+    }
+
+    if( !m_xbee->tx_idle() )
+    {
+        return;
+    }
+
+    for( uint32_t seq = m_base; seq < m_next; seq++ )
+    {
+        uint8_t slot = seq % LOG_DL_MAX_WINDOW;
+
+        if( ( !( m_acked & ( 1UL << slot ) ) )
+         && ( ( m_resend & ( 1UL << slot ) )
+           || ( now_ms - m_sent_ms[slot] >= LOG_DL_RTO_MS ) ) )
+        {
+            this->send_chunk( seq, now_ms );
+            return;
+        }
+    }
+
+    if( ( m_next < this->chunk_cnt() )
+     && ( m_next < m_base + m_window ) )
+    {
+        this->send_chunk( m_next, now_ms );
+    }
+}
+
+
+/**********************************************************
+*   abort
+*       Drop the transfer and anything asked for, without
+*       a DONE.
+**********************************************************/
+void LogDownlink::abort()
+{
+    m_file.close();
+    m_active = false;
+    m_list_pending = false;
+    m_get_pending = false;
+    m_done_pending = false;
+}
+
+
+/**********************************************************
+*   busy
+*       True while there's anything for service() to do.
+**********************************************************/
+bool LogDownlink::busy() const
+{
+    return ( m_active )
+        || ( m_list_pending )
+        || ( m_get_pending )
+        || ( m_done_pending );
+}
+
+
+uint32_t LogDownlink::chunks_sent() const
+{
+    return m_sent;
+}
+
+
+uint32_t LogDownlink::chunks_resent() const
+{
+    return m_resent;
+}
+
+
+/**********************************************************
+*   list
+*       Send one LIST reply, the files from the start'th
+*       on, walking each log directory in the root.
+**********************************************************/
+void LogDownlink::list( uint16_t start )
+{
+    uint8_t frame[ MAX_DATA_LENGTH - sizeof(data_type_t) ];
+    log_dl_list_hdr_t hdr;
+    log_dl_entry_t entry;
+    char name[ LOG_FILES_DIR_LEN ];
+    uint16_t index = 0;
+    File root;
+    File dir;
+    File file;
+
+    hdr.op = LOG_DL_LIST;
+    hdr.start = start;
+    hdr.count = 0;
+    hdr.more = 0;
+
+    if( root.open( "/", O_READ ) )
+    {
+        while( ( !hdr.more )
+            && ( dir.openNext( &root, O_READ ) ) )
+        {
+            if( ( !dir.isDir() )
+             || ( !dir.getName( name, sizeof(name) ) )
+             || ( !log_dl_dir( name, entry.month, entry.day ) ) )
+            {
+                continue;
+            }
+
+            this->load_index( name );
+
+            while( file.openNext( &dir, O_READ ) )
+            {
+                if( ( !this->log_entry( file, entry ) )
+                 || ( index++ < start ) )
+                {
+                    continue;
+                }
+
+                if( hdr.count == LOG_DL_LIST_MAX )
+                {
+                    hdr.more = 1;
+                    break;
+                }
+
+                memcpy( &frame[ sizeof(hdr) + hdr.count * sizeof(entry) ], &entry, sizeof(entry) );
+                hdr.count++;
+            }
+        }
+    }
+
+    file.close();
+    dir.close();
+    root.close();
+
+    memcpy( frame, &hdr, sizeof(hdr) );
+    m_xbee->send_data( LOG_DOWNLINK, frame, sizeof(hdr) + hdr.count * sizeof(entry) );
+}
+
+
+/**********************************************************
+*   start
+*       Start the GET that came in, from its offset
+*       rounded down to a chunk. One for the file that's
+*       being sent already, the ground resuming, starts
+*       over from there too.
+**********************************************************/
+void LogDownlink::start( uint32_t now_ms )
+{
+    char path[ LOG_FILES_PATH_LEN ];
+
+    this->abort();
+
+    m_xfer = m_get.xfer;
+    m_end = 0;
+    m_base = 0;
+
+    snprintf( path, sizeof(path), "/%u_%u/log_%u.bin", m_get.file.month, m_get.file.day, m_get.file.num );
+    if( !m_file.open( path, O_READ ) )
+    {
+        this->finish( LOG_DL_STS_NO_FILE );
+        return;
+    }
+
+    uint32_t length = m_get.file.length;
+    uint32_t offset = m_get.offset;
+    uint8_t window = m_get.window;
+
+    m_end = min( length, m_file.fileSize() );
+    m_base = min( offset, m_end ) / LOG_DL_CHUNK;
+    m_next = m_base;
+    m_window = min( max( window, (uint8_t)1 ), (uint8_t)LOG_DL_MAX_WINDOW );
+    m_acked = 0;
+    m_resend = 0;
+    m_order = 0;
+    m_newest_acked = 0;
+    m_heard_ms = now_ms;
+    m_active = true;
+}
+
+
+/**********************************************************
+*   ack
+*       Mark the chunks an ACK has, and move the window
+*       past the ones in order. Any still missing that
+*       were sent before the latest one acked were skipped
+*       by the link, and go again first.
+**********************************************************/
+void LogDownlink::ack( log_dl_ack_t const & ack )
+{
+    if( ( !m_active )
+     || ( ack.xfer != m_xfer ) )
+    {
+        return;
+    }
+
+    m_heard = true;
+
+    for( uint32_t seq = m_base; seq < m_next; seq++ )
+    {
+        uint8_t slot = seq % LOG_DL_MAX_WINDOW;
+        uint32_t bit = seq - ack.base - 1;
+
+        if( ( seq < ack.base )
+         || ( ( seq > ack.base )
+           && ( bit < 32 )
+           && ( ack.map & ( 1UL << bit ) ) ) )
+        {
+            m_acked |= 1UL << slot;
+            m_newest_acked = max( m_newest_acked, m_sent_order[slot] );
+        }
+    }
+
+    while( ( m_base < m_next )
+        && ( m_acked & ( 1UL << ( m_base % LOG_DL_MAX_WINDOW ) ) ) )
+    {
+        m_acked &= ~( 1UL << ( m_base % LOG_DL_MAX_WINDOW ) );
+        m_resend &= ~( 1UL << ( m_base % LOG_DL_MAX_WINDOW ) );
+        m_base++;
+    }
+
+    for( uint32_t seq = m_base; seq < m_next; seq++ )
+    {
+        uint8_t slot = seq % LOG_DL_MAX_WINDOW;
+
+        if( ( !( m_acked & ( 1UL << slot ) ) )
+         && ( m_sent_order[slot] < m_newest_acked ) )
+        {
+            m_resend |= 1UL << slot;
+        }
+    }
+}
+
+
+/**********************************************************
+*   send_chunk
+*       Read chunk seq from the card and send it. False
+*       if the radio's queue was full. A read that fails
+*       ends the transfer.
+**********************************************************/
+bool LogDownlink::send_chunk( uint32_t seq, uint32_t now_ms )
+{
+    log_dl_data_hdr_t hdr;
+    uint32_t offset = seq * LOG_DL_CHUNK;
+    uint16_t length = min( (uint32_t)LOG_DL_CHUNK, m_end - offset );
+    uint8_t slot = seq % LOG_DL_MAX_WINDOW;
+
+    hdr.op = LOG_DL_DATA;
+    hdr.xfer = m_xfer;
+    hdr.seq = seq;
+    memcpy( m_frame, &hdr, sizeof(hdr) );
+
+    if( ( !m_file.seek( offset ) )
+     || ( m_file.read( &m_frame[ sizeof(hdr) ], length ) != length ) )
+    {
+        this->finish( LOG_DL_STS_READ_ERR );
+        return false;
+    }
+
+    if( !m_xbee->send_data( LOG_DOWNLINK, m_frame, sizeof(hdr) + length ) )
+    {
+        return false;
+    }
+
+    m_sent_ms[slot] = now_ms;
+    m_sent_order[slot] = ++m_order;
+    m_resend &= ~( 1UL << slot );
+    m_sent++;
+
+    if( seq == m_next )
+    {
+        m_next++;
+    }
+    else
+    {
+        m_resent++;
+    }
+
+    return true;
+}
+
+
+/**********************************************************
+*   finish
+*       End the transfer and queue its DONE.
+**********************************************************/
+void LogDownlink::finish( log_dl_sts_t sts )
+{
+    m_file.close();
+    m_active = false;
+
+    m_done.op = LOG_DL_DONE;
+    m_done.xfer = m_xfer;
+    m_done.sts = sts;
+    m_done.length = m_end;
+    m_done_pending = true;
+}
+
+
+/**********************************************************
+*   log_entry
+*       Fill in entry's number and length if file is a
+*       log. Its length is the index's if the index has
+*       it, else the file's size. False if it isn't a log,
+*       or is one LogFiles has ready and nothing's been
+*       written to yet.
+**********************************************************/
+bool LogDownlink::log_entry( File & file, log_dl_entry_t & entry )
+{
+    char name[ LOG_FILES_DIR_LEN ];
+    uint16_t num;
+
+    if( ( file.isDir() )
+     || ( !file.getName( name, sizeof(name) ) )
+     || ( !log_dl_num( name, num ) ) )
+    {
+        return false;
+    }
+
+    entry.num = num;
+    entry.length = file.fileSize();
+
+    for( uint8_t i = 0; i < m_index.hdr.entry_cnt; i++ )
+    {
+        if( m_index.entries[i].num == entry.num )
+        {
+            if( m_index.entries[i].state == LOG_FILE_READY )
+            {
+                return false;
+            }
+            entry.length = min( entry.length, (uint32_t)m_index.entries[i].length );
+        }
+    }
+
+    return entry.length > 0;
+}
+
+
+/**********************************************************
+*   load_index
+*       Read dir's index.bin, or clear m_index if it has
+*       none.
+**********************************************************/
+void LogDownlink::load_index( char const * dir )
+{
+    char path[ LOG_FILES_PATH_LEN ];
+    File file;
+
+    snprintf( path, sizeof(path), "/%s/index.bin", dir );
+
+    if( ( !file.open( path, O_READ ) )
+     || ( file.read( &m_index, sizeof(m_index) ) != (int)sizeof(m_index) )
+     || ( m_index.hdr.magic != LOG_INDEX_MAGIC )
+     || ( m_index.hdr.entry_cnt > LOG_INDEX_ENTRIES ) )
+    {
+        memset( &m_index, 0, sizeof(m_index) );
+    }
+
+    file.close();
+}
+
+
+uint32_t LogDownlink::chunk_cnt() const
+{
+    return ( m_end + LOG_DL_CHUNK - 1 ) / LOG_DL_CHUNK;
+}
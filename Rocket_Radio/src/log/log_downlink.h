@@ -0,0 +1,224 @@
+#ifndef LOG_DOWNLINK_H
+#define LOG_DOWNLINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <SdFat.h>
+
+#include "log_files.h"
+#include "../xbee/xbee.h"
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// Bytes of log in one DATA frame. With the data type and DATA header
+//  it fits a MAX_DATA_LENGTH frame, one RF packet unless escaping
+//  pushes its tail into a second.
+#define LOG_DL_CHUNK 240
+
+// Most chunks sent and not yet acked. Also the chunks an ACK's map
+//  covers past its base.
+#define LOG_DL_MAX_WINDOW 32
+
+// Window the client asks for. At 9600 baud a chunk is a quarter second
+//  on the wire, chunks are ACKed 4 at a time and the ACK takes a couple
+//  more chunks to come back, so 16 keeps the link full with room for a
+//  few to be lost.
+#define LOG_DL_WINDOW 16
+
+// A chunk that's gone this long without an ACK is sent again. One a
+//  later ACK shows was skipped goes again straight away.
+#define LOG_DL_RTO_MS 3000
+
+// The rocket drops a transfer nothing has been acked in for this long,
+//  so it doesn't send to a ground station that's gone away.
+#define LOG_DL_GIVE_UP_MS 30000
+
+// Files in one LIST reply.
+#define LOG_DL_LIST_MAX ( ( MAX_DATA_LENGTH - sizeof(data_type_t) - sizeof(log_dl_list_hdr_t) ) / sizeof(log_dl_entry_t) )
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// First byte of a LOG_DOWNLINK frame. LIST goes both ways, GET, ACK
+//  and ABORT only up and DATA and DONE only down.
+typedef uint8_t log_dl_op_t;
+enum
+{
+    LOG_DL_LIST     = 0,    // Files from start on, and the reply with them
+    LOG_DL_GET      = 1,    // Send a file from an offset
+    LOG_DL_DATA     = 2,    // One chunk of it
+    LOG_DL_ACK      = 3,    // Chunks the ground has
+    LOG_DL_DONE     = 4,    // Every chunk is acked, or the file can't be sent
+    LOG_DL_ABORT    = 5,    // Stop sending
+};
+
+// How a transfer ended, in DONE.
+typedef uint8_t log_dl_sts_t;
+enum
+{
+    LOG_DL_STS_OK       = 0,
+    LOG_DL_STS_NO_FILE  = 1,
+    LOG_DL_STS_READ_ERR = 2,
+};
+
+// A log file, /<month>_<day>/log_<num>.bin, and its bytes of log.
+typedef struct __attribute__((packed))
+{
+    uint8_t month;
+    uint8_t day;
+    uint16_t num;
+    uint32_t length;
+} log_dl_entry_t;
+
+// LIST request.
+typedef struct __attribute__((packed))
+{
+    log_dl_op_t op;
+    uint16_t start;
+} log_dl_list_req_t;
+
+// LIST reply, followed by count entries. more is set if there are
+//  files past them.
+typedef struct __attribute__((packed))
+{
+    log_dl_op_t op;
+    uint16_t start;
+    uint8_t count;
+    uint8_t more;
+} log_dl_list_hdr_t;
+
+// GET. Sends file from offset, rounded down to a chunk, up to its
+//  length or the end of the file if that's sooner, window chunks in
+//  flight at most. xfer tags the transfer's DATA and DONE frames and
+//  its ACKs, so nothing still in flight from the last is taken for it.
+typedef struct __attribute__((packed))
+{
+    log_dl_op_t op;
+    uint8_t xfer;
+    log_dl_entry_t file;
+    uint32_t offset;
+    uint8_t window;
+} log_dl_get_t;
+
+// DATA, followed by the chunk's bytes, the file's from seq * LOG_DL_CHUNK.
+//  Only the last chunk is short.
+typedef struct __attribute__((packed))
+{
+    log_dl_op_t op;
+    uint8_t xfer;
+    uint32_t seq;
+} log_dl_data_hdr_t;
+
+// ACK. The ground has every chunk before base, and chunk base + 1 + i
+//  if bit i of map is set.
+typedef struct __attribute__((packed))
+{
+    log_dl_op_t op;
+    uint8_t xfer;
+    uint32_t base;
+    uint32_t map;
+} log_dl_ack_t;
+
+// DONE. length is where the transfer ended, the file's end if it was
+//  shorter than asked for.
+typedef struct __attribute__((packed))
+{
+    log_dl_op_t op;
+    uint8_t xfer;
+    log_dl_sts_t sts;
+    uint32_t length;
+} log_dl_done_t;
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   LogDownlink
+*       Sends the SD logs to the ground over the radio,
+*       for after landing, so the card doesn't have to be
+*       got out of the rocket. LIST names every used
+*       log_<num>.bin in the /<month>_<day> directories
+*       with its length, from the directory's index.bin
+*       where it's there. Ready files LogFiles made ahead
+*       aren't logs yet and are left out.
+*
+*       GET sends a file as numbered chunks with selective
+*       repeat. Up to a window of them go out without
+*       waiting, ACKs say which came, and only the ones
+*       that didn't are sent again, when an ACK for later
+*       chunks shows they were skipped or after
+*       LOG_DL_RTO_MS. Nothing is buffered, a chunk is
+*       read from the card each time it's sent. A chunk is
+*       only given to the radio once its transmit queue is
+*       empty, so telemetry still gets through.
+*
+*       frame_received() only notes LIST and GET, the card
+*       is read in service(), which the caller runs while
+*       not logging, with the SPI bus held.
+**********************************************************/
+class LogDownlink
+{
+public:
+    LogDownlink( Xbee *xbee );
+
+    void frame_received( uint8_t const * data, uint16_t size );
+    void service( uint32_t now_ms );
+    void abort();
+    bool busy() const;
+
+    uint32_t chunks_sent() const;
+    uint32_t chunks_resent() const;
+
+private:
+    void list( uint16_t start );
+    void start( uint32_t now_ms );
+    void ack( log_dl_ack_t const & ack );
+    bool send_chunk( uint32_t seq, uint32_t now_ms );
+    void finish( log_dl_sts_t sts );
+    bool log_entry( File & file, log_dl_entry_t & entry );
+    void load_index( char const * dir );
+    uint32_t chunk_cnt() const;
+
+    Xbee *m_xbee;
+
+    // Requests frame_received() took, for service()
+    bool m_list_pending = false;
+    uint16_t m_list_start = 0;
+    bool m_get_pending = false;
+    log_dl_get_t m_get;
+    bool m_heard = false;           // An ACK came since the last service()
+
+    // The transfer. Chunks m_base to m_next - 1 are in flight, each
+    //  one's send time, send order and flags kept in slot
+    //  seq % LOG_DL_MAX_WINDOW.
+    File m_file;
+    bool m_active = false;
+    uint8_t m_xfer = 0;
+    uint32_t m_end = 0;
+    uint32_t m_base = 0;
+    uint32_t m_next = 0;
+    uint8_t m_window = LOG_DL_WINDOW;
+    uint32_t m_sent_ms[LOG_DL_MAX_WINDOW];
+    uint32_t m_sent_order[LOG_DL_MAX_WINDOW];
+    uint32_t m_acked = 0;           // By slot
+    uint32_t m_resend = 0;          // By slot, skipped by a later ACK
+    uint32_t m_order = 0;           // Sends so far
+    uint32_t m_newest_acked = 0;    // Latest send order acked
+    uint32_t m_heard_ms = 0;
+
+    bool m_done_pending = false;
+    log_dl_done_t m_done;
+
+    uint32_t m_sent = 0;
+    uint32_t m_resent = 0;
+
+    uint8_t m_frame[ sizeof(log_dl_data_hdr_t) + LOG_DL_CHUNK ];
+    log_index_t m_index;            // Of the directory being listed
+};
+
+#endif
@@ -0,0 +1,511 @@
+#include "log_files.h"
+#include "bin_log.h"
+
+#include <Arduino.h>
+#include <stdio.h>
+#include <string.h>
+
+static_assert( sizeof(log_index_t) <= 512, "index doesn't fit in a block" );
+
+
+/**********************************************************
+*   LogFiles
+*       Constructor. Files are file_blocks long, and
+*       prepare() keeps spares of them ready on top of the
+*       one to be written next.
+**********************************************************/
+LogFiles::LogFiles( SdFat & sd, uint32_t file_blocks, uint8_t spares ) :
+    m_sd( sd ),
+    m_file_blocks( file_blocks ),
+    m_spares( spares ),
+    m_index_block( 0 ),
+    m_open( NULL ),
+    m_pos( 0 ),
+    m_end( 0 )
+{
+    m_dir[0] = '\0';
+    memset( &m_index, 0, sizeof(m_index) );
+}
+
+
+/**********************************************************
+*   prepare
+*       Get the files the next log needs ready in dir. The
+*       FAT and erase work is all here, which can take a
+*       good fraction of a second, so it's for the pad and
+*       not while logging. Does nothing if they're ready
+*       already. If dir changed, the ready files in the
+*       last one are removed. Returns false if not even
+*       one file could be made ready.
+**********************************************************/
+bool LogFiles::prepare( char const * dir )
+{
+    if( m_open )
+    {
+        return false;
+    }
+
+    if( ( strcmp( dir, m_dir ) == 0 )
+     && ( this->ready_cnt() > m_spares ) )
+    {
+        return true;
+    }
+
+    if( strcmp( dir, m_dir ) != 0 )
+    {
+        if( m_dir[0] != '\0' )
+        {
+            this->forget_ready();
+            this->save();
+        }
+
+        if( !this->load( dir ) )
+        {
+            m_dir[0] = '\0';
+            return false;
+        }
+    }
+
+    while( ( this->ready_cnt() <= m_spares )
+        && ( this->add_file() ) )
+    {
+    }
+
+    return ( this->save() )
+        && ( this->ready_cnt() > 0 );
+}
+
+
+/**********************************************************
+*   open
+*       Take the oldest ready file to write. Nothing is
+*       written to the card. False if none are ready.
+**********************************************************/
+bool LogFiles::open()
+{
+    if( m_open )
+    {
+        return false;
+    }
+
+    for( uint8_t i = 0; i < m_index.hdr.entry_cnt; i++ )
+    {
+        log_index_ent_t & entry = m_index.entries[i];
+
+        if( entry.state == LOG_FILE_READY )
+        {
+            entry.state = LOG_FILE_USED;
+            entry.length = 0;
+            m_open = &entry;
+            m_pos = 0;
+            m_end = 0;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**********************************************************
+*   close
+*       Done with the open file. Closing to rotate to the
+*       next file only notes its length in RAM. The last
+*       close cuts the file down to what was written and
+*       saves the index, both FAT or index writes, for
+*       once the flight's over.
+**********************************************************/
+void LogFiles::close( bool last )
+{
+    if( !m_open )
+    {
+        return;
+    }
+
+    m_open->length = m_end;
+
+    if( last )
+    {
+        char path[ LOG_FILES_PATH_LEN ];
+        File file;
+
+        this->file_path( path, m_open->num );
+        if( file.open( path, O_RDWR ) )
+        {
+            file.truncate( m_end );
+            file.close();
+        }
+    }
+
+    m_open = NULL;
+
+    if( last )
+    {
+        this->save();
+    }
+}
+
+
+bool LogFiles::is_open() const
+{
+    return m_open != NULL;
+}
+
+
+/**********************************************************
+*   full
+*       True once the open file is within
+*       LOG_FILES_MARGIN of its end, time to rotate.
+**********************************************************/
+bool LogFiles::full() const
+{
+    return ( m_open )
+        && ( m_end + LOG_FILES_MARGIN >= m_open->blocks * 512 );
+}
+
+
+/**********************************************************
+*   number
+*       Number of the open file, log_<number>.bin. 0 if
+*       none is.
+**********************************************************/
+uint16_t LogFiles::number() const
+{
+    return m_open ? m_open->num : 0;
+}
+
+
+/**********************************************************
+*   write
+*       Write at the current position, straight to the
+*       file's blocks on the card. Whole aligned blocks,
+*       all BlockWriter writes, are one block write each.
+*       Anything else, like the stats patched into a log's
+*       header, is read, changed and written back. Stops
+*       at the end of the file. Returns bytes written.
+**********************************************************/
+size_t LogFiles::write( uint8_t const * data, size_t length )
+{
+    size_t done = 0;
+
+    if( !m_open )
+    {
+        return 0;
+    }
+
+    uint32_t size = m_open->blocks * 512;
+    if( m_pos >= size )
+    {
+        return 0;
+    }
+    length = min( length, (size_t)( size - m_pos ) );
+
+    while( done < length )
+    {
+        uint32_t block = m_open->first_block + m_pos / 512;
+        uint16_t offset = m_pos % 512;
+        size_t count = min( length - done, (size_t)( 512 - offset ) );
+        bool ok;
+
+        if( count == 512 )
+        {
+            ok = m_sd.card()->writeBlock( block, &data[done] );
+        }
+        else
+        {
+            ok = m_sd.card()->readBlock( block, m_scratch );
+            memcpy( &m_scratch[offset], &data[done], count );
+            ok = ok && m_sd.card()->writeBlock( block, m_scratch );
+        }
+
+        if( !ok )
+        {
+            break;
+        }
+
+        done += count;
+        m_pos += count;
+    }
+
+    m_end = max( m_end, m_pos );
+
+    return done;
+}
+
+
+bool LogFiles::seek( uint32_t position )
+{
+    if( ( !m_open )
+     || ( position > m_open->blocks * 512 ) )
+    {
+        return false;
+    }
+
+    m_pos = position;
+
+    return true;
+}
+
+
+/**********************************************************
+*   flush
+*       Nothing to do. The file's size was set when it was
+*       made, so there's no directory entry to keep up.
+**********************************************************/
+void LogFiles::flush()
+{
+}
+
+
+/**********************************************************
+*   load
+*       Read dir's index, making the directory and a new
+*       index if need be. Ready files that were written
+*       before a power loss are marked used.
+**********************************************************/
+bool LogFiles::load( char const * dir )
+{
+    char path[ LOG_FILES_PATH_LEN ];
+    File file;
+    uint32_t last_block;
+    bool ok;
+
+    if( strlen( dir ) >= sizeof(m_dir) )
+    {
+        return false;
+    }
+    strcpy( m_dir, dir );
+
+    if( ( !m_sd.exists( dir ) )
+     && ( !m_sd.mkdir( dir ) ) )
+    {
+        return false;
+    }
+
+    snprintf( path, sizeof(path), "%s/index.bin", dir );
+
+    if( m_sd.exists( path ) )
+    {
+        ok = ( file.open( path, O_READ ) )
+          && ( file.contiguousRange( &m_index_block, &last_block ) )
+          && ( m_sd.card()->readBlock( m_index_block, m_scratch ) );
+        file.close();
+
+        if( !ok )
+        {
+            return false;
+        }
+        memcpy( &m_index, m_scratch, sizeof(m_index) );
+    }
+    else
+    {
+        ok = ( file.createContiguous( path, 512 ) )
+          && ( file.contiguousRange( &m_index_block, &last_block ) );
+        file.close();
+
+        if( !ok )
+        {
+            return false;
+        }
+        m_index.hdr.magic = 0;
+    }
+
+    if( ( m_index.hdr.magic != LOG_INDEX_MAGIC )
+     || ( m_index.hdr.entry_cnt > LOG_INDEX_ENTRIES ) )
+    {
+        memset( &m_index, 0, sizeof(m_index) );
+        m_index.hdr.magic = LOG_INDEX_MAGIC;
+        m_index.hdr.next_num = 1;
+    }
+
+    for( uint8_t i = 0; i < m_index.hdr.entry_cnt; i++ )
+    {
+        log_index_ent_t & entry = m_index.entries[i];
+
+        if( ( entry.state == LOG_FILE_READY )
+         && ( this->written( entry ) ) )
+        {
+            entry.state = LOG_FILE_USED;
+            entry.length = entry.blocks * 512;
+        }
+    }
+
+    return true;
+}
+
+
+/**********************************************************
+*   save
+*       Write the index, one block.
+**********************************************************/
+bool LogFiles::save()
+{
+    if( m_dir[0] == '\0' )
+    {
+        return false;
+    }
+
+    memset( m_scratch, 0, sizeof(m_scratch) );
+    memcpy( m_scratch, &m_index, sizeof(m_index) );
+
+    return m_sd.card()->writeBlock( m_index_block, m_scratch );
+}
+
+
+/**********************************************************
+*   add_file
+*       Make the next numbered file contiguous, erase it
+*       and add it to the index as ready. Numbers already
+*       taken, by logs from before the index, are skipped.
+*       A full index forgets its oldest used file, which
+*       stays on the card.
+**********************************************************/
+bool LogFiles::add_file()
+{
+    char path[ LOG_FILES_PATH_LEN ];
+    File file;
+    uint32_t first_block;
+    uint32_t last_block;
+    uint16_t num = m_index.hdr.next_num;
+
+    if( m_index.hdr.entry_cnt >= LOG_INDEX_ENTRIES )
+    {
+        uint8_t i = 0;
+
+        while( ( i < m_index.hdr.entry_cnt )
+            && ( m_index.entries[i].state != LOG_FILE_USED ) )
+        {
+            i++;
+        }
+
+        if( !this->drop_entry( i ) )
+        {
+            return false;
+        }
+    }
+
+    for( ;; )
+    {
+        this->file_path( path, num );
+        if( !m_sd.exists( path ) )
+        {
+            break;
+        }
+        num++;
+    }
+
+    if( !file.createContiguous( path, m_file_blocks * 512 ) )
+    {
+        return false;
+    }
+
+    bool ok = ( file.contiguousRange( &first_block, &last_block ) )
+           && ( m_sd.card()->erase( first_block, last_block ) );
+    file.close();
+
+    if( !ok )
+    {
+        m_sd.remove( path );
+        return false;
+    }
+
+    log_index_ent_t & entry = m_index.entries[ m_index.hdr.entry_cnt++ ];
+
+    entry.num = num;
+    entry.state = LOG_FILE_READY;
+    entry.reserved = 0;
+    entry.first_block = first_block;
+    entry.blocks = m_file_blocks;
+    entry.length = 0;
+    m_index.hdr.next_num = num + 1;
+
+    return true;
+}
+
+
+/**********************************************************
+*   drop_entry
+*       Take entry index out of the index, closing the
+*       gap. False if there's no such entry.
+**********************************************************/
+bool LogFiles::drop_entry( uint8_t index )
+{
+    if( index >= m_index.hdr.entry_cnt )
+    {
+        return false;
+    }
+
+    memmove( &m_index.entries[index],
+             &m_index.entries[index + 1],
+             ( m_index.hdr.entry_cnt - index - 1 ) * sizeof(log_index_ent_t) );
+    m_index.hdr.entry_cnt--;
+
+    return true;
+}
+
+
+/**********************************************************
+*   forget_ready
+*       Remove the ready files, for when the logs are
+*       going to another directory.
+**********************************************************/
+void LogFiles::forget_ready()
+{
+    char path[ LOG_FILES_PATH_LEN ];
+    uint8_t i = 0;
+
+    while( i < m_index.hdr.entry_cnt )
+    {
+        if( m_index.entries[i].state == LOG_FILE_READY )
+        {
+            this->file_path( path, m_index.entries[i].num );
+            m_sd.remove( path );
+            this->drop_entry( i );
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+
+/**********************************************************
+*   written
+*       True if the entry's first block holds a log
+*       header.
+**********************************************************/
+bool LogFiles::written( log_index_ent_t const & entry )
+{
+    uint32_t magic;
+
+    if( !m_sd.card()->readBlock( entry.first_block, m_scratch ) )
+    {
+        return false;
+    }
+    memcpy( &magic, m_scratch, sizeof(magic) );
+
+    return magic == BIN_LOG_MAGIC;
+}
+
+
+uint8_t LogFiles::ready_cnt() const
+{
+    uint8_t count = 0;
+
+    for( uint8_t i = 0; i < m_index.hdr.entry_cnt; i++ )
+    {
+        if( m_index.entries[i].state == LOG_FILE_READY )
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+
+void LogFiles::file_path( char * path, uint16_t num ) const
+{
+    snprintf( path, LOG_FILES_PATH_LEN, "%s/log_%u.bin", m_dir, (unsigned)num );
+}
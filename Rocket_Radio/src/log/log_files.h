@@ -0,0 +1,135 @@
+#ifndef LOG_FILES_H
+#define LOG_FILES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <SdFat.h>
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// First four bytes of an index file, "RIDX" read as little endian.
+#define LOG_INDEX_MAGIC 0x58444952
+
+// Entries that fit in the index's one block.
+#define LOG_INDEX_ENTRIES 31
+
+// Longest directory LogFiles is given, and path it makes from one,
+//  "/12_31/log_65535.bin".
+#define LOG_FILES_DIR_LEN 16
+#define LOG_FILES_PATH_LEN ( LOG_FILES_DIR_LEN + 16 )
+
+// A file counts as full this close to its end. Room for the two blocks
+//  a BlockWriter holds and the partial one it writes again.
+#define LOG_FILES_MARGIN 2048
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// Where a log file is in its life.
+typedef uint8_t log_file_state_t;
+enum
+{
+    LOG_FILE_READY  = 0,    // Allocated and erased, nothing in it yet
+    LOG_FILE_USED   = 1,    // Holds a log
+};
+
+// Index file header, followed by entry_cnt entries.
+typedef struct __attribute__((packed))
+{
+    uint32_t magic;
+    uint16_t next_num;      // Number the next file made gets
+    uint8_t entry_cnt;
+    uint8_t reserved;
+} log_index_hdr_t;
+
+// One log file. Its blocks on the card run first_block on for blocks.
+typedef struct __attribute__((packed))
+{
+    uint16_t num;           // log_<num>.bin
+    log_file_state_t state;
+    uint8_t reserved;
+    uint32_t first_block;
+    uint32_t blocks;
+    uint32_t length;        // Bytes of log, once used
+} log_index_ent_t;
+
+typedef struct __attribute__((packed))
+{
+    log_index_hdr_t hdr;
+    log_index_ent_t entries[LOG_INDEX_ENTRIES];
+} log_index_t;
+
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   LogFiles
+*       Log files made ahead of time, so writing one never
+*       touches the FAT. prepare(), called on the pad,
+*       makes each file contiguous and file_blocks long,
+*       erases it and notes it in the directory's
+*       index.bin, keeping one to write plus spares ready.
+*       open() takes the next ready file, and the log is
+*       then written with raw block writes to where it
+*       sits on the card, through write() and seek() as a
+*       BlockWriter sink. Once full() the caller closes it
+*       and opens the next, a log that rotates across
+*       files rather than growing one.
+*
+*       index.bin is one contiguous block, updated by a
+*       single block write and only by prepare() and the
+*       last close(). A file the index thinks is ready
+*       but whose first block holds a log header was
+*       written before a power loss, and is taken as used
+*       next time the index is loaded.
+**********************************************************/
+class LogFiles
+{
+public:
+    LogFiles( SdFat & sd, uint32_t file_blocks, uint8_t spares );
+
+    bool prepare( char const * dir );
+    bool open();
+    void close( bool last );
+
+    bool is_open() const;
+    bool full() const;
+    uint16_t number() const;
+
+    // Sink for BlockWriter
+    size_t write( uint8_t const * data, size_t length );
+    bool seek( uint32_t position );
+    void flush();
+
+private:
+    bool load( char const * dir );
+    bool save();
+    bool add_file();
+    bool drop_entry( uint8_t index );
+    void forget_ready();
+    bool written( log_index_ent_t const & entry );
+    uint8_t ready_cnt() const;
+    void file_path( char * path, uint16_t num ) const;
+
+    SdFat & m_sd;
+    uint32_t m_file_blocks;
+    uint8_t m_spares;
+
+    char m_dir[LOG_FILES_DIR_LEN];  // Empty until an index is loaded
+    uint32_t m_index_block;
+    log_index_t m_index;
+
+    log_index_ent_t * m_open;       // File being written, NULL if none
+    uint32_t m_pos;
+    uint32_t m_end;                 // Furthest byte written
+
+    uint8_t m_scratch[512];
+};
+
+#endif
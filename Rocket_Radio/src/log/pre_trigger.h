@@ -0,0 +1,294 @@
+#ifndef PRE_TRIGGER_H
+#define PRE_TRIGGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "bin_log.h"
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// A log record as it's kept in a PreTrigger ring, ahead of its data.
+typedef struct __attribute__((packed))
+{
+    log_rec_type_t rec_type;
+    uint8_t size;
+    uint32_t time_ms;
+} pre_rec_hdr_t;
+
+// One record taken back out.
+typedef struct
+{
+    pre_rec_hdr_t hdr;
+    uint8_t data[BIN_LOG_MAX_DATA];
+} pre_rec_t;
+
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   PreTrigger
+*       RAM ring of log records that aren't going to the
+*       card yet. While the log is closed it always holds
+*       the last window_ms of them, so when logging starts
+*       late, on a launch, what led up to it still makes
+*       it into the log. Once logging starts it's drained
+*       into the log as the card keeps up, and records
+*       that come in meanwhile go in behind so the order
+*       holds.
+*
+*       Records are packed end to end, a 6 byte header
+*       each. When there's no room the oldest go.
+*
+*       Size - Bytes of records, up to 32768.
+**********************************************************/
+template< uint16_t Size >
+class PreTrigger
+{
+public:
+    static_assert( Size <= 32768, "indexes are 16 bits" );
+
+    PreTrigger();
+
+    void set_window( uint32_t window_ms );
+    void clear();
+
+    void push( log_rec_type_t rec_type, void const * data, uint8_t size, uint32_t time_ms );
+    bool pop( pre_rec_t & rec );
+
+    bool empty() const;
+    uint16_t used() const;
+    uint32_t oldest_ms() const;
+    uint32_t dropped() const;
+
+private:
+    void read( uint16_t from, void * data, uint16_t length ) const;
+    void write( uint16_t to, void const * data, uint16_t length );
+    void drop_oldest();
+
+    uint8_t m_ring[Size];
+    uint16_t m_head;            // Oldest record
+    uint16_t m_used;
+    uint32_t m_window_ms;
+    uint32_t m_dropped;
+};
+
+
+/******************************************************************************
+ *                          Method Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   PreTrigger
+*       Constructor
+**********************************************************/
+template< uint16_t Size >
+PreTrigger< Size >::PreTrigger() :
+    m_head( 0 ),
+    m_used( 0 ),
+    m_window_ms( 0 ),
+    m_dropped( 0 )
+{
+}
+
+
+/**********************************************************
+*   set_window
+*       Drop records more than window_ms older than the
+*       newest one. 0 keeps everything there's room for,
+*       for while the ring is being drained.
+**********************************************************/
+template< uint16_t Size >
+void PreTrigger< Size >::set_window( uint32_t window_ms )
+{
+    m_window_ms = window_ms;
+}
+
+
+template< uint16_t Size >
+void PreTrigger< Size >::clear()
+{
+    m_head = 0;
+    m_used = 0;
+}
+
+
+/**********************************************************
+*   push
+*       Add a record, dropping the oldest ones to make
+*       room and any that have aged out of the window.
+**********************************************************/
+template< uint16_t Size >
+void PreTrigger< Size >::push( log_rec_type_t rec_type, void const * data, uint8_t size, uint32_t time_ms )
+{
+    pre_rec_hdr_t hdr;
+    uint16_t const length = sizeof(hdr) + size;
+
+    if( ( size > BIN_LOG_MAX_DATA )
+     || ( length > Size ) )
+    {
+        return;
+    }
+
+    while( Size - m_used < length )
+    {
+        this->drop_oldest();
+        m_dropped++;
+    }
+
+    hdr.rec_type = rec_type;
+    hdr.size = size;
+    hdr.time_ms = time_ms;
+
+    uint16_t tail = ( m_head + m_used ) % Size;
+    this->write( tail, &hdr, sizeof(hdr) );
+    this->write( ( tail + sizeof(hdr) ) % Size, data, size );
+    m_used += length;
+
+    if( m_window_ms == 0 )
+    {
+        return;
+    }
+
+    while( ( m_used > length )
+        && ( (int32_t)( time_ms - this->oldest_ms() ) > (int32_t)m_window_ms ) )
+    {
+        this->drop_oldest();
+    }
+}
+
+
+/**********************************************************
+*   pop
+*       Take the oldest record out. False if there are
+*       none.
+**********************************************************/
+template< uint16_t Size >
+bool PreTrigger< Size >::pop( pre_rec_t & rec )
+{
+    if( m_used == 0 )
+    {
+        return false;
+    }
+
+    this->read( m_head, &rec.hdr, sizeof(rec.hdr) );
+    this->read( ( m_head + sizeof(rec.hdr) ) % Size, rec.data, rec.hdr.size );
+
+    m_head = ( m_head + sizeof(rec.hdr) + rec.hdr.size ) % Size;
+    m_used -= sizeof(rec.hdr) + rec.hdr.size;
+
+    return true;
+}
+
+
+template< uint16_t Size >
+bool PreTrigger< Size >::empty() const
+{
+    return m_used == 0;
+}
+
+
+/**********************************************************
+*   used
+*       Bytes of records, headers included.
+**********************************************************/
+template< uint16_t Size >
+uint16_t PreTrigger< Size >::used() const
+{
+    return m_used;
+}
+
+
+/**********************************************************
+*   oldest_ms
+*       Time of the oldest record. Only meaningful if the
+*       ring isn't empty.
+**********************************************************/
+template< uint16_t Size >
+uint32_t PreTrigger< Size >::oldest_ms() const
+{
+    pre_rec_hdr_t hdr;
+
+    this->read( m_head, &hdr, sizeof(hdr) );
+
+    return hdr.time_ms;
+}
+
+
+/**********************************************************
+*   dropped
+*       Records thrown away for room. Ones that aged out
+*       of the window aren't counted.
+**********************************************************/
+template< uint16_t Size >
+uint32_t PreTrigger< Size >::dropped() const
+{
+    return m_dropped;
+}
+
+
+/**********************************************************
+*   read
+*       Copy length bytes out of the ring from from, round
+*       the end if need be.
+**********************************************************/
+template< uint16_t Size >
+void PreTrigger< Size >::read( uint16_t from, void * data, uint16_t length ) const
+{
+    uint16_t first = Size - from;
+
+    if( first >= length )
+    {
+        memcpy( data, &m_ring[from], length );
+    }
+    else
+    {
+        memcpy( data, &m_ring[from], first );
+        memcpy( (uint8_t *)data + first, m_ring, length - first );
+    }
+}
+
+
+/**********************************************************
+*   write
+*       Copy length bytes into the ring at to, round the
+*       end if need be.
+**********************************************************/
+template< uint16_t Size >
+void PreTrigger< Size >::write( uint16_t to, void const * data, uint16_t length )
+{
+    uint16_t first = Size - to;
+
+    if( first >= length )
+    {
+        memcpy( &m_ring[to], data, length );
+    }
+    else
+    {
+        memcpy( &m_ring[to], data, first );
+        memcpy( m_ring, (uint8_t const *)data + first, length - first );
+    }
+}
+
+
+/**********************************************************
+*   drop_oldest
+*       Throw the oldest record away.
+**********************************************************/
+template< uint16_t Size >
+void PreTrigger< Size >::drop_oldest()
+{
+    pre_rec_hdr_t hdr;
+
+    this->read( m_head, &hdr, sizeof(hdr) );
+
+    m_head = ( m_head + sizeof(hdr) + hdr.size ) % Size;
+    m_used -= sizeof(hdr) + hdr.size;
+}
+
+#endif
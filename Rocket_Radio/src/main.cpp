@@ -1,20 +1,39 @@
 #include <Arduino.h>
 #include <SPI.h>
 #include <Wire.h>
-#include <SD.h>
+#include <SdFat.h>
 
 #include <string>
 
+// Lets tasks see how late they started, for prof.overrun()
+#define _TASK_TIMECRITICAL
 #include <TaskScheduler.h>
-#include <Adafruit_MCP3008.h>
 #include <Adafruit_GPS.h>
 
 #include <Adafruit_Sensor.h>
 #include <Adafruit_BNO055.h>
 #include <utility/imumaths.h>
 
-#include <AllSensors_DLV.h>
-
+#include "sensor_data.h"
+#include "acq/acq_sched.h"
+#include "acq/sampler.h"
+#include "bus/sam_spi_bus.h"
+#include "bus/sam_twi_bus.h"
+#include "flight/flight_detect.h"
+#include "gps/nmea_parser.h"
+#include "log/bin_log.h"
+#include "log/block_writer.h"
+#include "log/link_capture.h"
+#include "log/log_downlink.h"
+#include "log/log_files.h"
+#include "log/pre_trigger.h"
+#include "sensors/bno055_async.h"
+#include "sensors/dlv_async.h"
+#include "sensors/mcp3008_burst.h"
+#include "telemetry/sensor_batch.h"
+#include "telemetry/tagged_batch.h"
+#include "telemetry/tlm_schema.h"
+#include "util/prof.h"
 #include "xbee/xbee.h"
 
 /******************************************************************************
@@ -23,51 +42,59 @@
 #define ADC_SS_PIN 10
 #define SD_SS_PIN 4
 
-/******************************************************************************
- *                               Global Types
- *****************************************************************************/
-typedef struct __attribute__((packed))
-{
-    uint16_t adc_chnl_0;
-    uint16_t adc_chnl_1;
-    uint16_t adc_chnl_2;
-    uint16_t adc_chnl_3;
-    uint16_t adc_chnl_4;
-    uint16_t adc_chnl_5;
-    uint16_t adc_chnl_6;
-    uint16_t adc_chnl_7;
-    float angle_x;
-    float angle_y;
-    float angle_z;
-    float accel_x;
-    float accel_y;
-    float accel_z;
-    float prsur;
-    float prsur_temp;
-} data_pkg_t;
-
-typedef struct __attribute__((packed))
-{
-    uint8_t year;
-    uint8_t month;
-    uint8_t day;
-    uint8_t hour;
-    uint8_t min;
-    uint8_t sec;
-    float lat;
-    float lon;
-    bool fix;
-    uint8_t fix_qual;
-    uint8_t sat_num;
-} gps_data_t;
-
-typedef uint8_t data_log_sts_t;
-enum
-{
-    DATA_LOG_STS_START = 0,
-    DATA_LOG_STS_STOP  = 1,
-};
-
+// SD log flush policy. Data waits in RAM at most this long, and at most
+//  this many bytes of it, before it's written to the card.
+#define LOG_FLUSH_INTERVAL_MS 1000
+#define LOG_MAX_AT_RISK 512
+
+// SD log files, made and erased on the pad so logging never waits on
+//  the FAT. 64MB is about half an hour of logging at 35kB a second. A
+//  log that fills one goes on in the next, and a spare is kept ready on
+//  top of the one the next log starts in.
+#define LOG_FILE_BLOCKS 131072
+#define LOG_FILE_SPARES 1
+
+// How long to wait before trying again to get log files ready, if the
+//  card was missing or full.
+#define LOG_PREPARE_RETRY_MS 5000
+
+// Pre-trigger ring. While the log is closed it holds the last
+//  flight_cfg.pre_ms of records, about 8k a second at pad rates with
+//  only 1 in PRE_TRIGGER_ADC_DECIMATION ADC samples kept.
+#define PRE_TRIGGER_SIZE 16384
+#define PRE_TRIGGER_ADC_DECIMATION 10
+
+// data_collect_task period, normally and during a burst.
+#define DATA_COLLECT_MS 100
+#define DATA_COLLECT_BURST_MS 20
+
+// GPS UART. 10 RMC and GGA pairs a second are about 1500 bytes, more
+//  than 9600 baud carries. The module starts at 9600 and is switched.
+#define GPS_BOOT_BAUD 9600
+#define GPS_BAUD 57600
+
+// Most bytes taken from the GPS UART at once.
+#define GPS_READ_CHUNK 32
+
+// How the radio is driven. XBEE_API needs AP=2 set on the radio, and
+//  GROUND_XBEE_ADDR set to the ground radio's SH:SL for TX status to
+//  report real deliveries, broadcasts are never acked.
+#define XBEE_LINK_MODE XBEE_TRANSPARENT
+#define GROUND_XBEE_ADDR XBEE_API_BROADCAST_ADDR
+
+// Send telemetry with Reed-Solomon parity. Off until the LabVIEW ground
+//  station can decode it, the native ground tool already can.
+#define XBEE_LINK_FEC false
+
+// Send every sensor sample, the data_collect_task ones in SENSOR_CODED
+//  frames and each sensor's own reads in SENSOR_TAGGED frames. Off
+//  until the LabVIEW ground station can decode them, the latest sample
+//  goes out in a SENSOR_DATA frame each data_send_task pass instead.
+//  The native ground tool reads both.
+#define TLM_BATCHED false
+
+static_assert( DIAG_FRAME_SIZE <= MAX_DATA_LENGTH - 1, "DIAGNOSTICS frame doesn't fit" );
+static_assert( DIAG_FRAME_SIZE <= BIN_LOG_STATS_SIZE, "stats don't fit in the log header" );
 
 /******************************************************************************
  *                          Function Declarations
@@ -76,9 +103,39 @@ enum
 void data_send_task();
 void gps_send_task();
 void data_collect_task();
+void diag_send_task();
+void task_overrun_check();
+void diag_counts();
+void adc_miss_count();
+
+// Logging
+void log_record( log_rec_type_t rec_type, void const * data, uint8_t size, uint32_t time_ms );
+void pre_trigger_drain();
+bool log_start( bool prepare );
+void log_stop();
+void log_prepare();
+bool log_open( bool prepare );
+void log_rotate();
+void log_header();
+void log_dir( char * dir );
+
+// Flight events
+void flight_event( flight_event_t event );
+void set_burst( bool burst );
+
+// Frame handlers
+void data_log_hndlr( uint8_t const * data, uint16_t size );
+void log_downlink_hndlr( uint8_t const * data, uint16_t size );
+void link_rx_tap( uint8_t const * data, uint8_t size );
+
+// Sensor reads, called by acq at each source's rate
+bus_sts_t imu_euler_read( uint32_t time_us, void * sample );
+bus_sts_t imu_accel_read( uint32_t time_us, void * sample );
+bus_sts_t pressure_read( uint32_t time_us, void * sample );
+void acq_sample_hndlr( src_id_t source, void const * sample, uint8_t size );
 
 //SD Data Collection Functions
-void sd_start_collection();
+bool sd_start_collection( bool prepare );
 void sd_stop_collection();
 
 /******************************************************************************
@@ -88,32 +145,158 @@ void sd_stop_collection();
 Scheduler scheduler;
 Task t1( 200, TASK_FOREVER, data_send_task );
 Task t2( 1000, TASK_FOREVER, gps_send_task );
-Task t3( 100, TASK_FOREVER, data_collect_task );
+Task t3( DATA_COLLECT_MS, TASK_FOREVER, data_collect_task );
+Task t4( 5000, TASK_FOREVER, diag_send_task );
+
+// Times loop() and the tasks. Sent in DIAGNOSTICS frames and saved in
+//  the SD log's header when it's closed.
+Profiler prof;
 
 // Xbee object
-Xbee xbee( &Serial1 );
+Xbee xbee( &Serial1, XBEE_LINK_MODE );
 
-// Adc object
-Adafruit_MCP3008 adc;
+// Every sensor sample taken, waiting to go out in SENSOR_CODED frames.
+//  Only used with TLM_BATCHED.
+SensorBatch sensor_batch( &xbee );
+
+// Samples at each sensor's own rate, waiting to go out in SENSOR_TAGGED
+//  frames. Only used with TLM_BATCHED.
+TaggedBatch tagged_batch( &xbee );
+
+// Handler for each type of frame the ground station sends us
+const struct
+{
+    data_type_t data_type;
+    frame_hndlr_t hndlr;
+} frame_hndlrs[] =
+{
+    { DATA_LOG,     data_log_hndlr      },
+    { LOG_DOWNLINK, log_downlink_hndlr  },
+};
 
-// GPS object
+// Sensor buses. Reads are started and finished later rather than
+//  waited on, so the UARTs keep being serviced.
+SamSpiBus spi_bus;
+SamTwiBus twi_bus;
+
+// Adc object, all 8 channels read in one burst
+Mcp3008Burst adc( &spi_bus, ADC_SS_PIN );
+
+// Reads the ADC from a timer interrupt at SAMPLER_RATE_HZ. Every sample
+//  goes to the SD card, one per data_collect_task period to telemetry.
+Sampler sampler( &adc );
+
+// GPS object. Only used to send the module commands, nmea parses what
+//  it sends back.
 Adafruit_GPS gps( &Serial2 );
+NmeaParser nmea;
 
-// IMU Object
+// IMU Object. Adafruit_BNO055 sets it up, imu_reader reads it.
 // Adafruit_BNO055 imu_sensor = Adafruit_BNO055();
 Adafruit_BNO055 imu_sensor = Adafruit_BNO055( -1, BNO055_ADDRESS_B );
+Bno055Async imu_reader( &twi_bus, BNO055_ADDRESS_B );
 
 // Pressure Sensor object
-AllSensors_DLV_015A pressure_sensor = AllSensors_DLV_015A( &Wire );
+DlvAsync pressure_sensor( &twi_bus, DLV_015A_RANGE_PSI );
+
+// Each sensor on the I2C bus is read at a rate that suits it. The IMU
+//  fuses at 100Hz, the DLV is slow. The phases keep reads from landing
+//  on the same millisecond, so they don't queue up behind each other.
+//  The ADC isn't here, Sampler reads it from a timer interrupt.
+const acq_source_t acq_sources[] =
+{
+    // source           period ms   phase ms    read
+    { SRC_IMU_EULER,    10,         0,          imu_euler_read  },
+    { SRC_IMU_ACCEL,    10,         5,          imu_accel_read  },
+    { SRC_PRESSURE,     50,         2,          pressure_read   },
+};
+
+AcqScheduler acq( acq_sources, sizeof(acq_sources) / sizeof(acq_sources[0]) );
 
-//File objects and data string 
-File snsr_file;
-File gps_file;
-File count_file;
+// Read periods during a burst, sources not here keep theirs. The IMU
+//  already runs at its 100Hz fusion rate.
+const struct
+{
+    src_id_t source;
+    uint16_t period_ms;
+} acq_burst_periods[] =
+{
+    { SRC_PRESSURE,     10 },
+};
 
-// Store all sensor data in this structure.
+// Launch and apogee detection and the windows around them. tools/
+//  flight_replay runs the same detectors over a recorded CSV, to try
+//  new values against old flights.
+const flight_cfg_t flight_cfg =
+{
+    30.0,       // launch_accel m/s^2, about 3g
+    100,        // launch_hold_ms
+    0.1,        // launch_dp psi, about 70m up
+    0.02,       // apogee_dp psi, about 15m down
+    200,        // apogee_hold_ms
+    4000,       // apogee_lockout_ms
+    2000,       // pre_ms
+    10000,      // post_ms
+    120000,     // burst_max_ms
+};
+
+FlightDetect flight( flight_cfg );
+
+// Log record for each source's samples
+const log_rec_type_t src_log_recs[SRC_CNT] =
+{
+    LOG_REC_ADC,
+    LOG_REC_EULER,
+    LOG_REC_ACCEL,
+    LOG_REC_PRSUR,
+};
+
+// Samples of each source sent in SENSOR_TAGGED frames, 1 in N. About
+//  500 bytes a second at these rates, which leaves room at 9600 baud
+//  for the SENSOR_CODED and GPS frames.
+const struct
+{
+    src_id_t source;
+    uint8_t decimation;
+} tagged_decimation[] =
+{
+    { SRC_IMU_EULER,    5 },    // 20Hz
+    { SRC_PRESSURE,     2 },    // 10Hz
+};
+
+// SD card, and the log files on it. See LogFiles.
+SdFat sd;
+LogFiles log_files( sd, LOG_FILE_BLOCKS, LOG_FILE_SPARES );
+uint32_t log_retry_ms;
+
+// Binary sensor and GPS log. Records are gathered into 512 byte blocks
+//  that are written to log_files from loop().
+BlockWriter<LogFiles> log_writer( log_files );
+BinLog< BlockWriter<LogFiles> > bin_log( log_writer );
+
+// Sends the logs on the card to the ground when asked, while not
+//  logging. See LogDownlink, tools/log_dl is the ground's end.
+LogDownlink log_downlink( &xbee );
+
+// Records waiting to go in the log. See PreTrigger.
+PreTrigger< PRE_TRIGGER_SIZE > pre_trigger;
+uint16_t pre_adc_skip;
+
+// Latest value from every sensor. Sent and logged every
+//  data_collect_task period.
 data_pkg_t sensor_data;
 
+// ADC samples due and missed while logging, for the miss rate in the
+//  DIAGNOSTICS frame. The sampler's totals as of the last loop() pass.
+uint32_t adc_log_tries;
+uint32_t adc_log_missed;
+uint32_t adc_tries_seen;
+uint32_t adc_missed_seen;
+
+// Launches that found no log file ready. The files aren't got ready at
+//  launch, it stalls loop() for as long as the card takes.
+uint32_t log_not_ready;
+
 bool logging_data;
 
 /******************************************************************************
@@ -128,42 +311,74 @@ bool logging_data;
 void setup()
 {
     logging_data = false;
+    pre_trigger.set_window( flight_cfg.pre_ms );
+
+    prof.begin( millis() );
 
     // Serial initialization (DEBUGING)
     Serial.begin( 9600 );
 
+    // SD log policy
+    log_writer.set_flush_interval( LOG_FLUSH_INTERVAL_MS );
+    log_writer.set_max_at_risk( LOG_MAX_AT_RISK );
+
     // Xbee initialization
     xbee.setup( 9600 );
+    xbee.set_dest_addr( GROUND_XBEE_ADDR );
+    xbee.set_fec( XBEE_LINK_FEC );
+    for( auto const & entry : frame_hndlrs )
+    {
+        xbee.set_frame_hndlr( entry.data_type, entry.hndlr );
+    }
+    xbee.set_rx_tap( link_rx_tap );
+    sensor_batch.set_coded( true );
+    for( auto const & entry : tagged_decimation )
+    {
+        tagged_batch.set_decimation( entry.source, entry.decimation );
+    }
 
     // ADC initialization
-    adc.begin( ADC_SS_PIN );
+    pinMode( ADC_SS_PIN, OUTPUT );
+    digitalWrite( ADC_SS_PIN, HIGH );
+    SPI.begin();
+    spi_bus.begin();
 
     //SD initialization 
-    SD.begin( SD_SS_PIN );
+    sd.begin( SD_SS_PIN );
+    log_retry_ms = millis();
     
     // GPS initialization
-    gps.begin( 9600 );
+    gps.begin( GPS_BOOT_BAUD );
+    gps.sendCommand( PMTK_SET_BAUD_57600 );
+    Serial2.flush();
+    delay( 100 );
+    gps.begin( GPS_BAUD );
     gps.sendCommand( PMTK_SET_NMEA_OUTPUT_RMCGGA ); // turn on RMC (recommended minimum) and GGA (fix data) including altitude
-    gps.sendCommand( PMTK_SET_NMEA_UPDATE_1HZ );    // Set the update rate
+    gps.sendCommand( PMTK_SET_NMEA_UPDATE_10HZ );   // Set the update rate
     gps.sendCommand( PGCMD_NOANTENNA );             // Turn off updates on antenna status
 
-    // IMU setup
+    // IMU setup. The last use of Wire, twi_bus has TWI1 from here.
     imu_sensor.begin();
     delay(1000);
     imu_sensor.setExtCrystalUse( true );
 
-    // Humidity setup
-    pressure_sensor.setPressureUnit( AllSensors_DLV::PSI );
-    pressure_sensor.setTemperatureUnit( AllSensors_DLV::FAHRENHEIT );
-
     // Setup cooperative scheduler
     scheduler.init();
     scheduler.addTask( t1 );
     scheduler.addTask( t2 );
     scheduler.addTask( t3 );
+    scheduler.addTask( t4 );
     t1.enable();
     t2.enable();
     t3.enable();
+    t4.enable();
+
+    // Start sampling last so nothing above is holding up the rings
+    sampler.set_decimation( SAMPLE_TO_TLM, SAMPLER_RATE_HZ * t3.getInterval() / 1000 );
+    sampler.begin( SAMPLER_RATE_HZ );
+
+    acq.set_sink( acq_sample_hndlr );
+    acq.begin( micros() );
 }
 
 
@@ -173,264 +388,720 @@ void setup()
 **********************************************************/
 void loop()
 {
+    uint32_t loop_start = prof.start();
+    uint32_t start;
+
     scheduler.execute();
 
     /******************************************************
-    *  Receive data from xbee and parse it.
+    *  Start whichever sensor read is due, or move along
+    *  the one on the bus.
     ******************************************************/
+    start = prof.start();
+    acq.run( micros() );
+    prof.stop( PROF_ACQ_RUN, start );
+
+    /******************************************************
+    *  Receive data from xbee. Frames are passed to the
+    *  handlers in frame_hndlrs.
+    ******************************************************/
+    start = prof.start();
     xbee.read();
-    if( xbee.new_data_received() )
-    {
-        data_type_t data_type;
-        uint8_t data[ MAX_DATA_LENGTH ];
-        uint8_t size;
+    prof.stop( PROF_XBEE_READ, start );
 
-        xbee.get_data( data_type, data, size );
+    /******************************************************
+    *  End the burst once its post window is over.
+    ******************************************************/
+    flight_event( flight.tick( millis() ) );
 
-        switch( data_type )
+    /******************************************************
+    *  Log the sampler's ADC reads and write buffered log
+    *  data to the SD card, at most one block per pass,
+    *  moving on to the next file when one fills. While
+    *  not logging only 1 in PRE_TRIGGER_ADC_DECIMATION
+    *  goes in the pre-trigger ring, there isn't room for
+    *  them all, and the files for the next log are got
+    *  ready and the ground can have the logs sent down.
+    *  ADC samples missed while logging are counted, the
+    *  card's writes hold the bus the ADC is on.
+    ******************************************************/
+    adc_sample_t adc_sample;
+    while( sampler.pop( SAMPLE_TO_LOG, adc_sample ) )
+    {
+        if( ( logging_data )
+         || ( ++pre_adc_skip >= PRE_TRIGGER_ADC_DECIMATION ) )
         {
-            case DATA_LOG:
-            {
-                data_log_sts_t sts = (data_log_sts_t)*data;
-
-                switch( sts )
-                {
-                    case DATA_LOG_STS_START:
-                        if( !logging_data )
-                        {
-                            logging_data = true;
-                            sd_start_collection();
-                        }
-                        break;
-                
-                    case DATA_LOG_STS_STOP:
-                        if( logging_data )
-                        {
-                            logging_data = false;
-                            sd_stop_collection();
-                        }
-                        break;
-
-                    default:
-                        break;
-                }
-                
-                xbee.send_data( DATA_LOG, (uint8_t*)&sts, sizeof(data_log_sts_t) );
-                break;
-            }
+            pre_adc_skip = 0;
+            log_record( LOG_REC_ADC, &adc_sample, sizeof(adc_sample), adc_sample.time_us / 1000 );
+        }
+    }
 
-            default:
-                break;
+    if( logging_data )
+    {
+        start = prof.start();
+        spi_bus_acquire();
+        if( log_files.full() )
+        {
+            log_rotate();
         }
+        pre_trigger_drain();
+        log_writer.service();
+        spi_bus_release();
+        prof.stop( PROF_SD_WRITE, start );
+    }
+    else
+    {
+        log_prepare();
 
+        if( log_downlink.busy() )
+        {
+            spi_bus_acquire();
+            log_downlink.service( millis() );
+            spi_bus_release();
+        }
     }
+    adc_miss_count();
 
     /******************************************************
-    *  Receive data from GPS and parse it.
+    *  Parse everything the GPS has sent and log each fix
+    *  once both its sentences are in.
     ******************************************************/
-    gps.read();
-    if( gps.newNMEAreceived() ) 
-    {    
-        gps.parse( gps.lastNMEA() );
+    uint8_t chunk[ GPS_READ_CHUNK ];
+    int available;
+    while( ( available = Serial2.available() ) > 0 )
+    {
+        uint8_t count = min( available, GPS_READ_CHUNK );
+
+        for( uint8_t i = 0; i < count; i++ )
+        {
+            chunk[i] = (uint8_t)Serial2.read();
+        }
+        nmea.receive( chunk, count );
     }
+
+    if( nmea.fix_ready() )
+    {
+        log_record( LOG_REC_GPS, &nmea.data(), sizeof(gps_data_t), millis() );
+    }
+
+    prof.stop( PROF_LOOP, loop_start );
+    prof.loop( millis() );
+}
+
+
+/**********************************************************
+*   data_log_hndlr
+*       Handles DATA_LOG frames from the ground station.
+*       Starts or stops logging to the SD card and echos
+*       the command back.
+**********************************************************/
+void data_log_hndlr( uint8_t const * data, uint16_t size )
+{
+    if( size < sizeof(data_log_sts_t) )
+    {
+        return;
+    }
+
+    data_log_sts_t sts = (data_log_sts_t)*data;
+
+    switch( sts )
+    {
+        case DATA_LOG_STS_START:
+            log_start( true );
+            break;
+    
+        case DATA_LOG_STS_STOP:
+            log_stop();
+            break;
+
+        default:
+            break;
+    }
+    
+    xbee.send_data( DATA_LOG, (uint8_t*)&sts, sizeof(data_log_sts_t) );
+}
+
+
+/**********************************************************
+*   log_downlink_hndlr
+*       Handles LOG_DOWNLINK frames from the ground
+*       station, the file list and transfers of the logs.
+**********************************************************/
+void log_downlink_hndlr( uint8_t const * data, uint16_t size )
+{
+    log_downlink.frame_received( data, size );
+}
+
+
+/**********************************************************
+*   link_rx_tap
+*       Logs every byte the radio receives, as it came,
+*       so tools/replay can run the link again.
+**********************************************************/
+void link_rx_tap( uint8_t const * data, uint8_t size )
+{
+    if( ( log_files.is_open() )
+     && ( logging_data        ) )
+    {
+        link_capture( bin_log, micros(), data, size );
+    }
+}
+
+
+/**********************************************************
+*   imu_euler_read
+*       Read the IMU's orientation.
+**********************************************************/
+bus_sts_t imu_euler_read( uint32_t time_us, void * sample )
+{
+    return imu_reader.read( BNO055_EULER_REG, BNO055_EULER_LSB, time_us, (vec3_sample_t *)sample );
+}
+
+
+/**********************************************************
+*   imu_accel_read
+*       Read the IMU's linear acceleration, gravity taken
+*       out.
+**********************************************************/
+bus_sts_t imu_accel_read( uint32_t time_us, void * sample )
+{
+    return imu_reader.read( BNO055_ACCEL_REG, BNO055_ACCEL_LSB, time_us, (vec3_sample_t *)sample );
+}
+
+
+/**********************************************************
+*   pressure_read
+*       Read the DLV pressure sensor.
+**********************************************************/
+bus_sts_t pressure_read( uint32_t time_us, void * sample )
+{
+    return pressure_sensor.read( time_us, (prsur_sample_t *)sample );
+}
+
+
+/**********************************************************
+*   acq_sample_hndlr
+*       Takes every sample acq reads. Logs it, queues it
+*       for SENSOR_TAGGED frames with TLM_BATCHED, keeps
+*       it as the latest value for data_collect_task and
+*       hands accel and pressure to the flight detectors.
+**********************************************************/
+void acq_sample_hndlr( src_id_t source, void const * sample, uint8_t size )
+{
+    vec3_sample_t const * vec = (vec3_sample_t const *)sample;
+    prsur_sample_t const * prsur = (prsur_sample_t const *)sample;
+
+    switch( source )
+    {
+        case SRC_IMU_EULER:
+            sensor_data.angle_x = vec->x;
+            sensor_data.angle_y = vec->y;
+            sensor_data.angle_z = vec->z;
+            break;
+
+        case SRC_IMU_ACCEL:
+            sensor_data.accel_x = vec->x;
+            sensor_data.accel_y = vec->y;
+            sensor_data.accel_z = vec->z;
+            flight_event( flight.accel( vec->time_us / 1000, vec->x, vec->y, vec->z ) );
+            break;
+
+        case SRC_PRESSURE:
+            sensor_data.prsur = prsur->prsur;
+            sensor_data.prsur_temp = prsur->temp;
+            flight_event( flight.pressure( prsur->time_us / 1000, prsur->prsur ) );
+            break;
+
+        default:
+            return;
+    }
+
+    if( TLM_BATCHED )
+    {
+        tagged_batch.add( source, sample, size );
+    }
+
+    uint32_t time_us;
+
+    memcpy( &time_us, sample, sizeof(time_us) );
+    log_record( src_log_recs[source], sample, size, time_us / 1000 );
 }
 
 
 /**********************************************************
 *   data_collect_task
-*       100ms task. Collects data from various sensors.
+*       100ms task, 20ms during a burst. Takes the latest
+*       value from every sensor as one sample for
+*       telemetry and the snsr log.
 **********************************************************/
 void data_collect_task()
 {
-    char snsr_data_string[ 256 ];
+    uint32_t start = prof.start();
 
-    imu::Vector<3> eul_vec;
-    imu::Vector<3> acc_vec;
-    imu::Quaternion quat;
+    task_overrun_check();
 
-    // Get IMU data
-    eul_vec = imu_sensor.getVector( Adafruit_BNO055::VECTOR_EULER );
-    acc_vec = imu_sensor.getVector( Adafruit_BNO055::VECTOR_LINEARACCEL );
+    // Get ADC data. The newest read the sampler made for us.
+    adc_sample_t adc_sample;
+    while( sampler.pop( SAMPLE_TO_TLM, adc_sample ) )
+    {
+        sensor_data.adc_chnl_0 = adc_sample.adc[0];
+        sensor_data.adc_chnl_1 = adc_sample.adc[1];
+        sensor_data.adc_chnl_2 = adc_sample.adc[2];
+        sensor_data.adc_chnl_3 = adc_sample.adc[3];
+        sensor_data.adc_chnl_4 = adc_sample.adc[4];
+        sensor_data.adc_chnl_5 = adc_sample.adc[5];
+        sensor_data.adc_chnl_6 = adc_sample.adc[6];
+        sensor_data.adc_chnl_7 = adc_sample.adc[7];
+    }
 
-    sensor_data.angle_x = (float)eul_vec.x();
-    sensor_data.angle_y = (float)eul_vec.y();
-    sensor_data.angle_z = (float)eul_vec.z();
-    
-    sensor_data.accel_x = (float)acc_vec.x();
-    sensor_data.accel_y = (float)acc_vec.y();
-    sensor_data.accel_z = (float)acc_vec.z();
-
-    // Get ADC data
-    sensor_data.adc_chnl_0 = adc.readADC( 0 );
-    sensor_data.adc_chnl_1 = adc.readADC( 1 );
-    sensor_data.adc_chnl_2 = adc.readADC( 2 );
-    sensor_data.adc_chnl_3 = adc.readADC( 3 );
-    sensor_data.adc_chnl_4 = adc.readADC( 4 );
-    sensor_data.adc_chnl_5 = adc.readADC( 5 );
-    sensor_data.adc_chnl_6 = adc.readADC( 6 );
-    sensor_data.adc_chnl_7 = adc.readADC( 7 );
-
-    // Get humidity data
-    pressure_sensor.readData();
-    sensor_data.prsur = pressure_sensor.pressure;
-    sensor_data.prsur_temp = pressure_sensor.temperature;
-
-    if( ( snsr_file     )
-     && ( logging_data  ) )
-    {
-        // Save Data to SD card
-        sprintf( snsr_data_string,
-                "%s, %s, %s, %s, %s, %s, %d, %d, %d, %d, %d, %d, %d, %d, %s, %s",
-                String( sensor_data.angle_x, 4 ).c_str(),
-                String( sensor_data.angle_y, 4 ).c_str(), 
-                String( sensor_data.angle_z, 4 ).c_str(), 
-                String( sensor_data.accel_x, 4 ).c_str(), 
-                String( sensor_data.accel_y, 4 ).c_str(), 
-                String( sensor_data.accel_z, 4 ).c_str(),
-                sensor_data.adc_chnl_0,
-                sensor_data.adc_chnl_1,
-                sensor_data.adc_chnl_2,
-                sensor_data.adc_chnl_3,
-                sensor_data.adc_chnl_4,
-                sensor_data.adc_chnl_5,
-                sensor_data.adc_chnl_6,
-                sensor_data.adc_chnl_7,
-                String( sensor_data.prsur, 4 ).c_str(),
-                String( sensor_data.prsur_temp, 4 ).c_str()
-        );
-
-        snsr_file.println( snsr_data_string );
+    if( TLM_BATCHED )
+    {
+        sensor_batch.add( sensor_data );
     }
+
+    // Save Data to SD card
+    log_record( LOG_REC_SENSOR, &sensor_data, sizeof(sensor_data), millis() );
+
+    prof.stop( PROF_DATA_COLLECT, start );
 }
 
 
 /**********************************************************
 *   data_send_task
-*       100ms task. Sends out data to ground
-*       station. This is separate from the data collection
-*       task so that we can send out data at a slower rate
-*       than at which it is collected.
+*       200ms task. Sends the latest sample to the ground
+*       station, or with TLM_BATCHED every sample taken
+*       since the last pass. sensor_batch decides how many
+*       go in each frame from how busy the radio is.
 **********************************************************/
 void data_send_task()
 {
-    xbee.send_data( SENSOR_DATA, (uint8_t*)&sensor_data, sizeof(sensor_data) );
+    uint32_t start = prof.start();
+
+    task_overrun_check();
+
+    if( TLM_BATCHED )
+    {
+        sensor_batch.send();
+        tagged_batch.send();
+    }
+    else
+    {
+        uint8_t buffer[ SENSOR_DATA_WIRE_SIZE ];
+
+        sensor_wire_t::pack( sensor_data, buffer );
+        xbee.send_data( SENSOR_DATA, buffer, sizeof(buffer), true );
+    }
+
+    prof.stop( PROF_DATA_SEND, start );
 }
 
 /**********************************************************
 *   gps_send_task
 *       1000ms task. Sends the date, time, long and
-*       lat from GPS to ground station.
+*       lat from GPS to ground station. Every fix is
+*       logged from loop(), only the latest is sent.
 **********************************************************/
 void gps_send_task()
 {
-    gps_data_t data;
-    char gps_data_string[ 150 ];
-
-    data.year       = gps.year;
-    data.month      = gps.month;
-    data.day        = gps.day;
-    data.hour       = gps.hour;
-    data.min        = gps.minute;
-    data.sec        = gps.seconds;
-    data.lat        = gps.latitudeDegrees;
-    data.lon        = gps.longitudeDegrees;
-    data.fix        = gps.fix;
-    data.fix_qual   = gps.fixquality;
-    data.sat_num    = gps.satellites;
-
-    xbee.send_data( GPS_DATA, (uint8_t*)&data, sizeof(data) );
-
-    if( ( gps_file     )
-     && ( logging_data ) )
-    {
-        //Save Data To SD card 
-        sprintf( gps_data_string, 
-                "%d, %d, %d, %d, %d, %d, %s, %s, %d, %d, %d",
-                data.year, 
-                data.month, 
-                data.day, 
-                data.hour,
-                data.min,
-                data.sec,
-                String( data.lat, 4 ).c_str(), 
-                String( data.lon, 4 ).c_str(),
-                data.fix,
-                data.fix_qual,
-                data.sat_num   );
-
-        gps_file.println( gps_data_string );
-
-        gps_file.flush();
-        snsr_file.flush();
+    uint32_t start = prof.start();
+    uint8_t buffer[ GPS_DATA_WIRE_SIZE ];
+
+    task_overrun_check();
+
+    gps_wire_t::pack( nmea.data(), buffer );
+    xbee.send_data( GPS_DATA, buffer, sizeof(buffer), true );
+
+    prof.stop( PROF_GPS_SEND, start );
+}
+
+
+/**********************************************************
+*   diag_send_task
+*       5000ms task. Sends how long each part of the
+*       firmware has been taking to the ground station.
+**********************************************************/
+void diag_send_task()
+{
+    uint8_t buffer[ DIAG_FRAME_SIZE ];
+
+    diag_counts();
+    uint16_t size = prof.fill( buffer, sizeof(buffer), millis() );
+
+    xbee.send_data( DIAGNOSTICS, buffer, size, true );
+}
+
+
+/**********************************************************
+*   diag_counts
+*       Give prof the counts that go out with the times.
+**********************************************************/
+void diag_counts()
+{
+    uint32_t late = 0;
+    uint32_t failed = 0;
+
+    for( auto const & src : acq_sources )
+    {
+        late += acq.late( src.source );
+        failed += acq.failed( src.source );
     }
+
+    prof.set_count( PROF_CNT_ADC_LOG_MISSED, adc_log_missed );
+    prof.set_count( PROF_CNT_ADC_LOG_MISS_RATE, adc_log_tries ? (uint32_t)( (uint64_t)adc_log_missed * 10000 / adc_log_tries ) : 0 );
+    prof.set_count( PROF_CNT_ADC_DROPPED, sampler.dropped( SAMPLE_TO_LOG ) );
+    prof.set_count( PROF_CNT_ACQ_LATE, late );
+    prof.set_count( PROF_CNT_ACQ_FAILED, failed );
+    prof.set_count( PROF_CNT_LOG_NOT_READY, log_not_ready );
 }
 
+
 /**********************************************************
-*   sd_start_collection
-*       Initializes the files for the SD card to 
-*       write to 
+*   adc_miss_count
+*       Add the ADC samples due and missed since the last
+*       pass to the logging totals if logging. The SD card
+*       holds the SPI bus while it writes, and the sampler
+*       misses any sample due then.
 **********************************************************/
-void sd_start_collection()
-{
-    char base_dir[15];
-    char cnt_file_path[ 15 ];
-    char snsr_file_path[ 25 ];
-    char gps_file_path[ 25 ];
-    uint8_t file_cnt;
-    uint8_t day;
-    uint8_t month;
-
-    day = gps.day;
-    month = gps.month;
-    file_cnt = 0;
-
-    // Create the base dir
-    sprintf( base_dir, "/%d_%d", month, day );
-    SD.mkdir( base_dir );
-
-    // Get the log cnt in the base dir
-    sprintf( cnt_file_path, "%s/cnt.txt", base_dir );
-    if( SD.exists( cnt_file_path ) )
-    {
-        count_file = SD.open( cnt_file_path, ( O_WRITE | O_READ ) );
-        file_cnt = count_file.parseInt();
-        
-        count_file.seek( 0 );
-        count_file.println( ++file_cnt );
-        count_file.close();
-    }
-    //Count file does not exist and needs to be initialized
+void adc_miss_count()
+{
+    uint32_t tries = sampler.tries();
+    uint32_t missed = sampler.missed();
+
+    if( logging_data )
+    {
+        adc_log_tries += tries - adc_tries_seen;
+        adc_log_missed += missed - adc_missed_seen;
+    }
+
+    adc_tries_seen = tries;
+    adc_missed_seen = missed;
+}
+
+
+/**********************************************************
+*   task_overrun_check
+*       Count the running task in prof if it started after
+*       its scheduled time.
+**********************************************************/
+void task_overrun_check()
+{
+    if( scheduler.currentTask().getOverrun() < 0 )
+    {
+        prof.overrun();
+    }
+}
+
+/**********************************************************
+*   log_record
+*       Write a record to the SD log, or to the pre-trigger
+*       ring while the log is closed or the ring still has
+*       a backlog for it.
+**********************************************************/
+void log_record( log_rec_type_t rec_type, void const * data, uint8_t size, uint32_t time_ms )
+{
+    if( ( log_files.is_open()   )
+     && ( logging_data          )
+     && ( pre_trigger.empty()   ) )
+    {
+        bin_log.write( rec_type, data, size, time_ms );
+    }
     else
     {
-        file_cnt = 1;
-        count_file = SD.open( cnt_file_path, ( O_WRITE | O_READ | O_CREAT ) );
-        count_file.println( file_cnt );
-        count_file.close();
+        pre_trigger.push( rec_type, data, size, time_ms );
     }
+}
+
 
+/**********************************************************
+*   pre_trigger_drain
+*       Move records from the pre-trigger ring into the log
+*       while the block writer has room for them.
+**********************************************************/
+void pre_trigger_drain()
+{
+    pre_rec_t rec;
 
-    //Initialize the Sensor Data File
-    sprintf( snsr_file_path, "%s/snsr_%d.csv", base_dir, file_cnt );
+    if( !log_files.is_open() )
+    {
+        return;
+    }
 
-    snsr_file = SD.open( snsr_file_path, ( O_WRITE | O_CREAT | O_TRUNC ) );
-    if( snsr_file )
+    while( ( log_writer.space() >= sizeof(log_rec_hdr_t) + BIN_LOG_MAX_DATA )
+        && ( pre_trigger.pop( rec ) ) )
     {
-        snsr_file.println( "angle_X, angle_Y, angle_Z, accel_X, accel_Y, accel_Z, adc_chnl_0, adc_chnl_1, adc_chnl_2, adc_chnl_3, adc_chnl_4, adc_chnl_5, adc_chnl_6, adc_chnl_7, air pressure, air pressure temp" );
-        snsr_file.flush();
+        bin_log.write( rec.hdr.rec_type, rec.data, rec.hdr.size, rec.hdr.time_ms );
     }
-    
-    //Initialize GPS data file 
-    sprintf(gps_file_path, "%s/gps_%d.csv", base_dir, file_cnt );
-    
-    gps_file = SD.open( gps_file_path, ( O_WRITE | O_CREAT | O_TRUNC ) );
-    if( gps_file )
+}
+
+
+/**********************************************************
+*   log_start
+*       Open a new log. The pre-trigger ring stops aging
+*       records out and drains into it from loop(), so the
+*       log starts pre_ms before now. A log downlink
+*       going on is dropped. If no file is ready they're
+*       got ready first only if prepare is set. Returns
+*       false if already logging or no file was opened.
+**********************************************************/
+bool log_start( bool prepare )
+{
+    bool opened;
+
+    if( logging_data )
+    {
+        return false;
+    }
+
+    spi_bus_acquire();
+    log_downlink.abort();
+    opened = sd_start_collection( prepare );
+    spi_bus_release();
+
+    if( opened )
+    {
+        logging_data = true;
+        pre_trigger.set_window( 0 );
+    }
+
+    return opened;
+}
+
+
+/**********************************************************
+*   log_stop
+*       Write out what's left in the pre-trigger ring and
+*       close the log.
+**********************************************************/
+void log_stop()
+{
+    if( !logging_data )
+    {
+        return;
+    }
+
+    spi_bus_acquire();
+    while( ( log_files.is_open() )
+        && ( !pre_trigger.empty()  ) )
+    {
+        pre_trigger_drain();
+        log_writer.flush();
+    }
+    sd_stop_collection();
+    spi_bus_release();
+
+    logging_data = false;
+    pre_trigger.clear();
+    pre_trigger.set_window( flight_cfg.pre_ms );
+}
+
+
+/**********************************************************
+*   log_prepare
+*       Get the files the next log goes in ready, from
+*       loop() while not logging. Only touches the card
+*       after a log is closed, when the GPS date changes
+*       the directory, or every LOG_PREPARE_RETRY_MS while
+*       it's failing.
+**********************************************************/
+void log_prepare()
+{
+    char dir[ LOG_FILES_DIR_LEN ];
+    bool ready;
+
+    if( (int32_t)( millis() - log_retry_ms ) < 0 )
+    {
+        return;
+    }
+
+    log_dir( dir );
+
+    spi_bus_acquire();
+    ready = log_files.prepare( dir );
+    spi_bus_release();
+
+    if( !ready )
+    {
+        log_retry_ms = millis() + LOG_PREPARE_RETRY_MS;
+    }
+}
+
+
+/**********************************************************
+*   log_open
+*       Open the next ready log file. If log_prepare()
+*       hasn't got one ready, the card went in late or the
+*       spares ran out, they're got ready here if prepare
+*       is set, stalling loop() while it's done.
+**********************************************************/
+bool log_open( bool prepare )
+{
+    char dir[ LOG_FILES_DIR_LEN ];
+
+    if( log_files.open() )
+    {
+        return true;
+    }
+
+    if( !prepare )
     {
-        gps_file.println( "year, month, day, hour, minute, second, latitude, longitude, fix, fix quality, satellites" );
-        gps_file.flush();
+        return false;
     }
 
+    log_dir( dir );
 
+    return ( log_files.prepare( dir ) )
+        && ( log_files.open() );
 }
+
+
+/**********************************************************
+*   log_rotate
+*       Carry the log on in the next file once this one is
+*       full. Each file gets its own header, so it's a log
+*       tools/log2csv reads on its own, and only the last
+*       one has the run's stats.
+**********************************************************/
+void log_rotate()
+{
+    log_writer.flush();
+    log_files.close( false );
+
+    if( log_open( true ) )
+    {
+        log_header();
+    }
+}
+
+
+/**********************************************************
+*   log_header
+*       Start a newly opened log file with BinLog's
+*       header. It's bigger than the block writer's two
+*       blocks, so blocks are written as it fills them.
+**********************************************************/
+void log_header()
+{
+    log_writer.begin();
+    log_writer.set_blocking( true );
+    bin_log.begin();
+    log_writer.set_blocking( false );
+    log_writer.flush();
+}
+
+
+/**********************************************************
+*   log_dir
+*       Directory the day's logs go in, /month_day from
+*       the GPS.
+**********************************************************/
+void log_dir( char * dir )
+{
+    snprintf( dir, LOG_FILES_DIR_LEN, "/%d_%d", nmea.data().month, nmea.data().day );
+}
+
+
+/**********************************************************
+*   flight_event
+*       Act on what the flight detectors saw. Launch opens
+*       the log if the ground station hasn't, only if a
+*       file is ready, and starts the burst. Every event
+*       is logged.
+**********************************************************/
+void flight_event( flight_event_t event )
+{
+    flight_evt_rec_t rec;
+    uint32_t time_ms = millis();
+
+    switch( event )
+    {
+        case FLIGHT_EVT_NONE:
+            return;
+
+        case FLIGHT_EVT_LAUNCH:
+            if( logging_data )
+            {
+                // The ground station started it
+            }
+            else if( log_start( false ) )
+            {
+                data_log_sts_t sts = DATA_LOG_STS_START;
+                xbee.send_data( DATA_LOG, (uint8_t*)&sts, sizeof(data_log_sts_t) );
+            }
+            else
+            {
+                log_not_ready++;
+            }
+            set_burst( true );
+            time_ms = flight.launch_ms();
+            break;
+
+        case FLIGHT_EVT_APOGEE:
+            time_ms = flight.apogee_ms();
+            break;
+
+        case FLIGHT_EVT_BURST_END:
+            set_burst( false );
+            break;
+
+        default:
+            break;
+    }
+
+    rec.event = event;
+    rec.state = flight.state();
+    rec.prsur = flight.prsur();
+    rec.ground_prsur = flight.ground_prsur();
+    log_record( LOG_REC_EVENT, &rec, sizeof(rec), time_ms );
+}
+
+
+/**********************************************************
+*   set_burst
+*       Switch acquisition to the burst rates, or back to
+*       the normal ones.
+**********************************************************/
+void set_burst( bool burst )
+{
+    for( auto const & src : acq_sources )
+    {
+        uint16_t period_ms = src.period_ms;
+
+        for( auto const & entry : acq_burst_periods )
+        {
+            if( ( burst )
+             && ( entry.source == src.source ) )
+            {
+                period_ms = entry.period_ms;
+            }
+        }
+
+        acq.set_period( src.source, period_ms );
+    }
+
+    t3.setInterval( burst ? DATA_COLLECT_BURST_MS : DATA_COLLECT_MS );
+    sampler.set_decimation( SAMPLE_TO_TLM, SAMPLER_RATE_HZ * t3.getInterval() / 1000 );
+}
+
+
+/**********************************************************
+*   sd_start_collection
+*       Opens the next log file and writes the log header.
+*       Holds both sensor and GPS records, tools/log2csv
+*       turns it back into the snsr and gps CSVs. Returns
+*       false if no file was opened.
+**********************************************************/
+bool sd_start_collection( bool prepare )
+{
+    if( !log_open( prepare ) )
+    {
+        return false;
+    }
+
+    log_header();
+    return true;
+}
+
+
 /**********************************************************
 *   sd_stop_collection
 *       This function will write any remaining data 
@@ -438,7 +1109,12 @@ void sd_start_collection()
 **********************************************************/
 void sd_stop_collection()
 {
-    snsr_file.close();
-    gps_file.close();    
+    uint8_t stats[ DIAG_FRAME_SIZE ];
+
+    diag_counts();
+    uint16_t size = prof.fill( stats, sizeof(stats), millis() );
 
+    // Run stats into the space BinLog left in the header
+    log_writer.patch( bin_log_stats_offset(), stats, size );
+    log_files.close( true );
 }
\ No newline at end of file
@@ -0,0 +1,125 @@
+#ifndef SENSOR_DATA_H
+#define SENSOR_DATA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+#define ADC_CHNL_CNT 8
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// data_pkg_t, sensor_sample_t and gps_data_t are laid out for the CPU,
+//  not packed. What goes over the radio is set by their schemas in
+//  telemetry/tlm_schema.h.
+typedef struct
+{
+    uint16_t adc_chnl_0;
+    uint16_t adc_chnl_1;
+    uint16_t adc_chnl_2;
+    uint16_t adc_chnl_3;
+    uint16_t adc_chnl_4;
+    uint16_t adc_chnl_5;
+    uint16_t adc_chnl_6;
+    uint16_t adc_chnl_7;
+    float angle_x;
+    float angle_y;
+    float angle_z;
+    float accel_x;
+    float accel_y;
+    float accel_z;
+    float prsur;
+    float prsur_temp;
+} data_pkg_t;
+
+// One data_pkg_t in a SENSOR_BATCH frame. index counts up by one for
+//  every sample taken so the ground station can spot gaps.
+typedef struct
+{
+    uint16_t index;
+    data_pkg_t data;
+} sensor_sample_t;
+
+// One read of every ADC channel by the timer driven sampler. time_us
+//  is micros() when the read started.
+typedef struct __attribute__((packed))
+{
+    uint32_t time_us;
+    uint16_t adc[ADC_CHNL_CNT];
+} adc_sample_t;
+
+// Sources the acquisition scheduler reads, each at its own rate. Tags
+//  every sample in the log and in SENSOR_TAGGED frames.
+typedef uint8_t src_id_t;
+enum
+{
+    SRC_ADC         = 0,    // adc_sample_t
+    SRC_IMU_EULER   = 1,    // vec3_sample_t, degrees
+    SRC_IMU_ACCEL   = 2,    // vec3_sample_t, linear accel m/s^2
+    SRC_PRESSURE    = 3,    // prsur_sample_t
+
+    SRC_CNT
+};
+
+typedef struct __attribute__((packed))
+{
+    uint32_t time_us;
+    float x;
+    float y;
+    float z;
+} vec3_sample_t;
+
+typedef struct __attribute__((packed))
+{
+    uint32_t time_us;
+    float prsur;
+    float temp;
+} prsur_sample_t;
+
+typedef struct
+{
+    uint8_t year;
+    uint8_t month;
+    uint8_t day;
+    uint8_t hour;
+    uint8_t min;
+    uint8_t sec;
+    float lat;
+    float lon;
+    bool fix;
+    uint8_t fix_qual;
+    uint8_t sat_num;
+} gps_data_t;
+
+// Size of a sample from source, 0 if it isn't one.
+inline uint8_t src_sample_size( src_id_t source )
+{
+    switch( source )
+    {
+        case SRC_ADC:
+            return sizeof(adc_sample_t);
+
+        case SRC_IMU_EULER:
+        case SRC_IMU_ACCEL:
+            return sizeof(vec3_sample_t);
+
+        case SRC_PRESSURE:
+            return sizeof(prsur_sample_t);
+
+        default:
+            return 0;
+    }
+}
+
+typedef uint8_t data_log_sts_t;
+enum
+{
+    DATA_LOG_STS_START = 0,
+    DATA_LOG_STS_STOP  = 1,
+};
+
+#endif
@@ -0,0 +1,46 @@
+#include "bno055_async.h"
+
+#include <string.h>
+
+Bno055Async::Bno055Async( Bus *bus, uint8_t addr ) :
+    m_bus( bus )
+{
+    memset( &m_xfer, 0, sizeof(m_xfer) );
+    m_xfer.addr = addr;
+    m_xfer.reg_len = 1;
+    m_xfer.rx = m_buf;
+    m_xfer.len = sizeof(m_buf);
+}
+
+
+/**********************************************************
+*   read
+*       Read the vector at reg, scaled by lsb, into
+*       sample.
+**********************************************************/
+bus_sts_t Bno055Async::read( uint8_t reg, float lsb, uint32_t time_us, vec3_sample_t * sample )
+{
+    if( m_xfer.sts == BUS_IDLE )
+    {
+        m_xfer.reg = reg;
+    }
+
+    bus_sts_t sts = bus_step( m_bus, m_xfer );
+    if( sts != BUS_DONE )
+    {
+        return sts;
+    }
+
+    int16_t raw[3];
+    for( uint8_t i = 0; i < 3; i++ )
+    {
+        raw[i] = (int16_t)( m_buf[ 2 * i ] | ( m_buf[ 2 * i + 1 ] << 8 ) );
+    }
+
+    sample->time_us = time_us;
+    sample->x = raw[0] * lsb;
+    sample->y = raw[1] * lsb;
+    sample->z = raw[2] * lsb;
+
+    return BUS_DONE;
+}
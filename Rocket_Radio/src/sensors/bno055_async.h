@@ -0,0 +1,47 @@
+#ifndef BNO055_ASYNC_H
+#define BNO055_ASYNC_H
+
+#include <stdint.h>
+
+#include "../bus/bus.h"
+#include "../sensor_data.h"
+
+
+/******************************************************************************
+ *                                   Defines
+ *****************************************************************************/
+
+// Data registers, each three little endian int16s.
+#define BNO055_EULER_REG    0x1A
+#define BNO055_ACCEL_REG    0x28
+
+// Value of one LSB in the default units, degrees and m/s^2.
+#define BNO055_EULER_LSB    ( 1.0f / 16.0f )
+#define BNO055_ACCEL_LSB    ( 1.0f / 100.0f )
+
+
+/******************************************************************************
+ *                                 Bno055Async
+ *****************************************************************************/
+
+/**********************************************************
+*   Bno055Async
+*       Reads BNO055 vectors without waiting on the bus.
+*       Call read the same way each pass until it stops
+*       returning BUS_BUSY. Adafruit_BNO055 still does the
+*       setup.
+**********************************************************/
+class Bno055Async
+{
+public:
+    Bno055Async( Bus *bus, uint8_t addr );
+
+    bus_sts_t read( uint8_t reg, float lsb, uint32_t time_us, vec3_sample_t * sample );
+
+private:
+    Bus *m_bus;
+    bus_xfer_t m_xfer;
+    uint8_t m_buf[6];
+};
+
+#endif
@@ -0,0 +1,46 @@
+#include "dlv_async.h"
+
+#include <string.h>
+
+DlvAsync::DlvAsync( Bus *bus, float range_psi, uint8_t addr ) :
+    m_bus( bus ),
+    m_range_psi( range_psi )
+{
+    memset( &m_xfer, 0, sizeof(m_xfer) );
+    m_xfer.addr = addr;
+    m_xfer.rx = m_buf;
+    m_xfer.len = sizeof(m_buf);
+}
+
+
+/**********************************************************
+*   read
+*       Read pressure and temperature into sample. Status
+*       bits other than fresh or stale data are an error.
+**********************************************************/
+bus_sts_t DlvAsync::read( uint32_t time_us, prsur_sample_t * sample )
+{
+    bus_sts_t sts = bus_step( m_bus, m_xfer );
+    if( sts != BUS_DONE )
+    {
+        return sts;
+    }
+
+    // 2 status bits, 14 bits pressure, 11 bits temperature
+    uint8_t status = m_buf[0] >> 6;
+    uint16_t raw_prsur = ( ( m_buf[0] & 0x3F ) << 8 ) | m_buf[1];
+    uint16_t raw_temp = ( m_buf[2] << 3 ) | ( m_buf[3] >> 5 );
+
+    if( status & 0x01 )
+    {
+        return BUS_ERROR;
+    }
+
+    float temp_c = raw_temp * ( 200.0f / 2047.0f ) - 50.0f;
+
+    sample->time_us = time_us;
+    sample->prsur = ( (float)raw_prsur - DLV_OUTPUT_MIN ) * m_range_psi / ( DLV_OUTPUT_MAX - DLV_OUTPUT_MIN );
+    sample->temp = temp_c * 1.8f + 32.0f;
+
+    return BUS_DONE;
+}
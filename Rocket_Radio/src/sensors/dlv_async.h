@@ -0,0 +1,50 @@
+#ifndef DLV_ASYNC_H
+#define DLV_ASYNC_H
+
+#include <stdint.h>
+
+#include "../bus/bus.h"
+#include "../sensor_data.h"
+
+
+/******************************************************************************
+ *                                   Defines
+ *****************************************************************************/
+
+#define DLV_I2C_ADDR 0x28
+
+// Full scale of the DLV-015A, PSI absolute.
+#define DLV_015A_RANGE_PSI 15.0f
+
+// Pressure counts at 0 and full scale, 10% and 90% of 14 bits.
+#define DLV_OUTPUT_MIN 1638
+#define DLV_OUTPUT_MAX 14746
+
+
+/******************************************************************************
+ *                                  DlvAsync
+ *****************************************************************************/
+
+/**********************************************************
+*   DlvAsync
+*       Reads an AllSensors DLV pressure sensor without
+*       waiting on the bus. Pressure in PSI, temperature
+*       in degrees F, same as the AllSensors library was
+*       set up for. Call read the same way each pass until
+*       it stops returning BUS_BUSY.
+**********************************************************/
+class DlvAsync
+{
+public:
+    DlvAsync( Bus *bus, float range_psi, uint8_t addr = DLV_I2C_ADDR );
+
+    bus_sts_t read( uint32_t time_us, prsur_sample_t * sample );
+
+private:
+    Bus *m_bus;
+    bus_xfer_t m_xfer;
+    uint8_t m_buf[4];
+    float m_range_psi;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "mcp3008_burst.h"
+
+#include <string.h>
+
+Mcp3008Burst::Mcp3008Burst( Bus *bus, uint8_t cs_pin ) :
+    m_bus( bus )
+{
+    // Single ended conversion of each channel in turn
+    for( uint8_t i = 0; i < ADC_CHNL_CNT; i++ )
+    {
+        m_tx[ i * MCP3008_XFER_LEN + 0 ] = 0x01;
+        m_tx[ i * MCP3008_XFER_LEN + 1 ] = 0x80 | ( i << 4 );
+        m_tx[ i * MCP3008_XFER_LEN + 2 ] = 0x00;
+    }
+
+    memset( &m_xfer, 0, sizeof(m_xfer) );
+    m_xfer.addr = cs_pin;
+    m_xfer.frame_len = MCP3008_XFER_LEN;
+    m_xfer.tx = m_tx;
+    m_xfer.rx = m_rx;
+    m_xfer.len = MCP3008_BURST_LEN;
+    m_xfer.done = xfer_done;
+    m_xfer.ctx = this;
+}
+
+
+void Mcp3008Burst::set_done( mcp3008_done_t done, void * ctx )
+{
+    m_done = done;
+    m_ctx = ctx;
+}
+
+
+/**********************************************************
+*   start
+*       Start a burst, stamped with time_us. Returns false
+*       if the bus is busy.
+**********************************************************/
+bool Mcp3008Burst::start( uint32_t time_us )
+{
+    if( m_bus->busy() )
+    {
+        return false;
+    }
+
+    m_time_us = time_us;
+
+    return m_bus->start( &m_xfer );
+}
+
+
+bool Mcp3008Burst::busy()
+{
+    return m_xfer.sts == BUS_BUSY;
+}
+
+
+/**********************************************************
+*   xfer_done
+*       Pull the 10 bit results out of the replies.
+**********************************************************/
+void Mcp3008Burst::xfer_done( bus_xfer_t * xfer )
+{
+    Mcp3008Burst * self = (Mcp3008Burst *)xfer->ctx;
+    adc_sample_t sample;
+    bool ok = ( xfer->sts == BUS_DONE );
+
+    xfer->sts = BUS_IDLE;
+
+    if( ( !ok           )
+     || ( !self->m_done ) )
+    {
+        return;
+    }
+
+    sample.time_us = self->m_time_us;
+    for( uint8_t i = 0; i < ADC_CHNL_CNT; i++ )
+    {
+        uint8_t const * reply = &self->m_rx[ i * MCP3008_XFER_LEN ];
+
+        sample.adc[i] = ( ( reply[1] & 0x03 ) << 8 ) | reply[2];
+    }
+
+    self->m_done( self->m_ctx, sample );
+}
@@ -0,0 +1,65 @@
+#ifndef MCP3008_BURST_H
+#define MCP3008_BURST_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "../bus/bus.h"
+#include "../sensor_data.h"
+
+
+/******************************************************************************
+ *                                   Defines
+ *****************************************************************************/
+
+// Bytes clocked per single ended conversion. Start bit, channel, reply.
+#define MCP3008_XFER_LEN 3
+
+#define MCP3008_BURST_LEN ( ADC_CHNL_CNT * MCP3008_XFER_LEN )
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// Called from the bus interrupt with every channel of a burst.
+typedef void (*mcp3008_done_t)( void * ctx, adc_sample_t const & sample );
+
+
+/******************************************************************************
+ *                                Mcp3008Burst
+ *****************************************************************************/
+
+/**********************************************************
+*   Mcp3008Burst
+*       Reads all 8 MCP3008 channels as one bus transfer,
+*       chip select raised between conversions, rather
+*       than 8 separate transactions each waiting for the
+*       last. The sample goes to the done callback when the
+*       last byte is in.
+**********************************************************/
+class Mcp3008Burst
+{
+public:
+    Mcp3008Burst( Bus *bus, uint8_t cs_pin );
+
+    void set_done( mcp3008_done_t done, void * ctx );
+
+    bool start( uint32_t time_us );
+    bool busy();
+
+private:
+    static void xfer_done( bus_xfer_t * xfer );
+
+    Bus *m_bus;
+    bus_xfer_t m_xfer;
+
+    uint8_t m_tx[MCP3008_BURST_LEN];
+    uint8_t m_rx[MCP3008_BURST_LEN];
+    uint32_t m_time_us = 0;
+
+    mcp3008_done_t m_done = NULL;
+    void * m_ctx = NULL;
+};
+
+#endif
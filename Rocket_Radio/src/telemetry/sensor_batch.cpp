@@ -0,0 +1,166 @@
+#include "sensor_batch.h"
+
+#include <string.h>
+
+static_assert( SENSOR_BATCH_MAX_SAMPLES >= 1, "a sample has to fit in a frame" );
+static_assert( SENSOR_BATCH_RING_SIZE <= UINT8_MAX, "counts are 8 bits" );
+
+SensorBatch::SensorBatch( Xbee *xbee ) :
+    m_xbee( xbee )
+{
+}
+
+
+/**********************************************************
+*   add
+*       Queue a sample to be sent. Drops the oldest one
+*       waiting if the ring is full.
+**********************************************************/
+void SensorBatch::add( data_pkg_t const & sample )
+{
+    if( m_cnt == SENSOR_BATCH_RING_SIZE )
+    {
+        m_head = ( m_head + 1 ) % SENSOR_BATCH_RING_SIZE;
+        m_cnt--;
+        m_dropped++;
+    }
+
+    sensor_sample_t & slot = m_ring[ ( m_head + m_cnt ) % SENSOR_BATCH_RING_SIZE ];
+    slot.index = m_index++;
+    slot.data = sample;
+    m_cnt++;
+}
+
+
+/**********************************************************
+*   send
+*       Send every full frame's worth of samples, then the
+*       rest too if the radio has nothing else to send.
+**********************************************************/
+void SensorBatch::send()
+{
+    uint8_t buffer[ MAX_DATA_LENGTH - sizeof(data_type_t) ];
+
+    while( m_cnt > 0 )
+    {
+        // Coded frames change the encoder's state, so build with
+        //  a copy and keep it only if the frame goes out.
+        TlmEncoder encoder( m_encoder );
+        uint8_t count;
+        uint8_t size = m_coded ? this->build_coded( buffer, count, encoder )
+                               : this->build_raw( buffer, count );
+
+        if( ( count == m_cnt )
+         && ( count < m_max_samples )
+         && ( !m_xbee->tx_idle() ) )
+        {
+            return;
+        }
+
+        if( !m_xbee->send_data( m_coded ? SENSOR_CODED : SENSOR_BATCH, buffer, size, true ) )
+        {
+            return;
+        }
+
+        m_encoder = encoder;
+        m_head = ( m_head + count ) % SENSOR_BATCH_RING_SIZE;
+        m_cnt -= count;
+    }
+}
+
+
+/**********************************************************
+*   set_coded
+*       Send SENSOR_CODED frames instead of SENSOR_BATCH.
+*       Resets the samples per frame cap to the most the
+*       frame type can hold.
+**********************************************************/
+void SensorBatch::set_coded( bool coded )
+{
+    m_coded = coded;
+    m_max_samples = coded ? SENSOR_BATCH_RING_SIZE : SENSOR_BATCH_MAX_SAMPLES;
+    m_encoder.force_key();
+}
+
+
+/**********************************************************
+*   set_max_samples
+*       Cap the samples per frame, from 1 up to the most
+*       the frame type can hold.
+**********************************************************/
+void SensorBatch::set_max_samples( uint8_t max_samples )
+{
+    uint8_t limit = m_coded ? SENSOR_BATCH_RING_SIZE : SENSOR_BATCH_MAX_SAMPLES;
+
+    if( max_samples < 1 )
+    {
+        max_samples = 1;
+    }
+    else if( max_samples > limit )
+    {
+        max_samples = limit;
+    }
+
+    m_max_samples = max_samples;
+}
+
+
+/**********************************************************
+*   dropped
+*       Samples dropped because the ring was full.
+**********************************************************/
+uint32_t SensorBatch::dropped()
+{
+    return m_dropped;
+}
+
+
+/**********************************************************
+*   build_raw
+*       Build a SENSOR_BATCH frame from the oldest samples.
+*       Returns its size, count is set to the samples in
+*       it.
+**********************************************************/
+uint8_t SensorBatch::build_raw( uint8_t * buffer, uint8_t & count )
+{
+    uint8_t size = 0;
+
+    count = ( m_cnt < m_max_samples ) ? m_cnt : m_max_samples;
+    buffer[ size++ ] = count;
+
+    for( uint8_t i = 0; i < count; i++ )
+    {
+        sensor_sample_pack( this->sample( i ), &buffer[size] );
+        size += SENSOR_SAMPLE_WIRE_SIZE;
+    }
+
+    return size;
+}
+
+
+/**********************************************************
+*   build_coded
+*       Build a SENSOR_CODED frame from as many of the
+*       oldest samples as fit. Returns its size, count is
+*       set to the samples in it.
+**********************************************************/
+uint8_t SensorBatch::build_coded( uint8_t * buffer, uint8_t & count, TlmEncoder & encoder )
+{
+    encoder.begin_frame( buffer, MAX_DATA_LENGTH - sizeof(data_type_t), this->sample( 0 ).index );
+
+    for( count = 0; ( count < m_cnt ) && ( count < m_max_samples ); count++ )
+    {
+        if( !encoder.add( this->sample( count ).data ) )
+        {
+            break;
+        }
+    }
+
+    return encoder.end_frame();
+}
+
+
+sensor_sample_t const & SensorBatch::sample( uint8_t i )
+{
+    return m_ring[ ( m_head + i ) % SENSOR_BATCH_RING_SIZE ];
+}
@@ -0,0 +1,81 @@
+#ifndef SENSOR_BATCH_H
+#define SENSOR_BATCH_H
+
+#include <stdint.h>
+
+#include "../sensor_data.h"
+#include "../xbee/xbee.h"
+#include "tlm_codec.h"
+#include "tlm_schema.h"
+
+
+/******************************************************************************
+ *                                   Defines
+ *****************************************************************************/
+
+// SENSOR_BATCH frame header, the data type then the sample count.
+#define SENSOR_BATCH_HDR_SIZE ( sizeof(data_type_t) + sizeof(uint8_t) )
+
+// Most samples that fit in one SENSOR_BATCH frame.
+#define SENSOR_BATCH_MAX_SAMPLES ( ( MAX_DATA_LENGTH - SENSOR_BATCH_HDR_SIZE ) / SENSOR_SAMPLE_WIRE_SIZE )
+
+// Samples held waiting for the radio. Once full the oldest is dropped.
+//  Also the most samples in one SENSOR_CODED frame.
+#define SENSOR_BATCH_RING_SIZE 32
+
+
+/******************************************************************************
+ *                                 SensorBatch
+ *****************************************************************************/
+
+/**********************************************************
+*   SensorBatch
+*       Collects every sensor sample and sends them to the
+*       ground station packed several to a frame. Either
+*       SENSOR_BATCH frames:
+*
+*           data type | count | count * sensor_sample_t
+*
+*       each sample as sensor_sample_pack lays it out, or,
+*       with set_coded, SENSOR_CODED frames built by
+*       TlmEncoder, which hold about four times as many.
+*
+*       How many go in a frame follows the link. While the
+*       radio is idle whatever is waiting goes out right
+*       away, so samples aren't held back when there's
+*       bandwidth to spare. While it's busy samples pile up
+*       and go out in full frames, which spreads the frame
+*       overhead over the most samples.
+**********************************************************/
+class SensorBatch
+{
+public:
+    SensorBatch( Xbee *xbee );
+
+    void add( data_pkg_t const & sample );
+    void send();
+
+    void set_coded( bool coded );
+    void set_max_samples( uint8_t max_samples );
+    uint32_t dropped();
+
+private:
+    uint8_t build_raw( uint8_t * buffer, uint8_t & count );
+    uint8_t build_coded( uint8_t * buffer, uint8_t & count, TlmEncoder & encoder );
+    sensor_sample_t const & sample( uint8_t i );
+
+    Xbee *m_xbee;
+    TlmEncoder m_encoder;
+    bool m_coded = false;
+
+    // Ring of m_cnt samples starting at m_head
+    sensor_sample_t m_ring[SENSOR_BATCH_RING_SIZE];
+    uint8_t m_head = 0;
+    uint8_t m_cnt = 0;
+
+    uint16_t m_index = 0;
+    uint8_t m_max_samples = SENSOR_BATCH_MAX_SAMPLES;
+    uint32_t m_dropped = 0;
+};
+
+#endif
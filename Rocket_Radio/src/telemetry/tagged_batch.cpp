@@ -0,0 +1,160 @@
+#include "tagged_batch.h"
+
+#include <string.h>
+
+TaggedBatch::TaggedBatch( Xbee *xbee ) :
+    m_xbee( xbee )
+{
+    memset( m_decimation, 0, sizeof(m_decimation) );
+    memset( m_skip, 0, sizeof(m_skip) );
+}
+
+
+/**********************************************************
+*   set_decimation
+*       Send every decimation'th sample from source. 0
+*       sends none.
+**********************************************************/
+void TaggedBatch::set_decimation( src_id_t source, uint8_t decimation )
+{
+    if( source < SRC_CNT )
+    {
+        m_decimation[source] = decimation;
+        m_skip[source] = 0;
+    }
+}
+
+
+/**********************************************************
+*   add
+*       Queue a sample to be sent, if its source is due
+*       one. Drops the oldest samples waiting to make room.
+**********************************************************/
+void TaggedBatch::add( src_id_t source, void const * sample, uint8_t size )
+{
+    if( ( source >= SRC_CNT                     )
+     || ( size != src_sample_size( source )     )
+     || ( m_decimation[source] == 0             ) )
+    {
+        return;
+    }
+
+    if( ++m_skip[source] < m_decimation[source] )
+    {
+        return;
+    }
+    m_skip[source] = 0;
+
+    while( TAGGED_BATCH_BUF_SIZE - m_cnt < 1 + size )
+    {
+        this->drop_oldest();
+    }
+
+    uint8_t const * p = (uint8_t const *)sample;
+    m_buf[ ( m_head + m_cnt++ ) % TAGGED_BATCH_BUF_SIZE ] = source;
+    for( uint8_t i = 0; i < size; i++ )
+    {
+        m_buf[ ( m_head + m_cnt++ ) % TAGGED_BATCH_BUF_SIZE ] = p[i];
+    }
+}
+
+
+/**********************************************************
+*   send
+*       Send every full frame's worth of samples, then the
+*       rest too if the radio has nothing else to send.
+**********************************************************/
+void TaggedBatch::send()
+{
+    uint8_t buffer[ MAX_DATA_LENGTH - sizeof(data_type_t) ];
+
+    while( m_cnt > 0 )
+    {
+        uint16_t size = 0;
+
+        // Whole samples only
+        while( size < m_cnt )
+        {
+            uint8_t entry = 1 + src_sample_size( this->at( size ) );
+
+            if( size + entry > sizeof(buffer) )
+            {
+                break;
+            }
+
+            for( uint8_t i = 0; i < entry; i++ )
+            {
+                buffer[ size + i ] = this->at( size + i );
+            }
+            size += entry;
+        }
+
+        if( ( size == m_cnt )
+         && ( !m_xbee->tx_idle() ) )
+        {
+            return;
+        }
+
+        if( !m_xbee->send_data( SENSOR_TAGGED, buffer, (uint8_t)size, true ) )
+        {
+            return;
+        }
+
+        m_head = ( m_head + size ) % TAGGED_BATCH_BUF_SIZE;
+        m_cnt -= size;
+    }
+}
+
+
+/**********************************************************
+*   dropped
+*       Samples dropped because the buffer was full.
+**********************************************************/
+uint32_t TaggedBatch::dropped()
+{
+    return m_dropped;
+}
+
+
+uint8_t TaggedBatch::at( uint16_t i )
+{
+    return m_buf[ ( m_head + i ) % TAGGED_BATCH_BUF_SIZE ];
+}
+
+
+void TaggedBatch::drop_oldest()
+{
+    uint16_t entry = 1 + src_sample_size( this->at( 0 ) );
+
+    m_head = ( m_head + entry ) % TAGGED_BATCH_BUF_SIZE;
+    m_cnt -= entry;
+    m_dropped++;
+}
+
+
+/**********************************************************
+*   tagged_next
+*       Point source and sample at the sample at offset in
+*       a SENSOR_TAGGED frame and move offset past it.
+**********************************************************/
+bool tagged_next( uint8_t const * data, uint8_t size, uint8_t & offset, src_id_t & source, uint8_t const * & sample )
+{
+    if( offset >= size )
+    {
+        return false;
+    }
+
+    uint8_t sample_size = src_sample_size( data[offset] );
+
+    if( ( sample_size == 0 )
+     || ( offset + 1 + sample_size > size ) )
+    {
+        return false;
+    }
+
+    source = data[offset];
+    sample = &data[ offset + 1 ];
+    offset += 1 + sample_size;
+
+    return true;
+}
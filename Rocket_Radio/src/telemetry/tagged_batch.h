@@ -0,0 +1,78 @@
+#ifndef TAGGED_BATCH_H
+#define TAGGED_BATCH_H
+
+#include <stdint.h>
+
+#include "../sensor_data.h"
+#include "../xbee/xbee.h"
+
+
+/******************************************************************************
+ *                                   Defines
+ *****************************************************************************/
+
+// Bytes of tagged samples held waiting for the radio. Once full the
+//  oldest are dropped.
+#define TAGGED_BATCH_BUF_SIZE 512
+
+
+/******************************************************************************
+ *                          Function Declarations
+ *****************************************************************************/
+
+// Step through the samples in a SENSOR_TAGGED frame. Start with offset
+//  0, returns false at the end of the frame or at a source it doesn't
+//  know.
+bool tagged_next( uint8_t const * data, uint8_t size, uint8_t & offset, src_id_t & source, uint8_t const * & sample );
+
+
+/******************************************************************************
+ *                                 TaggedBatch
+ *****************************************************************************/
+
+/**********************************************************
+*   TaggedBatch
+*       Sends samples from sources running at different
+*       rates in SENSOR_TAGGED frames:
+*
+*           data type | source | sample | source | sample ...
+*
+*       Each sample is src_sample_size( source ) bytes and
+*       carries its own time_us, so the ground station can
+*       put the streams back on one time line. Each source
+*       is decimated on its own, and not sent at all until
+*       set_decimation says so.
+*
+*       Frames are filled the same way SensorBatch fills
+*       them, right away while the radio is idle, full
+*       while it's busy.
+**********************************************************/
+class TaggedBatch
+{
+public:
+    TaggedBatch( Xbee *xbee );
+
+    void set_decimation( src_id_t source, uint8_t decimation );
+
+    void add( src_id_t source, void const * sample, uint8_t size );
+    void send();
+
+    uint32_t dropped();
+
+private:
+    uint8_t at( uint16_t i );
+    void drop_oldest();
+
+    Xbee *m_xbee;
+
+    // Ring of m_cnt bytes starting at m_head
+    uint8_t m_buf[TAGGED_BATCH_BUF_SIZE];
+    uint16_t m_head = 0;
+    uint16_t m_cnt = 0;
+
+    uint8_t m_decimation[SRC_CNT];
+    uint8_t m_skip[SRC_CNT];
+    uint32_t m_dropped = 0;
+};
+
+#endif
@@ -0,0 +1,573 @@
+#include "tlm_codec.h"
+
+#include <math.h>
+#include <string.h>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define TLM_FLOAT_MAX ( ( 1L << ( TLM_FLOAT_BITS - 1 ) ) - 1 )
+#define TLM_ADC_MAX ( ( 1 << TLM_ADC_BITS ) - 1 )
+
+// Delta field codes
+#define TLM_CODE_SAME 0
+#define TLM_CODE_SMALL 1
+#define TLM_CODE_LARGE 2
+#define TLM_CODE_WHOLE 3
+#define TLM_CODE_BITS 2
+
+#define FLOAT_FIELD( field, res ) { offsetof( data_pkg_t, field ), offsetof( tlm_codec_cfg_t, res ) }
+
+
+/******************************************************************************
+ *                               Local Types
+ *****************************************************************************/
+
+// Where a float field is in data_pkg_t, and where its resolution is in
+//  the config.
+typedef struct
+{
+    uint8_t offset;
+    uint8_t res_offset;
+} tlm_float_field_t;
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+const tlm_codec_cfg_t tlm_codec_default_cfg =
+{
+    1.0f / 16.0f,   // BNO055 euler LSB
+    0.01f,          // BNO055 linear accel LSB
+    0.001f,         // DLV-015A is 14 bits over 15 PSI
+    0.1f,
+    10,             // A keyframe a second at 10Hz
+};
+
+// The floats in the order they're coded, after the ADC channels.
+static const tlm_float_field_t float_fields[ TLM_FIELD_CNT - TLM_ADC_CNT ] =
+{
+    FLOAT_FIELD( angle_x,       angle_res ),
+    FLOAT_FIELD( angle_y,       angle_res ),
+    FLOAT_FIELD( angle_z,       angle_res ),
+    FLOAT_FIELD( accel_x,       accel_res ),
+    FLOAT_FIELD( accel_y,       accel_res ),
+    FLOAT_FIELD( accel_z,       accel_res ),
+    FLOAT_FIELD( prsur,         prsur_res ),
+    FLOAT_FIELD( prsur_temp,    temp_res  ),
+};
+
+static const uint8_t adc_offsets[ TLM_ADC_CNT ] =
+{
+    offsetof( data_pkg_t, adc_chnl_0 ),
+    offsetof( data_pkg_t, adc_chnl_1 ),
+    offsetof( data_pkg_t, adc_chnl_2 ),
+    offsetof( data_pkg_t, adc_chnl_3 ),
+    offsetof( data_pkg_t, adc_chnl_4 ),
+    offsetof( data_pkg_t, adc_chnl_5 ),
+    offsetof( data_pkg_t, adc_chnl_6 ),
+    offsetof( data_pkg_t, adc_chnl_7 ),
+};
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+static float field_res( tlm_codec_cfg_t const & cfg, uint8_t i )
+{
+    float res;
+
+    memcpy( &res, (uint8_t const *)&cfg + float_fields[i].res_offset, sizeof(res) );
+
+    return res;
+}
+
+
+static uint8_t field_bits( uint8_t field )
+{
+    return ( field < TLM_ADC_CNT ) ? TLM_ADC_BITS : TLM_FLOAT_BITS;
+}
+
+
+/**********************************************************
+*   quantize
+*       Every field of sample as an integer. Floats are
+*       rounded to their resolution and clamped to 24 bits.
+**********************************************************/
+static void quantize( tlm_codec_cfg_t const & cfg, data_pkg_t const & sample, int32_t * q )
+{
+    uint8_t const * p = (uint8_t const *)&sample;
+
+    for( uint8_t i = 0; i < TLM_ADC_CNT; i++ )
+    {
+        uint16_t v;
+        memcpy( &v, &p[ adc_offsets[i] ], sizeof(v) );
+        q[i] = ( v > TLM_ADC_MAX ) ? TLM_ADC_MAX : v;
+    }
+
+    for( uint8_t i = 0; i < TLM_FIELD_CNT - TLM_ADC_CNT; i++ )
+    {
+        float v;
+        memcpy( &v, &p[ float_fields[i].offset ], sizeof(v) );
+
+        float scaled = v / field_res( cfg, i );
+        int32_t value;
+
+        if( scaled != scaled )
+        {
+            value = 0;
+        }
+        else if( scaled >= TLM_FLOAT_MAX )
+        {
+            value = TLM_FLOAT_MAX;
+        }
+        else if( scaled <= -TLM_FLOAT_MAX )
+        {
+            value = -TLM_FLOAT_MAX;
+        }
+        else
+        {
+            value = lroundf( scaled );
+        }
+
+        q[ TLM_ADC_CNT + i ] = value;
+    }
+}
+
+
+/**********************************************************
+*   dequantize
+*       Inverse of quantize.
+**********************************************************/
+static void dequantize( tlm_codec_cfg_t const & cfg, int32_t const * q, data_pkg_t & sample )
+{
+    uint8_t * p = (uint8_t *)&sample;
+
+    for( uint8_t i = 0; i < TLM_ADC_CNT; i++ )
+    {
+        uint16_t v = (uint16_t)q[i];
+        memcpy( &p[ adc_offsets[i] ], &v, sizeof(v) );
+    }
+
+    for( uint8_t i = 0; i < TLM_FIELD_CNT - TLM_ADC_CNT; i++ )
+    {
+        float v = q[ TLM_ADC_CNT + i ] * field_res( cfg, i );
+        memcpy( &p[ float_fields[i].offset ], &v, sizeof(v) );
+    }
+}
+
+
+static uint32_t zigzag( int32_t v )
+{
+    return ( (uint32_t)v << 1 ) ^ (uint32_t)( v >> 31 );
+}
+
+
+static int32_t unzigzag( uint32_t v )
+{
+    return (int32_t)( v >> 1 ) ^ -(int32_t)( v & 1 );
+}
+
+
+/**********************************************************
+*   delta_code
+*       Smallest code that holds delta, and its size in
+*       bits including the code.
+**********************************************************/
+static uint8_t delta_code( int32_t delta, uint8_t field, uint8_t & bits )
+{
+    uint32_t zz = zigzag( delta );
+
+    if( delta == 0 )
+    {
+        bits = TLM_CODE_BITS;
+        return TLM_CODE_SAME;
+    }
+    else if( zz < ( 1UL << TLM_DELTA_SMALL_BITS ) )
+    {
+        bits = TLM_CODE_BITS + TLM_DELTA_SMALL_BITS;
+        return TLM_CODE_SMALL;
+    }
+    else if( zz < ( 1UL << TLM_DELTA_LARGE_BITS ) )
+    {
+        bits = TLM_CODE_BITS + TLM_DELTA_LARGE_BITS;
+        return TLM_CODE_LARGE;
+    }
+
+    bits = TLM_CODE_BITS + field_bits( field );
+    return TLM_CODE_WHOLE;
+}
+
+
+/**********************************************************
+*   put_bits
+*       Write the low count bits of value at bit position
+*       pos, least significant bit first. The buffer must
+*       start out zeroed.
+**********************************************************/
+static void put_bits( uint8_t * buffer, uint16_t & pos, uint32_t value, uint8_t count )
+{
+    while( count > 0 )
+    {
+        uint8_t shift = pos & 7;
+        uint8_t take = 8 - shift;
+
+        if( take > count )
+        {
+            take = count;
+        }
+
+        buffer[ pos >> 3 ] |= (uint8_t)( ( value & ( ( 1U << take ) - 1 ) ) << shift );
+
+        value >>= take;
+        pos += take;
+        count -= take;
+    }
+}
+
+
+/**********************************************************
+*   get_bits
+*       Read count bits written by put_bits. Reads past
+*       end give zeros and set overrun.
+**********************************************************/
+static uint32_t get_bits( uint8_t const * buffer, uint16_t end, uint16_t & pos, uint8_t count, bool & overrun )
+{
+    uint32_t value = 0;
+    uint8_t done = 0;
+
+    if( pos + count > end )
+    {
+        overrun = true;
+        pos = end;
+        return 0;
+    }
+
+    while( done < count )
+    {
+        uint8_t shift = pos & 7;
+        uint8_t take = 8 - shift;
+
+        if( take > count - done )
+        {
+            take = count - done;
+        }
+
+        value |= (uint32_t)( ( buffer[ pos >> 3 ] >> shift ) & ( ( 1U << take ) - 1 ) ) << done;
+
+        pos += take;
+        done += take;
+    }
+
+    return value;
+}
+
+
+static int32_t sign_extend( uint32_t value, uint8_t bits )
+{
+    uint32_t sign = 1UL << ( bits - 1 );
+
+    return (int32_t)( ( value ^ sign ) - sign );
+}
+
+
+/******************************************************************************
+ *                               TlmEncoder
+ *****************************************************************************/
+
+/**********************************************************
+*   TlmEncoder
+*       Constructor
+**********************************************************/
+TlmEncoder::TlmEncoder( tlm_codec_cfg_t const & cfg ) :
+    m_cfg( cfg ),
+    m_next_index( 0 ),
+    m_need_key( true ),
+    m_buffer( NULL ),
+    m_bits( 0 ),
+    m_max_bits( 0 ),
+    m_count( 0 )
+{
+    memset( m_prev, 0, sizeof(m_prev) );
+
+    if( m_cfg.key_interval == 0 )
+    {
+        m_cfg.key_interval = 1;
+    }
+}
+
+
+/**********************************************************
+*   begin_frame
+*       Start a frame in buffer. The first sample added
+*       gets index first_index, the rest count up from it.
+**********************************************************/
+void TlmEncoder::begin_frame( uint8_t * buffer, uint8_t size, uint16_t first_index )
+{
+    m_buffer = buffer;
+    m_max_bits = ( size > TLM_FRAME_HDR_SIZE ) ? ( size - TLM_FRAME_HDR_SIZE ) * 8 : 0;
+    m_bits = 0;
+    m_count = 0;
+
+    memset( buffer, 0, size );
+    memcpy( buffer, &first_index, sizeof(first_index) );
+
+    // Deltas are no good if samples were skipped
+    if( first_index != m_next_index )
+    {
+        m_need_key = true;
+        m_next_index = first_index;
+    }
+}
+
+
+/**********************************************************
+*   add
+*       Add the next sample to the frame. Returns false,
+*       and leaves the frame as it was, if it doesn't fit.
+**********************************************************/
+bool TlmEncoder::add( data_pkg_t const & sample )
+{
+    int32_t q[ TLM_FIELD_CNT ];
+    uint8_t codes[ TLM_FIELD_CNT ];
+    uint8_t widths[ TLM_FIELD_CNT ];
+    uint16_t bits = 1;
+    bool key = ( m_need_key )
+            || ( m_next_index % m_cfg.key_interval == 0 );
+
+    if( m_count == UINT8_MAX )
+    {
+        return false;
+    }
+
+    quantize( m_cfg, sample, q );
+
+    // Size it first so a sample that won't fit changes nothing
+    for( uint8_t i = 0; i < TLM_FIELD_CNT; i++ )
+    {
+        if( key )
+        {
+            widths[i] = field_bits( i );
+        }
+        else
+        {
+            codes[i] = delta_code( q[i] - m_prev[i], i, widths[i] );
+        }
+
+        bits += widths[i];
+    }
+
+    if( m_bits + bits > m_max_bits )
+    {
+        return false;
+    }
+
+    uint8_t * data = &m_buffer[ TLM_FRAME_HDR_SIZE ];
+
+    put_bits( data, m_bits, key ? 1 : 0, 1 );
+
+    for( uint8_t i = 0; i < TLM_FIELD_CNT; i++ )
+    {
+        if( key )
+        {
+            put_bits( data, m_bits, (uint32_t)q[i], widths[i] );
+            continue;
+        }
+
+        put_bits( data, m_bits, codes[i], TLM_CODE_BITS );
+
+        switch( codes[i] )
+        {
+            case TLM_CODE_SMALL:
+            case TLM_CODE_LARGE:
+                put_bits( data, m_bits, zigzag( q[i] - m_prev[i] ), widths[i] - TLM_CODE_BITS );
+                break;
+
+            case TLM_CODE_WHOLE:
+                put_bits( data, m_bits, (uint32_t)q[i], widths[i] - TLM_CODE_BITS );
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    memcpy( m_prev, q, sizeof(m_prev) );
+    m_need_key = false;
+    m_next_index++;
+    m_count++;
+
+    return true;
+}
+
+
+/**********************************************************
+*   end_frame
+*       Finish the frame. Returns its size in bytes, 0 if
+*       no samples were added.
+**********************************************************/
+uint8_t TlmEncoder::end_frame()
+{
+    if( m_count == 0 )
+    {
+        return 0;
+    }
+
+    m_buffer[2] = m_count;
+
+    return TLM_FRAME_HDR_SIZE + ( m_bits + 7 ) / 8;
+}
+
+
+/**********************************************************
+*   force_key
+*       Make the next sample a keyframe.
+**********************************************************/
+void TlmEncoder::force_key()
+{
+    m_need_key = true;
+}
+
+
+/******************************************************************************
+ *                               TlmDecoder
+ *****************************************************************************/
+
+/**********************************************************
+*   TlmDecoder
+*       Constructor
+**********************************************************/
+TlmDecoder::TlmDecoder( tlm_codec_cfg_t const & cfg ) :
+    m_cfg( cfg ),
+    m_next_index( 0 ),
+    m_synced( false ),
+    m_skipped( 0 ),
+    m_bad_frames( 0 )
+{
+    memset( m_prev, 0, sizeof(m_prev) );
+}
+
+
+/**********************************************************
+*   decode_frame
+*       Decode a SENSOR_CODED frame, not including the
+*       data type, into samples. Returns the number of
+*       samples decoded.
+**********************************************************/
+uint8_t TlmDecoder::decode_frame( uint8_t const * buffer, uint8_t size, sensor_sample_t * samples, uint8_t max_samples )
+{
+    uint16_t first_index;
+    uint8_t count;
+    uint8_t decoded = 0;
+    uint16_t pos = 0;
+    bool overrun = false;
+
+    if( size < TLM_FRAME_HDR_SIZE )
+    {
+        m_bad_frames++;
+        return 0;
+    }
+
+    memcpy( &first_index, buffer, sizeof(first_index) );
+    count = buffer[2];
+
+    uint8_t const * data = &buffer[ TLM_FRAME_HDR_SIZE ];
+    uint16_t end = ( size - TLM_FRAME_HDR_SIZE ) * 8;
+
+    // Lost a frame, wait for a keyframe
+    if( first_index != m_next_index )
+    {
+        m_synced = false;
+    }
+
+    for( uint8_t s = 0; s < count; s++ )
+    {
+        int32_t q[ TLM_FIELD_CNT ];
+        bool key = get_bits( data, end, pos, 1, overrun );
+
+        for( uint8_t i = 0; i < TLM_FIELD_CNT; i++ )
+        {
+            uint8_t bits = field_bits( i );
+
+            if( key )
+            {
+                q[i] = get_bits( data, end, pos, bits, overrun );
+            }
+            else
+            {
+                switch( get_bits( data, end, pos, TLM_CODE_BITS, overrun ) )
+                {
+                    case TLM_CODE_SMALL:
+                        q[i] = m_prev[i] + unzigzag( get_bits( data, end, pos, TLM_DELTA_SMALL_BITS, overrun ) );
+                        break;
+
+                    case TLM_CODE_LARGE:
+                        q[i] = m_prev[i] + unzigzag( get_bits( data, end, pos, TLM_DELTA_LARGE_BITS, overrun ) );
+                        break;
+
+                    case TLM_CODE_WHOLE:
+                        q[i] = get_bits( data, end, pos, bits, overrun );
+                        break;
+
+                    default:
+                        q[i] = m_prev[i];
+                        break;
+                }
+            }
+
+            if( i >= TLM_ADC_CNT )
+            {
+                q[i] = sign_extend( (uint32_t)q[i] & ( ( 1UL << TLM_FLOAT_BITS ) - 1 ), TLM_FLOAT_BITS );
+            }
+        }
+
+        if( overrun )
+        {
+            m_bad_frames++;
+            m_synced = false;
+            break;
+        }
+
+        memcpy( m_prev, q, sizeof(m_prev) );
+        m_synced |= key;
+
+        if( ( !m_synced )
+         || ( decoded == max_samples ) )
+        {
+            m_skipped++;
+            continue;
+        }
+
+        samples[ decoded ].index = first_index + s;
+        dequantize( m_cfg, q, samples[ decoded ].data );
+        decoded++;
+    }
+
+    m_next_index = first_index + count;
+
+    return decoded;
+}
+
+
+/**********************************************************
+*   skipped
+*       Samples thrown away waiting for a keyframe.
+**********************************************************/
+uint32_t TlmDecoder::skipped()
+{
+    return m_skipped;
+}
+
+
+/**********************************************************
+*   bad_frames
+*       Frames that ended before their last sample.
+**********************************************************/
+uint32_t TlmDecoder::bad_frames()
+{
+    return m_bad_frames;
+}
@@ -0,0 +1,126 @@
+#ifndef TLM_CODEC_H
+#define TLM_CODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "../sensor_data.h"
+
+
+/******************************************************************************
+ *                                   Defines
+ *****************************************************************************/
+
+// Fields in a data_pkg_t. The 8 ADC channels then the 8 floats.
+#define TLM_FIELD_CNT 16
+#define TLM_ADC_CNT 8
+
+// Bits for a whole value. The MCP3008 is 10 bits, quantized floats are
+//  stored as 24 bit two's complement.
+#define TLM_ADC_BITS 10
+#define TLM_FLOAT_BITS 24
+
+// Delta sizes. Each field of a delta sample starts with a 2 bit code:
+//  0 - unchanged, 1 - TLM_DELTA_SMALL_BITS zigzag delta,
+//  2 - TLM_DELTA_LARGE_BITS zigzag delta, 3 - whole value.
+#define TLM_DELTA_SMALL_BITS 4
+#define TLM_DELTA_LARGE_BITS 8
+
+// SENSOR_CODED frame header, ahead of the bit packed samples.
+#define TLM_FRAME_HDR_SIZE 3
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// Resolution each float is sent at, and how often a keyframe is sent.
+typedef struct
+{
+    float angle_res;        // Degrees
+    float accel_res;        // m/s^2
+    float prsur_res;        // PSI
+    float temp_res;         // Degrees F
+    uint8_t key_interval;   // Samples
+} tlm_codec_cfg_t;
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+// The resolution of the sensors themselves. Both ends have to use the
+//  same settings.
+extern const tlm_codec_cfg_t tlm_codec_default_cfg;
+
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   TlmEncoder
+*       Packs data_pkg_t samples into SENSOR_CODED frames:
+*
+*           u16 first index | u8 count | bit packed samples
+*
+*       Every key_interval'th sample, and the first one
+*       after a gap in the indexes, is a keyframe holding
+*       every field whole. The rest hold each field as a
+*       delta from the sample before. ADC channels are
+*       exact, floats are rounded to the resolution in the
+*       config.
+**********************************************************/
+class TlmEncoder
+{
+public:
+    TlmEncoder( tlm_codec_cfg_t const & cfg = tlm_codec_default_cfg );
+
+    void begin_frame( uint8_t * buffer, uint8_t size, uint16_t first_index );
+    bool add( data_pkg_t const & sample );
+    uint8_t end_frame();
+
+    void force_key();
+
+private:
+    tlm_codec_cfg_t m_cfg;
+
+    int32_t m_prev[TLM_FIELD_CNT];
+    uint16_t m_next_index;
+    bool m_need_key;
+
+    uint8_t * m_buffer;
+    uint16_t m_bits;        // Bits written to m_buffer
+    uint16_t m_max_bits;
+    uint8_t m_count;
+};
+
+
+/**********************************************************
+*   TlmDecoder
+*       Turns SENSOR_CODED frames back into samples. After
+*       a lost frame delta samples are skipped until the
+*       next keyframe.
+**********************************************************/
+class TlmDecoder
+{
+public:
+    TlmDecoder( tlm_codec_cfg_t const & cfg = tlm_codec_default_cfg );
+
+    uint8_t decode_frame( uint8_t const * buffer, uint8_t size, sensor_sample_t * samples, uint8_t max_samples );
+
+    uint32_t skipped();
+    uint32_t bad_frames();
+
+private:
+    tlm_codec_cfg_t m_cfg;
+
+    int32_t m_prev[TLM_FIELD_CNT];
+    uint16_t m_next_index;
+    bool m_synced;
+
+    uint32_t m_skipped;
+    uint32_t m_bad_frames;
+};
+
+#endif
@@ -0,0 +1,11 @@
+#include "tlm_schema.h"
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+constexpr log_field_t tlm_schema_t::sensor[];
+constexpr log_field_t tlm_schema_t::gps[];
+constexpr uint8_t tlm_schema_t::sensor_cnt;
+constexpr uint8_t tlm_schema_t::gps_cnt;
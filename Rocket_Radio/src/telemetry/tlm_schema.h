@@ -0,0 +1,123 @@
+#ifndef TLM_SCHEMA_H
+#define TLM_SCHEMA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "../sensor_data.h"
+#include "../log/bin_log.h"
+#include "wire_schema.h"
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// Frame sizes the ground station's LabVIEW clusters, data_pkg_t.ctl and
+//  gps_data_t.ctl, are built for. A schema change that moves these needs
+//  the same change made there.
+#define SENSOR_DATA_WIRE_SIZE 48
+#define GPS_DATA_WIRE_SIZE 17
+
+// One sample in a SENSOR_BATCH frame, its index then its data.
+#define SENSOR_SAMPLE_WIRE_SIZE ( sizeof(uint16_t) + SENSOR_DATA_WIRE_SIZE )
+
+#define TLM_SENSOR_FIELD( name, type, precision, field ) \
+    { name, type, offsetof( data_pkg_t, field ), precision }
+
+#define TLM_GPS_FIELD( name, type, precision, field ) \
+    { name, type, offsetof( gps_data_t, field ), precision }
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+/**********************************************************
+*   tlm_schema_t
+*       Field tables for the structs that go over the
+*       radio. They're the SD log's layouts and CSV
+*       columns, in the CSV's order, and they're what
+*       WireSchema packs frames with, in struct order.
+*       Static members so there's one copy of each, in
+*       tlm_schema.cpp.
+**********************************************************/
+struct tlm_schema_t
+{
+    // Same columns, in the same order, as the sensor CSV files used to have.
+    static constexpr log_field_t sensor[] =
+    {
+        TLM_SENSOR_FIELD( "angle_X",           LOG_FIELD_FLOAT, 4, angle_x     ),
+        TLM_SENSOR_FIELD( "angle_Y",           LOG_FIELD_FLOAT, 4, angle_y     ),
+        TLM_SENSOR_FIELD( "angle_Z",           LOG_FIELD_FLOAT, 4, angle_z     ),
+        TLM_SENSOR_FIELD( "accel_X",           LOG_FIELD_FLOAT, 4, accel_x     ),
+        TLM_SENSOR_FIELD( "accel_Y",           LOG_FIELD_FLOAT, 4, accel_y     ),
+        TLM_SENSOR_FIELD( "accel_Z",           LOG_FIELD_FLOAT, 4, accel_z     ),
+        TLM_SENSOR_FIELD( "adc_chnl_0",        LOG_FIELD_U16,   0, adc_chnl_0  ),
+        TLM_SENSOR_FIELD( "adc_chnl_1",        LOG_FIELD_U16,   0, adc_chnl_1  ),
+        TLM_SENSOR_FIELD( "adc_chnl_2",        LOG_FIELD_U16,   0, adc_chnl_2  ),
+        TLM_SENSOR_FIELD( "adc_chnl_3",        LOG_FIELD_U16,   0, adc_chnl_3  ),
+        TLM_SENSOR_FIELD( "adc_chnl_4",        LOG_FIELD_U16,   0, adc_chnl_4  ),
+        TLM_SENSOR_FIELD( "adc_chnl_5",        LOG_FIELD_U16,   0, adc_chnl_5  ),
+        TLM_SENSOR_FIELD( "adc_chnl_6",        LOG_FIELD_U16,   0, adc_chnl_6  ),
+        TLM_SENSOR_FIELD( "adc_chnl_7",        LOG_FIELD_U16,   0, adc_chnl_7  ),
+        TLM_SENSOR_FIELD( "air pressure",      LOG_FIELD_FLOAT, 4, prsur       ),
+        TLM_SENSOR_FIELD( "air pressure temp", LOG_FIELD_FLOAT, 4, prsur_temp  ),
+    };
+
+    // Same columns, in the same order, as the GPS CSV files used to have.
+    static constexpr log_field_t gps[] =
+    {
+        TLM_GPS_FIELD( "year",          LOG_FIELD_U8,    0, year        ),
+        TLM_GPS_FIELD( "month",         LOG_FIELD_U8,    0, month       ),
+        TLM_GPS_FIELD( "day",           LOG_FIELD_U8,    0, day         ),
+        TLM_GPS_FIELD( "hour",          LOG_FIELD_U8,    0, hour        ),
+        TLM_GPS_FIELD( "minute",        LOG_FIELD_U8,    0, min         ),
+        TLM_GPS_FIELD( "second",        LOG_FIELD_U8,    0, sec         ),
+        TLM_GPS_FIELD( "latitude",      LOG_FIELD_FLOAT, 4, lat         ),
+        TLM_GPS_FIELD( "longitude",     LOG_FIELD_FLOAT, 4, lon         ),
+        TLM_GPS_FIELD( "fix",           LOG_FIELD_BOOL,  0, fix         ),
+        TLM_GPS_FIELD( "fix quality",   LOG_FIELD_U8,    0, fix_qual    ),
+        TLM_GPS_FIELD( "satellites",    LOG_FIELD_U8,    0, sat_num     ),
+    };
+
+    static constexpr uint8_t sensor_cnt = sizeof(sensor) / sizeof(sensor[0]);
+    static constexpr uint8_t gps_cnt = sizeof(gps) / sizeof(gps[0]);
+};
+
+#undef TLM_SENSOR_FIELD
+#undef TLM_GPS_FIELD
+
+// SENSOR_DATA frames, and each sample of a SENSOR_BATCH frame.
+typedef WireSchema< data_pkg_t, tlm_schema_t::sensor, tlm_schema_t::sensor_cnt > sensor_wire_t;
+
+// GPS_DATA frames.
+typedef WireSchema< gps_data_t, tlm_schema_t::gps, tlm_schema_t::gps_cnt > gps_wire_t;
+
+static_assert( sensor_wire_t::size == SENSOR_DATA_WIRE_SIZE, "SENSOR_DATA frames changed size, see data_pkg_t.ctl" );
+static_assert( gps_wire_t::size == GPS_DATA_WIRE_SIZE, "GPS_DATA frames changed size, see gps_data_t.ctl" );
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   sensor_sample_pack
+*       Write a sample as it goes in a SENSOR_BATCH frame,
+*       SENSOR_SAMPLE_WIRE_SIZE bytes.
+**********************************************************/
+inline void sensor_sample_pack( sensor_sample_t const & sample, uint8_t * out )
+{
+    wire_put( out, sample.index );
+    sensor_wire_t::pack( sample.data, &out[ sizeof(uint16_t) ] );
+}
+
+
+inline void sensor_sample_unpack( uint8_t const * in, sensor_sample_t & sample )
+{
+    sample.index = wire_get< uint16_t >( in );
+    sensor_wire_t::unpack( &in[ sizeof(uint16_t) ], sample.data );
+}
+
+#endif
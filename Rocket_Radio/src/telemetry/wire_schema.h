@@ -0,0 +1,229 @@
+#ifndef WIRE_SCHEMA_H
+#define WIRE_SCHEMA_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "../log/bin_log.h"
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// C type of each field type.
+template< log_field_type_t Type > struct wire_value;
+template<> struct wire_value< LOG_FIELD_U8 >    { typedef uint8_t type; };
+template<> struct wire_value< LOG_FIELD_U16 >   { typedef uint16_t type; };
+template<> struct wire_value< LOG_FIELD_U32 >   { typedef uint32_t type; };
+template<> struct wire_value< LOG_FIELD_I16 >   { typedef int16_t type; };
+template<> struct wire_value< LOG_FIELD_I32 >   { typedef int32_t type; };
+template<> struct wire_value< LOG_FIELD_FLOAT > { typedef float type; };
+template<> struct wire_value< LOG_FIELD_BOOL >  { typedef bool type; };
+
+// Unsigned type the same size as a value, to shift it out a byte at a
+//  time.
+template< uint8_t Size > struct wire_uint;
+template<> struct wire_uint< 1 > { typedef uint8_t type; };
+template<> struct wire_uint< 2 > { typedef uint16_t type; };
+template<> struct wire_uint< 4 > { typedef uint32_t type; };
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   wire_field_size
+*       Bytes a field type takes on the wire.
+**********************************************************/
+constexpr uint8_t wire_field_size( log_field_type_t type )
+{
+    return ( ( type == LOG_FIELD_U16 ) || ( type == LOG_FIELD_I16 ) ) ? 2 :
+           ( ( type == LOG_FIELD_U32 ) || ( type == LOG_FIELD_I32 ) || ( type == LOG_FIELD_FLOAT ) ) ? 4 : 1;
+}
+
+
+/**********************************************************
+*   wire_size
+*       Bytes count fields take on the wire.
+**********************************************************/
+constexpr uint16_t wire_size( log_field_t const * fields, uint8_t count )
+{
+    return ( count == 0 ) ? 0 : wire_field_size( fields[0].type ) + wire_size( fields + 1, count - 1 );
+}
+
+
+/**********************************************************
+*   wire_offset
+*       Where the field at offset in the struct goes on
+*       the wire. Fields go out in the order they sit in
+*       the struct, whatever order the table lists them
+*       in, with no padding between.
+**********************************************************/
+constexpr uint16_t wire_offset( log_field_t const * fields, uint8_t count, uint8_t offset )
+{
+    return ( count == 0 ) ? 0 :
+           ( ( fields[0].offset < offset ) ? wire_field_size( fields[0].type ) : 0 ) + wire_offset( fields + 1, count - 1, offset );
+}
+
+
+/**********************************************************
+*   wire_clear_of
+*       True if field's bytes in the struct don't overlap
+*       any of count others.
+**********************************************************/
+constexpr bool wire_clear_of( log_field_t const & field, log_field_t const * others, uint8_t count )
+{
+    return ( count == 0 ) ||
+           ( ( ( field.offset + wire_field_size( field.type ) <= others[0].offset )
+            || ( others[0].offset + wire_field_size( others[0].type ) <= field.offset ) )
+          && ( wire_clear_of( field, others + 1, count - 1 ) ) );
+}
+
+
+/**********************************************************
+*   wire_disjoint
+*       True if no two of count fields share a byte of the
+*       struct.
+**********************************************************/
+constexpr bool wire_disjoint( log_field_t const * fields, uint8_t count )
+{
+    return ( count < 2 ) ||
+           ( ( wire_clear_of( fields[0], fields + 1, count - 1 ) )
+          && ( wire_disjoint( fields + 1, count - 1 ) ) );
+}
+
+
+/**********************************************************
+*   wire_put
+*       Write value little endian a byte at a time, so out
+*       needn't be aligned.
+**********************************************************/
+template< typename V >
+inline void wire_put( uint8_t * out, V value )
+{
+    typename wire_uint< sizeof(V) >::type bits;
+
+    memcpy( &bits, &value, sizeof(bits) );
+    for( uint8_t i = 0; i < sizeof(V); i++ )
+    {
+        out[i] = (uint8_t)( bits >> ( 8 * i ) );
+    }
+}
+
+
+/**********************************************************
+*   wire_get
+*       Read a little endian value a byte at a time.
+**********************************************************/
+template< typename V >
+inline V wire_get( uint8_t const * in )
+{
+    typename wire_uint< sizeof(V) >::type bits = 0;
+    V value;
+
+    for( uint8_t i = 0; i < sizeof(V); i++ )
+    {
+        bits |= (typename wire_uint< sizeof(V) >::type)in[i] << ( 8 * i );
+    }
+    memcpy( &value, &bits, sizeof(value) );
+
+    return value;
+}
+
+
+template<>
+inline bool wire_get< bool >( uint8_t const * in )
+{
+    return in[0] != 0;
+}
+
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   wire_fields
+*       Packs and unpacks field I of a schema, then the
+*       ones after it. Unrolled at compile time, each field
+*       is a load from a fixed, aligned offset in T and
+*       byte stores to a fixed offset on the wire.
+**********************************************************/
+template< typename T, log_field_t const * Fields, uint8_t I, uint8_t Count >
+struct wire_fields
+{
+    typedef typename wire_value< Fields[I].type >::type value_t;
+
+    static constexpr uint8_t offset = Fields[I].offset;
+    static constexpr uint16_t wire = wire_offset( Fields, Count, Fields[I].offset );
+
+    static_assert( offset + sizeof(value_t) <= sizeof(T), "field runs off the end of the struct" );
+    static_assert( offset % alignof(value_t) == 0, "field isn't aligned in the struct" );
+
+    static void pack( T const & data, uint8_t * out )
+    {
+        value_t value;
+
+        memcpy( &value, (uint8_t const *)&data + offset, sizeof(value) );
+        wire_put( &out[wire], value );
+        wire_fields< T, Fields, I + 1, Count >::pack( data, out );
+    }
+
+    static void unpack( uint8_t const * in, T & data )
+    {
+        value_t value = wire_get< value_t >( &in[wire] );
+
+        memcpy( (uint8_t *)&data + offset, &value, sizeof(value) );
+        wire_fields< T, Fields, I + 1, Count >::unpack( in, data );
+    }
+};
+
+
+template< typename T, log_field_t const * Fields, uint8_t Count >
+struct wire_fields< T, Fields, Count, Count >
+{
+    static void pack( T const &, uint8_t * ) {}
+    static void unpack( uint8_t const *, T & ) {}
+};
+
+
+/**********************************************************
+*   WireSchema
+*       Turns a T into its bytes on the radio and back,
+*       driven by the same field table the SD log and its
+*       CSV columns use. The wire is every field in struct
+*       order, little endian and packed, so T itself can be
+*       laid out for the CPU rather than the radio.
+*
+*       Fields - Table of Count fields, offsets into T.
+**********************************************************/
+template< typename T, log_field_t const * Fields, uint8_t Count >
+class WireSchema
+{
+public:
+    static constexpr uint16_t size = wire_size( Fields, Count );
+
+    static_assert( wire_disjoint( Fields, Count ), "two fields share bytes of the struct" );
+
+    static void pack( T const & data, uint8_t * out )
+    {
+        wire_fields< T, Fields, 0, Count >::pack( data, out );
+    }
+
+    static void unpack( uint8_t const * in, T & data )
+    {
+        wire_fields< T, Fields, 0, Count >::unpack( in, data );
+    }
+
+    static uint16_t wire( uint8_t field )
+    {
+        return wire_offset( Fields, Count, Fields[field].offset );
+    }
+};
+
+
+template< typename T, log_field_t const * Fields, uint8_t Count >
+constexpr uint16_t WireSchema< T, Fields, Count >::size;
+
+#endif
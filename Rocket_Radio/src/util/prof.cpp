@@ -0,0 +1,210 @@
+#include "prof.h"
+
+#include <string.h>
+
+static_assert( PROF_SECTION_CNT <= UINT8_MAX, "section count is 8 bits" );
+static_assert( PROF_COUNT_CNT <= UINT8_MAX, "count count is 8 bits" );
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+char const * const prof_section_names[PROF_SECTION_CNT] =
+{
+    "loop",
+    "data_collect",
+    "data_send",
+    "gps_send",
+    "sd_write",
+    "xbee_read",
+    "acq_run",
+};
+
+char const * const prof_count_names[PROF_COUNT_CNT] =
+{
+    "adc_log_missed",
+    "adc_log_miss_rate",
+    "adc_dropped",
+    "acq_late",
+    "acq_failed",
+    "log_not_ready",
+};
+
+
+/******************************************************************************
+ *                                  Profiler
+ *****************************************************************************/
+
+Profiler::Profiler()
+{
+    this->clear( 0 );
+}
+
+
+/**********************************************************
+*   begin
+*       Clear every stat. On the board also starts the
+*       cycle counter, which is off out of reset.
+**********************************************************/
+void Profiler::begin( uint32_t now_ms )
+{
+#if defined( ARDUINO_ARCH_SAM )
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+
+    this->clear( now_ms );
+}
+
+
+uint32_t Profiler::start()
+{
+    return prof_ticks();
+}
+
+
+/**********************************************************
+*   stop
+*       Count a run of section that began at start.
+**********************************************************/
+void Profiler::stop( prof_section_t section, uint32_t start )
+{
+    this->add( section, prof_ticks() - start );
+}
+
+
+/**********************************************************
+*   add
+*       Count a run of section that took ticks.
+**********************************************************/
+void Profiler::add( prof_section_t section, uint32_t ticks )
+{
+    if( section >= PROF_SECTION_CNT )
+    {
+        return;
+    }
+
+    stat_t & stat = m_stats[section];
+    uint32_t us = ticks / PROF_TICKS_PER_US;
+    uint8_t bin = ( us < 2 ) ? 0 : 31 - __builtin_clz( us );
+
+    stat.count++;
+    stat.sum += ticks;
+    stat.min = ( ticks < stat.min ) ? ticks : stat.min;
+    stat.max = ( ticks > stat.max ) ? ticks : stat.max;
+    stat.hist[ ( bin < PROF_HIST_BINS ) ? bin : PROF_HIST_BINS - 1 ]++;
+}
+
+
+/**********************************************************
+*   loop
+*       Count a pass of loop().
+**********************************************************/
+void Profiler::loop( uint32_t now_ms )
+{
+    uint32_t elapsed = now_ms - m_window_ms;
+
+    m_window_loops++;
+    if( elapsed >= PROF_RATE_WINDOW_MS )
+    {
+        m_loops_per_s = (uint32_t)( (uint64_t)m_window_loops * 1000 / elapsed );
+        m_window_loops = 0;
+        m_window_ms = now_ms;
+    }
+}
+
+
+/**********************************************************
+*   overrun
+*       Count a task run that started late.
+**********************************************************/
+void Profiler::overrun()
+{
+    if( m_overruns < UINT16_MAX )
+    {
+        m_overruns++;
+    }
+}
+
+
+/**********************************************************
+*   set_count
+*       Set a count to go out with the times. Anything past
+*       UINT16_MAX is sent as UINT16_MAX.
+**********************************************************/
+void Profiler::set_count( prof_count_t count, uint32_t value )
+{
+    if( count < PROF_COUNT_CNT )
+    {
+        m_counts[count] = ( value < UINT16_MAX ) ? value : UINT16_MAX;
+    }
+}
+
+
+/**********************************************************
+*   fill
+*       Write a DIAGNOSTICS frame into buffer. Returns its
+*       size, 0 if it doesn't fit.
+**********************************************************/
+uint16_t Profiler::fill( uint8_t * buffer, uint16_t size, uint32_t now_ms )
+{
+    diag_hdr_t hdr;
+
+    if( size < DIAG_FRAME_SIZE )
+    {
+        return 0;
+    }
+
+    hdr.uptime_ms = now_ms - m_start_ms;
+    hdr.loops_per_s = m_loops_per_s;
+    hdr.overruns = m_overruns;
+    hdr.section_cnt = PROF_SECTION_CNT;
+    hdr.count_cnt = PROF_COUNT_CNT;
+    memcpy( buffer, &hdr, sizeof(hdr) );
+
+    for( uint8_t i = 0; i < PROF_SECTION_CNT; i++ )
+    {
+        stat_t const & stat = m_stats[i];
+        diag_stat_t out;
+
+        memset( &out, 0, sizeof(out) );
+        out.count = stat.count;
+
+        if( stat.count )
+        {
+            out.min_us = stat.min / PROF_TICKS_PER_US;
+            out.max_us = stat.max / PROF_TICKS_PER_US;
+            out.mean_us = (uint32_t)( stat.sum / stat.count / PROF_TICKS_PER_US );
+
+            for( uint8_t b = 0; b < PROF_HIST_BINS; b++ )
+            {
+                out.hist[b] = (uint8_t)( ( (uint64_t)stat.hist[b] * 255 + stat.count - 1 ) / stat.count );
+            }
+        }
+
+        memcpy( &buffer[ sizeof(hdr) + i * sizeof(out) ], &out, sizeof(out) );
+    }
+
+    memcpy( &buffer[ sizeof(hdr) + PROF_SECTION_CNT * sizeof(diag_stat_t) ], m_counts, sizeof(m_counts) );
+
+    return DIAG_FRAME_SIZE;
+}
+
+
+void Profiler::clear( uint32_t now_ms )
+{
+    memset( m_stats, 0, sizeof(m_stats) );
+    for( uint8_t i = 0; i < PROF_SECTION_CNT; i++ )
+    {
+        m_stats[i].min = UINT32_MAX;
+    }
+
+    m_start_ms = now_ms;
+    m_window_ms = now_ms;
+    m_window_loops = 0;
+    m_loops_per_s = 0;
+    m_overruns = 0;
+    memset( m_counts, 0, sizeof(m_counts) );
+}
@@ -0,0 +1,180 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#if defined( ARDUINO_ARCH_SAM )
+#include <Arduino.h>
+#else
+#include <chrono>
+#endif
+
+
+/******************************************************************************
+ *                                   Defines
+ *****************************************************************************/
+
+// Ticks of prof_ticks() per microsecond. The M3's cycle counter on the
+//  board, nanoseconds on the host.
+#if defined( ARDUINO_ARCH_SAM )
+#define PROF_TICKS_PER_US ( VARIANT_MCK / 1000000UL )
+#else
+#define PROF_TICKS_PER_US 1000UL
+#endif
+
+// Histogram buckets. Bucket 0 counts times under 2us, bucket n times
+//  from 2^n up to 2^(n+1) us, the last one everything longer.
+#define PROF_HIST_BINS 16
+
+// Window loops per second is counted over.
+#define PROF_RATE_WINDOW_MS 1000
+
+// DIAGNOSTICS frame size.
+#define DIAG_FRAME_SIZE ( sizeof(diag_hdr_t) + PROF_SECTION_CNT * sizeof(diag_stat_t) + PROF_COUNT_CNT * sizeof(uint16_t) )
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// Parts of the firmware that are timed.
+typedef uint8_t prof_section_t;
+enum
+{
+    PROF_LOOP           = 0,    // A whole pass of loop(), tasks included
+    PROF_DATA_COLLECT   = 1,    // data_collect_task
+    PROF_DATA_SEND      = 2,    // data_send_task
+    PROF_GPS_SEND       = 3,    // gps_send_task
+    PROF_SD_WRITE       = 4,    // log_writer.service()
+    PROF_XBEE_READ      = 5,    // xbee.read()
+    PROF_ACQ_RUN        = 6,    // acq.run()
+
+    PROF_SECTION_CNT
+};
+
+// Counts sent and saved with the times. Set from the firmware's own
+//  counters with set_count().
+typedef uint8_t prof_count_t;
+enum
+{
+    PROF_CNT_ADC_LOG_MISSED     = 0,    // ADC samples missed while logging
+    PROF_CNT_ADC_LOG_MISS_RATE  = 1,    // The same over the samples due then, in 0.01%
+    PROF_CNT_ADC_DROPPED        = 2,    // ADC samples the log ring had no room for
+    PROF_CNT_ACQ_LATE           = 3,    // Sensor reads skipped for being late, all sources
+    PROF_CNT_ACQ_FAILED         = 4,    // Sensor reads that failed, all sources
+    PROF_CNT_LOG_NOT_READY      = 5,    // Launches with no log file ready to open
+
+    PROF_COUNT_CNT
+};
+
+// DIAGNOSTICS frame, and the stats at the end of a log's header. Followed
+//  by section_cnt diag_stat_t, in prof_section_t order, then count_cnt
+//  uint16_t counts, in prof_count_t order.
+typedef struct __attribute__((packed))
+{
+    uint32_t uptime_ms;
+    uint32_t loops_per_s;
+    uint16_t overruns;      // Task runs that started behind schedule
+    uint8_t section_cnt;
+    uint8_t count_cnt;
+} diag_hdr_t;
+
+// Times are in us, and everything counts from boot. hist is each
+//  bucket's share of count in 255ths, rounded up so a bucket that was
+//  ever hit is never 0.
+typedef struct __attribute__((packed))
+{
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint32_t mean_us;
+    uint8_t hist[PROF_HIST_BINS];
+} diag_stat_t;
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+extern char const * const prof_section_names[PROF_SECTION_CNT];
+extern char const * const prof_count_names[PROF_COUNT_CNT];
+
+
+/******************************************************************************
+ *                          Function Declarations
+ *****************************************************************************/
+
+/**********************************************************
+*   prof_ticks
+*       Free running tick count. Wraps, so only the
+*       difference between two reads means anything. On
+*       the board that's up to about 51s.
+**********************************************************/
+inline uint32_t prof_ticks()
+{
+#if defined( ARDUINO_ARCH_SAM )
+    return DWT->CYCCNT;
+#else
+    return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+#endif
+}
+
+
+/******************************************************************************
+ *                                  Profiler
+ *****************************************************************************/
+
+/**********************************************************
+*   Profiler
+*       Times sections of the firmware with prof_ticks().
+*       Keeps the count, min, max, mean and a log2
+*       histogram of each, loop() passes per second and how
+*       many task runs were late. Costs two tick reads and
+*       a few adds per section. Counts kept elsewhere go
+*       out with them.
+*
+*           uint32_t start = prof.start();
+*           xbee.read();
+*           prof.stop( PROF_XBEE_READ, start );
+**********************************************************/
+class Profiler
+{
+public:
+    Profiler();
+
+    void begin( uint32_t now_ms );
+
+    uint32_t start();
+    void stop( prof_section_t section, uint32_t start );
+    void add( prof_section_t section, uint32_t ticks );
+
+    void loop( uint32_t now_ms );
+    void overrun();
+    void set_count( prof_count_t count, uint32_t value );
+
+    uint16_t fill( uint8_t * buffer, uint16_t size, uint32_t now_ms );
+
+private:
+    void clear( uint32_t now_ms );
+
+    struct stat_t
+    {
+        uint32_t count;
+        uint32_t min;
+        uint32_t max;
+        uint64_t sum;
+        uint32_t hist[PROF_HIST_BINS];
+    };
+
+    stat_t m_stats[PROF_SECTION_CNT];
+
+    uint32_t m_start_ms;
+    uint32_t m_window_ms;
+    uint32_t m_window_loops;
+    uint32_t m_loops_per_s;
+    uint16_t m_overruns;
+    uint16_t m_counts[PROF_COUNT_CNT];
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdint.h>
+#include <atomic>
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   SpscRing
+*       Lock free ring for one producer and one consumer,
+*       for example an interrupt handler feeding loop().
+*       push() is only ever called by the producer and
+*       pop() by the consumer. Neither blocks or disables
+*       interrupts. A push to a full ring is dropped and
+*       counted, the items already queued are kept.
+*
+*       T    - Item type, copied in and out.
+*       Size - Slots, a power of two up to 32768.
+**********************************************************/
+template< typename T, uint16_t Size >
+class SpscRing
+{
+public:
+    static_assert( ( Size >= 2 ) && ( ( Size & ( Size - 1 ) ) == 0 ), "Size has to be a power of two" );
+    static_assert( Size <= 32768, "indexes are 16 bits" );
+
+    SpscRing();
+
+    bool push( T const & item );
+    bool pop( T & item );
+
+    uint16_t count() const;
+    bool empty() const;
+    uint32_t dropped() const;
+
+private:
+    T m_items[Size];
+
+    // Free running, only the low bits index m_items. m_tail is only
+    //  written by the producer and m_head by the consumer.
+    std::atomic<uint16_t> m_head;
+    std::atomic<uint16_t> m_tail;
+
+    std::atomic<uint32_t> m_dropped;
+};
+
+
+/******************************************************************************
+ *                          Method Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   SpscRing
+*       Constructor
+**********************************************************/
+template< typename T, uint16_t Size >
+SpscRing< T, Size >::SpscRing() :
+    m_head( 0 ),
+    m_tail( 0 ),
+    m_dropped( 0 )
+{
+}
+
+
+/**********************************************************
+*   push
+*       Producer side. Returns false, and counts a drop,
+*       if the ring is full.
+**********************************************************/
+template< typename T, uint16_t Size >
+bool SpscRing< T, Size >::push( T const & item )
+{
+    uint16_t tail = m_tail.load( std::memory_order_relaxed );
+
+    if( (uint16_t)( tail - m_head.load( std::memory_order_acquire ) ) == Size )
+    {
+        m_dropped.store( m_dropped.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+        return false;
+    }
+
+    m_items[ tail & ( Size - 1 ) ] = item;
+
+    // The item has to be in place before the consumer can see it
+    m_tail.store( tail + 1, std::memory_order_release );
+
+    return true;
+}
+
+
+/**********************************************************
+*   pop
+*       Consumer side. Returns false if the ring is empty.
+**********************************************************/
+template< typename T, uint16_t Size >
+bool SpscRing< T, Size >::pop( T & item )
+{
+    uint16_t head = m_head.load( std::memory_order_relaxed );
+
+    if( head == m_tail.load( std::memory_order_acquire ) )
+    {
+        return false;
+    }
+
+    item = m_items[ head & ( Size - 1 ) ];
+
+    // Done with the slot, the producer may reuse it
+    m_head.store( head + 1, std::memory_order_release );
+
+    return true;
+}
+
+
+/**********************************************************
+*   count
+*       Items queued. Only exact from the consumer side.
+**********************************************************/
+template< typename T, uint16_t Size >
+uint16_t SpscRing< T, Size >::count() const
+{
+    return m_tail.load( std::memory_order_acquire ) - m_head.load( std::memory_order_relaxed );
+}
+
+
+template< typename T, uint16_t Size >
+bool SpscRing< T, Size >::empty() const
+{
+    return this->count() == 0;
+}
+
+
+/**********************************************************
+*   dropped
+*       Pushes refused because the ring was full.
+**********************************************************/
+template< typename T, uint16_t Size >
+uint32_t SpscRing< T, Size >::dropped() const
+{
+    return m_dropped.load( std::memory_order_relaxed );
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef crc16_h
+#define crc16_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define CRC16_CCITT_INIT_VAL 0xFFFF
+
+// Available CRC engines. All of them produce the same value as
+//  avr-libc's _crc_ccitt_update (reflected 0x8408 polynomial), which is
+//  what the ground station's update_crc16.vi implements.
+#define CRC16_ENGINE_BITWISE 0  // No tables, smallest flash footprint
+#define CRC16_ENGINE_TABLE   1  // 256 entry table, 512 bytes of flash
+#define CRC16_ENGINE_SLICE4  2  // 4x256 entry tables, 2k of flash
+
+// Pick the engine with -DCRC16_ENGINE=... in the build flags.
+#ifndef CRC16_ENGINE
+#define CRC16_ENGINE CRC16_ENGINE_TABLE
+#endif
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+extern const uint16_t crc16_ccitt_table[256];
+extern const uint16_t crc16_ccitt_slice_table[3][256];
+
+
+/******************************************************************************
+ *                          Function Declarations
+ *****************************************************************************/
+
+uint16_t crc16_ccitt_update_bitwise( uint16_t crc, uint8_t data );
+
+uint16_t crc16_ccitt_block_bitwise( uint16_t crc, uint8_t const * buffer, size_t length );
+uint16_t crc16_ccitt_block_table( uint16_t crc, uint8_t const * buffer, size_t length );
+uint16_t crc16_ccitt_block_slice4( uint16_t crc, uint8_t const * buffer, size_t length );
+
+
+/**********************************************************
+*   crc16_ccitt_update_table
+*       Update the crc for one byte using the lookup
+*       table.
+**********************************************************/
+static inline uint16_t crc16_ccitt_update_table( uint16_t crc, uint8_t data )
+{
+    return ( crc >> 8 ) ^ crc16_ccitt_table[ ( crc ^ data ) & 0xFF ];
+}
+
+
+/**********************************************************
+*   crc16_ccitt_update
+*       Update the crc for one byte with the selected
+*       engine. Slice-by-4 only helps on blocks so single
+*       bytes use the plain table.
+**********************************************************/
+static inline uint16_t crc16_ccitt_update( uint16_t crc, uint8_t data )
+{
+#if CRC16_ENGINE == CRC16_ENGINE_BITWISE
+    return crc16_ccitt_update_bitwise( crc, data );
+#else
+    return crc16_ccitt_update_table( crc, data );
+#endif
+}
+
+
+/**********************************************************
+*   crc16_ccitt_block
+*       Update the crc for a block of bytes with the
+*       selected engine.
+**********************************************************/
+static inline uint16_t crc16_ccitt_block( uint16_t crc, uint8_t const * buffer, size_t length )
+{
+#if CRC16_ENGINE == CRC16_ENGINE_BITWISE
+    return crc16_ccitt_block_bitwise( crc, buffer, length );
+#elif CRC16_ENGINE == CRC16_ENGINE_TABLE
+    return crc16_ccitt_block_table( crc, buffer, length );
+#else
+    return crc16_ccitt_block_slice4( crc, buffer, length );
+#endif
+}
+
+#endif
@@ -1,27 +1,66 @@
 #ifndef hdlc_h
 #define hdlc_h
 
-#include "Arduino.h"
 #include <stdint.h>
+#include <stddef.h>
 #include <stdbool.h>
-#include <functional>
+#include <string.h>
+
+#include "crc16.h"
+#include "rs_code.h"
 
 /******************************************************************************
  *                                 Defines
  *****************************************************************************/
 
+#define FRAME_BOUNDARY_OCTET 0x7E
+#define CONTROL_ESCAPE_OCTET 0x7D
+#define INVERT_OCTET 0x20
 
-/******************************************************************************
- *                               Global Types
- *****************************************************************************/
+// Worst case size of an encoded frame carrying length data bytes. Every
+//  data and crc byte escaped plus the two boundary bytes.
+#define HDLC_ENCODED_LENGTH(length) ( 2 * ( (length) + 2 ) + 2 )
+
+// Data bytes escaped at a time by the streaming send, sized so the
+//  escaped chunk stays on the stack.
+#define HDLC_STREAM_CHUNK 32
+
+// Set in the first data byte, the data type, of a frame sent with FEC.
+#define HDLC_FEC_FLAG 0x80
+
+// Data types are below this. A frame that fails its check is tried
+//  again with HDLC_FEC_FLAG flipped if the rest of its first byte is
+//  one.
+#ifndef HDLC_DATA_TYPE_CNT
+#define HDLC_DATA_TYPE_CNT 16
+#endif
+
+// Message bytes in each FEC block. The data and crc are cut into blocks
+//  this long, the last one shorter, each followed by its parity.
+#define HDLC_FEC_DATA ( RS_BLOCK_SIZE - RS_FEC_NROOTS )
+
+// Bytes in a frame carrying a message, data plus crc, of length bytes
+//  once the parity of every block is added.
+#define HDLC_FEC_LENGTH(length) ( (length) + ( ( (length) + HDLC_FEC_DATA - 1 ) / HDLC_FEC_DATA ) * RS_FEC_NROOTS )
+
+// Worst case size of an encoded FEC frame carrying length data bytes.
+#define HDLC_FEC_ENCODED_LENGTH(length) ( 2 * HDLC_FEC_LENGTH( (length) + 2 ) + 2 )
 
-typedef std::function<void(uint8_t)> send_hdnlr_t;
-typedef std::function<void(uint8_t*, uint8_t)> recv_hndlr_t;
 
 /******************************************************************************
- *                          Function Declarations
+ *                               Global Types
  *****************************************************************************/
 
+// State of a frame being encoded a piece at a time.
+typedef struct
+{
+    uint16_t fcs;
+    bool fec;
+    uint16_t length;                    // Message bytes so far, FEC only
+    uint8_t fill;                       // Message bytes in the open block
+    uint8_t parity[ RS_FEC_NROOTS ];    // Parity of the open block
+} hdlc_encode_t;
+
 
 /******************************************************************************
  *                                Classes
@@ -30,32 +69,636 @@ typedef std::function<void(uint8_t*, uint8_t)> recv_hndlr_t;
 /**********************************************************
 *   Hdlc
 *       Used to wrap data in an HDLC frame for transmission
-*       and to parse HDLC frames byte by byte as they're 
-*       received.
+*       and to parse HDLC frames byte by byte or a block at
+*       a time as they're received.
+*
+*       MaxLen  - Max data bytes in a frame. Sizes the
+*                 frame buffers at compile time.
+*       Sink    - Where encoded bytes go. Needs
+*                 write( uint8_t const *, size_t ), and
+*                 write( uint8_t ) only if
+*                 send_frame_bytes is used, so a
+*                 UARTClass works as is.
+*       Handler - Gets complete frames through
+*                 frame_received( uint8_t *, uint16_t ).
+*
+*       Both are called directly so the calls can be
+*       inlined, and nothing is allocated on the heap.
+*       Frames are decoded into a buffer the caller gives,
+*       of max_frame_length bytes, and the Hdlc holds no
+*       frame buffers of its own.
+*
+*       A frame can be sent whole with send_frame or
+*       encode_frame, or streamed with begin_frame,
+*       append_frame and end_frame so a large payload never
+*       has to be put together in one buffer. The crc is
+*       worked out as the pieces go by. send_frame_bytes
+*       is the old byte at a time path, for a sink that
+*       only takes single bytes.
+*
+*       Frames sent with fec set carry Reed-Solomon parity
+*       after every HDLC_FEC_DATA bytes of data and crc,
+*       and HDLC_FEC_FLAG in their first byte. The
+*       receiver fixes what it can before checking the crc
+*       and hands the frame on with the flag cleared, so
+*       handlers can't tell the two apart. The flag picks
+*       the path before anything is fixed, so a frame that
+*       fails is tried once more down the other one.
 **********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
 class Hdlc
 {
 public:
-    Hdlc( uint16_t max_data_length );
+    static_assert( HDLC_ENCODED_LENGTH( MaxLen ) <= UINT16_MAX, "frame lengths are 16 bits" );
+
+    static_assert( HDLC_FEC_ENCODED_LENGTH( MaxLen ) <= UINT16_MAX, "frame lengths are 16 bits" );
+
+    static const uint16_t max_frame_length = HDLC_FEC_LENGTH( MaxLen + 2 );
+    static const uint16_t max_encoded_length = HDLC_FEC_ENCODED_LENGTH( MaxLen );
+
+    Hdlc( Sink & sink, Handler & handler, uint8_t * rcv_buffer );
 
-    void set_send_hndlr( send_hdnlr_t const & send_byte_hndlr );
-    void set_rcv_hndlr( recv_hndlr_t const & recv_hndlr );
+    void set_rcv_buffer( uint8_t * buffer );
 
     void byte_receive( uint8_t data );
-    void send_frame( uint8_t const * const buffer, uint8_t length );
+    void receive( uint8_t const * data, size_t length );
+    void send_frame( uint8_t const * const buffer, uint16_t length, bool fec = false );
+    void send_frame_bytes( uint8_t const * const buffer, uint16_t length, bool fec = false );
+
+    void begin_frame( bool fec = false );
+    void append_frame( uint8_t const * buffer, uint16_t length );
+    void end_frame();
+
+    static uint16_t encode_frame( uint8_t const * const buffer, uint16_t length, uint8_t * out, uint16_t out_size, bool fec = false );
+
+    static uint8_t * encode_begin( uint8_t * out, hdlc_encode_t &state, bool fec = false );
+    static uint8_t * encode_append( uint8_t const * buffer, uint16_t length, uint8_t * out, hdlc_encode_t &state );
+    static uint8_t * encode_end( uint8_t * out, hdlc_encode_t &state );
+
+    uint32_t crc_errors() const;
+    uint32_t fec_corrected() const;
+
+private:
+    bool check_frame( uint8_t * buffer, uint16_t &length, bool fec );
+    bool fec_decode( uint8_t * buffer, uint16_t &length );
+    static uint8_t * fec_append( uint8_t const * buffer, uint16_t length, uint8_t * out, hdlc_encode_t &state );
+    static uint8_t * escape_byte( uint8_t data, uint8_t * out );
+    void write_bytes( uint8_t const * out, uint8_t const * end );
 
-private:    
-    void send_byte( uint8_t data );
-    void send_boundry_byte();
+    Sink & m_sink;
+    Handler & m_handler;
 
-    send_hdnlr_t m_send_byte_hndlr;
-    recv_hndlr_t m_recv_frame_hndlr;
-        
     bool escape_character;
     uint8_t *receive_frame_buffer;
-    uint8_t frame_position;
-    uint16_t frame_checksum;
-    uint16_t max_frame_length;
+    uint16_t frame_position;
+    uint32_t m_crc_errors;
+    uint32_t m_fec_corrected;
+    hdlc_encode_t m_send;
 };
 
-#endif
\ No newline at end of file
+
+/******************************************************************************
+ *                          Method Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   Hdlc
+*       Constructor. Received frames are decoded into
+*       rcv_buffer, which must hold max_frame_length bytes.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+Hdlc< MaxLen, Sink, Handler >::Hdlc( Sink & sink, Handler & handler, uint8_t * rcv_buffer ) :
+    m_sink( sink ),
+    m_handler( handler ),
+    escape_character( false ),
+    receive_frame_buffer( rcv_buffer ),
+    frame_position( 0 ),
+    m_crc_errors( 0 ),
+    m_fec_corrected( 0 )
+{
+}
+
+
+/**********************************************************
+*   set_rcv_buffer
+*       Decode received frames into buffer from now on.
+*       buffer must hold max_frame_length bytes. Safe to
+*       call from the receive handler, the next frame goes
+*       into the new buffer.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+void Hdlc< MaxLen, Sink, Handler >::set_rcv_buffer( uint8_t * buffer )
+{
+    this->receive_frame_buffer = buffer;
+}
+
+
+/**********************************************************
+*   byte_receive
+*       Function to find valid HDLC frame from incoming
+*       data
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+void Hdlc< MaxLen, Sink, Handler >::byte_receive( uint8_t data )
+{
+    this->receive( &data, 1 );
+}
+
+
+/**********************************************************
+*   receive
+*       Find valid HDLC frames in a block of incoming
+*       data. The receive handler is called once for
+*       every complete frame in the block. The parser
+*       state lives in locals for the length of the block
+*       so stores into the frame buffer don't force it to
+*       be reloaded for every byte.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+void Hdlc< MaxLen, Sink, Handler >::receive( uint8_t const * data, size_t length )
+{
+    uint8_t const * const end = data + length;
+    uint8_t * buffer = this->receive_frame_buffer;
+    uint16_t position = this->frame_position;
+    bool escape = this->escape_character;
+
+    while( data < end )
+    {
+        uint8_t byte = *data++;
+
+        // We're either at the beging or end of a frame
+        if( byte == FRAME_BOUNDARY_OCTET )
+        {
+            // We expected to get an escaped char instead
+            //  we got the frame boundry. Discard partial
+            //  frame.
+            if( escape )
+            {
+                escape = false;
+            }
+            // Check if we're at the end of the frame and
+            //  if its crc is valid. FEC frames are fixed up
+            //  first.
+            else if( position >= 2 )
+            {
+                uint16_t frame_length = position;
+                bool fec = ( buffer[0] & HDLC_FEC_FLAG ) != 0;
+                bool good = this->check_frame( buffer, frame_length, fec );
+
+                // A hit on the flag bit sends the frame down the
+                //  wrong path. Try the other one if the rest of
+                //  the first byte could still be a data type.
+                if( ( !good )
+                 && ( ( buffer[0] & ~HDLC_FEC_FLAG ) < HDLC_DATA_TYPE_CNT ) )
+                {
+                    buffer[0] ^= HDLC_FEC_FLAG;
+                    frame_length = position;
+                    good = this->check_frame( buffer, frame_length, !fec );
+                }
+
+                if( good )
+                {
+                    // The handler may hand us a new buffer
+                    this->frame_position = 0;
+                    this->escape_character = false;
+                    m_handler.frame_received( buffer, frame_length );
+                    buffer = this->receive_frame_buffer;
+                }
+                else
+                {
+                    m_crc_errors++;
+                }
+            }
+
+            // Reset the frame
+            position = 0;
+            continue;
+        }
+
+        // The previous char was an escape.
+        //  Convert data back to unescaped version.
+        if( escape )
+        {
+            escape = false;
+            byte ^= INVERT_OCTET;
+        }
+        // This char is an escape char
+        else if( byte == CONTROL_ESCAPE_OCTET )
+        {
+            escape = true;
+            continue;
+        }
+
+        // Throw away frame if it's longer than the max frame
+        //  length. A frame that just fills the buffer is fine.
+        if( position == max_frame_length )
+        {
+            position = 0;
+        }
+
+        // Add data to frame buffer
+        buffer[ position++ ] = byte;
+    }
+
+    this->frame_position = position;
+    this->escape_character = escape;
+}
+
+
+/**********************************************************
+*   crc_errors
+*       Frames thrown away because their crc was wrong.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+uint32_t Hdlc< MaxLen, Sink, Handler >::crc_errors() const
+{
+    return m_crc_errors;
+}
+
+
+/**********************************************************
+*   fec_corrected
+*       Frames that only got through because FEC fixed
+*       them.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+uint32_t Hdlc< MaxLen, Sink, Handler >::fec_corrected() const
+{
+    return m_fec_corrected;
+}
+
+
+/**********************************************************
+*   check_frame
+*       Check a received frame of length bytes, crc
+*       included, as a plain frame or, if fec is set, fix
+*       it up as an FEC frame first. On success length is
+*       the frame's data length.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+bool Hdlc< MaxLen, Sink, Handler >::check_frame( uint8_t * buffer, uint16_t &length, bool fec )
+{
+    if( fec )
+    {
+        return this->fec_decode( buffer, length );
+    }
+
+    length -= 2;
+    return ( length <= MaxLen )
+        && ( crc16_ccitt_block( CRC16_CCITT_INIT_VAL, buffer, length ) == ( ( buffer[length + 1] << 8 ) | buffer[length] ) ); // (msb << 8 ) | lsb
+}
+
+
+/**********************************************************
+*   fec_decode
+*       Fix each block of an FEC frame of length bytes in
+*       place, pull the message bytes together and check
+*       the crc. On success length is the frame's data
+*       length and the FEC flag is cleared.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+bool Hdlc< MaxLen, Sink, Handler >::fec_decode( uint8_t * buffer, uint16_t &length )
+{
+    uint16_t message = 0;
+    uint16_t fixed = 0;
+    uint16_t position = 0;
+
+    while( position < length )
+    {
+        uint16_t block = length - position;
+        int count;
+
+        if( block > RS_BLOCK_SIZE )
+        {
+            block = RS_BLOCK_SIZE;
+        }
+
+        count = rs_fec.decode( &buffer[ position ], block );
+        if( count < 0 )
+        {
+            return false;
+        }
+
+        // Only the last block can be short. decode already turned
+        //  away one with no message bytes.
+        memmove( &buffer[ message ], &buffer[ position ], block - RS_FEC_NROOTS );
+        message += block - RS_FEC_NROOTS;
+        position += block;
+        fixed += count;
+    }
+
+    if( message < 3 )
+    {
+        return false;
+    }
+
+    length = message - 2;
+    if( crc16_ccitt_block( CRC16_CCITT_INIT_VAL, buffer, length ) != ( ( buffer[length + 1] << 8 ) | buffer[length] ) )
+    {
+        return false;
+    }
+
+    if( fixed > 0 )
+    {
+        m_fec_corrected++;
+    }
+
+    buffer[0] &= ~HDLC_FEC_FLAG;
+    return true;
+}
+
+
+/**********************************************************
+*   send_frame
+*       Wrap given data in HDLC frame and send it out,
+*       with FEC parity if fec is set.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+void Hdlc< MaxLen, Sink, Handler >::send_frame( uint8_t const * const buffer, uint16_t length, bool fec )
+{
+    this->begin_frame( fec );
+    this->append_frame( buffer, length );
+    this->end_frame();
+}
+
+
+/**********************************************************
+*   send_frame_bytes
+*       The same frame as send_frame, given to the sink a
+*       byte at a time through write( uint8_t ). Every
+*       byte is a sink call, so it's only for a sink that
+*       can't take blocks.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+void Hdlc< MaxLen, Sink, Handler >::send_frame_bytes( uint8_t const * const buffer, uint16_t length, bool fec )
+{
+    // The crc can finish one FEC block and start another
+    uint8_t out[ 2 * ( 2 + 2 * RS_FEC_NROOTS ) + 1 ];
+    hdlc_encode_t state;
+
+    this->write_bytes( out, encode_begin( out, state, fec ) );
+    for( uint16_t i = 0; i < length; i++ )
+    {
+        this->write_bytes( out, encode_append( &buffer[i], 1, out, state ) );
+    }
+    this->write_bytes( out, encode_end( out, state ) );
+}
+
+
+/**********************************************************
+*   begin_frame
+*       Start streaming a frame to the sink. Follow with
+*       any number of append_frame calls and one
+*       end_frame.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+void Hdlc< MaxLen, Sink, Handler >::begin_frame( bool fec )
+{
+    uint8_t out[ 1 ];
+    uint8_t * end = encode_begin( out, m_send, fec );
+
+    m_sink.write( out, end - out );
+}
+
+
+/**********************************************************
+*   append_frame
+*       Escape the next piece of the frame's data and send
+*       it, a chunk at a time so the sink gets blocks
+*       rather than single bytes.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+void Hdlc< MaxLen, Sink, Handler >::append_frame( uint8_t const * buffer, uint16_t length )
+{
+    // A chunk can finish at most one FEC block
+    uint8_t out[ 2 * ( HDLC_STREAM_CHUNK + RS_FEC_NROOTS ) ];
+
+    while( length > 0 )
+    {
+        uint16_t count = ( length < HDLC_STREAM_CHUNK ) ? length : HDLC_STREAM_CHUNK;
+        uint8_t * end = encode_append( buffer, count, out, m_send );
+
+        m_sink.write( out, end - out );
+        buffer += count;
+        length -= count;
+    }
+}
+
+
+/**********************************************************
+*   end_frame
+*       Send the crc of everything appended since
+*       begin_frame and close the frame.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+void Hdlc< MaxLen, Sink, Handler >::end_frame()
+{
+    // The crc can finish one FEC block and start another
+    uint8_t out[ 2 * ( 2 + 2 * RS_FEC_NROOTS ) + 1 ];
+    uint8_t * end = encode_end( out, m_send );
+
+    m_sink.write( out, end - out );
+}
+
+
+/**********************************************************
+*   encode_frame
+*       Wrap given data in HDLC frame and write the
+*       escaped frame into out so it can be sent with one
+*       call. Returns the encoded length, or 0 if out
+*       might be too small to hold the frame.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+uint16_t Hdlc< MaxLen, Sink, Handler >::encode_frame( uint8_t const * const buffer, uint16_t length, uint8_t * out, uint16_t out_size, bool fec )
+{
+    uint8_t * end;
+    hdlc_encode_t state;
+
+    if( out_size < ( fec ? HDLC_FEC_ENCODED_LENGTH( length ) : HDLC_ENCODED_LENGTH( length ) ) )
+    {
+        return 0;
+    }
+
+    end = encode_begin( out, state, fec );
+    end = encode_append( buffer, length, end, state );
+    end = encode_end( end, state );
+
+    return end - out;
+}
+
+
+/**********************************************************
+*   encode_begin
+*       Streaming version of encode_frame for building a
+*       frame in place from pieces. Writes the opening
+*       boundary byte to out and resets state. Returns the
+*       new end of out. The caller makes sure out has
+*       room for HDLC_ENCODED_LENGTH, or
+*       HDLC_FEC_ENCODED_LENGTH, of the whole frame.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+uint8_t * Hdlc< MaxLen, Sink, Handler >::encode_begin( uint8_t * out, hdlc_encode_t &state, bool fec )
+{
+    state.fcs = CRC16_CCITT_INIT_VAL;
+    state.fec = fec;
+    state.length = 0;
+    state.fill = 0;
+    if( fec )
+    {
+        memset( state.parity, 0, sizeof(state.parity) );
+    }
+
+    *out++ = FRAME_BOUNDARY_OCTET;
+
+    return out;
+}
+
+
+/**********************************************************
+*   encode_append
+*       Escape the next piece of a frame's data into out
+*       and add it to the crc. Returns the new end of out.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+uint8_t * Hdlc< MaxLen, Sink, Handler >::encode_append( uint8_t const * buffer, uint16_t length, uint8_t * out, hdlc_encode_t &state )
+{
+    if( state.fec )
+    {
+        return fec_append( buffer, length, out, state );
+    }
+
+    state.fcs = crc16_ccitt_block( state.fcs, buffer, length );
+
+    for( uint16_t i = 0; i < length; i++ )
+    {
+        out = escape_byte( buffer[i], out );
+    }
+
+    return out;
+}
+
+
+/**********************************************************
+*   encode_end
+*       Write the low then high crc, the parity of the
+*       last FEC block and the closing boundary byte.
+*       Returns the new end of out.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+uint8_t * Hdlc< MaxLen, Sink, Handler >::encode_end( uint8_t * out, hdlc_encode_t &state )
+{
+    if( state.fec )
+    {
+        uint8_t const fcs[] = { (uint8_t)( state.fcs & 0xFF ), (uint8_t)( state.fcs >> 8 ) };
+
+        out = fec_append( fcs, sizeof(fcs), out, state );
+        if( state.fill > 0 )
+        {
+            for( uint8_t i = 0; i < RS_FEC_NROOTS; i++ )
+            {
+                out = escape_byte( state.parity[i], out );
+            }
+        }
+    }
+    else
+    {
+        out = escape_byte( state.fcs & 0xFF, out );
+        out = escape_byte( state.fcs >> 8, out );
+    }
+
+    *out++ = FRAME_BOUNDARY_OCTET;
+
+    return out;
+}
+
+
+/**********************************************************
+*   fec_append
+*       encode_append for an FEC frame. Sets the flag in
+*       the first byte, runs everything through the block's
+*       parity and sends the parity each time a block
+*       fills.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+uint8_t * Hdlc< MaxLen, Sink, Handler >::fec_append( uint8_t const * buffer, uint16_t length, uint8_t * out, hdlc_encode_t &state )
+{
+    while( length > 0 )
+    {
+        uint8_t const * piece = buffer;
+        uint16_t count = HDLC_FEC_DATA - state.fill;
+        uint8_t first;
+
+        if( count > length )
+        {
+            count = length;
+        }
+
+        if( state.length == 0 )
+        {
+            first = buffer[0] | HDLC_FEC_FLAG;
+            piece = &first;
+            count = 1;
+        }
+
+        state.fcs = crc16_ccitt_block( state.fcs, piece, count );
+        rs_fec.update( state.parity, piece, count );
+        for( uint16_t i = 0; i < count; i++ )
+        {
+            out = escape_byte( piece[i], out );
+        }
+
+        buffer += count;
+        length -= count;
+        state.length += count;
+        state.fill += count;
+
+        if( state.fill == HDLC_FEC_DATA )
+        {
+            for( uint8_t i = 0; i < RS_FEC_NROOTS; i++ )
+            {
+                out = escape_byte( state.parity[i], out );
+            }
+            memset( state.parity, 0, sizeof(state.parity) );
+            state.fill = 0;
+        }
+    }
+
+    return out;
+}
+
+
+/**********************************************************
+*   escape_byte
+*       Write data to out, escaping it if needed. Returns
+*       the new end of out.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+inline uint8_t * Hdlc< MaxLen, Sink, Handler >::escape_byte( uint8_t data, uint8_t * out )
+{
+    if( ( data == CONTROL_ESCAPE_OCTET )
+     || ( data == FRAME_BOUNDARY_OCTET ) )
+    {
+        *out++ = CONTROL_ESCAPE_OCTET;
+        data ^= INVERT_OCTET;
+    }
+
+    *out++ = data;
+
+    return out;
+}
+
+
+/**********************************************************
+*   write_bytes
+*       Give the sink out up to end one byte at a time.
+**********************************************************/
+template< uint16_t MaxLen, typename Sink, typename Handler >
+void Hdlc< MaxLen, Sink, Handler >::write_bytes( uint8_t const * out, uint8_t const * end )
+{
+    while( out < end )
+    {
+        m_sink.write( *out++ );
+    }
+}
+
+#endif
@@ -0,0 +1,368 @@
+#include "rs_code.h"
+
+#include <string.h>
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+const uint8_t gf_exp[512] =
+{
+    0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26,
+    0x4C, 0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0,
+    0x9D, 0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23,
+    0x46, 0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1,
+    0x5F, 0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0,
+    0xFD, 0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2,
+    0xD9, 0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE,
+    0x81, 0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC,
+    0x85, 0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54,
+    0xA8, 0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73,
+    0xE6, 0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF,
+    0xE3, 0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41,
+    0x82, 0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6,
+    0x51, 0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09,
+    0x12, 0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16,
+    0x2C, 0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E, 0x01,
+    0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26, 0x4C,
+    0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9, 0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0, 0x9D,
+    0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35, 0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23, 0x46,
+    0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0, 0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1, 0x5F,
+    0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC, 0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0, 0xFD,
+    0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F, 0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2, 0xD9,
+    0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88, 0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE, 0x81,
+    0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93, 0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC, 0x85,
+    0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9, 0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54, 0xA8,
+    0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA, 0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73, 0xE6,
+    0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E, 0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF, 0xE3,
+    0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4, 0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41, 0x82,
+    0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E, 0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6, 0x51,
+    0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF, 0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09, 0x12,
+    0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5, 0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16, 0x2C,
+    0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83, 0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E, 0x01, 0x02
+};
+
+const uint8_t gf_log[256] =
+{
+    0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1A, 0xC6, 0x03, 0xDF, 0x33, 0xEE, 0x1B, 0x68, 0xC7, 0x4B,
+    0x04, 0x64, 0xE0, 0x0E, 0x34, 0x8D, 0xEF, 0x81, 0x1C, 0xC1, 0x69, 0xF8, 0xC8, 0x08, 0x4C, 0x71,
+    0x05, 0x8A, 0x65, 0x2F, 0xE1, 0x24, 0x0F, 0x21, 0x35, 0x93, 0x8E, 0xDA, 0xF0, 0x12, 0x82, 0x45,
+    0x1D, 0xB5, 0xC2, 0x7D, 0x6A, 0x27, 0xF9, 0xB9, 0xC9, 0x9A, 0x09, 0x78, 0x4D, 0xE4, 0x72, 0xA6,
+    0x06, 0xBF, 0x8B, 0x62, 0x66, 0xDD, 0x30, 0xFD, 0xE2, 0x98, 0x25, 0xB3, 0x10, 0x91, 0x22, 0x88,
+    0x36, 0xD0, 0x94, 0xCE, 0x8F, 0x96, 0xDB, 0xBD, 0xF1, 0xD2, 0x13, 0x5C, 0x83, 0x38, 0x46, 0x40,
+    0x1E, 0x42, 0xB6, 0xA3, 0xC3, 0x48, 0x7E, 0x6E, 0x6B, 0x3A, 0x28, 0x54, 0xFA, 0x85, 0xBA, 0x3D,
+    0xCA, 0x5E, 0x9B, 0x9F, 0x0A, 0x15, 0x79, 0x2B, 0x4E, 0xD4, 0xE5, 0xAC, 0x73, 0xF3, 0xA7, 0x57,
+    0x07, 0x70, 0xC0, 0xF7, 0x8C, 0x80, 0x63, 0x0D, 0x67, 0x4A, 0xDE, 0xED, 0x31, 0xC5, 0xFE, 0x18,
+    0xE3, 0xA5, 0x99, 0x77, 0x26, 0xB8, 0xB4, 0x7C, 0x11, 0x44, 0x92, 0xD9, 0x23, 0x20, 0x89, 0x2E,
+    0x37, 0x3F, 0xD1, 0x5B, 0x95, 0xBC, 0xCF, 0xCD, 0x90, 0x87, 0x97, 0xB2, 0xDC, 0xFC, 0xBE, 0x61,
+    0xF2, 0x56, 0xD3, 0xAB, 0x14, 0x2A, 0x5D, 0x9E, 0x84, 0x3C, 0x39, 0x53, 0x47, 0x6D, 0x41, 0xA2,
+    0x1F, 0x2D, 0x43, 0xD8, 0xB7, 0x7B, 0xA4, 0x76, 0xC4, 0x17, 0x49, 0xEC, 0x7F, 0x0C, 0x6F, 0xF6,
+    0x6C, 0xA1, 0x3B, 0x52, 0x29, 0x9D, 0x55, 0xAA, 0xFB, 0x60, 0x86, 0xB1, 0xBB, 0xCC, 0x3E, 0x5A,
+    0xCB, 0x59, 0x5F, 0xB0, 0x9C, 0xA9, 0xA0, 0x51, 0x0B, 0xF5, 0x16, 0xEB, 0x7A, 0x75, 0x2C, 0xD7,
+    0x4F, 0xAE, 0xD5, 0xE9, 0xE6, 0xE7, 0xAD, 0xE8, 0x74, 0xD6, 0xF4, 0xEA, 0xA8, 0x50, 0x58, 0xAF
+};
+
+const RsCode rs_fec( RS_FEC_NROOTS );
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   gf_mul
+*       Product of a and b in GF(256).
+**********************************************************/
+static inline uint8_t gf_mul( uint8_t a, uint8_t b )
+{
+    if( ( a == 0 )
+     || ( b == 0 ) )
+    {
+        return 0;
+    }
+
+    return gf_exp[ gf_log[a] + gf_log[b] ];
+}
+
+
+/**********************************************************
+*   gf_div
+*       a over b in GF(256). b must not be 0.
+**********************************************************/
+static inline uint8_t gf_div( uint8_t a, uint8_t b )
+{
+    if( a == 0 )
+    {
+        return 0;
+    }
+
+    return gf_exp[ gf_log[a] + 255 - gf_log[b] ];
+}
+
+
+/**********************************************************
+*   gf_eval
+*       Value of the polynomial with coefficients poly,
+*       lowest power first, at the point with log x_log.
+**********************************************************/
+static uint8_t gf_eval( uint8_t const * poly, uint8_t count, uint8_t x_log )
+{
+    uint8_t sum = 0;
+    uint16_t power = 0;
+
+    for( uint8_t k = 0; k < count; k++ )
+    {
+        if( poly[k] != 0 )
+        {
+            sum ^= gf_exp[ gf_log[ poly[k] ] + power ];
+        }
+
+        power += x_log;
+        if( power >= 255 )
+        {
+            power -= 255;
+        }
+    }
+
+    return sum;
+}
+
+
+/******************************************************************************
+ *                          Method Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   RsCode
+*       Constructor. Builds the generator polynomial, the
+*       product of ( x + alpha^i ) for i below nroots. For
+*       every nroots up to 32 none of its coefficients are
+*       0, so they can all be kept as logs.
+**********************************************************/
+RsCode::RsCode( uint8_t nroots ) :
+    m_nroots( ( nroots > RS_MAX_NROOTS ) ? RS_MAX_NROOTS : nroots )
+{
+    uint8_t gen[ RS_MAX_NROOTS + 1 ] = { 1 };
+
+    for( uint8_t i = 0; i < m_nroots; i++ )
+    {
+        for( uint8_t j = i + 1; j > 0; j-- )
+        {
+            gen[j] ^= gf_mul( gen[j - 1], gf_exp[i] );
+        }
+    }
+
+    for( uint8_t j = 0; j <= m_nroots; j++ )
+    {
+        m_gen_log[j] = gf_log[ gen[j] ];
+    }
+}
+
+
+uint8_t RsCode::nroots() const
+{
+    return m_nroots;
+}
+
+
+/**********************************************************
+*   max_data
+*       Most message bytes in one block.
+**********************************************************/
+uint8_t RsCode::max_data() const
+{
+    return RS_BLOCK_SIZE - m_nroots;
+}
+
+
+/**********************************************************
+*   update
+*       Run the next length message bytes of a block
+*       through the parity register. parity holds nroots
+*       bytes and starts zeroed. When the block's message
+*       is done it holds the parity to send after it.
+**********************************************************/
+void RsCode::update( uint8_t * parity, uint8_t const * data, uint16_t length ) const
+{
+    uint8_t const n = m_nroots;
+
+    for( uint16_t i = 0; i < length; i++ )
+    {
+        uint8_t feedback = data[i] ^ parity[0];
+
+        memmove( &parity[0], &parity[1], n - 1 );
+        parity[n - 1] = 0;
+
+        if( feedback != 0 )
+        {
+            uint8_t const fb_log = gf_log[feedback];
+
+            for( uint8_t j = 0; j < n; j++ )
+            {
+                parity[j] ^= gf_exp[ fb_log + m_gen_log[j + 1] ];
+            }
+        }
+    }
+}
+
+
+/**********************************************************
+*   decode
+*       Correct a block in place, length bytes of message
+*       and parity. Returns the number of bytes corrected,
+*       or -1 if there were more errors than the code can
+*       fix. Syndromes, Berlekamp-Massey for the error
+*       locator, Chien search for where the errors are and
+*       Forney for their values.
+**********************************************************/
+int RsCode::decode( uint8_t * block, uint16_t length ) const
+{
+    uint8_t const n = m_nroots;
+    uint8_t syn[ RS_MAX_NROOTS ];
+    uint8_t lambda[ RS_MAX_NROOTS + 1 ] = { 1 };
+    uint8_t prev[ RS_MAX_NROOTS + 1 ] = { 1 };
+    uint8_t omega[ RS_MAX_NROOTS ];
+    uint8_t loc[ RS_MAX_NROOTS ];
+    uint8_t deg = 0;
+    uint8_t shift = 1;
+    uint8_t prev_d = 1;
+    uint8_t found = 0;
+    bool clean = true;
+
+    if( ( length <= n )
+     || ( length > RS_BLOCK_SIZE ) )
+    {
+        return -1;
+    }
+
+    // Syndromes, the block evaluated at each root. First byte is the
+    //  highest power. All the roots are stepped a byte at a time so
+    //  their chains of lookups overlap.
+    memset( syn, 0, n );
+    for( uint16_t i = 0; i < length; i++ )
+    {
+        uint8_t const byte = block[i];
+
+        for( uint8_t j = 0; j < n; j++ )
+        {
+            uint8_t const s = syn[j];
+
+            syn[j] = byte ^ ( ( s == 0 ) ? 0 : gf_exp[ gf_log[s] + j ] );
+        }
+    }
+
+    for( uint8_t j = 0; j < n; j++ )
+    {
+        clean &= ( syn[j] == 0 );
+    }
+
+    if( clean )
+    {
+        return 0;
+    }
+
+    // Berlekamp-Massey
+    for( uint8_t r = 0; r < n; r++ )
+    {
+        uint8_t d = syn[r];
+
+        for( uint8_t i = 1; i <= deg; i++ )
+        {
+            d ^= gf_mul( lambda[i], syn[r - i] );
+        }
+
+        if( d == 0 )
+        {
+            shift++;
+            continue;
+        }
+
+        uint8_t scale = gf_div( d, prev_d );
+        uint8_t old[ RS_MAX_NROOTS + 1 ];
+        memcpy( old, lambda, sizeof(old) );
+
+        for( uint8_t i = 0; i + shift <= n; i++ )
+        {
+            lambda[i + shift] ^= gf_mul( scale, prev[i] );
+        }
+
+        if( 2 * deg <= r )
+        {
+            deg = r + 1 - deg;
+            memcpy( prev, old, sizeof(prev) );
+            prev_d = d;
+            shift = 1;
+        }
+        else
+        {
+            shift++;
+        }
+    }
+
+    if( 2 * deg > n )
+    {
+        return -1;
+    }
+
+    // Chien search, only over the positions this block has. Byte i
+    //  is the power length - 1 - i, its root is alpha^-power.
+    for( uint16_t i = 0; i < length; i++ )
+    {
+        uint8_t power = length - 1 - i;
+
+        if( gf_eval( lambda, deg + 1, ( 255 - power ) % 255 ) == 0 )
+        {
+            if( found == deg )
+            {
+                return -1;
+            }
+            loc[ found++ ] = i;
+        }
+    }
+
+    if( found != deg )
+    {
+        return -1;
+    }
+
+    // Error evaluator, syndromes times locator mod x^n
+    for( uint8_t i = 0; i < n; i++ )
+    {
+        uint8_t sum = 0;
+
+        for( uint8_t k = 0; ( k <= i ) && ( k <= deg ); k++ )
+        {
+            sum ^= gf_mul( lambda[k], syn[i - k] );
+        }
+        omega[i] = sum;
+    }
+
+    // Forney. With the first root at alpha^0 an error's value is
+    //  X * omega( 1/X ) / lambda'( 1/X ). The formal derivative keeps
+    //  only the odd terms of lambda.
+    for( uint8_t e = 0; e < found; e++ )
+    {
+        uint8_t power = length - 1 - loc[e];
+        uint8_t inv = ( 255 - power ) % 255;
+        uint8_t odd[ RS_MAX_NROOTS / 2 + 1 ];
+        uint8_t odd_cnt = 0;
+
+        for( uint8_t k = 1; k <= deg; k += 2 )
+        {
+            odd[ odd_cnt++ ] = lambda[k];
+        }
+
+        uint8_t num = gf_eval( omega, n, inv );
+        uint8_t den = gf_eval( odd, odd_cnt, ( 2 * inv ) % 255 );
+
+        if( den == 0 )
+        {
+            return -1;
+        }
+
+        block[ loc[e] ] ^= gf_mul( gf_div( num, den ), gf_exp[power] );
+    }
+
+    return found;
+}
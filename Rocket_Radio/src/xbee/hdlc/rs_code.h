@@ -0,0 +1,74 @@
+#ifndef rs_code_h
+#define rs_code_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// Symbols in a full codeword. Shorter blocks are the same code with
+//  leading zeros that aren't sent.
+#define RS_BLOCK_SIZE 255
+
+// Most parity symbols an RsCode can have. Corrects up to half as many
+//  bad bytes per block.
+#define RS_MAX_NROOTS 32
+
+// Parity symbols of the code frames are sent with, RS(255,223).
+#ifndef RS_FEC_NROOTS
+#define RS_FEC_NROOTS 32
+#endif
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+// GF(256) with the 0x11D polynomial. gf_exp[i] is alpha^i, doubled so a
+//  sum of two logs needs no mod. gf_log[0] is unused.
+extern const uint8_t gf_exp[512];
+extern const uint8_t gf_log[256];
+
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   RsCode
+*       Systematic Reed-Solomon code over GF(256), first
+*       root alpha^0. A block is up to RS_BLOCK_SIZE - nroots
+*       message bytes followed by nroots parity bytes.
+*
+*       Parity is built up a piece at a time with update,
+*       so a block can be encoded as it streams out.
+**********************************************************/
+class RsCode
+{
+public:
+    RsCode( uint8_t nroots );
+
+    uint8_t nroots() const;
+    uint8_t max_data() const;
+
+    void update( uint8_t * parity, uint8_t const * data, uint16_t length ) const;
+    int decode( uint8_t * block, uint16_t length ) const;
+
+private:
+    uint8_t m_nroots;
+
+    // Generator polynomial, highest power first, as logs
+    uint8_t m_gen_log[ RS_MAX_NROOTS + 1 ];
+};
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+// The code HDLC frames are sent with.
+extern const RsCode rs_fec;
+
+#endif
@@ -0,0 +1,261 @@
+#ifndef TX_QUEUE_H
+#define TX_QUEUE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// What to do with a stale-ok frame when the queue is full.
+typedef uint8_t tx_policy_t;
+enum
+{
+    TXQ_DROP_OLDEST = 0,    // Overwrite the oldest stale-ok frame not yet started
+    TXQ_DROP_NEWEST = 1,    // Keep what's queued, drop the new frame
+};
+
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   TxQueue
+*       Queue of whole encoded frames waiting for the UART.
+*       Frames are built straight into a slot with
+*       begin_frame / end_frame so queuing costs no extra
+*       copy. service() moves as many bytes as the UART's
+*       transmit buffer has room for and returns right
+*       away. The UART's TX interrupt does the rest.
+*
+*       Frames marked stale_ok (periodic telemetry) may be
+*       dropped to make room, frames that aren't (command
+*       replies) are only ever refused when there is no
+*       stale_ok frame left to drop.
+*
+*       Slots     - Max frames queued.
+*       SlotSize  - Max encoded frame size.
+**********************************************************/
+template< uint8_t Slots, uint16_t SlotSize >
+class TxQueue
+{
+public:
+    TxQueue();
+
+    void set_policy( tx_policy_t policy );
+
+    uint8_t * begin_frame( bool stale_ok );
+    void end_frame( uint16_t length );
+
+    template< typename Sink >
+    void service( Sink & sink );
+
+    bool empty() const;
+    uint8_t frames() const;
+    uint32_t dropped() const;
+
+private:
+    bool drop_oldest_stale();
+
+    tx_policy_t m_policy;
+
+    uint8_t m_slots[Slots][SlotSize];
+    uint16_t m_length[Slots];
+    bool m_stale_ok[Slots];
+
+    // Queued slots in send order, then free slots
+    uint8_t m_order[Slots];
+    uint8_t m_cnt;
+
+    uint8_t m_building;     // Slot handed out by begin_frame, Slots if none
+    uint16_t m_sent;        // Bytes of the first queued frame already sent
+    uint32_t m_dropped;
+};
+
+
+/******************************************************************************
+ *                          Method Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   TxQueue
+*       Constructor
+**********************************************************/
+template< uint8_t Slots, uint16_t SlotSize >
+TxQueue< Slots, SlotSize >::TxQueue() :
+    m_policy( TXQ_DROP_OLDEST ),
+    m_cnt( 0 ),
+    m_building( Slots ),
+    m_sent( 0 ),
+    m_dropped( 0 )
+{
+    for( uint8_t i = 0; i < Slots; i++ )
+    {
+        m_order[i] = i;
+    }
+}
+
+
+/**********************************************************
+*   set_policy
+*       Set what happens to stale-ok frames when full.
+**********************************************************/
+template< uint8_t Slots, uint16_t SlotSize >
+void TxQueue< Slots, SlotSize >::set_policy( tx_policy_t policy )
+{
+    m_policy = policy;
+}
+
+
+/**********************************************************
+*   begin_frame
+*       Get a slot of SlotSize bytes to build a frame in.
+*       Returns NULL, and counts a drop, if there's no
+*       room under the policy.
+**********************************************************/
+template< uint8_t Slots, uint16_t SlotSize >
+uint8_t * TxQueue< Slots, SlotSize >::begin_frame( bool stale_ok )
+{
+    if( m_cnt == Slots )
+    {
+        if( ( ( stale_ok )
+           && ( m_policy == TXQ_DROP_NEWEST ) )
+         || ( !drop_oldest_stale() ) )
+        {
+            m_dropped++;
+            return NULL;
+        }
+    }
+
+    m_building = m_order[m_cnt];
+    m_stale_ok[m_building] = stale_ok;
+
+    return m_slots[m_building];
+}
+
+
+/**********************************************************
+*   end_frame
+*       Queue the frame built in the slot from
+*       begin_frame. A length of 0 gives the slot back.
+**********************************************************/
+template< uint8_t Slots, uint16_t SlotSize >
+void TxQueue< Slots, SlotSize >::end_frame( uint16_t length )
+{
+    if( m_building == Slots )
+    {
+        return;
+    }
+
+    if( ( length > 0 )
+     && ( length <= SlotSize ) )
+    {
+        m_length[m_building] = length;
+        m_cnt++;
+    }
+
+    m_building = Slots;
+}
+
+
+/**********************************************************
+*   service
+*       Write as much of the queue as the sink can take
+*       without blocking. Sink needs availableForWrite()
+*       and write( uint8_t const *, size_t ).
+**********************************************************/
+template< uint8_t Slots, uint16_t SlotSize >
+template< typename Sink >
+void TxQueue< Slots, SlotSize >::service( Sink & sink )
+{
+    while( m_cnt > 0 )
+    {
+        int room = sink.availableForWrite();
+        if( room <= 0 )
+        {
+            return;
+        }
+
+        uint8_t slot = m_order[0];
+        uint16_t count = m_length[slot] - m_sent;
+        if( (int)count > room )
+        {
+            count = (uint16_t)room;
+        }
+
+        sink.write( &m_slots[slot][m_sent], count );
+        m_sent += count;
+
+        if( m_sent < m_length[slot] )
+        {
+            return;
+        }
+
+        // Frame done, move its slot to the free end
+        memmove( &m_order[0], &m_order[1], Slots - 1 );
+        m_order[Slots - 1] = slot;
+        m_cnt--;
+        m_sent = 0;
+    }
+}
+
+
+template< uint8_t Slots, uint16_t SlotSize >
+bool TxQueue< Slots, SlotSize >::empty() const
+{
+    return m_cnt == 0;
+}
+
+
+template< uint8_t Slots, uint16_t SlotSize >
+uint8_t TxQueue< Slots, SlotSize >::frames() const
+{
+    return m_cnt;
+}
+
+
+/**********************************************************
+*   dropped
+*       Frames dropped or refused because the queue was
+*       full.
+**********************************************************/
+template< uint8_t Slots, uint16_t SlotSize >
+uint32_t TxQueue< Slots, SlotSize >::dropped() const
+{
+    return m_dropped;
+}
+
+
+/**********************************************************
+*   drop_oldest_stale
+*       Free the slot of the oldest stale-ok frame that
+*       hasn't started going out. Returns false if there
+*       isn't one.
+**********************************************************/
+template< uint8_t Slots, uint16_t SlotSize >
+bool TxQueue< Slots, SlotSize >::drop_oldest_stale()
+{
+    // A partly sent frame has to finish or the receiver loses sync
+    uint8_t first = ( m_sent > 0 ) ? 1 : 0;
+
+    for( uint8_t i = first; i < m_cnt; i++ )
+    {
+        uint8_t slot = m_order[i];
+
+        if( m_stale_ok[slot] )
+        {
+            memmove( &m_order[i], &m_order[i + 1], Slots - i - 1 );
+            m_order[Slots - 1] = slot;
+            m_cnt--;
+            m_dropped++;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+#endif
@@ -1,61 +1,631 @@
 #include "xbee.h"
 
-Xbee::Xbee( HardwareSerial *serial ) :
+Xbee::Xbee( UARTClass *serial, xbee_mode_t mode ) :
     m_Serial(serial),
-    m_hdlc(MAX_DATA_LENGTH)
+    m_mode(mode),
+    m_hdlc(*serial, *this, m_pool[0]),
+    m_api(*this)
 {
-    m_hdlc.set_send_hndlr( [serial]( uint8_t byte )
+}
+
+void Xbee::setup( uint32_t baud_rate )
+{
+    m_Serial->begin( baud_rate );
+}
+
+void Xbee::read()
+{
+    uint8_t chunk[ XBEE_READ_CHUNK ];
+    uint16_t budget = m_read_budget;
+    int available;
+
+    write_pending();
+
+    // Drain everything the UART has buffered, up to the budget
+    while( ( budget > 0 )
+        && ( ( available = m_Serial->available() ) > 0 ) )
     {
-        serial->write( byte );
-    });
+        uint16_t count = min( (uint16_t)available, budget );
+        count = min( count, (uint16_t)XBEE_READ_CHUNK );
+
+        for( uint16_t i = 0; i < count; i++ )
+        {
+            chunk[i] = (uint8_t)m_Serial->read();
+        }
+
+        if( m_rx_tap )
+        {
+            m_rx_tap( chunk, count );
+        }
 
-    m_hdlc.set_rcv_hndlr( [this]( uint8_t* data, uint8_t size )
+        if( m_mode == XBEE_API )
+        {
+            m_api.receive( chunk, count );
+        }
+        else
+        {
+            m_hdlc.receive( chunk, count );
+        }
+        budget -= count;
+
+        // Free up the pool before the next chunk
+        dispatch();
+    }
+}
+
+
+void Xbee::set_read_budget( uint16_t budget )
+{
+    m_read_budget = budget;
+}
+
+
+void Xbee::set_frame_hndlr( data_type_t data_type, frame_hndlr_t const & hndlr )
+{
+    if( data_type < XBEE_HANDLER_CNT )
     {
-        memcpy( m_data, data, size );        
-        m_data_sz = size;
+        m_frame_hndlrs[data_type] = hndlr;
+    }
+}
+
 
-        m_new_data = true;
-    });
+uint32_t Xbee::dropped_frames()
+{
+    return m_dropped;
 }
 
-void Xbee::setup( uint32_t baud_rate )
+
+/**********************************************************
+*   crc_errors
+*       Frames thrown away for a bad crc, and in API mode
+*       API frames for a bad checksum.
+**********************************************************/
+uint32_t Xbee::crc_errors()
 {
-    m_Serial->begin( baud_rate );
+    return m_hdlc.crc_errors() + m_api.checksum_errors();
 }
 
-void Xbee::read()
+
+/**********************************************************
+*   fec_corrected
+*       Frames FEC fixed that would have failed the crc.
+**********************************************************/
+uint32_t Xbee::fec_corrected()
+{
+    return m_hdlc.fec_corrected();
+}
+
+
+/**********************************************************
+*   set_rx_tap
+*       Have tap see every byte read from the UART, to
+*       record the link.
+**********************************************************/
+void Xbee::set_rx_tap( rx_tap_t const & tap )
+{
+    m_rx_tap = tap;
+}
+
+
+/**********************************************************
+*   frame_received
+*       Called by the HDLC decoder when the buffer it was
+*       filling holds a complete frame. That's always the
+*       pool slot after the queued ones, so only its size
+*       is needed. Queue it and give the decoder the next
+*       free buffer. If every buffer is waiting on
+*       dispatch the new frame is dropped and its buffer
+*       reused.
+**********************************************************/
+void Xbee::frame_received( uint8_t *, uint16_t size )
+{
+    uint8_t slot = ( m_pool_head + m_pool_cnt ) % XBEE_FRAME_POOL_SIZE;
+
+    if( ( size < sizeof(data_type_t) )
+     || ( m_pool_cnt == XBEE_FRAME_POOL_SIZE - 1 ) )
+    {
+        m_dropped++;
+        return;
+    }
+
+    m_pool_sz[slot] = size;
+    m_pool_cnt++;
+
+    slot = ( slot + 1 ) % XBEE_FRAME_POOL_SIZE;
+    m_hdlc.set_rcv_buffer( m_pool[slot] );
+}
+
+
+/**********************************************************
+*   dispatch
+*       Hand every queued frame to the handler for its
+*       data type, oldest first.
+**********************************************************/
+void Xbee::dispatch()
+{
+    while( m_pool_cnt > 0 )
+    {
+        uint8_t const * frame = m_pool[m_pool_head];
+        data_type_t data_type = frame[0];
+
+        if( ( data_type < XBEE_HANDLER_CNT )
+         && ( m_frame_hndlrs[data_type] ) )
+        {
+            m_frame_hndlrs[data_type]( &frame[sizeof(data_type_t)], m_pool_sz[m_pool_head] - sizeof(data_type_t) );
+        }
+
+        m_pool_head = ( m_pool_head + 1 ) % XBEE_FRAME_POOL_SIZE;
+        m_pool_cnt--;
+    }
+}
+
+
+/**********************************************************
+*   send_data
+*       Queue a frame and return without waiting for the
+*       UART. Periodic telemetry should set stale_ok so it
+*       can be dropped for newer data when the link falls
+*       behind. Returns false if the frame was dropped.
+*       The data type goes in the frame too, so size can
+*       be at most XBEE_MAX_FRAME_LENGTH - 1.
+**********************************************************/
+bool Xbee::send_data( data_type_t data_type, uint8_t const * const buffer, uint16_t size, bool stale_ok )
 {
-    if( m_Serial->available() > 0 )
+    if( size > XBEE_MAX_FRAME_LENGTH - sizeof(data_type_t) )
     {
-        m_hdlc.byte_receive( (uint8_t)m_Serial->read() );
+        m_oversized++;
+        return false;
     }
+
+    if( !this->begin_send( data_type, stale_ok ) )
+    {
+        return false;
+    }
+
+    this->append_send( buffer, size );
+
+    return this->end_send();
 }
 
 
-void Xbee::send_data( data_type_t data_type, uint8_t const * const buffer, uint8_t size )
+/**********************************************************
+*   begin_send
+*       Start a frame that's streamed straight into the
+*       transmit queue with append_send and finished with
+*       end_send, so a large payload doesn't have to be
+*       staged in one buffer first. Returns false if the
+*       queue has no room or a frame is already open.
+**********************************************************/
+bool Xbee::begin_send( data_type_t data_type, bool stale_ok )
 {
-    uint8_t const tmp_sz = size + sizeof(data_type_t);
-    uint8_t tmp_buf[ tmp_sz ];
+    if( m_send_start )
+    {
+        return false;
+    }
 
-    memcpy( tmp_buf, &data_type, sizeof(data_type_t) );
-    memcpy( &tmp_buf[sizeof(data_type_t)], buffer, size );
+    m_send_start = m_tx_queue.begin_frame( stale_ok );
+    if( !m_send_start )
+    {
+        return false;
+    }
 
-    m_hdlc.send_frame( tmp_buf, tmp_sz );
+    m_send_end = hdlc_t::encode_begin( m_send_start, m_send_state, m_fec );
+    m_send_size = 0;
+    m_send_overflow = false;
+
+    this->append_send( &data_type, sizeof(data_type_t) );
+    return true;
 }
 
 
-bool Xbee::new_data_received()
+/**********************************************************
+*   append_send
+*       Add the next piece of the open frame. If the frame
+*       grows past XBEE_MAX_FRAME_LENGTH it's dropped at
+*       end_send.
+**********************************************************/
+void Xbee::append_send( uint8_t const * buffer, uint16_t size )
 {
-    bool tmp = m_new_data;
-    m_new_data = false;
-    return tmp;
+    if( ( !m_send_start )
+     || ( m_send_overflow ) )
+    {
+        return;
+    }
+
+    if( size > XBEE_MAX_FRAME_LENGTH - m_send_size )
+    {
+        m_send_overflow = true;
+        return;
+    }
+
+    m_send_end = hdlc_t::encode_append( buffer, size, m_send_end, m_send_state );
+    m_send_size += size;
 }
 
 
-void Xbee::get_data( data_type_t &data_type, uint8_t *buffer, uint8_t &size )
+/**********************************************************
+*   end_send
+*       Close the open frame and queue it. Returns false
+*       if it was too big and got dropped.
+**********************************************************/
+bool Xbee::end_send()
 {
-    data_type = m_data[0];
-    size = m_data_sz - 1;
+    bool queued = false;
+
+    if( !m_send_start )
+    {
+        return false;
+    }
 
-    memcpy( buffer, &m_data[1], m_data_sz - 1 );
+    if( m_send_overflow )
+    {
+        m_tx_queue.end_frame( 0 );
+        m_oversized++;
+    }
+    else
+    {
+        m_send_end = hdlc_t::encode_end( m_send_end, m_send_state );
+        m_tx_queue.end_frame( m_send_end - m_send_start );
+        queued = true;
+    }
+
+    m_send_start = NULL;
+
+    write_pending();
+    return queued;
+}
+
+
+void Xbee::set_tx_policy( tx_policy_t policy )
+{
+    m_tx_queue.set_policy( policy );
+}
+
+
+/**********************************************************
+*   set_fec
+*       Send frames begun from now on with FEC parity.
+*       Takes RS_FEC_NROOTS more bytes for every
+*       HDLC_FEC_DATA of frame, so even unescaped a full
+*       MAX_DATA_LENGTH frame is more than one RF packet. Frames
+*       with FEC are always taken on receive.
+**********************************************************/
+void Xbee::set_fec( bool fec )
+{
+    m_fec = fec;
+}
+
+
+/**********************************************************
+*   write_pending
+*       Top up the UART's transmit buffer from the queue.
+*       Never blocks. Called from read() and send_data().
+**********************************************************/
+void Xbee::write_pending()
+{
+    if( m_mode == XBEE_API )
+    {
+        this->api_write_pending();
+        return;
+    }
+
+    m_tx_queue.service( *m_Serial );
+}
+
+
+/**********************************************************
+*   tx_idle
+*       Nothing left to send. In API mode that includes
+*       waiting on the radio for TX status, so batching
+*       follows how fast the radio gets packets out, not
+*       just the UART.
+**********************************************************/
+bool Xbee::tx_idle()
+{
+    return ( m_tx_queue.empty() )
+        && ( m_api_out_sent == m_api_out_len )
+        && ( m_api_pending == 0 );
+}
+
+
+/**********************************************************
+*   dropped_tx_frames
+*       Frames the transmit queue had no room for, and
+*       frames too big to send.
+**********************************************************/
+uint32_t Xbee::dropped_tx_frames()
+{
+    return m_tx_queue.dropped() + m_oversized;
+}
+
+
+/**********************************************************
+*   set_dest_addr
+*       64 bit address transmit requests go to. Defaults
+*       to broadcast, which the radio never retries or
+*       reports failed, so set the ground radio's address
+*       to get real TX status.
+**********************************************************/
+void Xbee::set_dest_addr( uint64_t addr )
+{
+    m_dest_addr = addr;
+}
+
+
+uint32_t Xbee::tx_delivered()
+{
+    return m_tx_delivered;
+}
+
+
+uint32_t Xbee::tx_failed()
+{
+    return m_tx_failed;
+}
+
+
+/**********************************************************
+*   tx_retries
+*       RF retries the radio reported over all TX status.
+**********************************************************/
+uint32_t Xbee::tx_retries()
+{
+    return m_tx_retries;
+}
+
+
+/**********************************************************
+*   tx_window
+*       Transmit requests allowed in flight right now.
+**********************************************************/
+uint8_t Xbee::tx_window()
+{
+    return m_api_window;
+}
+
+
+/**********************************************************
+*   rssi
+*       Signal strength of the last packet received, in
+*       -dBm. 0 until the radio has reported one.
+**********************************************************/
+uint8_t Xbee::rssi()
+{
+    return m_rssi;
+}
+
+
+/**********************************************************
+*   api_frame_received
+*       Called by the API parser for every good frame. The
+*       RF data of a receive packet goes through the HDLC
+*       decoder a read chunk at a time, a packet can hold
+*       more frames than the pool.
+**********************************************************/
+void Xbee::api_frame_received( uint8_t const * data, uint16_t size )
+{
+    switch( data[0] )
+    {
+        case XBEE_API_RX_PACKET:
+            for( uint16_t i = XBEE_API_RX_HDR_SIZE; i < size; i += XBEE_READ_CHUNK )
+            {
+                m_hdlc.receive( &data[i], min( (uint16_t)( size - i ), (uint16_t)XBEE_READ_CHUNK ) );
+                dispatch();
+            }
+            m_rssi_wanted = true;
+            break;
+
+        case XBEE_API_TX_STATUS:
+            this->api_tx_status( data, size );
+            break;
+
+        case XBEE_API_AT_RESPONSE:
+            if( ( size > XBEE_API_AT_RESPONSE_VALUE )
+             && ( data[XBEE_API_AT_RESPONSE_ID] == m_rssi_id )
+             && ( data[XBEE_API_AT_RESPONSE_CMD] == 'D' )
+             && ( data[XBEE_API_AT_RESPONSE_CMD + 1] == 'B' ) )
+            {
+                if( data[XBEE_API_AT_RESPONSE_STATUS] == 0 )
+                {
+                    m_rssi = data[XBEE_API_AT_RESPONSE_VALUE];
+                }
+                m_rssi_id = 0;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**********************************************************
+*   api_tx_status
+*       A transmit request is done. Failures halve the
+*       window, a window's worth of deliveries in a row
+*       grows it by one. A status for a frame id not
+*       waiting, one that already timed out, is ignored.
+**********************************************************/
+void Xbee::api_tx_status( uint8_t const * data, uint16_t size )
+{
+    if( ( size < XBEE_API_TX_STATUS_SIZE )
+     || ( !this->api_retire( data[XBEE_API_TX_STATUS_ID] ) ) )
+    {
+        return;
+    }
+
+    m_tx_retries += data[XBEE_API_TX_STATUS_RETRIES];
+
+    if( data[XBEE_API_TX_STATUS_DELIVERY] == 0 )
+    {
+        m_tx_delivered++;
+
+        if( ( ++m_api_good >= m_api_window )
+         && ( m_api_window < XBEE_API_MAX_PENDING ) )
+        {
+            m_api_window++;
+            m_api_good = 0;
+        }
+    }
+    else
+    {
+        m_tx_failed++;
+        m_api_window = max( m_api_window / 2, 1 );
+        m_api_good = 0;
+    }
+}
+
+
+/**********************************************************
+*   api_write_pending
+*       Finish writing the API frame in progress, then
+*       start the next one. An RSSI query goes ahead of
+*       data, data waits while the window is full.
+**********************************************************/
+void Xbee::api_write_pending()
+{
+    api_sink_t sink = { *this };
+
+    while( true )
+    {
+        if( m_api_out_sent < m_api_out_len )
+        {
+            int room = m_Serial->availableForWrite();
+            if( room <= 0 )
+            {
+                return;
+            }
+
+            uint16_t count = min( (uint16_t)room, (uint16_t)( m_api_out_len - m_api_out_sent ) );
+            m_Serial->write( &m_api_out[m_api_out_sent], count );
+            m_api_out_sent += count;
+
+            if( m_api_out_sent < m_api_out_len )
+            {
+                return;
+            }
+        }
+
+        m_api_out_len = 0;
+        m_api_out_sent = 0;
+
+        // TX statuses that never came
+        this->api_expire();
+
+        if( ( m_rssi_wanted )
+         && ( m_rssi_id == 0 ) )
+        {
+            m_rssi_wanted = false;
+            m_rssi_id = this->api_next_id();
+            m_api_out_len = api_t::encode_at_command( m_rssi_id, "DB", m_api_out );
+            continue;
+        }
+
+        // Stages at most one transmit request
+        m_tx_queue.service( sink );
+        if( m_api_out_len == 0 )
+        {
+            return;
+        }
+    }
+}
+
+
+/**********************************************************
+*   api_next_id
+*       Frame id for the next request. Never 0, that asks
+*       the radio for no response.
+**********************************************************/
+uint8_t Xbee::api_next_id()
+{
+    if( ++m_frame_id == 0 )
+    {
+        m_frame_id = 1;
+    }
+
+    return m_frame_id;
+}
+
+
+/**********************************************************
+*   api_retire
+*       Free the slot of the transmit request with frame id
+*       id. Returns false if none is waiting with it.
+**********************************************************/
+bool Xbee::api_retire( uint8_t id )
+{
+    if( id == 0 )
+    {
+        return false;
+    }
+
+    for( api_pending_t & pending : m_api_sent )
+    {
+        if( pending.id == id )
+        {
+            pending.id = 0;
+            m_api_pending--;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+/**********************************************************
+*   api_expire
+*       Free the slot of each transmit request that's had
+*       no TX status for XBEE_API_STATUS_TIMEOUT_MS.
+**********************************************************/
+void Xbee::api_expire()
+{
+    uint32_t now = millis();
+
+    for( api_pending_t & pending : m_api_sent )
+    {
+        if( ( pending.id != 0 )
+         && ( now - pending.sent_ms > XBEE_API_STATUS_TIMEOUT_MS ) )
+        {
+            pending.id = 0;
+            m_api_pending--;
+        }
+    }
+}
+
+
+/**********************************************************
+*   api_sink_t
+*       Room for one RF packet when nothing is being
+*       written and the window has room, none otherwise.
+**********************************************************/
+int Xbee::api_sink_t::availableForWrite()
+{
+    if( ( xbee.m_api_out_len > 0 )
+     || ( xbee.m_api_pending >= xbee.m_api_window ) )
+    {
+        return 0;
+    }
+
+    return XBEE_MTU;
+}
+
+
+void Xbee::api_sink_t::write( uint8_t const * buffer, size_t size )
+{
+    uint8_t id = xbee.api_next_id();
+
+    xbee.m_api_out_len = api_t::encode_tx_request( id, xbee.m_dest_addr, buffer, size, xbee.m_api_out );
+
+    // availableForWrite() said there's a free slot
+    for( api_pending_t & pending : xbee.m_api_sent )
+    {
+        if( pending.id == 0 )
+        {
+            pending.id = id;
+            pending.sent_ms = millis();
+            xbee.m_api_pending++;
+            break;
+        }
+    }
 }
\ No newline at end of file
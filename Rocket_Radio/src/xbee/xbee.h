@@ -3,19 +3,94 @@
 
 #include <Arduino.h>
 #include <stdint.h>
+#include <functional>
 
 #include "hdlc/hdlc.h"
+#include "tx_queue.h"
+#include "xbee_api.h"
 
 
 /******************************************************************************
  *                                   Defines
  *****************************************************************************/
-#define MAX_DATA_LENGTH 64
+// Max bytes the radio sends in one RF packet, ATNP on the XBee. 256 on
+//  the XBee-PRO 900HP. The limit is on the HDLC encoded bytes, escapes
+//  included. Only a frame whose HDLC_ENCODED_LENGTH fits, 125 data
+//  bytes with the data type, is sure to go out whole in one packet.
+#define XBEE_MTU 256
+
+// Max data bytes in a telemetry frame, data type included. Unescaped,
+//  with the crc and the boundary bytes, it fills XBEE_MTU. Any byte
+//  that needs escaping pushes the end of the frame into a second
+//  packet, up to HDLC_ENCODED_LENGTH( MAX_DATA_LENGTH ) bytes, two
+//  packets, if every byte does.
+#define MAX_DATA_LENGTH ( XBEE_MTU - 4 )
+
+// Max data bytes in any frame Xbee sends or takes, data type included.
+//  Nothing the firmware sends is bigger than MAX_DATA_LENGTH, one RF
+//  packet before escaping, so that's the default. Bigger frames cut
+//  the per-frame overhead but the radio splits them over more packets
+//  and losing any one loses the frame. The XBEE_FRAME_POOL_SIZE pool
+//  buffers and XBEE_TX_QUEUE_SLOTS transmit queue slots are each sized
+//  for one, FEC parity and escaping included, about 18 bytes of RAM
+//  per byte of frame. An Xbee is about 7k at the default and 21k at 1024.
+#ifndef XBEE_MAX_FRAME_LENGTH
+#define XBEE_MAX_FRAME_LENGTH MAX_DATA_LENGTH
+#endif
+
+// Max number of bytes one call to read() takes from the UART, so a
+//  flood of incoming data can't starve the rest of loop().
+#define XBEE_READ_BUDGET 256
+
+// Bytes moved from the UART to the HDLC decoder at a time.
+#define XBEE_READ_CHUNK 32
+
+// Number of receive frame buffers. One is always being filled by the
+//  HDLC decoder, the rest hold frames waiting to be dispatched.
+#define XBEE_FRAME_POOL_SIZE 4
+
+// Size of one pool buffer. Frame data plus its crc and, for a frame
+//  sent with FEC, the parity.
+#define XBEE_FRAME_BUF_SIZE HDLC_FEC_LENGTH( XBEE_MAX_FRAME_LENGTH + 2 )
+
+// Data types 0 to XBEE_HANDLER_CNT - 1 can have a handler. The same
+//  range Hdlc takes as data types when a frame's FEC flag is in doubt.
+#define XBEE_HANDLER_CNT HDLC_DATA_TYPE_CNT
+
+// Encoded frames waiting for the UART. At 9600 baud a data_pkg_t frame
+//  takes about 55ms to go out.
+#define XBEE_TX_QUEUE_SLOTS 6
+
+// API mode. Most transmit requests waiting on a TX status at once. The
+//  window shrinks when the radio reports failed deliveries and grows
+//  back one packet per window of good ones.
+#define XBEE_API_MAX_PENDING 4
+
+// API mode. A transmit request with no TX status after this long is
+//  taken as lost so the window can't stall. Each request is timed on
+//  its own.
+#define XBEE_API_STATUS_TIMEOUT_MS 2000
+
+// API mode. Largest API frame taken from the radio, a receive packet
+//  of one full RF packet.
+#define XBEE_API_MAX_FRAME ( XBEE_API_RX_HDR_SIZE + XBEE_MTU )
 
 
 /******************************************************************************
  *                               Global Types
  *****************************************************************************/
+// How the radio is talked to. Transparent mode writes HDLC frames to
+//  the UART as is. API mode, AP=2 on the radio, sends them as the RF
+//  data of 0x10 transmit requests, gets TX status and RSSI back, and
+//  still takes HDLC frames from the far end, so a transparent mode
+//  ground station can't tell the difference.
+typedef uint8_t xbee_mode_t;
+enum
+{
+    XBEE_TRANSPARENT    = 0,
+    XBEE_API            = 1,
+};
+
 // Labels what's in the data field of the HDLC frame.
 typedef uint8_t data_type_t;
 enum
@@ -23,30 +98,145 @@ enum
     SENSOR_DATA     = 0,
     GPS_DATA        = 1,
     DATA_LOG        = 2,
+    SENSOR_BATCH    = 3,
+    SENSOR_CODED    = 4,
+    SENSOR_TAGGED   = 5,
+    DIAGNOSTICS     = 6,
+    LOG_DOWNLINK    = 7,
 };
 
+// Called with a view of a received frame's data, not including the
+//  data type. Only valid until the handler returns.
+typedef std::function<void(uint8_t const *, uint16_t)> frame_hndlr_t;
+
+// Called with the raw bytes of every chunk read from the UART, before
+//  they're decoded.
+typedef std::function<void(uint8_t const *, uint8_t)> rx_tap_t;
+
 /******************************************************************************
  *                                    Xbee
  *****************************************************************************/
 class Xbee
 {
+    typedef Hdlc< XBEE_MAX_FRAME_LENGTH, UARTClass, Xbee > hdlc_t;
+    typedef TxQueue< XBEE_TX_QUEUE_SLOTS, hdlc_t::max_encoded_length > tx_queue_t;
+    typedef XbeeApi< XBEE_API_MAX_FRAME, Xbee > api_t;
+    friend hdlc_t;
+    friend api_t;
+
+    // TxQueue sink that turns what it's given into one transmit request
+    //  at a time, while the window has room.
+    struct api_sink_t
+    {
+        Xbee & xbee;
+
+        int availableForWrite();
+        void write( uint8_t const * buffer, size_t size );
+    };
+
+    // API mode. A transmit request waiting on its TX status. id 0 is a
+    //  free slot.
+    struct api_pending_t
+    {
+        uint8_t id;
+        uint32_t sent_ms;
+    };
+
 public:
-    Xbee( HardwareSerial *serial );
+    Xbee( UARTClass *serial, xbee_mode_t mode = XBEE_TRANSPARENT );
 
     void setup( uint32_t baud_rate );
 
     void read();
-    bool new_data_received();
-    void get_data( data_type_t &data_type, uint8_t *buffer, uint8_t &size );
-    void send_data( data_type_t data_type, uint8_t const * const buffer, uint8_t size );
+    void set_read_budget( uint16_t budget );
+    void set_frame_hndlr( data_type_t data_type, frame_hndlr_t const & hndlr );
+    uint32_t dropped_frames();
+    uint32_t crc_errors();
+    uint32_t fec_corrected();
+    void set_rx_tap( rx_tap_t const & tap );
+    bool send_data( data_type_t data_type, uint8_t const * const buffer, uint16_t size, bool stale_ok = false );
+    bool begin_send( data_type_t data_type, bool stale_ok = false );
+    void append_send( uint8_t const * buffer, uint16_t size );
+    bool end_send();
+    void set_tx_policy( tx_policy_t policy );
+    void set_fec( bool fec );
+    void write_pending();
+    bool tx_idle();
+    uint32_t dropped_tx_frames();
+
+    // API mode only
+    void set_dest_addr( uint64_t addr );
+    uint32_t tx_delivered();
+    uint32_t tx_failed();
+    uint32_t tx_retries();
+    uint8_t tx_window();
+    uint8_t rssi();
 
 private:
-    HardwareSerial *m_Serial;
-    Hdlc m_hdlc;
+    void frame_received( uint8_t * data, uint16_t size );
+    void dispatch();
+
+    void api_frame_received( uint8_t const * data, uint16_t size );
+    void api_tx_status( uint8_t const * data, uint16_t size );
+    void api_write_pending();
+    uint8_t api_next_id();
+    bool api_retire( uint8_t id );
+    void api_expire();
+
+    // UARTClass, not HardwareSerial, the SAM core only has
+    //  availableForWrite() on UARTClass. Serial1 to Serial3 are
+    //  USARTClass, which is one.
+    UARTClass *m_Serial;
+    xbee_mode_t m_mode;
+    hdlc_t m_hdlc;
+    api_t m_api;
+    tx_queue_t m_tx_queue;
+    uint16_t m_read_budget = XBEE_READ_BUDGET;
+
+    frame_hndlr_t m_frame_hndlrs[XBEE_HANDLER_CNT];
+    rx_tap_t m_rx_tap;
+
+    // Frame pool, used as a ring. The m_pool_cnt frames starting at
+    //  m_pool_head are waiting to be dispatched and the one after them
+    //  is being filled by m_hdlc.
+    uint8_t m_pool[XBEE_FRAME_POOL_SIZE][XBEE_FRAME_BUF_SIZE];
+    uint16_t m_pool_sz[XBEE_FRAME_POOL_SIZE];
+    uint8_t m_pool_head = 0;
+    uint8_t m_pool_cnt = 0;
+    uint32_t m_dropped = 0;
+
+    // Frame being streamed into a transmit queue slot by begin_send,
+    //  NULL if none
+    uint8_t * m_send_start = NULL;
+    uint8_t * m_send_end = NULL;
+    uint16_t m_send_size = 0;
+    hdlc_encode_t m_send_state;
+    bool m_send_overflow = false;
+    bool m_fec = false;
+    uint32_t m_oversized = 0;       // Frames over XBEE_MAX_FRAME_LENGTH, dropped
+
+    // API mode. The API frame being written to the UART, one transmit
+    //  request or AT command.
+    uint8_t m_api_out[ XBEE_API_ENCODED_LENGTH( XBEE_API_TX_HDR_SIZE + XBEE_MTU ) ];
+    uint16_t m_api_out_len = 0;
+    uint16_t m_api_out_sent = 0;
+
+    uint64_t m_dest_addr = XBEE_API_BROADCAST_ADDR;
+    uint8_t m_frame_id = 0;
+    api_pending_t m_api_sent[ XBEE_API_MAX_PENDING ] = {};
+    uint8_t m_api_pending = 0;      // Slots in use in m_api_sent
+    uint8_t m_api_window = XBEE_API_MAX_PENDING;
+    uint8_t m_api_good = 0;         // Deliveries since the window last changed
+
+    uint32_t m_tx_delivered = 0;
+    uint32_t m_tx_failed = 0;
+    uint32_t m_tx_retries = 0;
 
-    uint8_t m_data[MAX_DATA_LENGTH];
-    uint8_t m_data_sz;
-    bool m_new_data = false;
+    // RSSI of the last packet received, asked for with ATDB after each
+    //  one. -dBm, 0 until the first answer.
+    uint8_t m_rssi = 0;
+    uint8_t m_rssi_id = 0;          // Frame id of the ATDB in flight, 0 if none
+    bool m_rssi_wanted = false;
 };
 
 #endif
\ No newline at end of file
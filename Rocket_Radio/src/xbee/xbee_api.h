@@ -0,0 +1,356 @@
+#ifndef XBEE_API_H
+#define XBEE_API_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define XBEE_API_START_OCTET    0x7E
+#define XBEE_API_ESCAPE_OCTET   0x7D
+#define XBEE_API_XON_OCTET      0x11
+#define XBEE_API_XOFF_OCTET     0x13
+#define XBEE_API_INVERT_OCTET   0x20
+
+// API frame types, the first byte of the frame data
+#define XBEE_API_AT_COMMAND     0x08
+#define XBEE_API_TX_REQUEST     0x10
+#define XBEE_API_AT_RESPONSE    0x88
+#define XBEE_API_TX_STATUS      0x8B
+#define XBEE_API_RX_PACKET      0x90
+
+// Frame data before the RF data. Type, frame id, 64 bit and 16 bit
+//  destination, broadcast radius and options for a transmit request.
+//  Type, 64 bit and 16 bit source and options for a receive packet.
+#define XBEE_API_TX_HDR_SIZE    14
+#define XBEE_API_RX_HDR_SIZE    12
+
+// Length of the frame data in a TX status and the offsets in it.
+#define XBEE_API_TX_STATUS_SIZE     7
+#define XBEE_API_TX_STATUS_ID       1
+#define XBEE_API_TX_STATUS_RETRIES  4
+#define XBEE_API_TX_STATUS_DELIVERY 5
+
+// Offsets in an AT command response.
+#define XBEE_API_AT_RESPONSE_ID     1
+#define XBEE_API_AT_RESPONSE_CMD    2
+#define XBEE_API_AT_RESPONSE_STATUS 4
+#define XBEE_API_AT_RESPONSE_VALUE  5
+
+// 64 bit address that reaches every radio on the network.
+#define XBEE_API_BROADCAST_ADDR 0x000000000000FFFFULL
+
+// Worst case size of an escaped API frame with length bytes of frame
+//  data. Start byte, then length, data and checksum all escaped.
+#define XBEE_API_ENCODED_LENGTH(length) ( 1 + 2 * ( 2 + (length) + 1 ) )
+
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   XbeeApi
+*       Frames for the XBee's escaped API mode, AP=2. The
+*       start byte begins a frame, then a 16 bit big
+*       endian length, the frame data and a checksum that
+*       makes the frame data sum to 0xFF. Everything after
+*       the start byte has 0x7E, 0x7D, 0x11 and 0x13
+*       escaped.
+*
+*       MaxLen  - Max frame data bytes. Longer frames are
+*                 thrown away.
+*       Handler - Gets complete frames through
+*                 api_frame_received( uint8_t const *,
+*                 uint16_t ), frame type first.
+*
+*       Frames are built with encode_begin, encode_append
+*       and encode_end, the same way Hdlc streams them.
+**********************************************************/
+template< uint16_t MaxLen, typename Handler >
+class XbeeApi
+{
+public:
+    XbeeApi( Handler & handler );
+
+    void receive( uint8_t const * data, size_t length );
+    uint32_t checksum_errors() const;
+
+    static uint8_t * encode_begin( uint16_t length, uint8_t * out, uint8_t &sum );
+    static uint8_t * encode_append( uint8_t const * buffer, uint16_t length, uint8_t * out, uint8_t &sum );
+    static uint8_t * encode_end( uint8_t * out, uint8_t sum );
+
+    static uint16_t encode_tx_request( uint8_t frame_id, uint64_t dest_addr, uint8_t const * data, uint16_t length, uint8_t * out );
+    static uint16_t encode_at_command( uint8_t frame_id, char const * command, uint8_t * out );
+
+private:
+    static uint8_t * escape_byte( uint8_t data, uint8_t * out );
+
+    // Where the parser is in the frame
+    enum
+    {
+        WAIT_START,
+        LENGTH_MSB,
+        LENGTH_LSB,
+        FRAME_DATA,
+        CHECKSUM,
+    };
+
+    Handler & m_handler;
+
+    uint8_t m_state;
+    bool m_escape;
+    uint16_t m_length;
+    uint16_t m_position;
+    uint8_t m_sum;
+    uint32_t m_checksum_errors;
+
+    uint8_t m_buffer[MaxLen];
+};
+
+
+/******************************************************************************
+ *                          Method Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   XbeeApi
+*       Constructor
+**********************************************************/
+template< uint16_t MaxLen, typename Handler >
+XbeeApi< MaxLen, Handler >::XbeeApi( Handler & handler ) :
+    m_handler( handler ),
+    m_state( WAIT_START ),
+    m_escape( false ),
+    m_length( 0 ),
+    m_position( 0 ),
+    m_sum( 0 ),
+    m_checksum_errors( 0 )
+{
+}
+
+
+/**********************************************************
+*   receive
+*       Find API frames in a block of incoming data. The
+*       handler is called once for every complete frame
+*       with a good checksum.
+**********************************************************/
+template< uint16_t MaxLen, typename Handler >
+void XbeeApi< MaxLen, Handler >::receive( uint8_t const * data, size_t length )
+{
+    uint8_t const * const end = data + length;
+
+    while( data < end )
+    {
+        uint8_t byte = *data++;
+
+        // A start byte is never escaped, so it always begins a new
+        //  frame. Whatever was in progress is lost.
+        if( byte == XBEE_API_START_OCTET )
+        {
+            m_state = LENGTH_MSB;
+            m_escape = false;
+            continue;
+        }
+
+        if( m_state == WAIT_START )
+        {
+            continue;
+        }
+
+        if( m_escape )
+        {
+            m_escape = false;
+            byte ^= XBEE_API_INVERT_OCTET;
+        }
+        else if( byte == XBEE_API_ESCAPE_OCTET )
+        {
+            m_escape = true;
+            continue;
+        }
+
+        switch( m_state )
+        {
+            case LENGTH_MSB:
+                m_length = byte << 8;
+                m_state = LENGTH_LSB;
+                break;
+
+            case LENGTH_LSB:
+                m_length |= byte;
+                m_position = 0;
+                m_sum = 0;
+                m_state = ( ( m_length > 0 ) && ( m_length <= MaxLen ) ) ? FRAME_DATA : WAIT_START;
+                break;
+
+            case FRAME_DATA:
+                m_buffer[ m_position++ ] = byte;
+                m_sum += byte;
+                if( m_position == m_length )
+                {
+                    m_state = CHECKSUM;
+                }
+                break;
+
+            case CHECKSUM:
+                m_state = WAIT_START;
+                if( (uint8_t)( m_sum + byte ) == 0xFF )
+                {
+                    m_handler.api_frame_received( m_buffer, m_length );
+                }
+                else
+                {
+                    m_checksum_errors++;
+                }
+                break;
+
+            default:
+                m_state = WAIT_START;
+                break;
+        }
+    }
+}
+
+
+/**********************************************************
+*   checksum_errors
+*       Frames thrown away because their checksum was
+*       wrong.
+**********************************************************/
+template< uint16_t MaxLen, typename Handler >
+uint32_t XbeeApi< MaxLen, Handler >::checksum_errors() const
+{
+    return m_checksum_errors;
+}
+
+
+/**********************************************************
+*   encode_begin
+*       Start a frame with length bytes of frame data in
+*       out. Returns the new end of out. The caller makes
+*       sure out holds XBEE_API_ENCODED_LENGTH( length ).
+**********************************************************/
+template< uint16_t MaxLen, typename Handler >
+uint8_t * XbeeApi< MaxLen, Handler >::encode_begin( uint16_t length, uint8_t * out, uint8_t &sum )
+{
+    sum = 0;
+    *out++ = XBEE_API_START_OCTET;
+    out = escape_byte( length >> 8, out );
+    out = escape_byte( length & 0xFF, out );
+
+    return out;
+}
+
+
+/**********************************************************
+*   encode_append
+*       Escape the next piece of frame data into out and
+*       add it to sum. Returns the new end of out.
+**********************************************************/
+template< uint16_t MaxLen, typename Handler >
+uint8_t * XbeeApi< MaxLen, Handler >::encode_append( uint8_t const * buffer, uint16_t length, uint8_t * out, uint8_t &sum )
+{
+    for( uint16_t i = 0; i < length; i++ )
+    {
+        sum += buffer[i];
+        out = escape_byte( buffer[i], out );
+    }
+
+    return out;
+}
+
+
+/**********************************************************
+*   encode_end
+*       Write the checksum. Returns the new end of out.
+**********************************************************/
+template< uint16_t MaxLen, typename Handler >
+uint8_t * XbeeApi< MaxLen, Handler >::encode_end( uint8_t * out, uint8_t sum )
+{
+    return escape_byte( 0xFF - sum, out );
+}
+
+
+/**********************************************************
+*   encode_tx_request
+*       Build a 0x10 transmit request carrying data to
+*       dest_addr. A frame_id of 0 asks for no TX status.
+*       out must hold XBEE_API_ENCODED_LENGTH(
+*       XBEE_API_TX_HDR_SIZE + length ). Returns the
+*       encoded length.
+**********************************************************/
+template< uint16_t MaxLen, typename Handler >
+uint16_t XbeeApi< MaxLen, Handler >::encode_tx_request( uint8_t frame_id, uint64_t dest_addr, uint8_t const * data, uint16_t length, uint8_t * out )
+{
+    uint8_t hdr[ XBEE_API_TX_HDR_SIZE ];
+    uint8_t * end;
+    uint8_t sum;
+
+    hdr[0] = XBEE_API_TX_REQUEST;
+    hdr[1] = frame_id;
+    for( uint8_t i = 0; i < 8; i++ )
+    {
+        hdr[ 2 + i ] = (uint8_t)( dest_addr >> ( 56 - 8 * i ) );
+    }
+    hdr[10] = 0xFF;     // 16 bit address unknown
+    hdr[11] = 0xFE;
+    hdr[12] = 0;        // Max hops
+    hdr[13] = 0;        // Options from TO
+
+    end = encode_begin( sizeof(hdr) + length, out, sum );
+    end = encode_append( hdr, sizeof(hdr), end, sum );
+    end = encode_append( data, length, end, sum );
+    end = encode_end( end, sum );
+
+    return end - out;
+}
+
+
+/**********************************************************
+*   encode_at_command
+*       Build a 0x08 AT command with no parameter, a query
+*       of the two letter command. out must hold
+*       XBEE_API_ENCODED_LENGTH( 4 ). Returns the encoded
+*       length.
+**********************************************************/
+template< uint16_t MaxLen, typename Handler >
+uint16_t XbeeApi< MaxLen, Handler >::encode_at_command( uint8_t frame_id, char const * command, uint8_t * out )
+{
+    uint8_t const frame[] = { XBEE_API_AT_COMMAND, frame_id, (uint8_t)command[0], (uint8_t)command[1] };
+    uint8_t * end;
+    uint8_t sum;
+
+    end = encode_begin( sizeof(frame), out, sum );
+    end = encode_append( frame, sizeof(frame), end, sum );
+    end = encode_end( end, sum );
+
+    return end - out;
+}
+
+
+/**********************************************************
+*   escape_byte
+*       Write data to out, escaping it if needed. Returns
+*       the new end of out.
+**********************************************************/
+template< uint16_t MaxLen, typename Handler >
+inline uint8_t * XbeeApi< MaxLen, Handler >::escape_byte( uint8_t data, uint8_t * out )
+{
+    if( ( data == XBEE_API_START_OCTET )
+     || ( data == XBEE_API_ESCAPE_OCTET )
+     || ( data == XBEE_API_XON_OCTET )
+     || ( data == XBEE_API_XOFF_OCTET ) )
+    {
+        *out++ = XBEE_API_ESCAPE_OCTET;
+        data ^= XBEE_API_INVERT_OCTET;
+    }
+
+    *out++ = data;
+
+    return out;
+}
+
+#endif
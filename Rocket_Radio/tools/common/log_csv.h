@@ -0,0 +1,113 @@
+// CSV output for the host tools, driven by the same field descriptions
+//  as the binary log.
+#ifndef LOG_CSV_H
+#define LOG_CSV_H
+
+#include "log/bin_log.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   log_csv_field
+*       Print one field of a record the way the firmware's
+*       sprintf did.
+**********************************************************/
+inline void log_csv_field( FILE * out, log_field_t const & field, uint8_t const * data )
+{
+    uint8_t const * p = &data[field.offset];
+
+    switch( field.type )
+    {
+        case LOG_FIELD_U8:
+        case LOG_FIELD_BOOL:
+            fprintf( out, "%u", p[0] );
+            break;
+
+        case LOG_FIELD_U16:
+        {
+            uint16_t v;
+            memcpy( &v, p, sizeof(v) );
+            fprintf( out, "%u", v );
+            break;
+        }
+
+        case LOG_FIELD_U32:
+        {
+            uint32_t v;
+            memcpy( &v, p, sizeof(v) );
+            fprintf( out, "%u", v );
+            break;
+        }
+
+        case LOG_FIELD_I16:
+        {
+            int16_t v;
+            memcpy( &v, p, sizeof(v) );
+            fprintf( out, "%d", v );
+            break;
+        }
+
+        case LOG_FIELD_I32:
+        {
+            int32_t v;
+            memcpy( &v, p, sizeof(v) );
+            fprintf( out, "%d", v );
+            break;
+        }
+
+        case LOG_FIELD_FLOAT:
+        {
+            float v;
+            memcpy( &v, p, sizeof(v) );
+            fprintf( out, "%.*f", field.precision, v );
+            break;
+        }
+
+        default:
+            fprintf( out, "?" );
+            break;
+    }
+}
+
+
+/**********************************************************
+*   log_csv_header
+*       Print the column names of a record type.
+**********************************************************/
+inline void log_csv_header( FILE * out, log_field_t const * fields, uint8_t field_cnt )
+{
+    for( uint8_t f = 0; f < field_cnt; f++ )
+    {
+        char name[ BIN_LOG_FIELD_NAME_LEN + 1 ] = { 0 };
+        memcpy( name, fields[f].name, BIN_LOG_FIELD_NAME_LEN );
+
+        fprintf( out, "%s%s", ( f == 0 ) ? "" : ", ", name );
+    }
+    fprintf( out, "\n" );
+}
+
+
+/**********************************************************
+*   log_csv_row
+*       Print every field of a record.
+**********************************************************/
+inline void log_csv_row( FILE * out, log_field_t const * fields, uint8_t field_cnt, uint8_t const * data )
+{
+    for( uint8_t f = 0; f < field_cnt; f++ )
+    {
+        if( f > 0 )
+        {
+            fprintf( out, ", " );
+        }
+        log_csv_field( out, fields[f], data );
+    }
+    fprintf( out, "\n" );
+}
+
+#endif
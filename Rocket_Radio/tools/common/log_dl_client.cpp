@@ -0,0 +1,426 @@
+#include "log_dl_client.h"
+
+#include <Arduino.h>
+#include <string.h>
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   LogDlClient
+*       Constructor. Transfer tags start from the clock, so
+*       a restarted ground tool doesn't take chunks still
+*       coming for the last one's transfer as its own.
+**********************************************************/
+LogDlClient::LogDlClient( log_dl_send_t const & send ) :
+    m_send( send ),
+    m_xfer( (uint8_t)micros() )
+{
+    memset( &m_file, 0, sizeof(m_file) );
+}
+
+
+void LogDlClient::set_list_hndlr( log_dl_list_hndlr_t const & hndlr )
+{
+    m_list_hndlr = hndlr;
+}
+
+
+void LogDlClient::set_data_hndlr( log_dl_data_hndlr_t const & hndlr )
+{
+    m_data_hndlr = hndlr;
+}
+
+
+/**********************************************************
+*   list
+*       Ask for every log file. The list handler gets each
+*       one, and the state goes back to idle once they're
+*       all in.
+**********************************************************/
+void LogDlClient::list( uint32_t now_ms )
+{
+    m_state = LOG_DL_LISTING;
+    m_list_start = 0;
+    m_heard = false;
+    m_heard_ms = now_ms;
+    this->send_list();
+}
+
+
+/**********************************************************
+*   get
+*       Ask for file from offset, window chunks in flight.
+*       Returns where the data will start, offset rounded
+*       down to a chunk.
+**********************************************************/
+uint32_t LogDlClient::get( log_dl_entry_t const & file, uint32_t offset, uint8_t window, uint32_t now_ms )
+{
+    m_state = LOG_DL_GETTING;
+    m_sts = LOG_DL_STS_OK;
+    m_file = file;
+    m_xfer++;
+    m_window = window;
+    m_base = min( offset, m_file.length ) / LOG_DL_CHUNK;
+    m_map = 0;
+    m_received = m_base * LOG_DL_CHUNK;
+    m_unacked = 0;
+    m_ack_now = false;
+    m_heard = false;
+    m_heard_ms = now_ms;
+    this->send_get();
+
+    return m_received;
+}
+
+
+/**********************************************************
+*   abort
+*       Stop the transfer, if there's one.
+**********************************************************/
+void LogDlClient::abort()
+{
+    log_dl_op_t op = LOG_DL_ABORT;
+
+    if( m_state == LOG_DL_GETTING )
+    {
+        m_send( &op, sizeof(op) );
+    }
+
+    m_state = LOG_DL_IDLE;
+}
+
+
+/**********************************************************
+*   frame_received
+*       LOG_DOWNLINK frame handler.
+**********************************************************/
+void LogDlClient::frame_received( uint8_t const * data, uint16_t size )
+{
+    if( size < sizeof(log_dl_op_t) )
+    {
+        return;
+    }
+
+    switch( data[0] )
+    {
+        case LOG_DL_LIST:
+            this->list_reply( data, size );
+            break;
+
+        case LOG_DL_DATA:
+            this->data( data, size );
+            break;
+
+        case LOG_DL_DONE:
+            if( size >= sizeof(log_dl_done_t) )
+            {
+                log_dl_done_t done;
+
+                memcpy( &done, data, sizeof(done) );
+                this->done( done );
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+/**********************************************************
+*   tick
+*       Send an ACK if one's due, and the request again if
+*       nothing's been heard for LOG_DL_RETRY_MS.
+**********************************************************/
+void LogDlClient::tick( uint32_t now_ms )
+{
+    if( m_heard )
+    {
+        m_heard = false;
+        m_heard_ms = now_ms;
+    }
+
+    if( ( m_state != LOG_DL_LISTING )
+     && ( m_state != LOG_DL_GETTING ) )
+    {
+        return;
+    }
+
+    if( ( m_state == LOG_DL_GETTING )
+     && ( ( m_ack_now )
+       || ( ( m_unacked > 0 )
+         && ( now_ms - m_heard_ms >= LOG_DL_ACK_MS ) ) ) )
+    {
+        this->send_ack();
+    }
+
+    if( now_ms - m_heard_ms >= LOG_DL_RETRY_MS )
+    {
+        m_heard_ms = now_ms;
+        m_retries++;
+
+        if( m_state == LOG_DL_LISTING )
+        {
+            this->send_list();
+        }
+        else
+        {
+            this->send_get();
+        }
+    }
+}
+
+
+log_dl_state_t LogDlClient::state() const
+{
+    return m_state;
+}
+
+
+log_dl_sts_t LogDlClient::status() const
+{
+    return m_sts;
+}
+
+
+/**********************************************************
+*   received
+*       Offset the file has come up to in order, where a
+*       GET would pick up from.
+**********************************************************/
+uint32_t LogDlClient::received() const
+{
+    return m_received;
+}
+
+
+uint32_t LogDlClient::length() const
+{
+    return m_file.length;
+}
+
+
+uint32_t LogDlClient::duplicates() const
+{
+    return m_duplicates;
+}
+
+
+uint32_t LogDlClient::retries() const
+{
+    return m_retries;
+}
+
+
+/**********************************************************
+*   list_reply
+*       Hand on the files in a LIST reply, and ask for the
+*       next lot if there are more. Replies to a request
+*       that was sent again are ignored.
+**********************************************************/
+void LogDlClient::list_reply( uint8_t const * data, uint16_t size )
+{
+    log_dl_list_hdr_t hdr;
+
+    if( ( m_state != LOG_DL_LISTING )
+     || ( size < sizeof(hdr) ) )
+    {
+        return;
+    }
+
+    memcpy( &hdr, data, sizeof(hdr) );
+    if( ( hdr.start != m_list_start )
+     || ( size < sizeof(hdr) + hdr.count * sizeof(log_dl_entry_t) ) )
+    {
+        return;
+    }
+
+    m_heard = true;
+
+    for( uint8_t i = 0; i < hdr.count; i++ )
+    {
+        log_dl_entry_t entry;
+
+        memcpy( &entry, &data[ sizeof(hdr) + i * sizeof(entry) ], sizeof(entry) );
+        if( m_list_hndlr )
+        {
+            m_list_hndlr( entry );
+        }
+    }
+
+    m_list_start += hdr.count;
+
+    if( hdr.more )
+    {
+        this->send_list();
+    }
+    else
+    {
+        m_state = LOG_DL_IDLE;
+    }
+}
+
+
+/**********************************************************
+*   data
+*       Take a chunk. The next one in order is handed on
+*       with any held after it. One further on is held,
+*       and ACKed straight away so the rocket sends the
+*       missing ones again. One already had is ACKed again,
+*       the last ACK was lost.
+**********************************************************/
+void LogDlClient::data( uint8_t const * data, uint16_t size )
+{
+    log_dl_data_hdr_t hdr;
+
+    if( ( ( m_state != LOG_DL_GETTING ) && ( m_state != LOG_DL_DONE_OK ) )
+     || ( size <= sizeof(hdr) )
+     || ( size > sizeof(hdr) + LOG_DL_CHUNK ) )
+    {
+        return;
+    }
+
+    memcpy( &hdr, data, sizeof(hdr) );
+    if( hdr.xfer != m_xfer )
+    {
+        return;
+    }
+
+    uint8_t const * chunk = &data[ sizeof(hdr) ];
+    uint16_t length = size - sizeof(hdr);
+
+    m_heard = true;
+
+    if( hdr.seq < m_base )
+    {
+        m_duplicates++;
+        m_ack_now = true;
+    }
+    else if( hdr.seq == m_base )
+    {
+        this->deliver( chunk, length );
+        m_base++;
+
+        while( m_map & 1 )
+        {
+            uint8_t slot = m_base % LOG_DL_MAX_WINDOW;
+
+            this->deliver( m_chunks[slot], m_chunk_len[slot] );
+            m_base++;
+            m_map >>= 1;
+        }
+        m_map >>= 1;
+
+        m_ack_now |= ( ++m_unacked >= LOG_DL_ACK_EVERY );
+    }
+    else if( hdr.seq - m_base - 1 < LOG_DL_MAX_WINDOW )
+    {
+        uint32_t bit = 1UL << ( hdr.seq - m_base - 1 );
+        uint8_t slot = hdr.seq % LOG_DL_MAX_WINDOW;
+
+        if( m_map & bit )
+        {
+            m_duplicates++;
+        }
+        else
+        {
+            memcpy( m_chunks[slot], chunk, length );
+            m_chunk_len[slot] = length;
+            m_map |= bit;
+        }
+        m_ack_now = true;
+    }
+
+    // Everything's in, ACK so the rocket finishes. DONE may still
+    //  be lost, a GET from the end brings it again.
+    if( m_received >= m_file.length )
+    {
+        m_ack_now = true;
+    }
+}
+
+
+/**********************************************************
+*   done
+*       The rocket's finished. It only does once every
+*       chunk is acked, and the file may have ended short
+*       of the length asked for.
+**********************************************************/
+void LogDlClient::done( log_dl_done_t const & done )
+{
+    if( ( m_state != LOG_DL_GETTING )
+     || ( done.xfer != m_xfer ) )
+    {
+        return;
+    }
+
+    m_heard = true;
+    m_sts = done.sts;
+
+    if( done.sts != LOG_DL_STS_OK )
+    {
+        m_state = LOG_DL_FAILED;
+    }
+    else if( m_received >= done.length )
+    {
+        m_file.length = done.length;
+        m_state = LOG_DL_DONE_OK;
+    }
+}
+
+
+void LogDlClient::deliver( uint8_t const * data, uint16_t size )
+{
+    if( m_data_hndlr )
+    {
+        m_data_hndlr( data, size );
+    }
+
+    m_received += size;
+}
+
+
+void LogDlClient::send_list()
+{
+    log_dl_list_req_t req;
+
+    req.op = LOG_DL_LIST;
+    req.start = m_list_start;
+    m_send( (uint8_t const *)&req, sizeof(req) );
+}
+
+
+/**********************************************************
+*   send_get
+*       GET from where the data in order stops, for the
+*       first request and every retry.
+**********************************************************/
+void LogDlClient::send_get()
+{
+    log_dl_get_t get;
+
+    get.op = LOG_DL_GET;
+    get.xfer = m_xfer;
+    get.file = m_file;
+    get.offset = m_base * LOG_DL_CHUNK;
+    get.window = m_window;
+    m_send( (uint8_t const *)&get, sizeof(get) );
+}
+
+
+void LogDlClient::send_ack()
+{
+    log_dl_ack_t ack;
+
+    ack.op = LOG_DL_ACK;
+    ack.xfer = m_xfer;
+    ack.base = m_base;
+    ack.map = m_map;
+    m_send( (uint8_t const *)&ack, sizeof(ack) );
+
+    m_unacked = 0;
+    m_ack_now = false;
+}
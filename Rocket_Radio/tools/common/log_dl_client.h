@@ -0,0 +1,128 @@
+// The ground's end of the log downlink, for the host tools. The
+//  firmware only has LogDownlink, the rocket's end.
+#ifndef LOG_DL_CLIENT_H
+#define LOG_DL_CLIENT_H
+
+#include "log/log_downlink.h"
+
+#include <stdint.h>
+#include <functional>
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// ACK once this many chunks have come in order, once one comes
+//  out of order, or this long after the last chunk if there are any
+//  not acked yet.
+#define LOG_DL_ACK_EVERY 4
+#define LOG_DL_ACK_MS 200
+
+// Ask again after hearing nothing for this long. A transfer
+//  picks up from where the data it has stops.
+#define LOG_DL_RETRY_MS 5000
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// Where the client is.
+typedef uint8_t log_dl_state_t;
+enum
+{
+    LOG_DL_IDLE     = 0,
+    LOG_DL_LISTING  = 1,
+    LOG_DL_GETTING  = 2,
+    LOG_DL_DONE_OK  = 3,    // The whole file came and the rocket said so
+    LOG_DL_FAILED   = 4,    // The rocket couldn't send it, see status()
+};
+
+// Sends a LOG_DOWNLINK frame's data, not including the data type.
+typedef std::function<void(uint8_t const *, uint16_t)> log_dl_send_t;
+
+// Called with each file LIST finds.
+typedef std::function<void(log_dl_entry_t const &)> log_dl_list_hndlr_t;
+
+// Called with the file's bytes, in order, from where GET started.
+typedef std::function<void(uint8_t const *, uint16_t)> log_dl_data_hndlr_t;
+
+
+/******************************************************************************
+ *                                Classes
+ *****************************************************************************/
+
+/**********************************************************
+*   LogDlClient
+*       The ground's end of LogDownlink. Asks for the file
+*       list or a file, ACKs chunks and puts them back in
+*       order, holding up to a window of them that came
+*       ahead of one that's missing. Frames go out through
+*       the send function, which has to add the data type.
+*
+*       A request that goes LOG_DL_RETRY_MS unanswered is
+*       sent again, a GET from where the data in order
+*       stops, so a transfer carries on through a dropout
+*       or a reset of either end. get() can start from an
+*       offset too, for a file part of which came before.
+**********************************************************/
+class LogDlClient
+{
+public:
+    LogDlClient( log_dl_send_t const & send );
+
+    void set_list_hndlr( log_dl_list_hndlr_t const & hndlr );
+    void set_data_hndlr( log_dl_data_hndlr_t const & hndlr );
+
+    void list( uint32_t now_ms );
+    uint32_t get( log_dl_entry_t const & file, uint32_t offset, uint8_t window, uint32_t now_ms );
+    void abort();
+    void frame_received( uint8_t const * data, uint16_t size );
+    void tick( uint32_t now_ms );
+
+    log_dl_state_t state() const;
+    log_dl_sts_t status() const;
+    uint32_t received() const;
+    uint32_t length() const;
+    uint32_t duplicates() const;
+    uint32_t retries() const;
+
+private:
+    void list_reply( uint8_t const * data, uint16_t size );
+    void data( uint8_t const * data, uint16_t size );
+    void done( log_dl_done_t const & done );
+    void deliver( uint8_t const * data, uint16_t size );
+    void send_list();
+    void send_get();
+    void send_ack();
+
+    log_dl_send_t m_send;
+    log_dl_list_hndlr_t m_list_hndlr;
+    log_dl_data_hndlr_t m_data_hndlr;
+
+    log_dl_state_t m_state = LOG_DL_IDLE;
+    log_dl_sts_t m_sts = LOG_DL_STS_OK;
+    bool m_heard = false;           // A frame came since the last tick()
+    uint32_t m_heard_ms = 0;        // Last frame, or request sent
+    uint16_t m_list_start = 0;
+
+    // The transfer. Every chunk before m_base has been handed on, bit
+    //  i of m_map is set if chunk m_base + 1 + i is held in slot
+    //  ( m_base + 1 + i ) % LOG_DL_MAX_WINDOW.
+    log_dl_entry_t m_file;
+    uint8_t m_xfer;                 // From the clock, see the constructor
+    uint8_t m_window = LOG_DL_WINDOW;
+    uint32_t m_base = 0;
+    uint32_t m_map = 0;
+    uint32_t m_received = 0;
+    uint8_t m_unacked = 0;          // Chunks in order since the last ACK
+    bool m_ack_now = false;
+
+    uint8_t m_chunks[LOG_DL_MAX_WINDOW][LOG_DL_CHUNK];
+    uint8_t m_chunk_len[LOG_DL_MAX_WINDOW];
+
+    uint32_t m_duplicates = 0;
+    uint32_t m_retries = 0;
+};
+
+#endif
@@ -0,0 +1,108 @@
+// Reads the binary logs BinLog writes, for the host tools.
+#ifndef LOG_READ_H
+#define LOG_READ_H
+
+#include "log/bin_log.h"
+
+#include <stdio.h>
+#include <vector>
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// A record type as the file's header describes it.
+typedef struct
+{
+    log_rec_desc_t desc;
+    std::vector<log_field_t> fields;
+} log_rec_info_t;
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   log_read_header
+*       Parse the file header and record descriptions and
+*       leave in at the first record.
+**********************************************************/
+inline bool log_read_header( FILE * in, log_hdr_t & hdr, std::vector<log_rec_info_t> & recs )
+{
+    if( ( fread( &hdr, sizeof(hdr), 1, in ) != 1 )
+     || ( hdr.magic != BIN_LOG_MAGIC ) )
+    {
+        fprintf( stderr, "not a binary log\n" );
+        return false;
+    }
+
+    if( ( hdr.version < 1 )
+     || ( hdr.version > BIN_LOG_VERSION ) )
+    {
+        fprintf( stderr, "unknown log version %u\n", hdr.version );
+        return false;
+    }
+
+    for( uint8_t i = 0; i < hdr.rec_type_cnt; i++ )
+    {
+        log_rec_info_t rec;
+
+        if( fread( &rec.desc, sizeof(rec.desc), 1, in ) != 1 )
+        {
+            return false;
+        }
+
+        rec.fields.resize( rec.desc.field_cnt );
+        if( ( rec.desc.field_cnt > 0 )
+         && ( fread( rec.fields.data(), sizeof(log_field_t), rec.desc.field_cnt, in ) != rec.desc.field_cnt ) )
+        {
+            return false;
+        }
+
+        recs.push_back( rec );
+    }
+
+    return fseek( in, hdr.hdr_size, SEEK_SET ) == 0;
+}
+
+
+/**********************************************************
+*   log_read_record
+*       Read the next record into rec_hdr and data, which
+*       must hold 256 bytes. Anything that isn't a sync
+*       byte is padding or garbage and is counted in
+*       skipped. Returns false at the end of the file.
+**********************************************************/
+inline bool log_read_record( FILE * in, std::vector<log_rec_info_t> const & recs, log_rec_hdr_t & rec_hdr, uint8_t * data, uint32_t & skipped )
+{
+    int c;
+
+    while( ( c = fgetc( in ) ) != EOF )
+    {
+        if( c != BIN_LOG_SYNC )
+        {
+            skipped++;
+            continue;
+        }
+
+        rec_hdr.sync = (uint8_t)c;
+        if( fread( &rec_hdr.rec_type, sizeof(rec_hdr) - 1, 1, in ) != 1 )
+        {
+            return false;
+        }
+
+        if( rec_hdr.rec_type >= recs.size() )
+        {
+            skipped += sizeof(rec_hdr);
+            continue;
+        }
+
+        return fread( data, recs[rec_hdr.rec_type].desc.size, 1, in ) == 1;
+    }
+
+    return false;
+}
+
+#endif
@@ -0,0 +1,89 @@
+// Raw serial port setup shared by the host tools that talk to the radio.
+#ifndef SERIAL_PORT_H
+#define SERIAL_PORT_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <termios.h>
+#include <unistd.h>
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   baud_const
+*       termios speed for a baud rate, 0 if there's none.
+**********************************************************/
+inline speed_t baud_const( uint32_t baud )
+{
+    switch( baud )
+    {
+        case 9600:      return B9600;
+        case 19200:     return B19200;
+        case 38400:     return B38400;
+        case 57600:     return B57600;
+        case 115200:    return B115200;
+        case 230400:    return B230400;
+        default:        return 0;
+    }
+}
+
+
+/**********************************************************
+*   serial_set_raw
+*       Put an open serial port or pty in raw mode at baud.
+*       A read() returns what's there, or nothing after
+*       vtime tenths of a second, so a caller can wake up
+*       on a quiet link. False, with errno set, if the port
+*       won't take it.
+**********************************************************/
+inline bool serial_set_raw( int fd, uint32_t baud, uint8_t vtime )
+{
+    struct termios tio;
+
+    if( tcgetattr( fd, &tio ) != 0 )
+    {
+        return false;
+    }
+
+    cfmakeraw( &tio );
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = vtime;
+    cfsetispeed( &tio, baud_const( baud ) );
+    cfsetospeed( &tio, baud_const( baud ) );
+
+    return tcsetattr( fd, TCSANOW, &tio ) == 0;
+}
+
+
+/**********************************************************
+*   serial_open
+*       Open a serial port or pty for reading and writing,
+*       raw at baud, see serial_set_raw. -1, with the error
+*       printed, if it can't be.
+**********************************************************/
+inline int serial_open( char const * path, uint32_t baud, uint8_t vtime )
+{
+    int fd = ::open( path, O_RDWR | O_NOCTTY );
+
+    if( fd < 0 )
+    {
+        perror( path );
+        return -1;
+    }
+
+    if( !serial_set_raw( fd, baud, vtime ) )
+    {
+        perror( path );
+        close( fd );
+        return -1;
+    }
+
+    return fd;
+}
+
+#endif
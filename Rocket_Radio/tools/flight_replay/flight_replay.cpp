@@ -0,0 +1,415 @@
+// Runs recorded sensor CSVs through the launch and apogee detectors the
+//  firmware uses, to see where a flight would have set them off and to
+//  try new thresholds and windows against old flights.
+//
+//  platformio run -e flight_replay
+//  .pioenvs/flight_replay/program [-p ms] [-s name=value ...] snsr_3.csv [more.csv ...]
+//
+// Takes any CSV with accel_X/Y/Z and/or "air pressure" columns: the snsr
+//  CSVs tools/log2csv writes, with or without -t, its accel and prsur
+//  ones from tagged records, or the ones the firmware wrote before the
+//  binary log. Rows are timed by a time_ms or time_us column, or failing
+//  that -p ms apart, 100 by default. Several files are merged by time.
+//  -s sets any flight_cfg_t field by name, see cfg_names. Exits non zero
+//  if no launch was found.
+#include "flight/flight_detect.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define FLIGHT_REPLAY_ROW_MS 100
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+// One sample for the detectors.
+typedef struct
+{
+    uint32_t time_ms;
+    bool is_accel;
+    float x;                    // Pressure in x if not accel
+    float y;
+    float z;
+} replay_sample_t;
+
+// A flight_cfg_t field -s can set.
+typedef struct
+{
+    char const * name;
+    void * field;
+    bool is_float;
+    uint8_t size;
+} cfg_name_t;
+
+
+/******************************************************************************
+ *                                Variables
+ *****************************************************************************/
+
+// Same as the firmware's, main.cpp
+static flight_cfg_t cfg =
+{
+    30.0,       // launch_accel m/s^2, about 3g
+    100,        // launch_hold_ms
+    0.1,        // launch_dp psi, about 70m up
+    0.02,       // apogee_dp psi, about 15m down
+    200,        // apogee_hold_ms
+    4000,       // apogee_lockout_ms
+    2000,       // pre_ms
+    10000,      // post_ms
+    120000,     // burst_max_ms
+};
+
+#define CFG_NAME( _name, _float ) { #_name, &cfg._name, _float, sizeof(cfg._name) }
+
+static const cfg_name_t cfg_names[] =
+{
+    CFG_NAME( launch_accel,         true    ),
+    CFG_NAME( launch_hold_ms,       false   ),
+    CFG_NAME( launch_dp,            true    ),
+    CFG_NAME( apogee_dp,            true    ),
+    CFG_NAME( apogee_hold_ms,       false   ),
+    CFG_NAME( apogee_lockout_ms,    false   ),
+    CFG_NAME( pre_ms,               false   ),
+    CFG_NAME( post_ms,              false   ),
+    CFG_NAME( burst_max_ms,         false   ),
+};
+
+static char const * const event_names[] =
+{
+    "none",
+    "launch",
+    "apogee",
+    "burst end",
+};
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   trim
+*       Strip spaces and line endings from both ends.
+**********************************************************/
+static std::string trim( std::string const & s )
+{
+    size_t start = s.find_first_not_of( " \t\r\n" );
+    size_t end = s.find_last_not_of( " \t\r\n" );
+
+    return ( start == std::string::npos ) ? "" : s.substr( start, end - start + 1 );
+}
+
+
+static std::vector<std::string> split( char const * line )
+{
+    std::vector<std::string> cols;
+    std::string col;
+
+    for( char const * p = line; *p; p++ )
+    {
+        if( *p == ',' )
+        {
+            cols.push_back( trim( col ) );
+            col.clear();
+        }
+        else
+        {
+            col += *p;
+        }
+    }
+    cols.push_back( trim( col ) );
+
+    return cols;
+}
+
+
+static int find_col( std::vector<std::string> const & names, char const * name )
+{
+    for( size_t c = 0; c < names.size(); c++ )
+    {
+        if( names[c] == name )
+        {
+            return (int)c;
+        }
+    }
+
+    return -1;
+}
+
+
+/**********************************************************
+*   read_csv
+*       Read the accel and pressure samples in a CSV,
+*       timed as described at the top.
+**********************************************************/
+static bool read_csv( char const * path, uint32_t row_ms, std::vector<replay_sample_t> & samples )
+{
+    char line[ 1024 ];
+    uint32_t row = 0;
+
+    FILE * in = fopen( path, "r" );
+    if( !in )
+    {
+        perror( path );
+        return false;
+    }
+
+    if( !fgets( line, sizeof(line), in ) )
+    {
+        fclose( in );
+        return false;
+    }
+
+    std::vector<std::string> names = split( line );
+    int time_ms_col = find_col( names, "time_ms" );
+    int time_us_col = find_col( names, "time_us" );
+    int accel_col[3] =
+    {
+        find_col( names, "accel_X" ),
+        find_col( names, "accel_Y" ),
+        find_col( names, "accel_Z" ),
+    };
+    int prsur_col = find_col( names, "air pressure" );
+    bool has_accel = ( accel_col[0] >= 0 ) && ( accel_col[1] >= 0 ) && ( accel_col[2] >= 0 );
+
+    if( ( !has_accel )
+     && ( prsur_col < 0 ) )
+    {
+        fprintf( stderr, "%s: no accel_X/Y/Z or air pressure columns\n", path );
+        fclose( in );
+        return false;
+    }
+
+    while( fgets( line, sizeof(line), in ) )
+    {
+        std::vector<std::string> cols = split( line );
+        replay_sample_t sample;
+
+        if( cols.size() < names.size() )
+        {
+            continue;
+        }
+
+        // time_ms from log2csv -t is when the record was written, the
+        //  sample's own time_us is better if it's there
+        if( time_us_col >= 0 )
+        {
+            sample.time_ms = (uint32_t)( strtoul( cols[time_us_col].c_str(), NULL, 10 ) / 1000 );
+        }
+        else if( time_ms_col >= 0 )
+        {
+            sample.time_ms = (uint32_t)strtoul( cols[time_ms_col].c_str(), NULL, 10 );
+        }
+        else
+        {
+            sample.time_ms = row * row_ms;
+        }
+        row++;
+
+        if( has_accel )
+        {
+            sample.is_accel = true;
+            sample.x = strtof( cols[accel_col[0]].c_str(), NULL );
+            sample.y = strtof( cols[accel_col[1]].c_str(), NULL );
+            sample.z = strtof( cols[accel_col[2]].c_str(), NULL );
+            samples.push_back( sample );
+        }
+
+        if( prsur_col >= 0 )
+        {
+            sample.is_accel = false;
+            sample.x = strtof( cols[prsur_col].c_str(), NULL );
+            sample.y = 0;
+            sample.z = 0;
+            samples.push_back( sample );
+        }
+    }
+
+    fclose( in );
+    return true;
+}
+
+
+/**********************************************************
+*   set_cfg
+*       Set a flight_cfg_t field from name=value.
+**********************************************************/
+static bool set_cfg( char const * arg )
+{
+    char const * eq = strchr( arg, '=' );
+
+    if( !eq )
+    {
+        return false;
+    }
+
+    for( cfg_name_t const & name : cfg_names )
+    {
+        if( ( strlen( name.name ) != (size_t)( eq - arg ) )
+         || ( strncmp( name.name, arg, eq - arg ) != 0 ) )
+        {
+            continue;
+        }
+
+        if( name.is_float )
+        {
+            *(float *)name.field = strtof( eq + 1, NULL );
+        }
+        else if( name.size == sizeof(uint16_t) )
+        {
+            *(uint16_t *)name.field = (uint16_t)strtoul( eq + 1, NULL, 10 );
+        }
+        else
+        {
+            *(uint32_t *)name.field = (uint32_t)strtoul( eq + 1, NULL, 10 );
+        }
+        return true;
+    }
+
+    return false;
+}
+
+
+/**********************************************************
+*   print_event
+**********************************************************/
+static void print_event( FlightDetect const & flight, flight_event_t event, uint32_t time_ms )
+{
+    uint32_t at_ms = time_ms;
+
+    if( event == FLIGHT_EVT_LAUNCH )
+    {
+        at_ms = flight.launch_ms();
+    }
+    else if( event == FLIGHT_EVT_APOGEE )
+    {
+        at_ms = flight.apogee_ms();
+    }
+
+    printf( "%-10s %9.3f s  seen %9.3f s  pressure %8.4f ground %8.4f psi\n",
+            event_names[event],
+            at_ms / 1000.0,
+            time_ms / 1000.0,
+            flight.prsur(),
+            flight.ground_prsur() );
+}
+
+
+/**********************************************************
+*   main
+**********************************************************/
+int main( int argc, char ** argv )
+{
+    std::vector<replay_sample_t> samples;
+    std::vector<char const *> paths;
+    uint32_t row_ms = FLIGHT_REPLAY_ROW_MS;
+    FlightDetect flight( cfg );
+    uint32_t burst_end_ms = FLIGHT_NO_TIME;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        if( ( strcmp( argv[i], "-p" ) == 0 )
+         && ( i + 1 < argc ) )
+        {
+            row_ms = (uint32_t)strtoul( argv[++i], NULL, 10 );
+        }
+        else if( ( strcmp( argv[i], "-s" ) == 0 )
+              && ( i + 1 < argc ) )
+        {
+            if( !set_cfg( argv[++i] ) )
+            {
+                fprintf( stderr, "unknown setting %s\n", argv[i] );
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            paths.push_back( argv[i] );
+        }
+    }
+
+    if( paths.empty() )
+    {
+        fprintf( stderr, "usage: %s [-p ms] [-s name=value ...] snsr_N.csv [...]\n", argv[0] );
+        fprintf( stderr, "settings:" );
+        for( cfg_name_t const & name : cfg_names )
+        {
+            fprintf( stderr, " %s", name.name );
+        }
+        fprintf( stderr, "\n" );
+        return EXIT_FAILURE;
+    }
+
+    for( char const * path : paths )
+    {
+        if( !read_csv( path, row_ms, samples ) )
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    if( samples.empty() )
+    {
+        fprintf( stderr, "no samples\n" );
+        return EXIT_FAILURE;
+    }
+
+    std::stable_sort( samples.begin(), samples.end(), []( replay_sample_t const & a, replay_sample_t const & b )
+    {
+        return a.time_ms < b.time_ms;
+    });
+
+    flight.reset();
+    for( replay_sample_t const & s : samples )
+    {
+        flight_event_t event = s.is_accel ? flight.accel( s.time_ms, s.x, s.y, s.z )
+                                          : flight.pressure( s.time_ms, s.x );
+
+        if( event != FLIGHT_EVT_NONE )
+        {
+            print_event( flight, event, s.time_ms );
+        }
+
+        event = flight.tick( s.time_ms );
+        if( event != FLIGHT_EVT_NONE )
+        {
+            print_event( flight, event, s.time_ms );
+            burst_end_ms = s.time_ms;
+        }
+    }
+
+    printf( "%u samples, %.3f to %.3f s\n", (unsigned)samples.size(), samples.front().time_ms / 1000.0, samples.back().time_ms / 1000.0 );
+
+    if( flight.launch_ms() == FLIGHT_NO_TIME )
+    {
+        printf( "no launch\n" );
+        return EXIT_FAILURE;
+    }
+
+    // What the SD log would hold at the burst rates
+    uint32_t pre_start_ms = ( flight.launch_ms() > cfg.pre_ms ) ? flight.launch_ms() - cfg.pre_ms : 0;
+
+    printf( "burst log %.3f to ", pre_start_ms / 1000.0 );
+    if( burst_end_ms == FLIGHT_NO_TIME )
+    {
+        printf( "end of data\n" );
+    }
+    else
+    {
+        printf( "%.3f s, %.1f s long\n", burst_end_ms / 1000.0, ( burst_end_ms - pre_start_ms ) / 1000.0 );
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,607 @@
+// Ground station decoder. Reads the radio's byte stream from a serial
+//  port, a pty or a capture file, decodes it with the same Hdlc code as
+//  the firmware and writes the sensor and GPS data out.
+//
+//  platformio run -e ground
+//  .pioenvs/ground/program [-b baud] [-f csv|bin] [-o prefix] [-c capture.bin] [-q] /dev/ttyUSB0
+//  .pioenvs/ground/program -l
+//
+// With -f csv (the default) there's a prefix_snsr.csv and prefix_gps.csv
+//  with the log's columns plus rx_ms, when the frame arrived. With -f bin
+//  it's prefix.bin in the SD log's format, which tools/log2csv reads.
+//  SENSOR_DATA, SENSOR_BATCH and SENSOR_CODED frames all go in as sensor
+//  rows. Frame rates and crc errors are printed once a second unless -q,
+//  and a summary when the input ends or on ^C.
+//
+// -c also records every byte read, with when it was read, as link
+//  records in a binary log that tools/replay plays back.
+//
+// -l prints where every field sits in SENSOR_DATA and GPS_DATA frames,
+//  from the same schema the firmware packs them with, to check the
+//  LabVIEW clusters against.
+#include "log/bin_log.h"
+#include "log/link_capture.h"
+#include "telemetry/sensor_batch.h"
+#include "telemetry/tlm_codec.h"
+#include "telemetry/tlm_schema.h"
+#include "xbee/xbee.h"
+#include "../common/log_csv.h"
+#include "../common/serial_port.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define GROUND_DEFAULT_BAUD 9600
+#define GROUND_READ_SIZE 4096
+#define GROUND_REPORT_MS 1000
+
+// Frame types there are names for.
+#define GROUND_TYPE_CNT 8
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+typedef std::chrono::steady_clock ground_clock_t;
+
+// Fwrite as a BinLog sink.
+struct file_sink_t
+{
+    FILE * file;
+
+    void write( uint8_t const * data, size_t length ) { fwrite( data, 1, length, file ); }
+};
+
+// The decoder never sends.
+struct null_sink_t
+{
+    void write( uint8_t ) {}
+    void write( uint8_t const *, size_t ) {}
+};
+
+/**********************************************************
+*   Ground
+*       Gets every good frame from the Hdlc decoder,
+*       counts it and writes out what's in it.
+**********************************************************/
+class Ground
+{
+public:
+    Ground( bool binary, std::string const & prefix );
+    ~Ground();
+
+    bool open();
+    void frame_received( uint8_t * data, uint16_t size );
+    void report( FILE * out, double seconds, uint32_t crc_errors, uint32_t fec_corrected, bool totals );
+
+    uint64_t bytes;
+
+private:
+    void sensor( data_pkg_t const & data );
+    void gps( gps_data_t const & data );
+    uint32_t rx_ms();
+
+    bool m_binary;
+    std::string m_prefix;
+    FILE * m_snsr;
+    FILE * m_gps;
+    file_sink_t m_sink;
+    BinLog< file_sink_t > m_log;
+    TlmDecoder m_decoder;
+    ground_clock_t::time_point m_start;
+
+    uint32_t m_frames[256];
+    uint32_t m_window[256];
+    uint64_t m_window_bytes;
+    uint32_t m_samples;
+};
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+static char const * const type_names[GROUND_TYPE_CNT] =
+{
+    "SENSOR_DATA",
+    "GPS_DATA",
+    "DATA_LOG",
+    "SENSOR_BATCH",
+    "SENSOR_CODED",
+    "SENSOR_TAGGED",
+    "DIAGNOSTICS",
+    "LOG_DOWNLINK",
+};
+
+static volatile sig_atomic_t stop_requested;
+
+
+/******************************************************************************
+ *                          Method Definitions
+ *****************************************************************************/
+
+Ground::Ground( bool binary, std::string const & prefix ) :
+    bytes( 0 ),
+    m_binary( binary ),
+    m_prefix( prefix ),
+    m_snsr( NULL ),
+    m_gps( NULL ),
+    m_sink(),
+    m_log( m_sink ),
+    m_start( ground_clock_t::now() ),
+    m_window_bytes( 0 ),
+    m_samples( 0 )
+{
+    memset( m_frames, 0, sizeof(m_frames) );
+    memset( m_window, 0, sizeof(m_window) );
+}
+
+
+Ground::~Ground()
+{
+    if( m_snsr )
+    {
+        fclose( m_snsr );
+    }
+
+    if( m_gps )
+    {
+        fclose( m_gps );
+    }
+
+    if( m_sink.file )
+    {
+        fclose( m_sink.file );
+    }
+}
+
+
+/**********************************************************
+*   open
+*       Create the output files and write their headers.
+**********************************************************/
+bool Ground::open()
+{
+    if( m_binary )
+    {
+        std::string path = m_prefix + ".bin";
+
+        m_sink.file = fopen( path.c_str(), "wb" );
+        if( !m_sink.file )
+        {
+            perror( path.c_str() );
+            return false;
+        }
+
+        m_log.begin();
+        return true;
+    }
+
+    std::string snsr_path = m_prefix + "_snsr.csv";
+    std::string gps_path = m_prefix + "_gps.csv";
+    log_layout_t const & snsr = bin_log_layouts[LOG_REC_SENSOR];
+    log_layout_t const & gps = bin_log_layouts[LOG_REC_GPS];
+
+    m_snsr = fopen( snsr_path.c_str(), "w" );
+    m_gps = fopen( gps_path.c_str(), "w" );
+    if( !m_snsr || !m_gps )
+    {
+        perror( m_snsr ? gps_path.c_str() : snsr_path.c_str() );
+        return false;
+    }
+
+    fprintf( m_snsr, "rx_ms, " );
+    log_csv_header( m_snsr, snsr.fields, snsr.desc.field_cnt );
+    fprintf( m_gps, "rx_ms, " );
+    log_csv_header( m_gps, gps.fields, gps.desc.field_cnt );
+    return true;
+}
+
+
+/**********************************************************
+*   frame_received
+*       Hdlc handler. data starts with the data type.
+**********************************************************/
+void Ground::frame_received( uint8_t * data, uint16_t size )
+{
+    if( size < 1 )
+    {
+        return;
+    }
+
+    uint8_t const * payload = data + 1;
+    uint16_t length = size - 1;
+
+    m_frames[data[0]]++;
+    m_window[data[0]]++;
+
+    switch( data[0] )
+    {
+        case SENSOR_DATA:
+            if( length == SENSOR_DATA_WIRE_SIZE )
+            {
+                data_pkg_t pkg;
+                sensor_wire_t::unpack( payload, pkg );
+                this->sensor( pkg );
+            }
+            break;
+
+        case GPS_DATA:
+            if( length == GPS_DATA_WIRE_SIZE )
+            {
+                gps_data_t gps;
+                gps_wire_t::unpack( payload, gps );
+                this->gps( gps );
+            }
+            break;
+
+        case SENSOR_BATCH:
+        {
+            uint8_t count = ( length > 0 ) ? payload[0] : 0;
+
+            if( length != 1 + count * SENSOR_SAMPLE_WIRE_SIZE )
+            {
+                break;
+            }
+
+            for( uint8_t i = 0; i < count; i++ )
+            {
+                sensor_sample_t sample;
+                sensor_sample_unpack( &payload[ 1 + i * SENSOR_SAMPLE_WIRE_SIZE ], sample );
+                this->sensor( sample.data );
+            }
+            break;
+        }
+
+        case SENSOR_CODED:
+        {
+            sensor_sample_t samples[ SENSOR_BATCH_RING_SIZE ];
+            uint8_t count = m_decoder.decode_frame( payload, length, samples, SENSOR_BATCH_RING_SIZE );
+
+            for( uint8_t i = 0; i < count; i++ )
+            {
+                this->sensor( samples[i].data );
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+
+/**********************************************************
+*   report
+*       Print frames per second of each type since the
+*       last report, or with totals every frame so far.
+**********************************************************/
+void Ground::report( FILE * out, double seconds, uint32_t crc_errors, uint32_t fec_corrected, bool totals )
+{
+    uint32_t const * counts = totals ? m_frames : m_window;
+    uint64_t window_bytes = totals ? bytes : bytes - m_window_bytes;
+
+    fprintf( out, "%8.1fs %9.0f B/s", (double)this->rx_ms() / 1000, window_bytes / seconds );
+
+    for( uint16_t t = 0; t < 256; t++ )
+    {
+        if( counts[t] == 0 )
+        {
+            continue;
+        }
+
+        if( t < GROUND_TYPE_CNT )
+        {
+            fprintf( out, "  %s", type_names[t] );
+        }
+        else
+        {
+            fprintf( out, "  type %u", t );
+        }
+
+        if( totals )
+        {
+            fprintf( out, " %u", counts[t] );
+        }
+        else
+        {
+            fprintf( out, " %.1f/s", counts[t] / seconds );
+        }
+    }
+
+    fprintf( out, "  crc errors %u", crc_errors );
+    if( fec_corrected )
+    {
+        fprintf( out, "  fixed by fec %u", fec_corrected );
+    }
+    if( totals )
+    {
+        fprintf( out, "  samples %u, %u coded frames bad", m_samples, m_decoder.bad_frames() );
+    }
+    fprintf( out, "\n" );
+
+    memset( m_window, 0, sizeof(m_window) );
+    m_window_bytes = bytes;
+}
+
+
+void Ground::sensor( data_pkg_t const & data )
+{
+    uint32_t time_ms = this->rx_ms();
+    log_layout_t const & layout = bin_log_layouts[LOG_REC_SENSOR];
+
+    m_samples++;
+
+    if( m_binary )
+    {
+        m_log.write( LOG_REC_SENSOR, &data, sizeof(data), time_ms );
+        return;
+    }
+
+    fprintf( m_snsr, "%u, ", time_ms );
+    log_csv_row( m_snsr, layout.fields, layout.desc.field_cnt, (uint8_t const *)&data );
+}
+
+
+void Ground::gps( gps_data_t const & data )
+{
+    uint32_t time_ms = this->rx_ms();
+    log_layout_t const & layout = bin_log_layouts[LOG_REC_GPS];
+
+    if( m_binary )
+    {
+        m_log.write( LOG_REC_GPS, &data, sizeof(data), time_ms );
+        return;
+    }
+
+    fprintf( m_gps, "%u, ", time_ms );
+    log_csv_row( m_gps, layout.fields, layout.desc.field_cnt, (uint8_t const *)&data );
+}
+
+
+uint32_t Ground::rx_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>( ground_clock_t::now() - m_start ).count();
+}
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   open_input
+*       Open a capture file as is, or a serial port or pty
+*       raw at baud. live is set for the latter.
+**********************************************************/
+static int open_input( char const * path, uint32_t baud, bool &live )
+{
+    struct stat st;
+    int fd = ::open( path, O_RDONLY | O_NOCTTY );
+
+    if( fd < 0 )
+    {
+        perror( path );
+        return -1;
+    }
+
+    live = ( fstat( fd, &st ) == 0 ) && S_ISCHR( st.st_mode );
+    if( !live )
+    {
+        return fd;
+    }
+
+    // Wake at least every 0.5s so the report goes out on a quiet link
+    if( !serial_set_raw( fd, baud, 5 ) )
+    {
+        perror( path );
+        close( fd );
+        return -1;
+    }
+
+    return fd;
+}
+
+
+static void on_signal( int )
+{
+    stop_requested = 1;
+}
+
+
+/**********************************************************
+*   print_layout
+*       Print one frame type's fields in wire order.
+**********************************************************/
+template< typename Schema >
+static void print_layout( char const * name, log_field_t const * fields, uint8_t count )
+{
+    static char const * const field_types[] = { "U8", "U16", "U32", "I16", "I32", "SGL", "TF" };
+
+    printf( "%s, %u bytes, little endian\n", name, Schema::size );
+
+    for( uint16_t wire = 0; wire < Schema::size; wire++ )
+    {
+        for( uint8_t f = 0; f < count; f++ )
+        {
+            if( Schema::wire( f ) == wire )
+            {
+                printf( "  %3u  %-4s %.*s\n", wire, field_types[ fields[f].type ], BIN_LOG_FIELD_NAME_LEN, fields[f].name );
+            }
+        }
+    }
+}
+
+
+/**********************************************************
+*   main
+**********************************************************/
+int main( int argc, char ** argv )
+{
+    uint32_t baud = GROUND_DEFAULT_BAUD;
+    bool binary = false;
+    bool quiet = false;
+    bool live = false;
+    std::string prefix = "ground";
+    char const * in_path = NULL;
+    char const * capture_path = NULL;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        if( ( strcmp( argv[i], "-b" ) == 0 )
+         && ( i + 1 < argc ) )
+        {
+            baud = strtoul( argv[++i], NULL, 10 );
+        }
+        else if( ( strcmp( argv[i], "-f" ) == 0 )
+              && ( i + 1 < argc ) )
+        {
+            binary = ( strcmp( argv[++i], "bin" ) == 0 );
+        }
+        else if( ( strcmp( argv[i], "-o" ) == 0 )
+              && ( i + 1 < argc ) )
+        {
+            prefix = argv[++i];
+        }
+        else if( ( strcmp( argv[i], "-c" ) == 0 )
+              && ( i + 1 < argc ) )
+        {
+            capture_path = argv[++i];
+        }
+        else if( strcmp( argv[i], "-q" ) == 0 )
+        {
+            quiet = true;
+        }
+        else if( strcmp( argv[i], "-l" ) == 0 )
+        {
+            print_layout< sensor_wire_t >( "SENSOR_DATA", tlm_schema_t::sensor, tlm_schema_t::sensor_cnt );
+            print_layout< gps_wire_t >( "GPS_DATA", tlm_schema_t::gps, tlm_schema_t::gps_cnt );
+            return EXIT_SUCCESS;
+        }
+        else
+        {
+            in_path = argv[i];
+        }
+    }
+
+    if( ( !in_path )
+     || ( !baud_const( baud ) ) )
+    {
+        fprintf( stderr, "usage: %s [-b baud] [-f csv|bin] [-o prefix] [-c capture.bin] [-q] device|capture\n", argv[0] );
+        fprintf( stderr, "       %s -l\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+
+    int fd = open_input( in_path, baud, live );
+    if( fd < 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    Ground ground( binary, prefix );
+    null_sink_t sink;
+    uint8_t rcv_buffer[ XBEE_FRAME_BUF_SIZE ];
+    Hdlc< XBEE_MAX_FRAME_LENGTH, null_sink_t, Ground > hdlc( sink, ground, rcv_buffer );
+
+    if( !ground.open() )
+    {
+        close( fd );
+        return EXIT_FAILURE;
+    }
+
+    file_sink_t capture_sink = { NULL };
+    BinLog< file_sink_t > capture( capture_sink );
+    if( capture_path )
+    {
+        capture_sink.file = fopen( capture_path, "wb" );
+        if( !capture_sink.file )
+        {
+            perror( capture_path );
+            close( fd );
+            return EXIT_FAILURE;
+        }
+        capture.begin();
+    }
+
+    signal( SIGINT, on_signal );
+    signal( SIGTERM, on_signal );
+
+    ground_clock_t::time_point start = ground_clock_t::now();
+    ground_clock_t::time_point last_report = start;
+    uint8_t buffer[ GROUND_READ_SIZE ];
+
+    while( !stop_requested )
+    {
+        ssize_t n = read( fd, buffer, sizeof(buffer) );
+
+        if( ( n < 0 )
+         && ( errno == EINTR ) )
+        {
+            continue;
+        }
+
+        // End of a capture, or the other end of a pty went away
+        if( ( ( n == 0 ) && ( !live ) )
+         || ( ( n < 0 ) && ( errno == EIO ) ) )
+        {
+            break;
+        }
+
+        if( n < 0 )
+        {
+            perror( in_path );
+            break;
+        }
+
+        ground_clock_t::time_point now = ground_clock_t::now();
+
+        if( capture_sink.file )
+        {
+            uint32_t time_us = std::chrono::duration_cast<std::chrono::microseconds>( now - start ).count();
+            link_capture( capture, time_us, buffer, n );
+        }
+
+        hdlc.receive( buffer, n );
+        ground.bytes += n;
+
+        double since = std::chrono::duration<double>( now - last_report ).count();
+        if( ( live )
+         && ( !quiet )
+         && ( since * 1000 >= GROUND_REPORT_MS ) )
+        {
+            ground.report( stderr, since, hdlc.crc_errors(), hdlc.fec_corrected(), false );
+            last_report = now;
+        }
+    }
+
+    double seconds = std::chrono::duration<double>( ground_clock_t::now() - start ).count();
+
+    ground.report( stdout, seconds, hdlc.crc_errors(), hdlc.fec_corrected(), true );
+    if( !live )
+    {
+        printf( "%.1f MB/s decoded\n", ground.bytes / seconds / 1e6 );
+    }
+
+    if( capture_sink.file )
+    {
+        fclose( capture_sink.file );
+    }
+
+    close( fd );
+    return EXIT_SUCCESS;
+}
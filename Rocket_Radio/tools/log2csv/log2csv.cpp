@@ -0,0 +1,251 @@
+// Turns a binary log written by BinLog back into CSV files, one per
+//  record type, with the same columns the firmware used to write.
+//
+//  platformio run -e log2csv
+//  .pioenvs/log2csv/program [-t] /5_12/log_3.bin
+//
+// log_3.bin becomes snsr_3.csv and gps_3.csv next to it. With -t every
+//  row starts with the record's time_ms and seq. If the log was closed
+//  cleanly the run's timing stats from its header go in diag_3.csv.
+#include "log/bin_log.h"
+#include "util/prof.h"
+#include "../common/log_csv.h"
+#include "../common/log_read.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+typedef struct
+{
+    FILE * out;
+    uint32_t rows;
+} rec_out_t;
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   out_path
+*       CSV path for one record type. dir/log_N.bin gives
+*       dir/<name>_N.csv, anything else dir/<stem>_<name>.csv.
+**********************************************************/
+static std::string out_path( std::string const & in_path, char const * name )
+{
+    size_t slash = in_path.find_last_of( '/' );
+    std::string dir = ( slash == std::string::npos ) ? "" : in_path.substr( 0, slash + 1 );
+    std::string stem = in_path.substr( dir.size() );
+
+    size_t dot = stem.find_last_of( '.' );
+    if( dot != std::string::npos )
+    {
+        stem = stem.substr( 0, dot );
+    }
+
+    if( stem.compare( 0, 4, "log_" ) == 0 )
+    {
+        return dir + name + stem.substr( 3 ) + ".csv";
+    }
+
+    return dir + stem + "_" + name + ".csv";
+}
+
+
+/**********************************************************
+*   write_stats
+*       Write the stats from the end of a version 2 header
+*       as one row per section. Nothing if the log wasn't
+*       closed, the stats are all zeros then.
+**********************************************************/
+static bool write_stats( FILE * in, log_hdr_t const & hdr, char const * in_path )
+{
+    uint8_t stats[ BIN_LOG_STATS_SIZE ];
+    diag_hdr_t diag;
+
+    if( ( hdr.version < 2 )
+     || ( fseek( in, hdr.hdr_size - BIN_LOG_STATS_SIZE, SEEK_SET ) != 0 )
+     || ( fread( stats, sizeof(stats), 1, in ) != 1 ) )
+    {
+        return false;
+    }
+
+    memcpy( &diag, stats, sizeof(diag) );
+    if( ( diag.section_cnt == 0 )
+     || ( sizeof(diag) + diag.section_cnt * sizeof(diag_stat_t) + diag.count_cnt * sizeof(uint16_t) > sizeof(stats) ) )
+    {
+        return false;
+    }
+
+    std::string path = out_path( in_path, "diag" );
+    FILE * out = fopen( path.c_str(), "w" );
+    if( !out )
+    {
+        perror( path.c_str() );
+        return false;
+    }
+
+    fprintf( out, "# uptime_ms %u, loops_per_s %u, overruns %u", diag.uptime_ms, diag.loops_per_s, diag.overruns );
+    for( uint8_t i = 0; i < diag.count_cnt; i++ )
+    {
+        uint16_t count;
+        memcpy( &count, &stats[ sizeof(diag) + diag.section_cnt * sizeof(diag_stat_t) + i * sizeof(count) ], sizeof(count) );
+
+        if( i < PROF_COUNT_CNT )
+        {
+            fprintf( out, ", %s %u", prof_count_names[i], count );
+        }
+        else
+        {
+            fprintf( out, ", count_%u %u", i, count );
+        }
+    }
+    fprintf( out, "\n" );
+    fprintf( out, "section, count, min_us, max_us, mean_us" );
+    for( uint8_t b = 0; b < PROF_HIST_BINS; b++ )
+    {
+        fprintf( out, ", hist_%u", b );
+    }
+    fprintf( out, "\n" );
+
+    for( uint8_t i = 0; i < diag.section_cnt; i++ )
+    {
+        diag_stat_t stat;
+        memcpy( &stat, &stats[ sizeof(diag) + i * sizeof(stat) ], sizeof(stat) );
+
+        if( i < PROF_SECTION_CNT )
+        {
+            fprintf( out, "%s", prof_section_names[i] );
+        }
+        else
+        {
+            fprintf( out, "%u", i );
+        }
+
+        fprintf( out, ", %u, %u, %u, %u", stat.count, stat.min_us, stat.max_us, stat.mean_us );
+        for( uint8_t b = 0; b < PROF_HIST_BINS; b++ )
+        {
+            fprintf( out, ", %u", stat.hist[b] );
+        }
+        fprintf( out, "\n" );
+    }
+
+    fclose( out );
+    return true;
+}
+
+
+/**********************************************************
+*   main
+**********************************************************/
+int main( int argc, char ** argv )
+{
+    bool with_time = false;
+    char const * in_path = NULL;
+    std::vector<log_rec_info_t> recs;
+    std::vector<rec_out_t> outs;
+    log_hdr_t hdr;
+    log_rec_hdr_t rec_hdr;
+    uint8_t data[ 256 ];
+    uint32_t skipped = 0;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        if( strcmp( argv[i], "-t" ) == 0 )
+        {
+            with_time = true;
+        }
+        else
+        {
+            in_path = argv[i];
+        }
+    }
+
+    if( !in_path )
+    {
+        fprintf( stderr, "usage: %s [-t] log_N.bin\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+
+    FILE * in = fopen( in_path, "rb" );
+    if( !in )
+    {
+        perror( in_path );
+        return EXIT_FAILURE;
+    }
+
+    if( !log_read_header( in, hdr, recs ) )
+    {
+        fclose( in );
+        return EXIT_FAILURE;
+    }
+
+    // Open a CSV per record type and write the column names
+    outs.resize( recs.size() );
+    for( size_t i = 0; i < recs.size(); i++ )
+    {
+        log_rec_info_t const & rec = recs[i];
+        char name[ BIN_LOG_REC_NAME_LEN + 1 ] = { 0 };
+        memcpy( name, rec.desc.name, BIN_LOG_REC_NAME_LEN );
+
+        std::string path = out_path( in_path, name );
+        outs[i].out = fopen( path.c_str(), "w" );
+        outs[i].rows = 0;
+        if( !outs[i].out )
+        {
+            perror( path.c_str() );
+            return EXIT_FAILURE;
+        }
+
+        if( with_time )
+        {
+            fprintf( outs[i].out, "time_ms, seq, " );
+        }
+
+        log_csv_header( outs[i].out, rec.fields.data(), rec.fields.size() );
+    }
+
+    while( log_read_record( in, recs, rec_hdr, data, skipped ) )
+    {
+        log_rec_info_t const & rec = recs[rec_hdr.rec_type];
+        rec_out_t & out = outs[rec_hdr.rec_type];
+
+        if( with_time )
+        {
+            fprintf( out.out, "%u, %u, ", rec_hdr.time_ms, rec_hdr.seq );
+        }
+
+        log_csv_row( out.out, rec.fields.data(), rec.fields.size(), data );
+        out.rows++;
+    }
+
+    for( size_t i = 0; i < recs.size(); i++ )
+    {
+        char name[ BIN_LOG_REC_NAME_LEN + 1 ] = { 0 };
+        memcpy( name, recs[i].desc.name, BIN_LOG_REC_NAME_LEN );
+
+        printf( "%s: %u rows\n", name, outs[i].rows );
+        fclose( outs[i].out );
+    }
+
+    if( skipped )
+    {
+        printf( "skipped %u bytes of padding\n", skipped );
+    }
+
+    if( write_stats( in, hdr, in_path ) )
+    {
+        printf( "diag: run stats\n" );
+    }
+
+    fclose( in );
+    return EXIT_SUCCESS;
+}
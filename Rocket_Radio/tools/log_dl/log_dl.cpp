@@ -0,0 +1,418 @@
+// Ground end of the SD log downlink. Lists the logs on the rocket's
+//  card, or brings one down, over the radio, so the card doesn't have
+//  to come out of the rocket. The rocket only answers while it isn't
+//  logging.
+//
+//  platformio run -e log_dl
+//  .pioenvs/log_dl/program [-b baud] /dev/ttyUSB0
+//  .pioenvs/log_dl/program [-b baud] [-w window] [-o out.bin] [-q] /dev/ttyUSB0 month_day/num
+//
+// Without a file every log is printed, as month_day/num and its length.
+//  With one, say 10_18/2 for /10_18/log_2.bin, it's written to out.bin,
+//  log_10_18_2.bin by default, which tools/log2csv reads. What's come so
+//  far is kept in out.bin.part, and running it again picks up from
+//  there, so a transfer cut off by ^C or a dropout doesn't start over.
+//  -w sets the chunks in flight, 1 is stop-and-wait.
+//
+// Progress is printed once a second unless -q, and the throughput at
+//  the end.
+#include "../common/log_dl_client.h"
+#include "../common/serial_port.h"
+#include "log/log_downlink.h"
+#include "xbee/xbee.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define DL_DEFAULT_BAUD 9600
+#define DL_READ_SIZE 1024
+#define DL_REPORT_MS 1000
+
+// Requests sent again with nothing new coming before giving up.
+#define DL_MAX_RETRIES 6
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+typedef std::chrono::steady_clock dl_clock_t;
+
+// Writes encoded frames to the port.
+struct fd_sink_t
+{
+    int fd;
+
+    void write( uint8_t data ) { this->write( &data, 1 ); }
+
+    void write( uint8_t const * data, size_t length )
+    {
+        while( length > 0 )
+        {
+            ssize_t n = ::write( fd, data, length );
+
+            if( n < 0 )
+            {
+                if( errno == EINTR )
+                {
+                    continue;
+                }
+                return;
+            }
+
+            data += n;
+            length -= n;
+        }
+    }
+};
+
+// Hands LOG_DOWNLINK frames from the Hdlc decoder to the client.
+struct dl_handler_t
+{
+    LogDlClient * client;
+
+    void frame_received( uint8_t * data, uint16_t size )
+    {
+        if( ( size > 0 )
+         && ( data[0] == LOG_DOWNLINK ) )
+        {
+            client->frame_received( data + 1, size - 1 );
+        }
+    }
+};
+
+typedef Hdlc< XBEE_MAX_FRAME_LENGTH, fd_sink_t, dl_handler_t > dl_hdlc_t;
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+static volatile sig_atomic_t stop_requested;
+
+static dl_clock_t::time_point start_time = dl_clock_t::now();
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+static uint32_t now_ms()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>( dl_clock_t::now() - start_time ).count();
+}
+
+
+static void on_signal( int )
+{
+    stop_requested = 1;
+}
+
+
+/**********************************************************
+*   run
+*       Read the port into the decoder and tick the client
+*       until done() says to stop, DL_MAX_RETRIES go by
+*       without any more of the file or ^C. False if it
+*       wasn't done().
+**********************************************************/
+template< typename Done >
+static bool run( int fd, dl_hdlc_t & hdlc, LogDlClient & client, Done done )
+{
+    uint8_t buffer[ DL_READ_SIZE ];
+    uint32_t received = client.received();
+    uint32_t retries = client.retries();
+
+    while( ( !stop_requested )
+        && ( client.retries() - retries <= DL_MAX_RETRIES ) )
+    {
+        ssize_t n = read( fd, buffer, sizeof(buffer) );
+
+        if( ( n < 0 )
+         && ( errno != EINTR ) )
+        {
+            perror( "read" );
+            return false;
+        }
+
+        if( n > 0 )
+        {
+            hdlc.receive( buffer, n );
+        }
+
+        client.tick( now_ms() );
+
+        if( client.received() != received )
+        {
+            received = client.received();
+            retries = client.retries();
+        }
+
+        if( done() )
+        {
+            return true;
+        }
+    }
+
+    if( !stop_requested )
+    {
+        fprintf( stderr, "no answer from the rocket\n" );
+    }
+
+    return false;
+}
+
+
+/**********************************************************
+*   parse_file
+*       month_day/num, as 10_18/2.
+**********************************************************/
+static bool parse_file( char const * arg, log_dl_entry_t & file )
+{
+    unsigned month;
+    unsigned day;
+    unsigned num;
+    int end = 0;
+
+    if( ( sscanf( arg, "%u_%u/%u%n", &month, &day, &num, &end ) != 3 )
+     || ( arg[end] != '\0' ) )
+    {
+        return false;
+    }
+
+    memset( &file, 0, sizeof(file) );
+    file.month = month;
+    file.day = day;
+    file.num = num;
+
+    return true;
+}
+
+
+/**********************************************************
+*   main
+**********************************************************/
+int main( int argc, char ** argv )
+{
+    uint32_t baud = DL_DEFAULT_BAUD;
+    uint8_t window = LOG_DL_WINDOW;
+    bool quiet = false;
+    char const * port = NULL;
+    char const * file_arg = NULL;
+    std::string out_path;
+    log_dl_entry_t want;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        if( ( strcmp( argv[i], "-b" ) == 0 )
+         && ( i + 1 < argc ) )
+        {
+            baud = strtoul( argv[++i], NULL, 10 );
+        }
+        else if( ( strcmp( argv[i], "-w" ) == 0 )
+              && ( i + 1 < argc ) )
+        {
+            window = strtoul( argv[++i], NULL, 10 );
+        }
+        else if( ( strcmp( argv[i], "-o" ) == 0 )
+              && ( i + 1 < argc ) )
+        {
+            out_path = argv[++i];
+        }
+        else if( strcmp( argv[i], "-q" ) == 0 )
+        {
+            quiet = true;
+        }
+        else if( !port )
+        {
+            port = argv[i];
+        }
+        else
+        {
+            file_arg = argv[i];
+        }
+    }
+
+    if( ( !port )
+     || ( !baud_const( baud ) )
+     || ( window < 1 )
+     || ( window > LOG_DL_MAX_WINDOW )
+     || ( ( file_arg ) && ( !parse_file( file_arg, want ) ) ) )
+    {
+        fprintf( stderr, "usage: %s [-b baud] device\n", argv[0] );
+        fprintf( stderr, "       %s [-b baud] [-w 1-%u] [-o out.bin] [-q] device month_day/num\n", argv[0], LOG_DL_MAX_WINDOW );
+        return EXIT_FAILURE;
+    }
+
+    // Wake every 0.1s so ACKs and retries go out on time
+    int fd = serial_open( port, baud, 1 );
+    if( fd < 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    signal( SIGINT, on_signal );
+    signal( SIGTERM, on_signal );
+
+    fd_sink_t sink = { fd };
+    dl_handler_t handler = { NULL };
+    uint8_t rcv_buffer[ dl_hdlc_t::max_frame_length ];
+    dl_hdlc_t hdlc( sink, handler, rcv_buffer );
+    LogDlClient client( [&]( uint8_t const * data, uint16_t size )
+    {
+        data_type_t type = LOG_DOWNLINK;
+
+        hdlc.begin_frame();
+        hdlc.append_frame( &type, sizeof(type) );
+        hdlc.append_frame( data, size );
+        hdlc.end_frame();
+    });
+    handler.client = &client;
+
+    // The list, for the file's length if there's one to get
+    std::vector<log_dl_entry_t> files;
+    client.set_list_hndlr( [&]( log_dl_entry_t const & entry ) { files.push_back( entry ); } );
+    client.list( now_ms() );
+
+    if( !run( fd, hdlc, client, [&]{ return client.state() == LOG_DL_IDLE; } ) )
+    {
+        close( fd );
+        return EXIT_FAILURE;
+    }
+
+    if( !file_arg )
+    {
+        for( log_dl_entry_t const & entry : files )
+        {
+            printf( "%u_%u/%u %10u\n", entry.month, entry.day, entry.num, entry.length );
+        }
+
+        close( fd );
+        return EXIT_SUCCESS;
+    }
+
+    for( log_dl_entry_t const & entry : files )
+    {
+        if( ( entry.month == want.month )
+         && ( entry.day == want.day )
+         && ( entry.num == want.num ) )
+        {
+            want.length = entry.length;
+        }
+    }
+
+    if( want.length == 0 )
+    {
+        fprintf( stderr, "%s: no such log\n", file_arg );
+        close( fd );
+        return EXIT_FAILURE;
+    }
+
+    if( out_path.empty() )
+    {
+        out_path = "log_" + std::to_string( want.month ) + "_" + std::to_string( want.day ) + "_" + std::to_string( want.num ) + ".bin";
+    }
+
+    // Pick up from what an earlier run saved, to the chunk
+    std::string part_path = out_path + ".part";
+    FILE * part = fopen( part_path.c_str(), "ab" );
+    struct stat st;
+
+    if( ( !part )
+     || ( fstat( fileno( part ), &st ) != 0 ) )
+    {
+        perror( part_path.c_str() );
+        close( fd );
+        return EXIT_FAILURE;
+    }
+
+    client.set_data_hndlr( [&]( uint8_t const * data, uint16_t size ) { fwrite( data, 1, size, part ); } );
+
+    // Opened to append, so cutting it back is all it takes
+    uint32_t offset = client.get( want, st.st_size, window, now_ms() );
+    if( ftruncate( fileno( part ), offset ) != 0 )
+    {
+        perror( part_path.c_str() );
+        fclose( part );
+        close( fd );
+        return EXIT_FAILURE;
+    }
+
+    if( offset > 0 )
+    {
+        fprintf( stderr, "resuming at %u of %u\n", offset, want.length );
+    }
+
+    uint32_t start = now_ms();
+    uint32_t last_report = start;
+
+    bool done = run( fd, hdlc, client, [&]
+    {
+        uint32_t now = now_ms();
+
+        if( ( !quiet )
+         && ( now - last_report >= DL_REPORT_MS ) )
+        {
+            fprintf( stderr, "%10u / %u  %6.0f B/s\n",
+                     client.received(),
+                     want.length,
+                     ( client.received() - offset ) * 1000.0 / ( now - start ) );
+            last_report = now;
+        }
+
+        return client.state() != LOG_DL_GETTING;
+    });
+
+    double seconds = ( now_ms() - start ) / 1000.0;
+
+    if( !done )
+    {
+        client.abort();
+    }
+    fclose( part );
+    close( fd );
+
+    printf( "%u of %u bytes in %.1f s, %.0f B/s, %u duplicate chunks, %u retries\n",
+            client.received() - offset,
+            want.length,
+            seconds,
+            ( client.received() - offset ) / seconds,
+            client.duplicates(),
+            client.retries() );
+
+    if( client.state() == LOG_DL_FAILED )
+    {
+        fprintf( stderr, "%s: rocket couldn't send it, status %u\n", file_arg, client.status() );
+        return EXIT_FAILURE;
+    }
+
+    if( client.state() != LOG_DL_DONE_OK )
+    {
+        fprintf( stderr, "%s kept, run again to resume\n", part_path.c_str() );
+        return EXIT_FAILURE;
+    }
+
+    if( rename( part_path.c_str(), out_path.c_str() ) != 0 )
+    {
+        perror( out_path.c_str() );
+        return EXIT_FAILURE;
+    }
+
+    printf( "%s\n", out_path.c_str() );
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,386 @@
+// Plays a recorded radio link back through the firmware's receive path,
+//  to see what a flight's link conditions did to it or to check a change
+//  to the framing code against a known capture.
+//
+//  platformio run -e replay
+//  .pioenvs/replay/program [-r] [-e frames] capture.bin
+//
+// Takes the link records from an SD log or a ground -c capture, or a
+//  raw byte dump of the UART. The bytes go through Hdlc::byte_receive
+//  and then through Xbee::read and its dispatch, as fast as they'll go,
+//  or with -r through Xbee only at the pace they were recorded. Reports
+//  throughput, the frames recovered and the frames known lost. With -e
+//  exits non zero if Xbee recovers fewer than that many frames.
+#include "log/bin_log.h"
+#include "log/link_capture.h"
+#include "telemetry/sensor_batch.h"
+#include "telemetry/tlm_codec.h"
+#include "xbee/xbee.h"
+#include "../common/log_read.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+// Raw dumps have no timing, they're cut into pieces this big.
+#define REPLAY_RAW_CHUNK LINK_CHUNK_SIZE
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+typedef std::chrono::steady_clock replay_clock_t;
+
+// The receive path never sends.
+struct null_sink_t
+{
+    void write( uint8_t ) {}
+    void write( uint8_t const *, size_t ) {}
+};
+
+// What came out of one run.
+struct replay_result_t
+{
+    uint64_t bytes;
+    double seconds;
+    uint32_t frames[XBEE_HANDLER_CNT];
+    uint32_t other_frames;          // Types with no handler slot
+    uint32_t crc_errors;
+    uint32_t fec_corrected;         // Frames that needed FEC to get through
+    uint32_t dropped;               // Good frames Xbee had no room for
+    uint32_t samples;               // Out of SENSOR_CODED frames
+    uint32_t samples_lost;          // Gaps in their sample index
+};
+
+// Hdlc handler that counts frames by type.
+struct frame_counter_t
+{
+    replay_result_t * result;
+
+    void frame_received( uint8_t * data, uint16_t size )
+    {
+        if( ( size > 0 )
+         && ( data[0] < XBEE_HANDLER_CNT ) )
+        {
+            result->frames[data[0]]++;
+        }
+        else
+        {
+            result->other_frames++;
+        }
+    }
+};
+
+
+/******************************************************************************
+ *                               Global Vars
+ *****************************************************************************/
+
+static char const * const type_names[] =
+{
+    "SENSOR_DATA",
+    "GPS_DATA",
+    "DATA_LOG",
+    "SENSOR_BATCH",
+    "SENSOR_CODED",
+    "SENSOR_TAGGED",
+    "DIAGNOSTICS",
+    "LOG_DOWNLINK",
+};
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   load
+*       Read the link records out of a binary log, or a
+*       raw dump cut into pieces with no timing. timed is
+*       set if the chunks have real times.
+**********************************************************/
+static bool load( char const * path, std::vector<link_chunk_t> &chunks, bool &timed )
+{
+    FILE * in = fopen( path, "rb" );
+    uint32_t magic = 0;
+
+    if( !in )
+    {
+        perror( path );
+        return false;
+    }
+
+    if( ( fread( &magic, sizeof(magic), 1, in ) == 1 )
+     && ( magic == BIN_LOG_MAGIC ) )
+    {
+        std::vector<log_rec_info_t> recs;
+        log_hdr_t hdr;
+        log_rec_hdr_t rec_hdr;
+        uint8_t data[ 256 ];
+        uint32_t skipped = 0;
+        int link = -1;
+
+        rewind( in );
+        if( !log_read_header( in, hdr, recs ) )
+        {
+            fclose( in );
+            return false;
+        }
+
+        // By name, the type number could change
+        for( size_t i = 0; i < recs.size(); i++ )
+        {
+            if( ( strncmp( recs[i].desc.name, "link", BIN_LOG_REC_NAME_LEN ) == 0 )
+             && ( recs[i].desc.size == sizeof(link_chunk_t) ) )
+            {
+                link = i;
+            }
+        }
+
+        while( log_read_record( in, recs, rec_hdr, data, skipped ) )
+        {
+            if( rec_hdr.rec_type == link )
+            {
+                link_chunk_t chunk;
+                memcpy( &chunk, data, sizeof(chunk) );
+                chunk.length = ( chunk.length < LINK_CHUNK_SIZE ) ? chunk.length : LINK_CHUNK_SIZE;
+                chunks.push_back( chunk );
+            }
+        }
+
+        timed = true;
+    }
+    else
+    {
+        link_chunk_t chunk;
+        size_t n;
+
+        rewind( in );
+        chunk.time_us = 0;
+        while( ( n = fread( chunk.data, 1, REPLAY_RAW_CHUNK, in ) ) > 0 )
+        {
+            chunk.length = n;
+            chunks.push_back( chunk );
+        }
+
+        timed = false;
+    }
+
+    fclose( in );
+    return true;
+}
+
+
+/**********************************************************
+*   run_hdlc
+*       Every byte through Hdlc::byte_receive, as fast as
+*       it goes.
+**********************************************************/
+static replay_result_t run_hdlc( std::vector<link_chunk_t> const & chunks )
+{
+    replay_result_t result;
+    frame_counter_t counter;
+    null_sink_t sink;
+    uint8_t rcv_buffer[ XBEE_FRAME_BUF_SIZE ];
+    Hdlc< XBEE_MAX_FRAME_LENGTH, null_sink_t, frame_counter_t > hdlc( sink, counter, rcv_buffer );
+
+    memset( &result, 0, sizeof(result) );
+    counter.result = &result;
+
+    replay_clock_t::time_point start = replay_clock_t::now();
+    for( size_t c = 0; c < chunks.size(); c++ )
+    {
+        for( uint8_t i = 0; i < chunks[c].length; i++ )
+        {
+            hdlc.byte_receive( chunks[c].data[i] );
+        }
+        result.bytes += chunks[c].length;
+    }
+    result.seconds = std::chrono::duration<double>( replay_clock_t::now() - start ).count();
+    result.crc_errors = hdlc.crc_errors();
+    result.fec_corrected = hdlc.fec_corrected();
+
+    return result;
+}
+
+
+/**********************************************************
+*   run_xbee
+*       Every chunk into Serial1 and out through
+*       Xbee::read and its handlers, as fast as it goes or
+*       at the recorded times.
+**********************************************************/
+static replay_result_t run_xbee( std::vector<link_chunk_t> const & chunks, bool real_time )
+{
+    replay_result_t result;
+    Xbee xbee( &Serial1 );
+    TlmDecoder decoder;
+
+    memset( &result, 0, sizeof(result) );
+    xbee.setup( 9600 );
+
+    for( data_type_t t = 0; t < XBEE_HANDLER_CNT; t++ )
+    {
+        xbee.set_frame_hndlr( t, [&result, t]( uint8_t const *, uint16_t )
+        {
+            result.frames[t]++;
+        });
+    }
+
+    xbee.set_frame_hndlr( SENSOR_CODED, [&]( uint8_t const * data, uint16_t size )
+    {
+        sensor_sample_t samples[ SENSOR_BATCH_RING_SIZE ];
+
+        result.frames[SENSOR_CODED]++;
+        result.samples += decoder.decode_frame( data, size, samples, SENSOR_BATCH_RING_SIZE );
+    });
+
+    replay_clock_t::time_point start = replay_clock_t::now();
+    uint32_t first_us = chunks.empty() ? 0 : chunks[0].time_us;
+
+    for( size_t c = 0; c < chunks.size(); c++ )
+    {
+        if( real_time )
+        {
+            std::this_thread::sleep_until( start + std::chrono::microseconds( chunks[c].time_us - first_us ) );
+        }
+
+        Serial1.inject( chunks[c].data, chunks[c].length );
+        while( Serial1.available() > 0 )
+        {
+            xbee.read();
+        }
+        result.bytes += chunks[c].length;
+    }
+
+    result.seconds = std::chrono::duration<double>( replay_clock_t::now() - start ).count();
+    result.crc_errors = xbee.crc_errors();
+    result.fec_corrected = xbee.fec_corrected();
+    result.dropped = xbee.dropped_frames();
+    result.samples_lost = decoder.skipped();
+
+    return result;
+}
+
+
+/**********************************************************
+*   report
+*       Print one run's results. Returns the frames it
+*       recovered.
+**********************************************************/
+static uint32_t report( char const * name, replay_result_t const & r )
+{
+    uint32_t frames = r.other_frames;
+
+    for( uint8_t t = 0; t < XBEE_HANDLER_CNT; t++ )
+    {
+        frames += r.frames[t];
+    }
+
+    printf( "%-20s %10llu bytes %8.3f s %8.2f MB/s\n", name, (unsigned long long)r.bytes, r.seconds, r.bytes / r.seconds / 1e6 );
+    printf( "%-20s %10u frames recovered,", "", frames );
+
+    for( uint8_t t = 0; t < XBEE_HANDLER_CNT; t++ )
+    {
+        if( r.frames[t] == 0 )
+        {
+            continue;
+        }
+
+        if( t < sizeof(type_names) / sizeof(type_names[0]) )
+        {
+            printf( " %s %u", type_names[t], r.frames[t] );
+        }
+        else
+        {
+            printf( " type %u %u", t, r.frames[t] );
+        }
+    }
+    printf( "\n" );
+
+    printf( "%-20s %10u frames lost, %u bad crc, %u dropped", "", r.crc_errors + r.dropped, r.crc_errors, r.dropped );
+    if( r.fec_corrected )
+    {
+        printf( ", %u fixed by FEC", r.fec_corrected );
+    }
+    if( r.samples )
+    {
+        printf( ", %u coded samples, %u missing", r.samples, r.samples_lost );
+    }
+    printf( "\n" );
+
+    return frames;
+}
+
+
+/**********************************************************
+*   main
+**********************************************************/
+int main( int argc, char ** argv )
+{
+    bool real_time = false;
+    bool timed = false;
+    long expected = -1;
+    char const * in_path = NULL;
+    std::vector<link_chunk_t> chunks;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        if( strcmp( argv[i], "-r" ) == 0 )
+        {
+            real_time = true;
+        }
+        else if( ( strcmp( argv[i], "-e" ) == 0 )
+              && ( i + 1 < argc ) )
+        {
+            expected = strtol( argv[++i], NULL, 10 );
+        }
+        else
+        {
+            in_path = argv[i];
+        }
+    }
+
+    if( !in_path )
+    {
+        fprintf( stderr, "usage: %s [-r] [-e frames] capture.bin\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+
+    if( !load( in_path, chunks, timed ) )
+    {
+        return EXIT_FAILURE;
+    }
+
+    if( real_time && !timed )
+    {
+        fprintf( stderr, "raw dump has no timing, replaying as fast as possible\n" );
+        real_time = false;
+    }
+
+    if( !real_time )
+    {
+        report( "hdlc byte_receive", run_hdlc( chunks ) );
+    }
+
+    uint32_t frames = report( real_time ? "xbee recorded pace" : "xbee read", run_xbee( chunks, real_time ) );
+
+    if( ( expected >= 0 )
+     && ( frames < (uint32_t)expected ) )
+    {
+        fprintf( stderr, "recovered %u frames, expected %ld\n", frames, expected );
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,284 @@
+// Runs recorded sensor CSVs through the telemetry codec and reports how
+//  well it compresses them, and the worst error rounding added to each
+//  column. Exits non zero if a sample doesn't survive the round trip.
+//
+//  platformio run -e tlm_stats
+//  .pioenvs/tlm_stats/program /5_12/snsr_3.csv [more.csv ...]
+//
+// Takes the snsr CSVs tools/log2csv writes, with or without -t, or the
+//  ones the firmware wrote before the binary log.
+#include "log/bin_log.h"
+#include "telemetry/tlm_codec.h"
+#include "telemetry/tlm_schema.h"
+#include "xbee/xbee.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define TLM_STATS_BAUD 9600
+
+// Flag, type byte, crc and flag around every frame. Escapes aren't
+//  counted.
+#define TLM_STATS_FRAME_OVERHEAD 5
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   trim
+*       Strip spaces and line endings from both ends.
+**********************************************************/
+static std::string trim( std::string const & s )
+{
+    size_t start = s.find_first_not_of( " \t\r\n" );
+    size_t end = s.find_last_not_of( " \t\r\n" );
+
+    return ( start == std::string::npos ) ? "" : s.substr( start, end - start + 1 );
+}
+
+
+static std::vector<std::string> split( char const * line )
+{
+    std::vector<std::string> cols;
+    std::string col;
+
+    for( char const * p = line; *p; p++ )
+    {
+        if( *p == ',' )
+        {
+            cols.push_back( trim( col ) );
+            col.clear();
+        }
+        else
+        {
+            col += *p;
+        }
+    }
+    cols.push_back( trim( col ) );
+
+    return cols;
+}
+
+
+/**********************************************************
+*   read_csv
+*       Read the samples in a sensor CSV. Columns are
+*       matched to data_pkg_t by the names in the binary
+*       log layout.
+**********************************************************/
+static bool read_csv( char const * path, std::vector<data_pkg_t> & samples )
+{
+    log_layout_t const & layout = bin_log_layouts[ LOG_REC_SENSOR ];
+    std::vector<int> col_field;
+    char line[ 1024 ];
+
+    FILE * in = fopen( path, "r" );
+    if( !in )
+    {
+        perror( path );
+        return false;
+    }
+
+    if( !fgets( line, sizeof(line), in ) )
+    {
+        fclose( in );
+        return false;
+    }
+
+    for( std::string const & name : split( line ) )
+    {
+        int field = -1;
+
+        for( uint8_t f = 0; f < layout.desc.field_cnt; f++ )
+        {
+            if( strncmp( name.c_str(), layout.fields[f].name, BIN_LOG_FIELD_NAME_LEN ) == 0 )
+            {
+                field = f;
+            }
+        }
+
+        col_field.push_back( field );
+    }
+
+    while( fgets( line, sizeof(line), in ) )
+    {
+        std::vector<std::string> cols = split( line );
+        data_pkg_t sample;
+        uint8_t * p = (uint8_t *)&sample;
+
+        if( cols.size() < col_field.size() )
+        {
+            continue;
+        }
+
+        memset( &sample, 0, sizeof(sample) );
+
+        for( size_t c = 0; c < col_field.size(); c++ )
+        {
+            if( col_field[c] < 0 )
+            {
+                continue;
+            }
+
+            log_field_t const & field = layout.fields[ col_field[c] ];
+
+            if( field.type == LOG_FIELD_FLOAT )
+            {
+                float v = strtof( cols[c].c_str(), NULL );
+                memcpy( &p[ field.offset ], &v, sizeof(v) );
+            }
+            else
+            {
+                uint16_t v = (uint16_t)strtoul( cols[c].c_str(), NULL, 10 );
+                memcpy( &p[ field.offset ], &v, sizeof(v) );
+            }
+        }
+
+        samples.push_back( sample );
+    }
+
+    fclose( in );
+    return true;
+}
+
+
+/**********************************************************
+*   main
+**********************************************************/
+int main( int argc, char ** argv )
+{
+    log_layout_t const & layout = bin_log_layouts[ LOG_REC_SENSOR ];
+    std::vector<data_pkg_t> samples;
+    std::vector<double> max_err( layout.desc.field_cnt, 0.0 );
+    uint8_t frame[ MAX_DATA_LENGTH ];
+    sensor_sample_t decoded[ UINT8_MAX ];
+    TlmEncoder encoder;
+    TlmDecoder decoder;
+    uint64_t coded_bytes = 0;
+    uint32_t frames = 0;
+    uint32_t out = 0;
+    bool ok = true;
+
+    if( argc < 2 )
+    {
+        fprintf( stderr, "usage: %s snsr_N.csv [...]\n", argv[0] );
+        return EXIT_FAILURE;
+    }
+
+    for( int i = 1; i < argc; i++ )
+    {
+        if( !read_csv( argv[i], samples ) )
+        {
+            return EXIT_FAILURE;
+        }
+    }
+
+    if( samples.empty() )
+    {
+        fprintf( stderr, "no samples\n" );
+        return EXIT_FAILURE;
+    }
+
+    // Pack into the biggest frames the radio takes, like SensorBatch
+    //  does when the link is busy
+    size_t next = 0;
+    while( next < samples.size() )
+    {
+        encoder.begin_frame( frame, sizeof(frame) - sizeof(data_type_t), (uint16_t)next );
+        while( ( next < samples.size() )
+            && ( encoder.add( samples[next] ) ) )
+        {
+            next++;
+        }
+
+        uint8_t size = encoder.end_frame();
+        uint8_t count = decoder.decode_frame( frame, size, decoded, UINT8_MAX );
+
+        for( uint8_t s = 0; s < count; s++ )
+        {
+            uint8_t const * a = (uint8_t const *)&samples[ out ];
+            uint8_t const * b = (uint8_t const *)&decoded[s].data;
+
+            if( decoded[s].index != (uint16_t)out )
+            {
+                ok = false;
+            }
+
+            for( uint8_t f = 0; f < layout.desc.field_cnt; f++ )
+            {
+                log_field_t const & field = layout.fields[f];
+                double err;
+
+                if( field.type == LOG_FIELD_FLOAT )
+                {
+                    float va, vb;
+                    memcpy( &va, &a[ field.offset ], sizeof(va) );
+                    memcpy( &vb, &b[ field.offset ], sizeof(vb) );
+                    err = fabs( (double)va - vb );
+                }
+                else
+                {
+                    uint16_t va, vb;
+                    memcpy( &va, &a[ field.offset ], sizeof(va) );
+                    memcpy( &vb, &b[ field.offset ], sizeof(vb) );
+                    err = fabs( (double)va - vb );
+
+                    // ADC channels are sent exactly
+                    ok &= ( err == 0.0 );
+                }
+
+                if( err > max_err[f] )
+                {
+                    max_err[f] = err;
+                }
+            }
+
+            out++;
+        }
+
+        coded_bytes += size + TLM_STATS_FRAME_OVERHEAD;
+        frames++;
+    }
+
+    // What the same samples cost as SENSOR_BATCH and SENSOR_DATA frames
+    uint32_t per_raw_frame = ( MAX_DATA_LENGTH - 2 ) / SENSOR_SAMPLE_WIRE_SIZE;
+    uint32_t raw_frames = ( samples.size() + per_raw_frame - 1 ) / per_raw_frame;
+    uint64_t raw_bytes = samples.size() * SENSOR_SAMPLE_WIRE_SIZE + raw_frames * ( 1 + TLM_STATS_FRAME_OVERHEAD );
+    uint64_t single_bytes = samples.size() * ( SENSOR_DATA_WIRE_SIZE + TLM_STATS_FRAME_OVERHEAD );
+    double link = TLM_STATS_BAUD / 10.0;
+
+    printf( "%zu samples, %u coded frames\n", samples.size(), frames );
+    printf( "%-14s %10s %12s %12s %8s\n", "", "bytes", "bytes/sample", "samples/s", "ratio" );
+    printf( "%-14s %10llu %12.1f %12.1f %8.2f\n", "SENSOR_DATA", (unsigned long long)single_bytes,
+            (double)single_bytes / samples.size(), link * samples.size() / single_bytes, 1.0 );
+    printf( "%-14s %10llu %12.1f %12.1f %8.2f\n", "SENSOR_BATCH", (unsigned long long)raw_bytes,
+            (double)raw_bytes / samples.size(), link * samples.size() / raw_bytes, (double)single_bytes / raw_bytes );
+    printf( "%-14s %10llu %12.1f %12.1f %8.2f\n", "SENSOR_CODED", (unsigned long long)coded_bytes,
+            (double)coded_bytes / samples.size(), link * samples.size() / coded_bytes, (double)single_bytes / coded_bytes );
+
+    printf( "\nworst error per column\n" );
+    for( uint8_t f = 0; f < layout.desc.field_cnt; f++ )
+    {
+        printf( "  %-20.20s %g\n", layout.fields[f].name, max_err[f] );
+    }
+
+    if( ( out != samples.size() )
+     || ( !ok ) )
+    {
+        fprintf( stderr, "round trip failed, %u of %zu samples back\n", out, samples.size() );
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,545 @@
+// Stands in for an XBee in escaped API mode (AP=2) on a pty, for trying
+//  Xbee's API transport without a radio.
+//
+//  platformio run -e xbee_emu
+//  .pioenvs/xbee_emu/program [-l loss%] [-r rssi] [-i rf_in] [-o rf_out]
+//  .pioenvs/xbee_emu/program -t [-l loss%] [-n frames]
+//
+// Prints the pty to open. Every 0x10 transmit request gets a 0x8B TX
+//  status, and a failed delivery for loss% of them at random. Delivered
+//  RF data goes to rf_out, which is what a transparent mode radio on
+//  the ground would put out, so tools/ground can read it. The bytes of
+//  rf_in come in as 0x90 receive packets. ATDB is answered with rssi
+//  give or take a few dB, any other AT command with OK.
+//
+// -t runs the firmware's Xbee in API mode against the emulator over the
+//  pty. Delivered packets are echoed back as receive packets. Sends n
+//  data_pkg_t sized frames, then checks every delivered one came back
+//  and every request got a TX status.
+#include "sensor_data.h"
+#include "telemetry/tlm_schema.h"
+#include "xbee/xbee.h"
+#include "xbee/xbee_api.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+
+/******************************************************************************
+ *                                 Defines
+ *****************************************************************************/
+
+#define EMU_DEFAULT_RSSI 60
+#define EMU_DEFAULT_FRAMES 1000
+
+// Gap between receive packets from rf_in, about what 256 byte packets
+//  at the 900HP's 10k RF rate need.
+#define EMU_RX_PACKET_MS 25
+
+// Retries the radio reports for a failed delivery, RR default plus one.
+#define EMU_FAIL_RETRIES 3
+
+// Delivery status for no MAC ACK.
+#define EMU_STATUS_NO_ACK 0x01
+
+// Self test gives up after this long with nothing moving.
+#define EMU_TEST_IDLE_MS 3000
+
+#define EMU_IO_SIZE 4096
+
+
+/******************************************************************************
+ *                               Global Types
+ *****************************************************************************/
+
+typedef std::chrono::steady_clock emu_clock_t;
+
+/**********************************************************
+*   XbeeEmu
+*       The radio end of the pty. Parses API frames from
+*       the host and queues the replies.
+**********************************************************/
+class XbeeEmu
+{
+public:
+    XbeeEmu( int fd, uint8_t loss_pct, uint8_t rssi );
+
+    void poll();
+    void send_rx_packet( uint8_t const * data, uint16_t length );
+    void api_frame_received( uint8_t const * data, uint16_t size );
+
+    FILE * rf_out;
+    bool loopback;
+
+    uint32_t requests;
+    uint32_t delivered;
+    uint32_t failed;
+
+private:
+    void send_frame( uint8_t const * frame, uint16_t length );
+
+    int m_fd;
+    uint8_t m_loss_pct;
+    uint8_t m_rssi;
+    XbeeApi< XBEE_API_TX_HDR_SIZE + XBEE_MTU, XbeeEmu > m_api;
+    std::vector<uint8_t> m_out;
+};
+
+
+/******************************************************************************
+ *                          Method Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   XbeeEmu
+*       Constructor
+**********************************************************/
+XbeeEmu::XbeeEmu( int fd, uint8_t loss_pct, uint8_t rssi ) :
+    rf_out( NULL ),
+    loopback( false ),
+    requests( 0 ),
+    delivered( 0 ),
+    failed( 0 ),
+    m_fd( fd ),
+    m_loss_pct( loss_pct ),
+    m_rssi( rssi ),
+    m_api( *this )
+{
+}
+
+
+/**********************************************************
+*   poll
+*       Take what the host wrote and write out what's
+*       queued for it, without blocking.
+**********************************************************/
+void XbeeEmu::poll()
+{
+    uint8_t buffer[ EMU_IO_SIZE ];
+    ssize_t count = ::read( m_fd, buffer, sizeof(buffer) );
+
+    if( count > 0 )
+    {
+        m_api.receive( buffer, count );
+    }
+
+    if( !m_out.empty() )
+    {
+        count = ::write( m_fd, m_out.data(), m_out.size() );
+        if( count > 0 )
+        {
+            m_out.erase( m_out.begin(), m_out.begin() + count );
+        }
+    }
+}
+
+
+/**********************************************************
+*   send_rx_packet
+*       Queue a 0x90 receive packet carrying data.
+**********************************************************/
+void XbeeEmu::send_rx_packet( uint8_t const * data, uint16_t length )
+{
+    uint8_t frame[ XBEE_API_RX_HDR_SIZE + XBEE_MTU ] = { XBEE_API_RX_PACKET };
+
+    length = ( length < XBEE_MTU ) ? length : XBEE_MTU;
+
+    frame[ 9 ] = 0x01;      // Source 0x0000000000000001
+    frame[ 10 ] = 0xFF;     // 16 bit address unknown
+    frame[ 11 ] = 0xFE;
+    memcpy( &frame[ XBEE_API_RX_HDR_SIZE ], data, length );
+
+    this->send_frame( frame, XBEE_API_RX_HDR_SIZE + length );
+}
+
+
+/**********************************************************
+*   api_frame_received
+*       Answer a frame from the host like the radio would.
+**********************************************************/
+void XbeeEmu::api_frame_received( uint8_t const * data, uint16_t size )
+{
+    switch( data[0] )
+    {
+        case XBEE_API_TX_REQUEST:
+        {
+            uint8_t status[ XBEE_API_TX_STATUS_SIZE ] = { XBEE_API_TX_STATUS };
+            bool lost = ( rand() % 100 ) < m_loss_pct;
+
+            if( size < XBEE_API_TX_HDR_SIZE )
+            {
+                break;
+            }
+
+            requests++;
+            status[ XBEE_API_TX_STATUS_ID ] = data[1];
+            status[ 2 ] = 0xFF;
+            status[ 3 ] = 0xFE;
+            status[ XBEE_API_TX_STATUS_RETRIES ] = lost ? EMU_FAIL_RETRIES : 0;
+            status[ XBEE_API_TX_STATUS_DELIVERY ] = lost ? EMU_STATUS_NO_ACK : 0;
+
+            if( lost )
+            {
+                failed++;
+            }
+            else
+            {
+                delivered++;
+
+                if( rf_out )
+                {
+                    fwrite( &data[ XBEE_API_TX_HDR_SIZE ], 1, size - XBEE_API_TX_HDR_SIZE, rf_out );
+                    fflush( rf_out );
+                }
+
+                if( loopback )
+                {
+                    this->send_rx_packet( &data[ XBEE_API_TX_HDR_SIZE ], size - XBEE_API_TX_HDR_SIZE );
+                }
+            }
+
+            // Frame id 0 asks for no status
+            if( data[1] != 0 )
+            {
+                this->send_frame( status, sizeof(status) );
+            }
+            break;
+        }
+
+        case XBEE_API_AT_COMMAND:
+        {
+            uint8_t response[ XBEE_API_AT_RESPONSE_VALUE + 1 ] = { XBEE_API_AT_RESPONSE };
+            uint16_t length = XBEE_API_AT_RESPONSE_VALUE;
+
+            if( size < 4 )
+            {
+                break;
+            }
+
+            response[ XBEE_API_AT_RESPONSE_ID ] = data[1];
+            response[ XBEE_API_AT_RESPONSE_CMD ] = data[2];
+            response[ XBEE_API_AT_RESPONSE_CMD + 1 ] = data[3];
+            response[ XBEE_API_AT_RESPONSE_STATUS ] = 0;
+
+            if( ( data[2] == 'D' )
+             && ( data[3] == 'B' ) )
+            {
+                response[ XBEE_API_AT_RESPONSE_VALUE ] = m_rssi - 3 + rand() % 7;
+                length++;
+            }
+
+            if( data[1] != 0 )
+            {
+                this->send_frame( response, length );
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+
+/**********************************************************
+*   send_frame
+*       Queue an API frame for the host.
+**********************************************************/
+void XbeeEmu::send_frame( uint8_t const * frame, uint16_t length )
+{
+    uint8_t out[ XBEE_API_ENCODED_LENGTH( XBEE_API_RX_HDR_SIZE + XBEE_MTU ) ];
+    uint8_t * end;
+    uint8_t sum;
+
+    end = decltype( m_api )::encode_begin( length, out, sum );
+    end = decltype( m_api )::encode_append( frame, length, end, sum );
+    end = decltype( m_api )::encode_end( end, sum );
+
+    m_out.insert( m_out.end(), out, end );
+}
+
+
+/******************************************************************************
+ *                          Function Definitions
+ *****************************************************************************/
+
+/**********************************************************
+*   open_pty
+*       Open a raw pty. Returns the master's fd, or -1.
+*       The slave's path goes in slave.
+**********************************************************/
+static int open_pty( char const * & slave )
+{
+    struct termios tio;
+    int fd = posix_openpt( O_RDWR | O_NOCTTY );
+
+    if( ( fd < 0 )
+     || ( grantpt( fd ) != 0 )
+     || ( unlockpt( fd ) != 0 )
+     || ( ( slave = ptsname( fd ) ) == NULL ) )
+    {
+        perror( "pty" );
+        return -1;
+    }
+
+    // Raw on both ends, no echo or line editing
+    if( tcgetattr( fd, &tio ) == 0 )
+    {
+        cfmakeraw( &tio );
+        tcsetattr( fd, TCSANOW, &tio );
+    }
+
+    fcntl( fd, F_SETFL, O_NONBLOCK );
+
+    return fd;
+}
+
+
+/**********************************************************
+*   run_emu
+*       Be the radio until killed. Sends rf_in, if given,
+*       a packet at a time.
+**********************************************************/
+static int run_emu( XbeeEmu & emu, FILE * rf_in )
+{
+    emu_clock_t::time_point next_rx = emu_clock_t::now();
+
+    while( true )
+    {
+        emu.poll();
+
+        if( ( rf_in )
+         && ( emu_clock_t::now() >= next_rx ) )
+        {
+            uint8_t packet[ XBEE_MTU ];
+            size_t count = fread( packet, 1, sizeof(packet), rf_in );
+
+            if( count > 0 )
+            {
+                emu.send_rx_packet( packet, count );
+            }
+            else
+            {
+                fclose( rf_in );
+                rf_in = NULL;
+            }
+
+            next_rx += std::chrono::milliseconds( EMU_RX_PACKET_MS );
+        }
+
+        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/**********************************************************
+*   run_test
+*       Xbee in API mode on the slave end, the emulator on
+*       the master, Serial1 moved to and from the pty by
+*       hand.
+**********************************************************/
+static int run_test( XbeeEmu & emu, char const * slave, uint32_t frames )
+{
+    int fd = ::open( slave, O_RDWR | O_NOCTTY | O_NONBLOCK );
+    struct termios tio;
+    Xbee xbee( &Serial1, XBEE_API );
+    uint8_t data[ SENSOR_DATA_WIRE_SIZE ];
+    uint32_t sent = 0;
+    uint32_t echoed = 0;
+    bool in_order = true;
+    std::vector<uint8_t> to_pty;
+    emu_clock_t::time_point last_moved = emu_clock_t::now();
+
+    if( fd < 0 )
+    {
+        perror( slave );
+        return EXIT_FAILURE;
+    }
+
+    if( tcgetattr( fd, &tio ) == 0 )
+    {
+        cfmakeraw( &tio );
+        tcsetattr( fd, TCSANOW, &tio );
+    }
+
+    emu.loopback = true;
+    xbee.setup( 9600 );
+    xbee.set_dest_addr( 0x0013A20012345678ULL );
+    xbee.set_frame_hndlr( SENSOR_DATA, [&]( uint8_t const * buffer, uint16_t size )
+    {
+        // Lost packets make gaps, but what's left stays in order
+        uint32_t index;
+        memcpy( &index, buffer, sizeof(index) );
+        in_order &= ( size == sizeof(data) ) && ( index >= echoed );
+        echoed++;
+    });
+
+    memset( data, 0, sizeof(data) );
+
+    while( std::chrono::duration_cast<std::chrono::milliseconds>( emu_clock_t::now() - last_moved ).count() < EMU_TEST_IDLE_MS )
+    {
+        uint8_t buffer[ EMU_IO_SIZE ];
+        bool moved = false;
+        ssize_t count;
+
+        if( sent < frames )
+        {
+            memcpy( data, &sent, sizeof(sent) );
+            if( xbee.send_data( SENSOR_DATA, data, sizeof(data) ) )
+            {
+                sent++;
+                moved = true;
+            }
+        }
+
+        // Serial1 to the pty
+        size_t taken = Serial1.take_tx( buffer, sizeof(buffer) );
+        to_pty.insert( to_pty.end(), buffer, buffer + taken );
+        if( !to_pty.empty() )
+        {
+            count = ::write( fd, to_pty.data(), to_pty.size() );
+            if( count > 0 )
+            {
+                to_pty.erase( to_pty.begin(), to_pty.begin() + count );
+                moved = true;
+            }
+        }
+
+        emu.poll();
+
+        // And back
+        count = ::read( fd, buffer, sizeof(buffer) );
+        if( count > 0 )
+        {
+            Serial1.inject( buffer, count );
+            moved = true;
+        }
+        xbee.read();
+
+        if( moved )
+        {
+            last_moved = emu_clock_t::now();
+        }
+        else if( ( sent == frames )
+              && ( xbee.tx_idle() ) )
+        {
+            break;
+        }
+        else
+        {
+            std::this_thread::sleep_for( std::chrono::microseconds( 200 ) );
+        }
+    }
+
+    close( fd );
+
+    printf( "%u frames sent, %u requests, %u delivered, %u failed, window %u\n",
+            sent, emu.requests, xbee.tx_delivered(), xbee.tx_failed(), xbee.tx_window() );
+    printf( "%u echoed back, %u retries, rssi -%u dBm, %u bad checksum or crc\n",
+            echoed, xbee.tx_retries(), xbee.rssi(), xbee.crc_errors() );
+
+    if( ( sent != frames )
+     || ( emu.requests != xbee.tx_delivered() + xbee.tx_failed() )
+     || ( emu.delivered != xbee.tx_delivered() )
+     || ( echoed != emu.delivered )
+     || ( !in_order )
+     || ( xbee.rssi() == 0 ) )
+    {
+        fprintf( stderr, "FAILED\n" );
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+
+/**********************************************************
+*   main
+**********************************************************/
+int main( int argc, char ** argv )
+{
+    bool test = false;
+    uint8_t loss_pct = 0;
+    uint8_t rssi = EMU_DEFAULT_RSSI;
+    uint32_t frames = EMU_DEFAULT_FRAMES;
+    FILE * rf_in = NULL;
+    FILE * rf_out = NULL;
+    char const * slave = NULL;
+
+    for( int i = 1; i < argc; i++ )
+    {
+        bool has_arg = ( i + 1 < argc );
+
+        if( strcmp( argv[i], "-t" ) == 0 )
+        {
+            test = true;
+        }
+        else if( ( strcmp( argv[i], "-l" ) == 0 ) && has_arg )
+        {
+            loss_pct = atoi( argv[++i] );
+        }
+        else if( ( strcmp( argv[i], "-r" ) == 0 ) && has_arg )
+        {
+            rssi = atoi( argv[++i] );
+        }
+        else if( ( strcmp( argv[i], "-n" ) == 0 ) && has_arg )
+        {
+            frames = strtoul( argv[++i], NULL, 10 );
+        }
+        else if( ( strcmp( argv[i], "-i" ) == 0 ) && has_arg )
+        {
+            if( !( rf_in = fopen( argv[++i], "rb" ) ) )
+            {
+                perror( argv[i] );
+                return EXIT_FAILURE;
+            }
+        }
+        else if( ( strcmp( argv[i], "-o" ) == 0 ) && has_arg )
+        {
+            if( !( rf_out = fopen( argv[++i], "wb" ) ) )
+            {
+                perror( argv[i] );
+                return EXIT_FAILURE;
+            }
+        }
+        else
+        {
+            fprintf( stderr, "usage: %s [-t] [-l loss%%] [-r rssi] [-n frames] [-i rf_in] [-o rf_out]\n", argv[0] );
+            return EXIT_FAILURE;
+        }
+    }
+
+    int fd = open_pty( slave );
+    if( fd < 0 )
+    {
+        return EXIT_FAILURE;
+    }
+
+    XbeeEmu emu( fd, loss_pct, rssi );
+    emu.rf_out = rf_out;
+    srand( 1 );
+
+    printf( "xbee on %s\n", slave );
+    fflush( stdout );
+
+    int result = test ? run_test( emu, slave, frames ) : run_emu( emu, rf_in );
+
+    if( rf_out )
+    {
+        fclose( rf_out );
+    }
+    close( fd );
+
+    return result;
+}